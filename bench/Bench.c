@@ -0,0 +1,1203 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <float.h>
+
+#include "../include/Space.h"
+#include "../include/SpaceSimd.h"
+#include "../include/SpaceBatch.h"
+#include "../include/Culling.h"
+#include "../include/Bvh.h"
+#include "../include/RenderQueue.h"
+#include "../include/RangeAllocator.h"
+#include "../include/VertexFormat.h"
+#include "../include/MeshOptimize.h"
+#include "../include/Lod.h"
+
+#define BENCH_INPUT_COUNT 64
+#define BENCH_INPUT_MASK (BENCH_INPUT_COUNT - 1)
+#define BENCH_BATCH_SIZE 4096
+#define BENCH_SCENE_SIZE 100000
+#define BENCH_RANGE_COUNT 1024
+#define BENCH_GRID_SIZE 32
+#define BENCH_GRID_VERTICES ((BENCH_GRID_SIZE + 1) * (BENCH_GRID_SIZE + 1))
+#define BENCH_GRID_INDICES (BENCH_GRID_SIZE * BENCH_GRID_SIZE * 6)
+
+typedef void (*BenchFunction)(size_t iterations);
+
+typedef struct
+{
+    const char* name;
+    BenchFunction run;
+    size_t itemsPerOp;
+    size_t opsDivisor;
+} Benchmark;
+
+typedef struct
+{
+    size_t iterations;
+    size_t samples;
+    size_t warmup;
+    bool json;
+    const char* filter;
+} BenchOptions;
+
+// The benchmark binary is linked with --wrap for the allocator entry points,
+// so every heap allocation made by the math code is counted here.
+static size_t allocationCount = 0;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* pointer, size_t size);
+
+void* __wrap_malloc(size_t size)
+{
+    allocationCount++;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size)
+{
+    allocationCount++;
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* pointer, size_t size)
+{
+    allocationCount++;
+    return __real_realloc(pointer, size);
+}
+
+static inline void consume(const void* pointer)
+{
+    __asm__ volatile("" : : "r"(pointer) : "memory");
+}
+
+static inline void consumeFloat(float value)
+{
+    consume(&value);
+}
+
+static Vec2 vec2Inputs[BENCH_INPUT_COUNT];
+static Vec3 vec3Inputs[BENCH_INPUT_COUNT];
+static Mat4 mat4Inputs[BENCH_INPUT_COUNT];
+static Mat4 batchMatrices[BENCH_INPUT_COUNT];
+static Affine affineInputs[BENCH_INPUT_COUNT];
+static Quat quatInputs[BENCH_INPUT_COUNT];
+static Quat quatOutputs[BENCH_INPUT_COUNT];
+static Affine affineOutputs[BENCH_INPUT_COUNT];
+
+static Vec3 batchPoints[BENCH_BATCH_SIZE];
+static Vec3 batchOther[BENCH_BATCH_SIZE];
+static Vec3 batchOutput[BENCH_BATCH_SIZE];
+static float batchScalars[BENCH_BATCH_SIZE];
+static float soaX[BENCH_BATCH_SIZE], soaY[BENCH_BATCH_SIZE], soaZ[BENCH_BATCH_SIZE];
+static float soaOtherX[BENCH_BATCH_SIZE], soaOtherY[BENCH_BATCH_SIZE], soaOtherZ[BENCH_BATCH_SIZE];
+static float soaOutX[BENCH_BATCH_SIZE], soaOutY[BENCH_BATCH_SIZE], soaOutZ[BENCH_BATCH_SIZE];
+
+static Aabb sceneBounds[BENCH_SCENE_SIZE];
+static uint32_t sceneVisible[BENCH_SCENE_SIZE];
+static uint8_t scenePlaneCache[FRUSTUM_CACHE_SIZE(BENCH_SCENE_SIZE)];
+static Frustum sceneFrustum;
+static Bvh sceneBvh;
+static uint32_t sceneOrder[BENCH_SCENE_SIZE];
+static uint8_t sceneLevels[BENCH_SCENE_SIZE];
+static LodView sceneLodView;
+static const MeshLod sceneLods[] =
+{
+    { 0, 36, 0.f, 0 },
+    { 36, 18, 0.002f, 0 },
+    { 54, 9, 0.01f, 0 },
+    { 63, 3, 0.05f, 0 },
+};
+
+static RenderQueue benchQueue;
+static RenderSortEntry sortEntries[BENCH_BATCH_SIZE];
+
+static RangeAllocator benchRanges;
+static RangeBlock liveRanges[BENCH_RANGE_COUNT];
+static uint32_t rangeSizes[BENCH_RANGE_COUNT];
+
+static uint32_t gridIndices[BENCH_GRID_INDICES];
+static uint32_t gridOptimized[BENCH_GRID_INDICES];
+static uint16_t halfOutputs[BENCH_BATCH_SIZE];
+
+static float randomFloat(float min, float max)
+{
+    return min + (max - min) * ((float)rand() / (float)RAND_MAX);
+}
+
+// A regular grid with its triangles shuffled, the worst case for the
+// post-transform cache.
+static void setupGrid(void)
+{
+    size_t index = 0;
+    for (uint32_t y = 0; y < BENCH_GRID_SIZE; y++)
+    {
+        for (uint32_t x = 0; x < BENCH_GRID_SIZE; x++)
+        {
+            const uint32_t corner = y * (BENCH_GRID_SIZE + 1) + x;
+            const uint32_t quad[6] = { corner, corner + BENCH_GRID_SIZE + 1, corner + BENCH_GRID_SIZE + 2, corner, corner + BENCH_GRID_SIZE + 2, corner + 1 };
+            memcpy(&gridIndices[index], quad, sizeof(quad));
+            index += 6;
+        }
+    }
+    for (size_t t = BENCH_GRID_INDICES / 3 - 1; t > 0; t--)
+    {
+        const size_t other = (size_t)rand() % (t + 1);
+        for (int k = 0; k < 3; k++)
+        {
+            const uint32_t swap = gridIndices[3 * t + k];
+            gridIndices[3 * t + k] = gridIndices[3 * other + k];
+            gridIndices[3 * other + k] = swap;
+        }
+    }
+}
+
+static void setupInputs(void)
+{
+    srand(1234);
+    for (int i = 0; i < BENCH_INPUT_COUNT; i++)
+    {
+        vec2Inputs[i] = vec2(randomFloat(-10.f, 10.f), randomFloat(-10.f, 10.f));
+        vec3Inputs[i] = vec3(randomFloat(-10.f, 10.f), randomFloat(-10.f, 10.f), randomFloat(-10.f, 10.f));
+        for (int j = 0; j < 16; j++)
+            (&mat4Inputs[i][0][0])[j] = randomFloat(-1.f, 1.f);
+        affine_from_mat4(&mat4Inputs[i], &affineInputs[i]);
+        quatInputs[i] = quat_fromAxisAngle(vec3Inputs[i], randomFloat(-180.f, 180.f));
+    }
+
+    for (int i = 0; i < BENCH_BATCH_SIZE; i++)
+    {
+        batchPoints[i] = vec3(randomFloat(-10.f, 10.f), randomFloat(-10.f, 10.f), randomFloat(-10.f, 10.f));
+        batchOther[i] = vec3(randomFloat(-10.f, 10.f), randomFloat(-10.f, 10.f), randomFloat(-10.f, 10.f));
+        soaX[i] = batchPoints[i].x;
+        soaY[i] = batchPoints[i].y;
+        soaZ[i] = batchPoints[i].z;
+        soaOtherX[i] = batchOther[i].x;
+        soaOtherY[i] = batchOther[i].y;
+        soaOtherZ[i] = batchOther[i].z;
+    }
+
+    for (int i = 0; i < BENCH_SCENE_SIZE; i++)
+    {
+        const Vec3 center = vec3(randomFloat(-200.f, 200.f), randomFloat(-20.f, 20.f), randomFloat(-200.f, 200.f));
+        const Vec3 halfSize = vec3(0.5f, 0.5f, 0.5f);
+        sceneBounds[i].min = vec3_sub(center, halfSize);
+        sceneBounds[i].max = vec3_add(center, halfSize);
+    }
+
+    Mat4 view;
+    Mat4 projection;
+    Mat4 cameraMatrix;
+    mat4_lookAt_inplace(&view, vec3(0.f, 0.f, 0.f), vec3(0.f, 0.f, -1.f), vec3(0.f, 1.f, 0.f));
+    mat4_perspective_inplace(&projection, 60.f, 4.f / 3.f, 0.01f, 100.f);
+    mat4_multiply_to(&view, &projection, &cameraMatrix);
+    frustum_extract(&sceneFrustum, &cameraMatrix);
+    sceneBvh = bvh_build(sceneBounds, BENCH_SCENE_SIZE, 1);
+    for (uint32_t i = 0; i < BENCH_SCENE_SIZE; i++)
+    {
+        sceneOrder[i] = i;
+    }
+    sceneLodView = lodView_create(vec3(0.f, 0.f, 0.f), 60.f, 4.f / 3.f, 1280.f, LOD_DEFAULT_THRESHOLD, LOD_DEFAULT_HYSTERESIS);
+
+    benchQueue = renderQueue_create(4);
+    for (int i = 0; i < BENCH_BATCH_SIZE; i++)
+    {
+        RenderCommand command = { 0 };
+        command.program = 1 + rand() % 8;
+        command.vertexArray = 1 + rand() % 64;
+        command.key = renderKey(
+            (RenderPass)(rand() % 2),
+            command.program,
+            command.vertexArray,
+            rand() % 256,
+            renderKey_depth(randomFloat(0.f, 1.f), false)
+        );
+        renderCommandBuffer_push(renderQueue_getBuffer(&benchQueue, i), &command);
+    }
+    renderQueue_sort(&benchQueue);
+
+    // Enough headroom that best fit always succeeds, so each op is one free
+    // plus one allocation against a fragmented free list.
+    setupGrid();
+
+    benchRanges = rangeAllocator_create(BENCH_RANGE_COUNT * 512);
+    for (int i = 0; i < BENCH_RANGE_COUNT; i++)
+    {
+        rangeSizes[i] = 1 + rand() % 256;
+        liveRanges[i].size = rangeSizes[i];
+        rangeAllocator_allocate(&benchRanges, liveRanges[i].size, 1, &liveRanges[i].offset);
+    }
+}
+
+static void rangeAllocatorChurn(size_t i)
+{
+    RangeBlock* range = &liveRanges[i % BENCH_RANGE_COUNT];
+    rangeAllocator_free(&benchRanges, range->offset, range->size);
+    range->size = rangeSizes[(i * 7) % BENCH_RANGE_COUNT];
+    if (!rangeAllocator_allocate(&benchRanges, range->size, 1, &range->offset))
+    {
+        range->size = 0;
+    }
+}
+
+#define INPUT_INDEX(i) ((i) & BENCH_INPUT_MASK)
+#define NEXT_INDEX(i) (((i) + 1) & BENCH_INPUT_MASK)
+
+#define BENCH_VALUE(name, expression)                     \
+    static void bench_##name(size_t iterations)           \
+    {                                                     \
+        for (size_t i = 0; i < iterations; i++)           \
+        {                                                 \
+            __typeof__(expression) result = (expression); \
+            consume(&result);                             \
+        }                                                 \
+    }
+
+#define BENCH_STATEMENT(name, statement)        \
+    static void bench_##name(size_t iterations) \
+    {                                           \
+        for (size_t i = 0; i < iterations; i++) \
+        {                                       \
+            statement;                          \
+        }                                       \
+    }
+
+#define BENCH_ALLOCATING(name, expression)      \
+    static void bench_##name(size_t iterations) \
+    {                                           \
+        for (size_t i = 0; i < iterations; i++) \
+        {                                       \
+            Mat4* result = (expression);        \
+            consume(result);                    \
+            free(result);                       \
+        }                                       \
+    }
+
+BENCH_VALUE(vec2_length, vec2_length(vec2Inputs[INPUT_INDEX(i)]))
+BENCH_VALUE(vec2_normalize, vec2_normalize(vec2Inputs[INPUT_INDEX(i)]))
+BENCH_STATEMENT(vec2_normalize_inplace, Vec2 vec = vec2Inputs[INPUT_INDEX(i)]; vec2_normalize_inplace(&vec); consume(&vec))
+BENCH_VALUE(vec2_add, vec2_add(vec2Inputs[INPUT_INDEX(i)], vec2Inputs[NEXT_INDEX(i)]))
+BENCH_STATEMENT(vec2_add_inplace, Vec2 vec = vec2Inputs[INPUT_INDEX(i)]; vec2_add_inplace(&vec, vec2Inputs[NEXT_INDEX(i)]); consume(&vec))
+BENCH_VALUE(vec2_sub, vec2_sub(vec2Inputs[INPUT_INDEX(i)], vec2Inputs[NEXT_INDEX(i)]))
+BENCH_STATEMENT(vec2_sub_inplace, Vec2 vec = vec2Inputs[INPUT_INDEX(i)]; vec2_sub_inplace(&vec, vec2Inputs[NEXT_INDEX(i)]); consume(&vec))
+BENCH_VALUE(vec2_scale, vec2_scale(vec2Inputs[INPUT_INDEX(i)], 1.5f))
+BENCH_STATEMENT(vec2_scale_inplace, Vec2 vec = vec2Inputs[INPUT_INDEX(i)]; vec2_scale_inplace(&vec, 1.5f); consume(&vec))
+BENCH_VALUE(vec2_div, vec2_div(vec2Inputs[INPUT_INDEX(i)], 1.5f))
+BENCH_STATEMENT(vec2_div_inplace, Vec2 vec = vec2Inputs[INPUT_INDEX(i)]; vec2_div_inplace(&vec, 1.5f); consume(&vec))
+BENCH_VALUE(vec2_dot, vec2_dot(vec2Inputs[INPUT_INDEX(i)], vec2Inputs[NEXT_INDEX(i)]))
+
+BENCH_VALUE(vec3_length, vec3_length(vec3Inputs[INPUT_INDEX(i)]))
+BENCH_VALUE(vec3_normalize, vec3_normalize(vec3Inputs[INPUT_INDEX(i)]))
+BENCH_STATEMENT(vec3_normalize_inplace, Vec3 vec = vec3Inputs[INPUT_INDEX(i)]; vec3_normalize_inplace(&vec); consume(&vec))
+BENCH_VALUE(vec3_add, vec3_add(vec3Inputs[INPUT_INDEX(i)], vec3Inputs[NEXT_INDEX(i)]))
+BENCH_STATEMENT(vec3_add_inplace, Vec3 vec = vec3Inputs[INPUT_INDEX(i)]; vec3_add_inplace(&vec, vec3Inputs[NEXT_INDEX(i)]); consume(&vec))
+BENCH_VALUE(vec3_sub, vec3_sub(vec3Inputs[INPUT_INDEX(i)], vec3Inputs[NEXT_INDEX(i)]))
+BENCH_STATEMENT(vec3_sub_inplace, Vec3 vec = vec3Inputs[INPUT_INDEX(i)]; vec3_sub_inplace(&vec, vec3Inputs[NEXT_INDEX(i)]); consume(&vec))
+BENCH_VALUE(vec3_scale, vec3_scale(vec3Inputs[INPUT_INDEX(i)], 1.5f))
+BENCH_STATEMENT(vec3_scale_inplace, Vec3 vec = vec3Inputs[INPUT_INDEX(i)]; vec3_scale_inplace(&vec, 1.5f); consume(&vec))
+BENCH_VALUE(vec3_div, vec3_div(vec3Inputs[INPUT_INDEX(i)], 1.5f))
+BENCH_STATEMENT(vec3_div_inplace, Vec3 vec = vec3Inputs[INPUT_INDEX(i)]; vec3_div_inplace(&vec, 1.5f); consume(&vec))
+BENCH_VALUE(vec3_dot, vec3_dot(vec3Inputs[INPUT_INDEX(i)], vec3Inputs[NEXT_INDEX(i)]))
+BENCH_VALUE(vec3_cross, vec3_cross(vec3Inputs[INPUT_INDEX(i)], vec3Inputs[NEXT_INDEX(i)]))
+
+static Mat4 mat4Output;
+
+BENCH_STATEMENT(mat4, Mat4* mat = mat4(1.f); consume(mat); free(mat))
+BENCH_STATEMENT(mat4_load_diagonal, mat4_load_diagonal(&mat4Output, 2.f); consume(&mat4Output))
+BENCH_STATEMENT(mat4_load_identity, mat4_load_identity(&mat4Output); consume(&mat4Output))
+BENCH_STATEMENT(mat4_copy, mat4_copy(&mat4Inputs[INPUT_INDEX(i)], &mat4Output); consume(&mat4Output))
+BENCH_ALLOCATING(mat4_scale, mat4_scale(&mat4Inputs[INPUT_INDEX(i)], 1.5f))
+BENCH_STATEMENT(mat4_scale_inplace, mat4_scale_inplace(&mat4Output, 1.0001f); consume(&mat4Output))
+BENCH_STATEMENT(mat4_scale_to, mat4_scale_to(&mat4Inputs[INPUT_INDEX(i)], 1.5f, &mat4Output); consume(&mat4Output))
+BENCH_ALLOCATING(mat4_multiply, mat4_multiply(&mat4Inputs[INPUT_INDEX(i)], &mat4Inputs[NEXT_INDEX(i)]))
+BENCH_STATEMENT(mat4_multiply_inplace, mat4_copy(&mat4Inputs[INPUT_INDEX(i)], &mat4Output); mat4_multiply_inplace(&mat4Output, &mat4Inputs[NEXT_INDEX(i)]); consume(&mat4Output))
+BENCH_STATEMENT(mat4_multiply_to, mat4_multiply_to(&mat4Inputs[INPUT_INDEX(i)], &mat4Inputs[NEXT_INDEX(i)], &mat4Output); consume(&mat4Output))
+BENCH_ALLOCATING(mat4_multiply_many, mat4_multiply_many(3, &mat4Inputs[INPUT_INDEX(i)], &mat4Inputs[NEXT_INDEX(i)], &mat4Inputs[INPUT_INDEX(i + 2)]))
+BENCH_STATEMENT(mat4_multiply_many_inplace, mat4_multiply_many_inplace(&mat4Output, 3, &mat4Inputs[INPUT_INDEX(i)], &mat4Inputs[NEXT_INDEX(i)], &mat4Inputs[INPUT_INDEX(i + 2)]); consume(&mat4Output))
+BENCH_ALLOCATING(mat4_translate, mat4_translate(&mat4Inputs[INPUT_INDEX(i)], vec3Inputs[INPUT_INDEX(i)]))
+BENCH_STATEMENT(mat4_translate_inplace, mat4_translate_inplace(&mat4Output, vec3Inputs[INPUT_INDEX(i)]); consume(&mat4Output))
+BENCH_STATEMENT(mat4_translate_to, mat4_translate_to(&mat4Inputs[INPUT_INDEX(i)], vec3Inputs[INPUT_INDEX(i)], &mat4Output); consume(&mat4Output))
+BENCH_ALLOCATING(mat4_rotate, mat4_rotate(&mat4Inputs[INPUT_INDEX(i)], 30.f, vec3Inputs[INPUT_INDEX(i)]))
+BENCH_STATEMENT(mat4_rotate_inplace, mat4_copy(&mat4Inputs[INPUT_INDEX(i)], &mat4Output); mat4_rotate_inplace(&mat4Output, 30.f, vec3Inputs[INPUT_INDEX(i)]); consume(&mat4Output))
+BENCH_STATEMENT(mat4_rotate_to, mat4_rotate_to(&mat4Inputs[INPUT_INDEX(i)], 30.f, vec3Inputs[INPUT_INDEX(i)], &mat4Output); consume(&mat4Output))
+BENCH_ALLOCATING(mat4_ortho, mat4_ortho(-1.f, 1.f, -1.f, 1.f, 0.1f, 100.f + (float)INPUT_INDEX(i)))
+BENCH_STATEMENT(mat4_ortho_inplace, mat4_ortho_inplace(&mat4Output, -1.f, 1.f, -1.f, 1.f, 0.1f, 100.f + (float)INPUT_INDEX(i)); consume(&mat4Output))
+BENCH_ALLOCATING(mat4_perspective, mat4_perspective(60.f, 4.f / 3.f, 0.01f, 100.f + (float)INPUT_INDEX(i)))
+BENCH_STATEMENT(mat4_perspective_inplace, mat4_perspective_inplace(&mat4Output, 60.f, 4.f / 3.f, 0.01f, 100.f + (float)INPUT_INDEX(i)); consume(&mat4Output))
+BENCH_ALLOCATING(mat4_lookAt, mat4_lookAt(vec3Inputs[INPUT_INDEX(i)], vec3Inputs[NEXT_INDEX(i)], vec3(0.f, 1.f, 0.f)))
+BENCH_STATEMENT(mat4_lookAt_inplace, mat4_lookAt_inplace(&mat4Output, vec3Inputs[INPUT_INDEX(i)], vec3Inputs[NEXT_INDEX(i)], vec3(0.f, 1.f, 0.f)); consume(&mat4Output))
+BENCH_STATEMENT(mat4_transpose_inplace, mat4_transpose_inplace(&mat4Output); consume(&mat4Output))
+BENCH_STATEMENT(mat4_transpose_to, mat4_transpose_to(&mat4Inputs[INPUT_INDEX(i)], &mat4Output); consume(&mat4Output))
+BENCH_VALUE(mat4_transform_point, mat4_transform_point(&mat4Inputs[INPUT_INDEX(i)], vec3Inputs[INPUT_INDEX(i)]))
+
+static Affine affineOutput;
+static Mat3 mat3Output;
+BENCH_STATEMENT(affine_multiply_to, affine_multiply_to(&affineInputs[INPUT_INDEX(i)], &affineInputs[NEXT_INDEX(i)], &affineOutput); consume(&affineOutput))
+BENCH_VALUE(affine_transform_point, affine_transform_point(&affineInputs[INPUT_INDEX(i)], vec3Inputs[INPUT_INDEX(i)]))
+BENCH_VALUE(affine_transform_direction, affine_transform_direction(&affineInputs[INPUT_INDEX(i)], vec3Inputs[INPUT_INDEX(i)]))
+BENCH_STATEMENT(affine_inverse_rigid_to, affine_inverse_rigid_to(&affineInputs[INPUT_INDEX(i)], &affineOutput); consume(&affineOutput))
+BENCH_STATEMENT(affine_inverse_to, affine_inverse_to(&affineInputs[INPUT_INDEX(i)], &affineOutput); consume(&affineOutput))
+BENCH_STATEMENT(affine_normal_matrix_to, affine_normal_matrix_to(&affineInputs[INPUT_INDEX(i)], &mat3Output); consume(&mat3Output))
+BENCH_STATEMENT(affine_to_mat4, affine_to_mat4(&affineInputs[INPUT_INDEX(i)], &mat4Output); consume(&mat4Output))
+
+static Vec3 vec3Output;
+BENCH_ALLOCATING(mat4_inverse, mat4_inverse(&mat4Inputs[INPUT_INDEX(i)]))
+BENCH_STATEMENT(mat4_inverse_inplace, mat4_copy(&mat4Inputs[INPUT_INDEX(i)], &mat4Output); mat4_inverse_inplace(&mat4Output); consume(&mat4Output))
+BENCH_STATEMENT(mat4_inverse_to, mat4_inverse_to(&mat4Inputs[INPUT_INDEX(i)], &mat4Output); consume(&mat4Output))
+BENCH_STATEMENT(mat4_normal_matrix_to, mat4_normal_matrix_to(&mat4Inputs[INPUT_INDEX(i)], &mat3Output); consume(&mat3Output))
+BENCH_STATEMENT(mat4_decompose, mat4_decompose(&mat4Inputs[INPUT_INDEX(i)], &vec3Output, &mat3Output, &vec3Output); consume(&mat3Output))
+BENCH_STATEMENT(mat4_batch_inverse, consumeFloat((float)mat4_batch_inverse(mat4Inputs, batchMatrices, BENCH_INPUT_COUNT)); consume(batchMatrices))
+
+static void benchKernelMultiply(const char* name, size_t iterations)
+{
+    const Mat4Kernels* kernels = mat4_kernels_find(name);
+    if (kernels == NULL)
+        return;
+    for (size_t i = 0; i < iterations; i++)
+    {
+        kernels->multiply(&mat4Inputs[INPUT_INDEX(i)], &mat4Inputs[NEXT_INDEX(i)], &mat4Output);
+        consume(&mat4Output);
+    }
+}
+
+static void benchKernelInverse(const char* name, size_t iterations)
+{
+    const Mat4Kernels* kernels = mat4_kernels_find(name);
+    if (kernels == NULL)
+        return;
+    for (size_t i = 0; i < iterations; i++)
+    {
+        kernels->inverse(&mat4Inputs[INPUT_INDEX(i)], &mat4Output);
+        consume(&mat4Output);
+    }
+}
+
+static void bench_kernel_scalar_multiply(size_t iterations) { benchKernelMultiply("scalar", iterations); }
+static void bench_kernel_sse_multiply(size_t iterations) { benchKernelMultiply("sse", iterations); }
+static void bench_kernel_avx2_multiply(size_t iterations) { benchKernelMultiply("avx2", iterations); }
+static void bench_kernel_neon_multiply(size_t iterations) { benchKernelMultiply("neon", iterations); }
+static void bench_kernel_scalar_inverse(size_t iterations) { benchKernelInverse("scalar", iterations); }
+static void bench_kernel_sse_inverse(size_t iterations) { benchKernelInverse("sse", iterations); }
+static void bench_kernel_avx2_inverse(size_t iterations) { benchKernelInverse("avx2", iterations); }
+static void bench_kernel_neon_inverse(size_t iterations) { benchKernelInverse("neon", iterations); }
+
+static Vec3Soa soaPoints() { Vec3Soa soa = { soaX, soaY, soaZ }; return soa; }
+static Vec3Soa soaOther() { Vec3Soa soa = { soaOtherX, soaOtherY, soaOtherZ }; return soa; }
+static Vec3Soa soaOutput() { Vec3Soa soa = { soaOutX, soaOutY, soaOutZ }; return soa; }
+
+BENCH_STATEMENT(vec3soa_transform_points, vec3soa_transform_points(&mat4Inputs[INPUT_INDEX(i)], soaPoints(), soaOutput(), BENCH_BATCH_SIZE); consume(soaOutX))
+BENCH_STATEMENT(vec3soa_normalize, vec3soa_normalize(soaPoints(), soaOutput(), BENCH_BATCH_SIZE); consume(soaOutX))
+BENCH_STATEMENT(vec3soa_dot, vec3soa_dot(soaPoints(), soaOther(), batchScalars, BENCH_BATCH_SIZE); consume(batchScalars))
+BENCH_STATEMENT(vec3soa_cross, vec3soa_cross(soaPoints(), soaOther(), soaOutput(), BENCH_BATCH_SIZE); consume(soaOutX))
+BENCH_VALUE(vec3soa_aabb, vec3soa_aabb(soaPoints(), BENCH_BATCH_SIZE))
+BENCH_STATEMENT(vec3_batch_transform_points, vec3_batch_transform_points(&mat4Inputs[INPUT_INDEX(i)], batchPoints, batchOutput, BENCH_BATCH_SIZE); consume(batchOutput))
+BENCH_STATEMENT(vec3_batch_normalize, vec3_batch_normalize(batchPoints, batchOutput, BENCH_BATCH_SIZE); consume(batchOutput))
+BENCH_STATEMENT(vec3_batch_dot, vec3_batch_dot(batchPoints, batchOther, batchScalars, BENCH_BATCH_SIZE); consume(batchScalars))
+BENCH_STATEMENT(vec3_batch_cross, vec3_batch_cross(batchPoints, batchOther, batchOutput, BENCH_BATCH_SIZE); consume(batchOutput))
+BENCH_VALUE(vec3_batch_aabb, vec3_batch_aabb(batchPoints, BENCH_BATCH_SIZE))
+BENCH_STATEMENT(vec3_loop_transform_points, for (int j = 0; j < BENCH_BATCH_SIZE; j++) batchOutput[j] = mat4_transform_point(&mat4Inputs[INPUT_INDEX(i)], batchPoints[j]); consume(batchOutput))
+BENCH_STATEMENT(vec3_loop_normalize, for (int j = 0; j < BENCH_BATCH_SIZE; j++) batchOutput[j] = vec3_normalize(batchPoints[j]); consume(batchOutput))
+
+BENCH_STATEMENT(frustum_cullAabbs, consumeFloat((float)frustum_cullAabbs(&sceneFrustum, sceneBounds, BENCH_SCENE_SIZE, scenePlaneCache, sceneVisible)))
+BENCH_STATEMENT(bvh_cullFrustum, consumeFloat((float)bvh_cullFrustum(&sceneBvh, sceneBounds, &sceneFrustum, sceneVisible)))
+BENCH_STATEMENT(bvh_refit, bvh_refit(&sceneBvh, sceneBounds); consume(sceneBvh.nodes))
+BENCH_STATEMENT(lod_selectBatch, lod_selectBatch(&sceneLodView, sceneLods, 4, sceneBounds, sceneOrder, BENCH_SCENE_SIZE, sceneLevels); consume(sceneLevels))
+
+BENCH_VALUE(quat_fromAxisAngle, quat_fromAxisAngle(vec3(0.f, 1.f, 0.f), vec3Inputs[INPUT_INDEX(i)].x))
+BENCH_VALUE(quat_fromAxisAngle_fast, quat_fromAxisAngle_fast(vec3(0.f, 1.f, 0.f), vec3Inputs[INPUT_INDEX(i)].x))
+BENCH_VALUE(quat_multiply, quat_multiply(quatInputs[INPUT_INDEX(i)], quatInputs[NEXT_INDEX(i)]))
+BENCH_VALUE(quat_normalize, quat_normalize(quatInputs[INPUT_INDEX(i)]))
+BENCH_VALUE(quat_rotate, quat_rotate(quatInputs[INPUT_INDEX(i)], vec3Inputs[INPUT_INDEX(i)]))
+BENCH_VALUE(quat_nlerp, quat_nlerp(quatInputs[INPUT_INDEX(i)], quatInputs[NEXT_INDEX(i)], 0.3f))
+BENCH_VALUE(quat_slerp, quat_slerp(quatInputs[INPUT_INDEX(i)], quatInputs[NEXT_INDEX(i)], 0.3f))
+BENCH_STATEMENT(quat_toMat4, quat_toMat4(quatInputs[INPUT_INDEX(i)], &mat4Output); consume(&mat4Output))
+BENCH_VALUE(quat_fromMat4, quat_fromMat4(&mat4Inputs[INPUT_INDEX(i)]))
+BENCH_STATEMENT(quat_batch_multiply, quat_batch_multiply(quatInputs, quatOutputs, quatOutputs, BENCH_INPUT_COUNT); consume(quatOutputs))
+BENCH_STATEMENT(quat_batch_toAffine, quat_batch_toAffine(quatInputs, vec3Inputs, affineOutputs, BENCH_INPUT_COUNT); consume(affineOutputs))
+BENCH_STATEMENT(mat4_loop_rotate, for (int j = 0; j < BENCH_INPUT_COUNT; j++) { mat4_load_identity(&batchMatrices[j]); mat4_rotate_inplace(&batchMatrices[j], 0.5f, vec3Inputs[j]); } consume(batchMatrices))
+
+static int compareSortEntries(const void* a, const void* b)
+{
+    const uint64_t first = ((const RenderSortEntry*)a)->key;
+    const uint64_t second = ((const RenderSortEntry*)b)->key;
+    return (first > second) - (first < second);
+}
+
+BENCH_STATEMENT(renderQueue_sort, renderQueue_sort(&benchQueue); consume(benchQueue.entries))
+BENCH_STATEMENT(meshOptimize_vertexCache, meshOptimize_vertexCache(gridOptimized, gridIndices, BENCH_GRID_INDICES, BENCH_GRID_VERTICES); consume(gridOptimized))
+BENCH_VALUE(meshOptimize_acmr, meshOptimize_acmr(gridIndices, BENCH_GRID_INDICES, BENCH_GRID_VERTICES, 16))
+BENCH_STATEMENT(vertexFormat_packHalf, for (int j = 0; j < BENCH_BATCH_SIZE; j++) { halfOutputs[j] = vertexFormat_packHalf(batchScalars[j]); } consume(halfOutputs))
+BENCH_STATEMENT(rangeAllocator_churn, rangeAllocatorChurn(i); consume(&benchRanges))
+BENCH_STATEMENT(renderQueue_qsort, for (int j = 0; j < BENCH_BATCH_SIZE; j++) { sortEntries[j].key = benchQueue.commands[j].key; sortEntries[j].index = j; } qsort(sortEntries, BENCH_BATCH_SIZE, sizeof(RenderSortEntry), compareSortEntries); consume(sortEntries))
+
+static void bench_camera_rotation_trig(size_t iterations)
+{
+    // The yaw/pitch update in camera_recomputeRotation.
+    float yaw = -90.f;
+    float pitch = 0.f;
+    Vec3 front = vec3(0.f, 0.f, -1.f);
+    for (size_t i = 0; i < iterations; i++)
+    {
+        yaw = fmodf(yaw + vec3Inputs[INPUT_INDEX(i)].x * 0.01f, 360.f);
+        pitch = fminf(fmaxf(pitch + vec3Inputs[INPUT_INDEX(i)].y * 0.01f, -89.f), 89.f);
+        front.x = cosf(radians(yaw)) * cosf(radians(pitch));
+        front.y = sinf(radians(pitch));
+        front.z = sinf(radians(yaw)) * cosf(radians(pitch));
+        front = vec3_normalize(front);
+        consume(&front);
+    }
+}
+
+static void bench_camera_rotation_quaternion(size_t iterations)
+{
+    // The incremental quaternion update used by the camera's quaternion mode.
+    Quat orientation = quat_identity();
+    for (size_t i = 0; i < iterations; i++)
+    {
+        const Quat yaw = quat_fromAxisAngle_fast(vec3(0.f, 1.f, 0.f), -vec3Inputs[INPUT_INDEX(i)].x * 0.01f);
+        const Quat pitch = quat_fromAxisAngle_fast(vec3(1.f, 0.f, 0.f), vec3Inputs[INPUT_INDEX(i)].y * 0.01f);
+        orientation = quat_normalize(quat_multiply(quat_multiply(yaw, orientation), pitch));
+        const Vec3 front = quat_rotate(orientation, vec3(0.f, 0.f, -1.f));
+        consume(&front);
+    }
+}
+
+static void bench_camera_recomputeMatrix_quaternion(size_t iterations)
+{
+    Mat4 cameraMatrix;
+    for (size_t i = 0; i < iterations; i++)
+    {
+        Mat4 view;
+        Mat4 projection;
+        mat4_view_inplace(&view, vec3Inputs[INPUT_INDEX(i)], quatInputs[NEXT_INDEX(i)]);
+        mat4_perspective_inplace(&projection, 60.f, 4.f / 3.f, 0.01f, 100.f);
+        mat4_multiply_to(&view, &projection, &cameraMatrix);
+        consume(&cameraMatrix);
+    }
+}
+
+static void bench_camera_recomputeMatrix(size_t iterations)
+{
+    // Mirrors camera_recomputeMatrix without needing a window or GL context.
+    Mat4 cameraMatrix;
+    for (size_t i = 0; i < iterations; i++)
+    {
+        const Vec3 position = vec3Inputs[INPUT_INDEX(i)];
+        const Vec3 front = vec3_normalize(vec3Inputs[NEXT_INDEX(i)]);
+        Mat4 view;
+        Mat4 projection;
+        mat4_lookAt_inplace(&view, position, vec3_add(position, front), vec3(0.f, 1.f, 0.f));
+        mat4_perspective_inplace(&projection, 60.f, 4.f / 3.f, 0.01f, 100.f);
+        mat4_multiply_to(&view, &projection, &cameraMatrix);
+        consume(&cameraMatrix);
+    }
+}
+
+#define BENCH(name) { #name, bench_##name, 1, 1 }
+#define BENCH_BATCH(name, items, divisor) { #name, bench_##name, items, divisor }
+
+static const Benchmark benchmarks[] =
+{
+    BENCH(vec2_length),
+    BENCH(vec2_normalize),
+    BENCH(vec2_normalize_inplace),
+    BENCH(vec2_add),
+    BENCH(vec2_add_inplace),
+    BENCH(vec2_sub),
+    BENCH(vec2_sub_inplace),
+    BENCH(vec2_scale),
+    BENCH(vec2_scale_inplace),
+    BENCH(vec2_div),
+    BENCH(vec2_div_inplace),
+    BENCH(vec2_dot),
+    BENCH(vec3_length),
+    BENCH(vec3_normalize),
+    BENCH(vec3_normalize_inplace),
+    BENCH(vec3_add),
+    BENCH(vec3_add_inplace),
+    BENCH(vec3_sub),
+    BENCH(vec3_sub_inplace),
+    BENCH(vec3_scale),
+    BENCH(vec3_scale_inplace),
+    BENCH(vec3_div),
+    BENCH(vec3_div_inplace),
+    BENCH(vec3_dot),
+    BENCH(vec3_cross),
+    BENCH(mat4),
+    BENCH(mat4_load_diagonal),
+    BENCH(mat4_load_identity),
+    BENCH(mat4_copy),
+    BENCH(mat4_scale),
+    BENCH(mat4_scale_inplace),
+    BENCH(mat4_scale_to),
+    BENCH(mat4_multiply),
+    BENCH(mat4_multiply_inplace),
+    BENCH(mat4_multiply_to),
+    BENCH(mat4_multiply_many),
+    BENCH(mat4_multiply_many_inplace),
+    BENCH(mat4_translate),
+    BENCH(mat4_translate_inplace),
+    BENCH(mat4_translate_to),
+    BENCH(mat4_rotate),
+    BENCH(mat4_rotate_inplace),
+    BENCH(mat4_rotate_to),
+    BENCH(mat4_ortho),
+    BENCH(mat4_ortho_inplace),
+    BENCH(mat4_perspective),
+    BENCH(mat4_perspective_inplace),
+    BENCH(mat4_lookAt),
+    BENCH(mat4_lookAt_inplace),
+    BENCH(mat4_transpose_inplace),
+    BENCH(mat4_transpose_to),
+    BENCH(mat4_transform_point),
+    BENCH(affine_multiply_to),
+    BENCH(affine_transform_point),
+    BENCH(affine_transform_direction),
+    BENCH(affine_inverse_rigid_to),
+    BENCH(affine_inverse_to),
+    BENCH(affine_normal_matrix_to),
+    BENCH(affine_to_mat4),
+    BENCH(mat4_inverse),
+    BENCH(mat4_inverse_inplace),
+    BENCH(mat4_inverse_to),
+    BENCH(mat4_normal_matrix_to),
+    BENCH(mat4_decompose),
+    BENCH_BATCH(mat4_batch_inverse, BENCH_INPUT_COUNT, 1000),
+    BENCH(quat_fromAxisAngle),
+    BENCH(quat_fromAxisAngle_fast),
+    BENCH(quat_multiply),
+    BENCH(quat_normalize),
+    BENCH(quat_rotate),
+    BENCH(quat_nlerp),
+    BENCH(quat_slerp),
+    BENCH(quat_toMat4),
+    BENCH(quat_fromMat4),
+    BENCH_BATCH(quat_batch_multiply, BENCH_INPUT_COUNT, 1000),
+    BENCH_BATCH(quat_batch_toAffine, BENCH_INPUT_COUNT, 1000),
+    BENCH_BATCH(mat4_loop_rotate, BENCH_INPUT_COUNT, 1000),
+    BENCH(kernel_scalar_multiply),
+    BENCH(kernel_sse_multiply),
+    BENCH(kernel_avx2_multiply),
+    BENCH(kernel_neon_multiply),
+    BENCH(kernel_scalar_inverse),
+    BENCH(kernel_sse_inverse),
+    BENCH(kernel_avx2_inverse),
+    BENCH(kernel_neon_inverse),
+    BENCH_BATCH(vec3soa_transform_points, BENCH_BATCH_SIZE, 1000),
+    BENCH_BATCH(vec3soa_normalize, BENCH_BATCH_SIZE, 1000),
+    BENCH_BATCH(vec3soa_dot, BENCH_BATCH_SIZE, 1000),
+    BENCH_BATCH(vec3soa_cross, BENCH_BATCH_SIZE, 1000),
+    BENCH_BATCH(vec3soa_aabb, BENCH_BATCH_SIZE, 1000),
+    BENCH_BATCH(vec3_batch_transform_points, BENCH_BATCH_SIZE, 1000),
+    BENCH_BATCH(vec3_batch_normalize, BENCH_BATCH_SIZE, 1000),
+    BENCH_BATCH(vec3_batch_dot, BENCH_BATCH_SIZE, 1000),
+    BENCH_BATCH(vec3_batch_cross, BENCH_BATCH_SIZE, 1000),
+    BENCH_BATCH(vec3_batch_aabb, BENCH_BATCH_SIZE, 1000),
+    BENCH_BATCH(vec3_loop_transform_points, BENCH_BATCH_SIZE, 1000),
+    BENCH_BATCH(vec3_loop_normalize, BENCH_BATCH_SIZE, 1000),
+    BENCH_BATCH(frustum_cullAabbs, BENCH_SCENE_SIZE, 10000),
+    BENCH_BATCH(bvh_cullFrustum, BENCH_SCENE_SIZE, 10000),
+    BENCH_BATCH(bvh_refit, BENCH_SCENE_SIZE, 10000),
+    BENCH_BATCH(lod_selectBatch, BENCH_SCENE_SIZE, 10000),
+    BENCH_BATCH(renderQueue_sort, BENCH_BATCH_SIZE, 1000),
+    BENCH_BATCH(renderQueue_qsort, BENCH_BATCH_SIZE, 1000),
+    BENCH(rangeAllocator_churn),
+    BENCH_BATCH(meshOptimize_vertexCache, BENCH_GRID_INDICES / 3, 10000),
+    BENCH_BATCH(meshOptimize_acmr, BENCH_GRID_INDICES / 3, 1000),
+    BENCH_BATCH(vertexFormat_packHalf, BENCH_BATCH_SIZE, 1000),
+    BENCH(camera_recomputeMatrix),
+    BENCH(camera_recomputeMatrix_quaternion),
+    BENCH(camera_rotation_trig),
+    BENCH(camera_rotation_quaternion),
+};
+
+static double nowNanoseconds(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec * 1e9 + (double)time.tv_nsec;
+}
+
+static int compareDoubles(const void* a, const void* b)
+{
+    const double first = *(const double*)a;
+    const double second = *(const double*)b;
+    return (first > second) - (first < second);
+}
+
+static void runBenchmark(const Benchmark* benchmark, BenchOptions* options, bool first)
+{
+    size_t ops = options->iterations / benchmark->opsDivisor;
+    ops = ops > 0 ? ops : 1;
+
+    for (size_t i = 0; i < options->warmup; i++)
+        benchmark->run(ops);
+
+    double* samples = malloc(options->samples * sizeof(double));
+    if (samples == NULL)
+    {
+        fprintf(stderr, "Failed to allocate benchmark samples!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    const size_t allocationsBefore = allocationCount;
+    for (size_t i = 0; i < options->samples; i++)
+    {
+        const double start = nowNanoseconds();
+        benchmark->run(ops);
+        samples[i] = (nowNanoseconds() - start) / (double)ops;
+    }
+    const size_t allocations = allocationCount - allocationsBefore;
+
+    qsort(samples, options->samples, sizeof(double), compareDoubles);
+    const double median = samples[options->samples / 2];
+    const double p99 = samples[(options->samples * 99) / 100];
+    const double allocationsPerOp = (double)allocations / (double)(ops * options->samples);
+    const double itemsPerSecond = (median > 0.0) ? (double)benchmark->itemsPerOp * 1e9 / median : 0.0;
+    free(samples);
+
+    if (options->json)
+    {
+        printf(
+            "%s    {\"name\": \"%s\", \"ops\": %zu, \"samples\": %zu, \"ns_per_op_median\": %.3f, "
+            "\"ns_per_op_p99\": %.3f, \"allocs_per_op\": %.3f, \"items_per_op\": %zu, \"items_per_second\": %.0f}",
+            first ? "" : ",\n",
+            benchmark->name, ops, options->samples, median, p99, allocationsPerOp, benchmark->itemsPerOp, itemsPerSecond
+        );
+    }
+    else
+    {
+        printf(
+            "%s,%zu,%zu,%.3f,%.3f,%.3f,%zu,%.0f\n",
+            benchmark->name, ops, options->samples, median, p99, allocationsPerOp, benchmark->itemsPerOp, itemsPerSecond
+        );
+    }
+}
+
+// A result fails when its maximum error exceeds the bound; a zero bound is
+// only reported. Errors are relative, or in units in the last place of the
+// reference rounded to float.
+typedef struct
+{
+    const char* name;
+    const char* unit;
+    double bound;
+    double maxError;
+    double sumError;
+    size_t samples;
+} PrecisionResult;
+
+static void precision_record(PrecisionResult* result, double error)
+{
+    result->maxError = error > result->maxError ? error : result->maxError;
+    result->sumError += error;
+    result->samples++;
+}
+
+static bool printPrecision(const PrecisionResult* result)
+{
+    const bool passed = result->bound <= 0.0 || result->maxError <= result->bound;
+    printf(
+        "%s,%zu,%s,%.3e,%.3e,%.3e,%s\n",
+        result->name, result->samples, result->unit, result->maxError, result->sumError / (double)result->samples,
+        result->bound, passed ? "ok" : "FAIL"
+    );
+    return passed;
+}
+
+// Gauss-Jordan elimination with partial pivoting in double precision.
+static bool referenceInverse(Mat4* mat, double inverse[4][4])
+{
+    double augmented[4][8];
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 8; j++)
+            augmented[i][j] = j < 4 ? (double)(*mat)[i][j] : (double)(j - 4 == i);
+
+    for (int column = 0; column < 4; column++)
+    {
+        int pivot = column;
+        for (int row = column + 1; row < 4; row++)
+            if (fabs(augmented[row][column]) > fabs(augmented[pivot][column]))
+                pivot = row;
+        if (augmented[pivot][column] == 0.0)
+            return false;
+        for (int j = 0; j < 8; j++)
+        {
+            const double temp = augmented[column][j];
+            augmented[column][j] = augmented[pivot][j];
+            augmented[pivot][j] = temp;
+        }
+        const double divisor = augmented[column][column];
+        for (int j = 0; j < 8; j++)
+            augmented[column][j] /= divisor;
+        for (int row = 0; row < 4; row++)
+        {
+            if (row == column)
+                continue;
+            const double factor = augmented[row][column];
+            for (int j = 0; j < 8; j++)
+                augmented[row][j] -= factor * augmented[column][j];
+        }
+    }
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++)
+            inverse[i][j] = augmented[i][j + 4];
+    return true;
+}
+
+static void randomViewProjection(Mat4* mat)
+{
+    Mat4 view;
+    Mat4 projection;
+    const Vec3 eye = vec3(randomFloat(-100.f, 100.f), randomFloat(-100.f, 100.f), randomFloat(-100.f, 100.f));
+    mat4_lookAt_inplace(&view, eye, vec3_add(eye, vec3(randomFloat(-1.f, 1.f), randomFloat(-1.f, 1.f), randomFloat(-1.f, 1.f))), vec3(0.f, 1.f, 0.f));
+    mat4_perspective_inplace(&projection, randomFloat(30.f, 90.f), randomFloat(0.5f, 2.f), 0.1f, 1000.f);
+    mat4_multiply_to(&view, &projection, mat);
+}
+
+typedef enum
+{
+    MATRIX_MODEL,
+    MATRIX_NON_UNIFORM_SCALE,
+    MATRIX_NEAR_SINGULAR,
+    MATRIX_VIEW_PROJECTION,
+    MATRIX_FAMILY_COUNT,
+} MatrixFamily;
+
+// Bounds on the maximum error of each family: relative to the largest
+// element of the reference for the inverse and normal matrix, and relative
+// to each scale, and absolute for the unit rotation axes, for the
+// decomposition. Near-singular inverses are divided by the condition number
+// first, since any float inverse loses that much.
+typedef struct
+{
+    const char* name;
+    bool conditioned;
+    double inverseBound;
+    double normalBound;
+    double decomposeBound;
+} MatrixFamilyInfo;
+
+static const MatrixFamilyInfo matrixFamilies[MATRIX_FAMILY_COUNT] =
+{
+    { "model", false, 1e-5, 1e-6, 2e-6 },
+    { "non_uniform_scale", false, 5e-5, 1e-6, 2e-6 },
+    // The normal matrix takes its determinant from a triple product, which
+    // cancels worse than the condition number alone accounts for.
+    { "near_singular", true, 1e-6, 5e-5, 2e-6 },
+    { "view_projection", false, 1e-3, 0.0, 0.0 },
+};
+
+static Vec3 randomAxis(void)
+{
+    Vec3 axis;
+    do
+    {
+        axis = vec3(randomFloat(-1.f, 1.f), randomFloat(-1.f, 1.f), randomFloat(-1.f, 1.f));
+    } while (vec3_dot(axis, axis) < 1e-4f);
+    return axis;
+}
+
+// Rotation and per-axis scale, with the columns of mat being the rotation
+// axes times the scales, as mat4_decompose expects.
+static void trsMatrix(Mat4* mat, Mat3* rotation, Vec3 scale, Vec3 translation)
+{
+    quat_toMat3(quat_fromAxisAngle(vec3_normalize(randomAxis()), randomFloat(-180.f, 180.f)), rotation);
+    const float scales[3] = { scale.x, scale.y, scale.z };
+    mat4_load_identity(mat);
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            (*mat)[i][j] = (*rotation)[i][j] * scales[i];
+    (*mat)[3][0] = translation.x;
+    (*mat)[3][1] = translation.y;
+    (*mat)[3][2] = translation.z;
+}
+
+static float randomScale(float decades)
+{
+    return powf(10.f, randomFloat(-decades, decades));
+}
+
+static void randomFamilyMatrix(Mat4* mat, Mat3* rotation, Vec3* scale, MatrixFamily family)
+{
+    const Vec3 translation = vec3(randomFloat(-100.f, 100.f), randomFloat(-100.f, 100.f), randomFloat(-100.f, 100.f));
+    switch (family)
+    {
+    case MATRIX_MODEL:
+        *scale = vec3(randomFloat(0.1f, 10.f), randomFloat(0.1f, 10.f), randomFloat(0.1f, 10.f));
+        trsMatrix(mat, rotation, *scale, translation);
+        break;
+    case MATRIX_NON_UNIFORM_SCALE:
+        *scale = vec3(randomScale(3.f), randomScale(3.f), randomScale(3.f));
+        trsMatrix(mat, rotation, *scale, translation);
+        break;
+    case MATRIX_NEAR_SINGULAR:
+        // One axis squashed to almost nothing, so the linear part is close
+        // to rank two but still an exact rotation and scale. Inverses also
+        // go through shearTowardsSingular.
+        *scale = vec3(randomFloat(0.1f, 10.f), randomFloat(0.1f, 10.f), randomFloat(0.1f, 10.f) * 1e-4f);
+        trsMatrix(mat, rotation, *scale, translation);
+        break;
+    default:
+        randomViewProjection(mat);
+        break;
+    }
+}
+
+// Replaces the third column by a blend of the first two plus a small
+// remainder, so the columns are nearly dependent without any tiny scale.
+static void shearTowardsSingular(Mat4* mat)
+{
+    const float a = randomFloat(-1.f, 1.f);
+    const float b = randomFloat(-1.f, 1.f);
+    const float remainder = randomScale(1.f) * 1e-3f;
+    for (int j = 0; j < 3; j++)
+        (*mat)[2][j] = a * (*mat)[0][j] + b * (*mat)[1][j] + remainder * (*mat)[2][j];
+}
+
+// Infinity-norm condition number of the linear part (size 3) or the whole
+// matrix (size 4).
+static double conditionNumber(Mat4* mat, double inverse[4][4], int size)
+{
+    double norm = 0.0;
+    double inverseNorm = 0.0;
+    for (int i = 0; i < size; i++)
+    {
+        double row = 0.0;
+        double inverseRow = 0.0;
+        for (int j = 0; j < size; j++)
+        {
+            row += fabs((*mat)[i][j]);
+            inverseRow += fabs(inverse[i][j]);
+        }
+        norm = fmax(norm, row);
+        inverseNorm = fmax(inverseNorm, inverseRow);
+    }
+    return norm * inverseNorm;
+}
+
+static double largestError(const float* values, const double* reference, int stride, int size, double* largest)
+{
+    double error = 0.0;
+    *largest = 0.0;
+    for (int i = 0; i < size; i++)
+    {
+        for (int j = 0; j < size; j++)
+        {
+            *largest = fmax(*largest, fabs(reference[i * 4 + j]));
+            error = fmax(error, fabs(values[i * stride + j] - reference[i * 4 + j]));
+        }
+    }
+    return error;
+}
+
+static bool precisionInverse(const char* kernelName, size_t count)
+{
+    const Mat4Kernels* kernels = mat4_kernels_find(kernelName);
+    if (kernels == NULL)
+        return true;
+
+    char names[MATRIX_FAMILY_COUNT][64];
+    PrecisionResult results[MATRIX_FAMILY_COUNT];
+    for (int family = 0; family < MATRIX_FAMILY_COUNT; family++)
+    {
+        snprintf(names[family], sizeof(names[family]), "mat4_inverse_%s_%s", kernelName, matrixFamilies[family].name);
+        results[family] = (PrecisionResult){ names[family], "relative", matrixFamilies[family].inverseBound, 0.0, 0.0, 0 };
+    }
+
+    srand(8765);
+    for (size_t i = 0; i < count; i++)
+    {
+        for (int family = 0; family < MATRIX_FAMILY_COUNT; family++)
+        {
+            Mat4 mat;
+            Mat4 inverse;
+            Mat3 rotation;
+            Vec3 scale;
+            double reference[4][4];
+            randomFamilyMatrix(&mat, &rotation, &scale, family);
+            if (family == MATRIX_NEAR_SINGULAR)
+                shearTowardsSingular(&mat);
+            if (!referenceInverse(&mat, reference) || !kernels->inverse(&mat, &inverse))
+                continue;
+
+            double largest;
+            double error = largestError(&inverse[0][0], &reference[0][0], 4, 4, &largest) / largest;
+            if (matrixFamilies[family].conditioned)
+                error /= conditionNumber(&mat, reference, 4);
+            precision_record(&results[family], error);
+        }
+    }
+
+    bool passed = true;
+    for (int family = 0; family < MATRIX_FAMILY_COUNT; family++)
+        passed = printPrecision(&results[family]) && passed;
+    return passed;
+}
+
+// The normal matrix is the inverse transpose of the linear part, which for
+// an affine matrix is the linear part of the inverse, transposed.
+static bool precisionNormalMatrix(size_t count)
+{
+    char names[MATRIX_FAMILY_COUNT][64];
+    PrecisionResult results[MATRIX_FAMILY_COUNT];
+    for (int family = 0; family < MATRIX_VIEW_PROJECTION; family++)
+    {
+        snprintf(names[family], sizeof(names[family]), "mat4_normal_matrix_%s", matrixFamilies[family].name);
+        results[family] = (PrecisionResult){ names[family], "relative", matrixFamilies[family].normalBound, 0.0, 0.0, 0 };
+    }
+
+    srand(9876);
+    for (size_t i = 0; i < count; i++)
+    {
+        for (int family = 0; family < MATRIX_VIEW_PROJECTION; family++)
+        {
+            Mat4 mat;
+            Mat3 normal;
+            Mat3 rotation;
+            Vec3 scale;
+            double inverse[4][4];
+            randomFamilyMatrix(&mat, &rotation, &scale, family);
+            if (family == MATRIX_NEAR_SINGULAR)
+                shearTowardsSingular(&mat);
+            if (!referenceInverse(&mat, inverse) || !mat4_normal_matrix_to(&mat, &normal))
+                continue;
+
+            double reference[4][4] = { { 0.0 } };
+            for (int j = 0; j < 3; j++)
+                for (int k = 0; k < 3; k++)
+                    reference[j][k] = inverse[k][j];
+            double largest;
+            double error = largestError(&normal[0][0], &reference[0][0], 3, 3, &largest) / largest;
+            if (matrixFamilies[family].conditioned)
+                error /= conditionNumber(&mat, inverse, 3);
+            precision_record(&results[family], error);
+        }
+    }
+
+    bool passed = true;
+    for (int family = 0; family < MATRIX_VIEW_PROJECTION; family++)
+        passed = printPrecision(&results[family]) && passed;
+    return passed;
+}
+
+// Matrices are built from a known rotation and scale, which are the
+// reference. The translation is copied and has to match exactly.
+static bool precisionDecompose(size_t count)
+{
+    char names[MATRIX_FAMILY_COUNT][64];
+    PrecisionResult results[MATRIX_FAMILY_COUNT];
+    for (int family = 0; family < MATRIX_VIEW_PROJECTION; family++)
+    {
+        snprintf(names[family], sizeof(names[family]), "mat4_decompose_%s", matrixFamilies[family].name);
+        results[family] = (PrecisionResult){ names[family], "relative", matrixFamilies[family].decomposeBound, 0.0, 0.0, 0 };
+    }
+
+    srand(5432);
+    for (size_t i = 0; i < count; i++)
+    {
+        for (int family = 0; family < MATRIX_VIEW_PROJECTION; family++)
+        {
+            Mat4 mat;
+            Mat3 rotation;
+            Mat3 decomposedRotation;
+            Vec3 scale;
+            Vec3 decomposedScale;
+            Vec3 translation;
+            randomFamilyMatrix(&mat, &rotation, &scale, family);
+            if (!mat4_decompose(&mat, &translation, &decomposedRotation, &decomposedScale))
+            {
+                precision_record(&results[family], INFINITY);
+                continue;
+            }
+
+            double error = fmax(fmax(
+                fabs(decomposedScale.x - scale.x) / scale.x,
+                fabs(decomposedScale.y - scale.y) / scale.y),
+                fabs(decomposedScale.z - scale.z) / scale.z);
+            for (int j = 0; j < 3; j++)
+                for (int k = 0; k < 3; k++)
+                    error = fmax(error, fabs(decomposedRotation[j][k] - rotation[j][k]));
+            if (translation.x != mat[3][0] || translation.y != mat[3][1] || translation.z != mat[3][2])
+                error = INFINITY;
+            precision_record(&results[family], error);
+        }
+    }
+
+    bool passed = true;
+    for (int family = 0; family < MATRIX_VIEW_PROJECTION; family++)
+        passed = printPrecision(&results[family]) && passed;
+    return passed;
+}
+
+static double ulpError(float value, double reference)
+{
+    // Below FLT_MIN the spacing stops shrinking with the exponent.
+    int exponent;
+    frexp(reference, &exponent);
+    return fabs((double)value - reference) / ldexp(1.0, (exponent < FLT_MIN_EXP ? FLT_MIN_EXP : exponent) - FLT_MANT_DIG);
+}
+
+// sqrtf is correctly rounded, but the sum of squares is rounded before it,
+// so lengths are held to 2 ULPs rather than 1, and normalizing adds the
+// rounding of the division.
+#define PRECISION_LENGTH_ULPS    2.0
+#define PRECISION_NORMALIZE_ULPS 3.0
+
+static void precisionVector(PrecisionResult* results, Vec3 vec)
+{
+    const double length = sqrt((double)vec.x * vec.x + (double)vec.y * vec.y + (double)vec.z * vec.z);
+    const double length2 = sqrt((double)vec.x * vec.x + (double)vec.y * vec.y);
+    if (length == 0.0 || length2 == 0.0)
+        return;
+
+    precision_record(&results[0], ulpError(vec3_length(vec), length));
+    const Vec3 normalized = vec3_normalize(vec);
+    precision_record(&results[1], fmax(fmax(ulpError(normalized.x, vec.x / length), ulpError(normalized.y, vec.y / length)), ulpError(normalized.z, vec.z / length)));
+
+    const Vec2 flat = vec2(vec.x, vec.y);
+    precision_record(&results[2], ulpError(vec2_length(flat), length2));
+    const Vec2 normalized2 = vec2_normalize(flat);
+    precision_record(&results[3], fmax(ulpError(normalized2.x, vec.x / length2), ulpError(normalized2.y, vec.y / length2)));
+}
+
+static bool runPrecision(BenchOptions* options)
+{
+    // Error of vector length and normalize against a double-precision
+    // reference, over vectors spanning many orders of magnitude and then
+    // over the whole float range, where the sum of squares overflows or
+    // underflows and the components may be denormal.
+    PrecisionResult results[] =
+    {
+        { "vec3_length", "ulp", PRECISION_LENGTH_ULPS, 0.0, 0.0, 0 },
+        { "vec3_normalize", "ulp", PRECISION_NORMALIZE_ULPS, 0.0, 0.0, 0 },
+        { "vec2_length", "ulp", PRECISION_LENGTH_ULPS, 0.0, 0.0, 0 },
+        { "vec2_normalize", "ulp", PRECISION_NORMALIZE_ULPS, 0.0, 0.0, 0 },
+    };
+
+    srand(4321);
+    const size_t count = options->iterations * 10;
+    for (size_t i = 0; i < count; i++)
+    {
+        const float magnitude = i % 2 == 0
+            ? powf(10.f, randomFloat(-6.f, 6.f))
+            : powf(10.f, randomFloat(-44.f, 38.f));
+        precisionVector(results, vec3(
+            randomFloat(-1.f, 1.f) * magnitude,
+            randomFloat(-1.f, 1.f) * magnitude,
+            randomFloat(-1.f, 1.f) * magnitude
+        ));
+    }
+
+    const Vec3 edgeCases[] =
+    {
+        vec3(FLT_MAX * 0.5f, FLT_MAX * 0.5f, 0.f),
+        vec3(-FLT_MAX * 0.5f, FLT_MAX * 0.25f, FLT_MAX * 0.5f),
+        vec3(1e30f, 1e30f, 1e30f),
+        vec3(1e20f, -1e19f, 1e-20f),
+        vec3(1e-25f, 1e-25f, -1e-25f),
+        vec3(FLT_MIN, FLT_MIN, FLT_MIN),
+        vec3(1e-40f, -1e-40f, 1e-40f),
+        vec3(FLT_TRUE_MIN, FLT_TRUE_MIN, 0.f),
+        vec3(1.f, 1e-40f, -1e-45f),
+    };
+    for (size_t i = 0; i < sizeof(edgeCases) / sizeof(edgeCases[0]); i++)
+        precisionVector(results, edgeCases[i]);
+
+    bool passed = true;
+    printf("name,samples,unit,max_error,mean_error,bound,status\n");
+    for (size_t i = 0; i < sizeof(results) / sizeof(results[0]); i++)
+        passed = printPrecision(&results[i]) && passed;
+
+    passed = precisionInverse("scalar", options->iterations) && passed;
+    passed = precisionInverse("sse", options->iterations) && passed;
+    passed = precisionInverse("avx2", options->iterations) && passed;
+    passed = precisionInverse("neon", options->iterations) && passed;
+    passed = precisionNormalMatrix(options->iterations) && passed;
+    passed = precisionDecompose(options->iterations) && passed;
+    return passed;
+}
+
+static void printUsage(const char* program)
+{
+    fprintf(stderr, "Usage: %s [--iterations N] [--samples N] [--warmup N] [--json] [--filter TEXT] [--precision]\n", program);
+}
+
+int main(int argc, char** argv)
+{
+    bool precision = false;
+    BenchOptions options =
+    {
+        .iterations = 100000,
+        .samples = 51,
+        .warmup = 5,
+        .json = false,
+        .filter = NULL,
+    };
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--json") == 0)
+            options.json = true;
+        else if (strcmp(argv[i], "--precision") == 0)
+            precision = true;
+        else if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc)
+            options.iterations = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+            options.samples = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--warmup") == 0 && i + 1 < argc)
+            options.warmup = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+            options.filter = argv[++i];
+        else
+        {
+            printUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (options.samples == 0 || options.iterations == 0)
+    {
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (precision)
+    {
+        return runPrecision(&options) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    setupInputs();
+
+    if (options.json)
+        printf("{\n  \"kernels\": \"%s\",\n  \"results\": [\n", mat4_kernels()->name);
+    else
+        printf("name,ops,samples,ns_per_op_median,ns_per_op_p99,allocs_per_op,items_per_op,items_per_second\n");
+
+    bool first = true;
+    for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); i++)
+    {
+        const Benchmark* benchmark = &benchmarks[i];
+        if (options.filter != NULL && strstr(benchmark->name, options.filter) == NULL)
+            continue;
+        if (strncmp(benchmark->name, "kernel_", 7) == 0)
+        {
+            char kernelName[16];
+            sscanf(benchmark->name + 7, "%15[^_]", kernelName);
+            if (mat4_kernels_find(kernelName) == NULL)
+                continue;
+        }
+        runBenchmark(benchmark, &options, first);
+        first = false;
+    }
+
+    if (options.json)
+        printf("\n  ]\n}\n");
+
+    bvh_delete(&sceneBvh);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,50 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "./Space.h"
+#include "./Culling.h"
+
+#define BVH_MAX_LEAF_SIZE 4
+
+typedef struct
+{
+    Aabb bounds;
+    uint32_t offset;
+    uint16_t count;
+    uint16_t axis;
+} BvhNode;
+
+typedef struct
+{
+    BvhNode* nodes;
+    uint32_t nodeCount;
+    uint32_t* primitiveIndices;
+    uint32_t primitiveCount;
+} Bvh;
+
+typedef struct
+{
+    Vec3 origin;
+    Vec3 direction;
+} Ray;
+
+typedef struct
+{
+    uint32_t primitive;
+    float distance;
+} BvhHit;
+
+typedef bool (*BvhRayTest)(void* userData, uint32_t primitive, Ray ray, float* distance);
+
+Bvh    bvh_build(const Aabb* bounds, uint32_t count, int threadCount);
+void   bvh_refit(Bvh* bvh, const Aabb* bounds);
+size_t bvh_cullFrustum(Bvh* bvh, const Aabb* bounds, Frustum* frustum, uint32_t* visibleIndices);
+bool   bvh_raycast(Bvh* bvh, const Aabb* bounds, Ray ray, float maxDistance, BvhRayTest test, void* userData, BvhHit* hit);
+size_t bvh_queryOverlap(Bvh* bvh, const Aabb* bounds, Aabb query, uint32_t* results, size_t maxResults);
+void   bvh_delete(Bvh* bvh);
+
+#endif // BVH_H
@@ -4,13 +4,27 @@
 #include <stdbool.h>
 
 #include "./Window.h"
+#include "./Graphics.h"
 #include "./Space.h"
 
+// Uniform block shared by every program that declares
+//     layout (std140) uniform Camera { mat4 cameraMatrix; vec4 cameraPosition; };
+// and bound once at this binding point.
+#define CAMERA_BLOCK_NAME    "Camera"
+#define CAMERA_BLOCK_BINDING 0
+
+typedef struct
+{
+    Mat4 matrix;
+    float position[4];
+} CameraBlock;
+
 typedef struct
 {
     Mat4 matrix;
     Vec3 position;
     Vec3 front;
+    Quat orientation;
     float yaw;
     float pitch;
     float fov;
@@ -18,6 +32,7 @@ typedef struct
     float sensitivity;
     float aspectRatio;
     bool locked;
+    bool quaternion;
 } Camera;
 
 Camera camera_create(float fov, float speed, float sensitivity, float aspectRatio);
@@ -30,8 +45,11 @@ void   camera_updateAspectRatio(Camera* camera, float aspectRatio);
 
 void camera_lock(Camera* camera);
 void camera_unlock(Camera* camera);
+void camera_enableQuaternion(Camera* camera);
+void camera_disableQuaternion(Camera* camera);
 void camera_recomputePosition(Camera* camera, Window* window);
 void camera_recomputeRotation(Camera* camera, Window* window);
 void camera_recomputeMatrix(Camera* camera);
+void camera_upload(Camera* camera, UBO UBO);
 
 #endif // CAMERA_H
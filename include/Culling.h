@@ -0,0 +1,38 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "./Space.h"
+
+#define FRUSTUM_PLANE_COUNT 6
+#define FRUSTUM_CACHE_SIZE(count) (((count) + 3) / 4)
+
+typedef struct
+{
+    Vec3 normal;
+    float distance;
+} Plane;
+
+typedef struct
+{
+    Vec3 center;
+    float radius;
+} Sphere;
+
+typedef struct
+{
+    Plane planes[FRUSTUM_PLANE_COUNT];
+    Vec3 absNormals[FRUSTUM_PLANE_COUNT];
+    uint8_t octants[FRUSTUM_PLANE_COUNT];
+} Frustum;
+
+void   frustum_extract(Frustum* frustum, Mat4* mat);
+bool   frustum_testSphere(Frustum* frustum, Sphere sphere);
+bool   frustum_testAabb(Frustum* frustum, Aabb aabb);
+size_t frustum_cullSpheres(Frustum* frustum, const Sphere* spheres, size_t count, uint8_t* planeCache, uint32_t* visibleIndices);
+size_t frustum_cullAabbs(Frustum* frustum, const Aabb* aabbs, size_t count, uint8_t* planeCache, uint32_t* visibleIndices);
+
+#endif // CULLING_H
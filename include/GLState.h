@@ -0,0 +1,46 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <GL/glew.h>
+
+// Shadow copy of the GL state the renderer touches. Every glState_* call is
+// compared against the cached value and only reaches the driver when it
+// changes something. The cache mirrors a single context; call glState_reset
+// after making it current or after issuing state changes behind its back.
+
+#define GL_STATE_TEXTURE_UNITS   16
+#define GL_STATE_INDEXED_BUFFERS 16
+
+typedef struct
+{
+    uint64_t issued;
+    uint64_t skipped;
+} GLStateStats;
+
+void glState_reset(void);
+void glState_useProgram(GLuint program);
+void glState_bindVertexArray(GLuint vertexArray);
+void glState_bindBuffer(GLenum target, GLuint buffer);
+void glState_bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+void glState_bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+void glState_bindTexture(GLuint unit, GLenum target, GLuint texture);
+
+void glState_enable(GLenum capability);
+void glState_disable(GLenum capability);
+void glState_depthFunc(GLenum func);
+void glState_depthMask(GLboolean mask);
+void glState_blendFunc(GLenum source, GLenum destination);
+void glState_cullFace(GLenum face);
+void glState_viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+void glState_deleteProgram(GLuint program);
+void glState_deleteVertexArrays(GLsizei count, const GLuint* vertexArrays);
+void glState_deleteBuffers(GLsizei count, const GLuint* buffers);
+void glState_deleteTextures(GLsizei count, const GLuint* textures);
+
+GLStateStats glState_getStats(void);
+void         glState_resetStats(void);
+void         glState_log(void);
+#endif // GL_STATE_H
@@ -0,0 +1,89 @@
+#ifndef GPU_ARENA_H
+#define GPU_ARENA_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <GL/glew.h>
+
+#include "./Graphics.h"
+#include "./RangeAllocator.h"
+#include "./RenderQueue.h"
+
+#define GPU_ARENA_MAX_ATTRIBS 16
+#define GPU_ARENA_INVALID_HANDLE UINT32_MAX
+
+typedef uint32_t GpuMeshHandle;
+
+typedef struct
+{
+    GLuint vertexOffset;
+    GLuint vertexCount;
+    GLuint indexOffset;
+    GLuint indexCount;
+    bool live;
+} GpuArenaMesh;
+
+typedef struct
+{
+    GLuint index;
+    GLuint size;
+    GLenum type;
+    GLboolean normalized;
+    const void* offset;
+} GpuArenaAttrib;
+
+typedef struct
+{
+    GLuint vertexCapacity;
+    GLuint vertexUsed;
+    GLuint indexCapacity;
+    GLuint indexUsed;
+    uint32_t meshCount;
+    float vertexFragmentation;
+    float indexFragmentation;
+    uint64_t moves;
+    uint64_t bytesMoved;
+    uint32_t grows;
+} GpuArenaStats;
+
+// One vertex buffer and one index buffer shared by every mesh of a vertex
+// format, sub-allocated in vertex and index units. Meshes are addressed by
+// handle, so defragmentation and growth can move their ranges without the
+// caller noticing; generation changes whenever any range moves.
+typedef struct
+{
+    VAO VAO;
+    VBO vertexBuffer;
+    EBO indexBuffer;
+    GLsizei vertexStride;
+    RangeAllocator vertices;
+    RangeAllocator indices;
+
+    GpuArenaMesh* meshes;
+    uint32_t meshCount;
+    uint32_t meshCapacity;
+    uint32_t* freeHandles;
+    uint32_t freeHandleCount;
+
+    GpuArenaAttrib attribs[GPU_ARENA_MAX_ATTRIBS];
+    uint32_t attribCount;
+
+    uint32_t generation;
+    uint64_t moves;
+    uint64_t bytesMoved;
+    uint32_t grows;
+} GpuArena;
+
+GpuArena      gpuArena_create(GLsizei vertexStride, GLuint vertexCapacity, GLuint indexCapacity);
+void          gpuArena_linkAttrib(GpuArena* arena, GLuint index, GLuint size, GLenum type, GLboolean normalized, const void* offset);
+GpuMeshHandle gpuArena_allocate(GpuArena* arena, GLuint vertexCount, GLuint indexCount);
+void          gpuArena_upload(GpuArena* arena, GpuMeshHandle handle, const void* vertices, const GLuint* indices);
+void          gpuArena_free(GpuArena* arena, GpuMeshHandle handle);
+uint32_t      gpuArena_defragment(GpuArena* arena, uint32_t maxMoves);
+void          gpuArena_draw(GpuArena* arena, GpuMeshHandle handle);
+void          gpuArena_fillCommand(GpuArena* arena, GpuMeshHandle handle, RenderCommand* command);
+GpuArenaStats gpuArena_getStats(GpuArena* arena);
+void          gpuArena_log(GpuArena* arena);
+void          gpuArena_delete(GpuArena* arena);
+
+#endif // GPU_ARENA_H
@@ -0,0 +1,117 @@
+#ifndef GPU_SCENE_H
+#define GPU_SCENE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <GL/glew.h>
+
+#include "./Graphics.h"
+#include "./GpuArena.h"
+#include "./Space.h"
+#include "./Culling.h"
+#include "./Lod.h"
+#include "./ShaderCache.h"
+
+#define GPU_SCENE_OBJECT_BINDING  0
+#define GPU_SCENE_COMMAND_BINDING 1
+#define GPU_SCENE_VISIBLE_BINDING 2
+#define GPU_SCENE_MESH_BINDING    3
+#define GPU_SCENE_LEVEL_BINDING   4
+
+// Vertex attribute carrying the object index of each drawn instance. It is
+// read from the compacted visible list with divisor 1, so each draw's
+// baseInstance selects the mesh's slice of that list.
+#define GPU_SCENE_OBJECT_ID_LOCATION 7
+
+#define GPU_SCENE_CULL_GROUP_SIZE 64
+
+typedef struct
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+} DrawElementsIndirectCommand;
+
+// std430 layout shared with the shaders: the transform as three rows, world
+// space bounds, the mesh index and a packed RGBA8 color.
+typedef struct
+{
+    GLfloat rows[3][4];
+    GLfloat boundsMin[3];
+    GLuint mesh;
+    GLfloat boundsMax[3];
+    GLuint color;
+} GpuObject;
+
+// std430 layout of the per-mesh LOD table read by the cull shader.
+typedef struct
+{
+    GLuint commandBase;
+    GLuint lodCount;
+    GLuint padding[2];
+    GLfloat errors[MESH_MAX_LODS];
+} GpuMeshInfo;
+
+typedef struct
+{
+    GpuMeshHandle handle;
+    GLuint objectCount;
+    GLuint commandBase;
+    GLuint lodCount;
+    MeshLod lods[MESH_MAX_LODS];
+} GpuMesh;
+
+// GPU-driven scene: every mesh lives in one shared vertex and index arena,
+// every object in a storage buffer. A compute pass frustum-culls the objects,
+// picks a level of detail for each and fills one indirect command per mesh
+// LOD, and a single glMultiDrawElementsIndirect draws everything that
+// survived.
+typedef struct
+{
+    GpuArena arena;
+    uint32_t arenaGeneration;
+
+    GpuMesh* meshes;
+    uint32_t meshCount;
+    uint32_t meshCapacity;
+
+    GpuObject* objects;
+    uint32_t objectCount;
+    uint32_t objectCapacity;
+    uint32_t dirtyBegin;
+    uint32_t dirtyEnd;
+    bool layoutDirty;
+
+    DrawElementsIndirectCommand* commands;
+    uint32_t commandCount;
+    GpuMeshInfo* meshInfos;
+    uint32_t visibleCapacity;
+    SSBO objectBuffer;
+    SSBO commandBuffer;
+    SSBO visibleBuffer;
+    SSBO meshBuffer;
+    SSBO levelBuffer;
+
+    Shader cullShader;
+    ShaderUniform planesUniform;
+    ShaderUniform objectCountUniform;
+    ShaderUniform lodViewUniform;
+    ShaderUniform lodThresholdUniform;
+    ShaderUniform lodHysteresisUniform;
+} GpuScene;
+
+bool     gpuScene_isSupported(void);
+GpuScene gpuScene_create(GLsizei vertexStride, GLuint vertexCapacity, GLuint indexCapacity, uint32_t meshCapacity, uint32_t objectCapacity, ShaderCache* shaderCache);
+void     gpuScene_linkAttrib(GpuScene* scene, GLuint index, GLuint size, GLenum type, GLboolean normalized, const void* offset);
+uint32_t gpuScene_addMesh(GpuScene* scene, const void* vertices, GLuint vertexCount, const GLuint* indices, GLuint indexCount);
+uint32_t gpuScene_addMeshLods(GpuScene* scene, const void* vertices, GLuint vertexCount, const GLuint* indices, GLuint indexCount, const MeshLod* lods, uint32_t lodCount);
+uint32_t gpuScene_addObject(GpuScene* scene, uint32_t mesh, Affine* model, Aabb bounds, GLuint color);
+void     gpuScene_setObject(GpuScene* scene, uint32_t object, Affine* model, Aabb bounds);
+void     gpuScene_cull(GpuScene* scene, Frustum* frustum, const LodView* lodView);
+void     gpuScene_draw(GpuScene* scene);
+uint32_t gpuScene_countVisible(GpuScene* scene);
+void     gpuScene_delete(GpuScene* scene);
+
+#endif // GPU_SCENE_H
@@ -3,34 +3,125 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <GL/glew.h>
 
 #include "./Space.h"
+#include "./RenderQueue.h"
+
+#define SHADER_MAX_NAME_LENGTH 64
+#define SHADER_MAX_STAGES      2
+
+// Resolved uniform location; -1 for names the program does not use, which GL
+// silently ignores like any other inactive uniform.
+typedef GLint ShaderUniform;
+
+typedef struct
+{
+    char name[SHADER_MAX_NAME_LENGTH];
+    uint32_t hash;
+    GLint location;
+    GLenum type;
+    GLint size;
+} ShaderUniformInfo;
+
+typedef struct
+{
+    char name[SHADER_MAX_NAME_LENGTH];
+    GLuint index;
+    GLint dataSize;
+} ShaderBlockInfo;
+
+// A linked program with its active uniforms and uniform blocks reflected
+// once at link time. Uniforms live in an open-addressed table keyed by an
+// FNV-1a hash of the name, so lookups never reach the driver.
+typedef struct
+{
+    GLuint ID;
+    ShaderUniformInfo* uniforms;
+    uint32_t uniformCapacity;
+    uint32_t uniformCount;
+    ShaderBlockInfo* blocks;
+    uint32_t blockCount;
+} Shader;
 
-typedef GLuint Shader;
 typedef GLuint VAO;
 typedef GLuint VBO; 
 typedef GLuint EBO;
+typedef GLuint UBO;
+typedef GLuint SSBO;
+
+// Per-instance vertex data streamed from the CPU. The buffer grows on
+// demand and is orphaned on every upload so the driver never stalls on a
+// buffer the GPU is still reading.
+typedef struct
+{
+    VBO VBO;
+    GLsizei stride;
+    GLsizei capacity;
+    GLsizei count;
+} InstanceBuffer;
 
-Shader shader_create(const char* vertexShaderSource, const char* fragmentShaderSource);
-void   shader_use(Shader ID);
-void   shader_delete(Shader ID);
-void   shader_setMat4(Shader ID, const char* uniformName, Mat4* mat);
+bool          shader_compileStatus(GLuint shader, GLenum stage);
+bool          shader_linkStatus(GLuint program);
+GLuint        shader_linkProgram(const GLenum* stages, const char* const* sources, uint32_t stageCount, bool retrievable);
+Shader        shader_fromProgram(GLuint program);
+Shader        shader_create(const char* vertexShaderSource, const char* fragmentShaderSource);
+Shader        shader_createCompute(const char* computeShaderSource);
+void          shader_use(Shader* shader);
+void          shader_delete(Shader* shader);
+ShaderUniform shader_getUniform(Shader* shader, const char* uniformName);
+bool          shader_bindBlock(Shader* shader, const char* blockName, GLuint bindingPoint);
+void          shader_setMat4(Shader* shader, const char* uniformName, Mat4* mat);
+void          shader_setMat3(Shader* shader, const char* uniformName, Mat3* mat);
+void          shader_setAffine(Shader* shader, const char* uniformName, Affine* mat);
+
+void shader_setUniformMat4(ShaderUniform uniform, Mat4* mat);
+void shader_setUniformMat3(ShaderUniform uniform, Mat3* mat);
+void shader_setUniformAffine(ShaderUniform uniform, Affine* mat);
+void shader_setUniformVec3(ShaderUniform uniform, Vec3 vec);
+void shader_setUniformFloat(ShaderUniform uniform, float value);
+void shader_setUniformInt(ShaderUniform uniform, int value);
+void shader_setUniformVec4Array(ShaderUniform uniform, const GLfloat* values, GLsizei count);
 
 VAO  vao_create();
 void vao_linkAttrib(VBO VBO, GLuint index, GLuint size, GLenum type, GLsizei stride, const void* offset);
+void vao_linkAttribFormat(VBO VBO, GLuint index, GLuint size, GLenum type, GLboolean normalized, GLsizei stride, const void* offset);
+void vao_linkInstanceAttrib(VBO VBO, GLuint index, GLuint size, GLenum type, GLsizei stride, const void* offset, GLuint divisor);
+void vao_linkInstanceMat4(VBO VBO, GLuint index, GLsizei stride, const void* offset);
+void vao_linkInstanceAffine(VBO VBO, GLuint index, GLsizei stride, const void* offset);
 void vao_bind(VAO VAO);
 void vao_unbind(VAO VAO);
 void vao_delete(VAO* VAO);
 
 VBO  vbo_create(const GLfloat* vertices, GLsizeiptr verticesSize);
+void vbo_update(VBO VBO, GLintptr offset, GLsizeiptr size, const void* data);
 void vbo_bind(VBO VBO);
 void vbo_unbind(VBO VBO);
 void vbo_delete(VBO* VBO);
 
-EBO  ebo_create(const GLuint* indices, GLsizeiptr indicesSize);
+EBO  ebo_create(const void* indices, GLsizeiptr indicesSize);
+void ebo_update(EBO EBO, GLintptr offset, GLsizeiptr size, const void* data);
 void ebo_bind(EBO EBO);
 void ebo_unbind(EBO EBO);
 void ebo_delete(EBO* EBO);
 
+UBO  ubo_create(GLsizeiptr size);
+void ubo_update(UBO UBO, GLintptr offset, GLsizeiptr size, const void* data);
+void ubo_bindBase(UBO UBO, GLuint bindingPoint);
+void ubo_delete(UBO* UBO);
+
+SSBO ssbo_create(GLsizeiptr size, const void* data);
+void ssbo_update(SSBO SSBO, GLintptr offset, GLsizeiptr size, const void* data);
+void ssbo_bindBase(SSBO SSBO, GLuint bindingPoint);
+void ssbo_delete(SSBO* SSBO);
+
+InstanceBuffer instanceBuffer_create(GLsizei stride, GLsizei capacity);
+void           instanceBuffer_upload(InstanceBuffer* buffer, const void* instances, GLsizei count);
+void           instanceBuffer_delete(InstanceBuffer* buffer);
+
+void draw_instanced(VAO VAO, GLenum mode, GLsizei indexCount, GLenum indexType, GLsizei instanceCount);
+void draw_renderQueue(RenderQueue* queue);
+
 #endif // GRAPHICS_H
@@ -0,0 +1,36 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define IMAGE_MAX_LEVELS 16
+#define IMAGE_CHANNELS   4
+
+// RGBA8 pixels for a base level and any mip levels, back to back. Rows are
+// stored bottom-up, the order GL expects them in.
+typedef struct
+{
+    uint32_t width;
+    uint32_t height;
+    uint32_t levelCount;
+    size_t levelOffsets[IMAGE_MAX_LEVELS];
+    size_t size;
+    uint8_t* pixels;
+} Image;
+
+bool     image_create(Image* image, uint32_t width, uint32_t height);
+bool     image_decode(Image* image, const uint8_t* data, size_t size);
+bool     image_load(Image* image, const char* path);
+bool     image_loadMipmapped(Image* image, const char* path, bool generate);
+bool     image_savePpm(const Image* image, const char* path);
+bool     image_setLevelCount(Image* image, uint32_t levelCount);
+void     image_generateMipmaps(Image* image, uint32_t firstLevel);
+uint32_t image_mipCount(uint32_t width, uint32_t height);
+uint32_t image_levelWidth(const Image* image, uint32_t level);
+uint32_t image_levelHeight(const Image* image, uint32_t level);
+uint8_t* image_level(const Image* image, uint32_t level);
+void     image_free(Image* image);
+
+#endif // IMAGE_H
@@ -0,0 +1,28 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "./Mesh.h"
+#include "./Space.h"
+
+#define LOD_DEFAULT_THRESHOLD  1.f
+#define LOD_DEFAULT_HYSTERESIS 0.25f
+
+// Everything LOD selection needs from the camera for one frame.
+// projectionScale turns an object-space error at distance 1 into pixels.
+typedef struct
+{
+    Vec3 position;
+    float projectionScale;
+    float threshold;
+    float hysteresis;
+} LodView;
+
+LodView lodView_create(Vec3 position, float fov, float aspectRatio, float viewportWidth, float thresholdPixels, float hysteresis);
+float   lod_projectedError(const LodView* view, float error, Vec3 center, float radius);
+uint8_t lod_select(const LodView* view, const MeshLod* lods, uint32_t lodCount, Vec3 center, float radius, uint8_t current);
+void    lod_selectBatch(const LodView* view, const MeshLod* lods, uint32_t lodCount, const Aabb* bounds, const uint32_t* visibleIndices, size_t count, uint8_t* levels);
+
+#endif // LOD_H
@@ -0,0 +1,121 @@
+#ifndef MESH_H
+#define MESH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "./Space.h"
+
+#define MESH_FILE_MAGIC     0x4853454Du // "MESH"
+#define MESH_FILE_VERSION   1
+#define MESH_FILE_ALIGNMENT 16
+#define MESH_MAX_ATTRIBS    8
+#define MESH_MAX_LODS       8
+
+// Component types use the GL enum values so they can be passed straight to
+// glVertexAttribPointer without the loader depending on GL headers.
+#define MESH_TYPE_BYTE           0x1400
+#define MESH_TYPE_UNSIGNED_BYTE  0x1401
+#define MESH_TYPE_SHORT          0x1402
+#define MESH_TYPE_UNSIGNED_SHORT 0x1403
+#define MESH_TYPE_INT            0x1404
+#define MESH_TYPE_UNSIGNED_INT   0x1405
+#define MESH_TYPE_FLOAT          0x1406
+#define MESH_TYPE_HALF_FLOAT     0x140B
+
+#define MESH_TYPE_INT_2_10_10_10_REV 0x8D9F
+
+typedef enum
+{
+    // Also checks every index against the vertex count, which costs one pass
+    // over the index blob.
+    MESH_LOAD_CHECK_INDICES = 1 << 0,
+} MeshLoadFlags;
+
+typedef struct
+{
+    uint32_t location;
+    uint32_t size;
+    uint32_t type;
+    uint32_t normalized;
+    uint32_t offset;
+} MeshAttrib;
+
+// A contiguous run of the index blob. LOD 0 is the full mesh; coarser
+// levels follow with a growing error.
+typedef struct
+{
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float error;
+    uint32_t reserved;
+} MeshLod;
+
+// On-disk header. Blobs follow it at MESH_FILE_ALIGNMENT-aligned offsets, in
+// the byte order of the machine that wrote them.
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t flags;
+    uint64_t fileSize;
+    uint32_t vertexCount;
+    uint32_t vertexStride;
+    uint32_t indexCount;
+    uint32_t indexSize;
+    uint32_t attribCount;
+    uint32_t lodCount;
+    float boundsMin[3];
+    float boundsMax[3];
+    uint64_t vertexOffset;
+    uint64_t indexOffset;
+    uint64_t lodOffset;
+    MeshAttrib attribs[MESH_MAX_ATTRIBS];
+} MeshFileHeader;
+
+// Read-only view of a mapped mesh file. The pointers alias the mapping, so
+// they can go to glBufferData as they are and stay valid until unload.
+typedef struct
+{
+    const MeshFileHeader* header;
+    const void* vertices;
+    const void* indices;
+    const MeshLod* lods;
+    Aabb bounds;
+    void* mapping;
+    size_t mappingSize;
+} Mesh;
+
+// Owned, editable geometry, as produced by the OBJ parser and consumed by the
+// writer.
+typedef struct
+{
+    void* vertices;
+    uint32_t vertexCount;
+    uint32_t vertexStride;
+    void* indices;
+    uint32_t indexCount;
+    uint32_t indexSize;
+    MeshAttrib attribs[MESH_MAX_ATTRIBS];
+    uint32_t attribCount;
+    MeshLod lods[MESH_MAX_LODS];
+    uint32_t lodCount;
+    Aabb bounds;
+} MeshData;
+
+bool mesh_load(Mesh* mesh, const char* path, uint32_t flags);
+void mesh_unload(Mesh* mesh);
+bool mesh_checkIndices(const void* indices, uint32_t indexCount, uint32_t indexSize, uint32_t vertexCount);
+
+bool meshData_parseObj(MeshData* data, const char* path, bool texcoords);
+void meshData_computeBounds(MeshData* data);
+void meshData_optimize(MeshData* data);
+uint32_t meshData_generateLods(MeshData* data, uint32_t levelCount, float ratio);
+void meshData_convert(MeshData* data, const MeshAttrib* attribs, uint32_t attribCount, uint32_t stride);
+bool meshData_narrowIndices(MeshData* data);
+bool meshData_save(const MeshData* data, const char* path);
+void meshData_free(MeshData* data);
+
+#endif // MESH_H
@@ -0,0 +1,20 @@
+#ifndef MESH_OPTIMIZE_H
+#define MESH_OPTIMIZE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MESH_OPTIMIZE_CACHE_SIZE 32
+
+void     meshOptimize_vertexCache(uint32_t* target, const uint32_t* indices, size_t indexCount, uint32_t vertexCount);
+uint32_t meshOptimize_vertexFetch(void* targetVertices, uint32_t* indices, size_t indexCount, const void* vertices, uint32_t vertexCount, uint32_t stride);
+// target is also the working buffer, so it must hold indexCount indices even
+// when targetIndexCount asks for fewer; it may not alias indices.
+size_t   meshOptimize_simplify(
+    uint32_t* target, const uint32_t* indices, size_t indexCount,
+    const float* positions, uint32_t vertexCount, size_t positionStride,
+    size_t targetIndexCount, float* error
+);
+float    meshOptimize_acmr(const uint32_t* indices, size_t indexCount, uint32_t vertexCount, uint32_t cacheSize);
+
+#endif // MESH_OPTIMIZE_H
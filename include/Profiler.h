@@ -0,0 +1,96 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <GL/glew.h>
+
+// Frame profiler: CPU zones from any thread, GPU zones on the render
+// thread, and per-frame counters, kept for the last PROFILER_HISTORY_FRAMES
+// frames and exportable as a Chrome trace_event file (chrome://tracing,
+// Perfetto).
+//
+// The zone and counter macros only expand to calls when PROFILER_ENABLED is
+// defined, so a build without it carries no instrumentation at all. With it,
+// a disabled profiler costs a relaxed load per zone.
+
+#define PROFILER_MAX_THREADS     16
+#define PROFILER_MAX_DEPTH       32
+#define PROFILER_RING_SIZE       4096
+#define PROFILER_HISTORY_FRAMES  120
+#define PROFILER_HISTORY_EVENTS  65536
+#define PROFILER_MAX_GPU_ZONES   32
+#define PROFILER_GPU_FRAMES      2
+
+typedef struct
+{
+    uint64_t drawCalls;
+    uint64_t triangles;
+    uint64_t stateChanges;
+    uint64_t uploadedBytes;
+    uint64_t uniformUpdates;
+} ProfilerCounters;
+
+// Times are nanoseconds on the CPU's monotonic clock; GPU zones are
+// translated onto it. name must outlive the profiler, in practice a string
+// literal.
+typedef struct
+{
+    const char* name;
+    uint64_t start;
+    uint64_t duration;
+    uint32_t thread;
+    uint32_t depth;
+} ProfilerEvent;
+
+typedef struct
+{
+    uint64_t index;
+    uint64_t start;
+    uint64_t end;
+    // Negative until the frame's GPU queries are read back, and for good if
+    // they were not available in time.
+    double gpuMilliseconds;
+    ProfilerCounters counters;
+} ProfilerFrame;
+
+extern ProfilerCounters profilerCounters;
+
+void                 profiler_init(void);
+void                 profiler_shutdown(void);
+void                 profiler_setEnabled(bool enabled);
+bool                 profiler_isEnabled(void);
+void                 profiler_setThreadName(const char* name);
+void                 profiler_beginFrame(void);
+void                 profiler_endFrame(void);
+void                 profiler_zoneBegin(const char* name);
+void                 profiler_zoneEnd(void);
+void                 profiler_scopeEnd(int* scope);
+void                 profiler_gpuZoneBegin(const char* name);
+void                 profiler_gpuZoneEnd(void);
+uint32_t             profiler_frameCount(void);
+const ProfilerFrame* profiler_getFrame(uint32_t framesAgo);
+bool                 profiler_exportTrace(const char* path);
+void                 profiler_log(void);
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b)  PROFILE_CONCAT_(a, b)
+
+#if defined(PROFILER_ENABLED)
+#define PROFILE_BEGIN(name)         profiler_zoneBegin(name)
+#define PROFILE_END()               profiler_zoneEnd()
+#define PROFILE_SCOPE(name)         __attribute__((cleanup(profiler_scopeEnd))) int PROFILE_CONCAT(profileScope, __LINE__) = (profiler_zoneBegin(name), 0)
+#define PROFILE_GPU_BEGIN(name)     profiler_gpuZoneBegin(name)
+#define PROFILE_GPU_END()           profiler_gpuZoneEnd()
+#define PROFILE_THREAD(name)        profiler_setThreadName(name)
+#define PROFILE_COUNT(counter, n)   (profilerCounters.counter += (uint64_t)(n))
+#else
+#define PROFILE_BEGIN(name)         ((void)0)
+#define PROFILE_END()               ((void)0)
+#define PROFILE_SCOPE(name)         ((void)0)
+#define PROFILE_GPU_BEGIN(name)     ((void)0)
+#define PROFILE_GPU_END()           ((void)0)
+#define PROFILE_THREAD(name)        ((void)0)
+#define PROFILE_COUNT(counter, n)   ((void)0)
+#endif
+
+#endif // PROFILER_H
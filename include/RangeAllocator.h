@@ -0,0 +1,36 @@
+#ifndef RANGE_ALLOCATOR_H
+#define RANGE_ALLOCATOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct
+{
+    uint32_t offset;
+    uint32_t size;
+} RangeBlock;
+
+// Best-fit allocator over [0, capacity) in caller-defined units. Free blocks
+// are kept sorted by offset, so freeing a range coalesces it with both
+// neighbours in one step. Bookkeeping lives on the CPU; nothing here touches
+// the memory being managed.
+typedef struct
+{
+    RangeBlock* freeBlocks;
+    uint32_t freeCount;
+    uint32_t freeCapacity;
+    uint32_t capacity;
+    uint32_t used;
+    uint32_t allocationCount;
+} RangeAllocator;
+
+RangeAllocator rangeAllocator_create(uint32_t capacity);
+bool           rangeAllocator_allocate(RangeAllocator* allocator, uint32_t size, uint32_t alignment, uint32_t* offset);
+bool           rangeAllocator_allocateBelow(RangeAllocator* allocator, uint32_t size, uint32_t alignment, uint32_t limit, uint32_t* offset);
+void           rangeAllocator_free(RangeAllocator* allocator, uint32_t offset, uint32_t size);
+void           rangeAllocator_grow(RangeAllocator* allocator, uint32_t capacity);
+uint32_t       rangeAllocator_largestFree(RangeAllocator* allocator);
+float          rangeAllocator_fragmentation(RangeAllocator* allocator);
+void           rangeAllocator_delete(RangeAllocator* allocator);
+
+#endif // RANGE_ALLOCATOR_H
@@ -0,0 +1,102 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Sort key layout, most significant first:
+// | pass (4) | program (12) | vertex array (12) | material (12) | depth (24) |
+// Sorting by the key groups draws by pass, then by the most expensive state
+// changes, and orders what is left by depth.
+#define RENDER_KEY_PASS_BITS     4
+#define RENDER_KEY_PROGRAM_BITS  12
+#define RENDER_KEY_VAO_BITS      12
+#define RENDER_KEY_MATERIAL_BITS 12
+#define RENDER_KEY_DEPTH_BITS    24
+
+#define RENDER_KEY_DEPTH_SHIFT    0
+#define RENDER_KEY_MATERIAL_SHIFT (RENDER_KEY_DEPTH_SHIFT + RENDER_KEY_DEPTH_BITS)
+#define RENDER_KEY_VAO_SHIFT      (RENDER_KEY_MATERIAL_SHIFT + RENDER_KEY_MATERIAL_BITS)
+#define RENDER_KEY_PROGRAM_SHIFT  (RENDER_KEY_VAO_SHIFT + RENDER_KEY_VAO_BITS)
+#define RENDER_KEY_PASS_SHIFT     (RENDER_KEY_PROGRAM_SHIFT + RENDER_KEY_PROGRAM_BITS)
+
+// Binding point the per-draw uniform range of a command is attached to.
+#define RENDER_QUEUE_DRAW_BINDING 1
+
+typedef enum
+{
+    RENDER_PASS_OPAQUE,
+    RENDER_PASS_TRANSPARENT,
+    RENDER_PASS_OVERLAY,
+} RenderPass;
+
+// A recorded draw. Object names and enums are stored as plain integers so
+// recording and sorting do not depend on GL. A zero index type draws arrays
+// starting at baseVertex.
+typedef struct
+{
+    uint64_t key;
+    uint32_t program;
+    uint32_t vertexArray;
+    uint32_t uniformBuffer;
+    uint32_t uniformOffset;
+    uint32_t uniformSize;
+    uint32_t mode;
+    uint32_t indexType;
+    uint32_t indexOffset;
+    uint32_t count;
+    uint32_t instanceCount;
+    int32_t baseVertex;
+} RenderCommand;
+
+typedef struct
+{
+    RenderCommand* commands;
+    uint32_t count;
+    uint32_t capacity;
+} RenderCommandBuffer;
+
+typedef struct
+{
+    uint64_t key;
+    uint32_t index;
+} RenderSortEntry;
+
+typedef struct
+{
+    uint64_t commands;
+    uint64_t drawCalls;
+    uint64_t programChanges;
+    uint64_t vertexArrayChanges;
+    uint64_t bufferChanges;
+} RenderQueueStats;
+
+// Every recording thread owns one command buffer, so recording needs no
+// locks. renderQueue_sort merges the buffers in thread order and radix sorts
+// the merged commands by key.
+typedef struct
+{
+    RenderCommandBuffer* buffers;
+    uint32_t bufferCount;
+    RenderCommand* commands;
+    RenderSortEntry* entries;
+    RenderSortEntry* scratch;
+    uint32_t count;
+    uint32_t capacity;
+    RenderQueueStats stats;
+} RenderQueue;
+
+uint64_t renderKey(RenderPass pass, uint32_t program, uint32_t vertexArray, uint32_t material, uint32_t depth);
+uint32_t renderKey_depth(float depth, bool backToFront);
+
+RenderQueue          renderQueue_create(uint32_t threadCount);
+RenderCommandBuffer* renderQueue_getBuffer(RenderQueue* queue, uint32_t thread);
+void                 renderQueue_sort(RenderQueue* queue);
+void                 renderQueue_clear(RenderQueue* queue);
+void                 renderQueue_delete(RenderQueue* queue);
+void                 renderQueue_log(RenderQueue* queue);
+
+void renderCommandBuffer_push(RenderCommandBuffer* buffer, const RenderCommand* command);
+
+#endif // RENDER_QUEUE_H
@@ -0,0 +1,61 @@
+#ifndef SHADER_CACHE_H
+#define SHADER_CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <GL/glew.h>
+
+#include "./Graphics.h"
+
+#define SHADER_CACHE_MAX_PATH 512
+#define SHADER_CACHE_MAGIC    0x48435353 // "SSCH"
+#define SHADER_CACHE_VERSION  1
+
+// Header of one cache file, followed by the program binary. compileMilliseconds
+// is what building the program from source cost when the entry was written,
+// so hits can report the time they saved.
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t binaryFormat;
+    uint32_t binarySize;
+    float compileMilliseconds;
+    uint32_t reserved;
+} ShaderCacheHeader;
+
+typedef struct
+{
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t rejected;
+    uint64_t writeFailures;
+    double loadMilliseconds;
+    double compileMilliseconds;
+    double savedMilliseconds;
+} ShaderCacheStats;
+
+// Program binaries on disk, one file per program named after a 64-bit FNV-1a
+// hash of its stage sources and the GL vendor, renderer and version strings.
+// A driver update changes the key, and a binary the driver still rejects is
+// deleted and rebuilt from source.
+typedef struct
+{
+    char directory[SHADER_CACHE_MAX_PATH];
+    uint64_t driverHash;
+    bool enabled;
+    ShaderCacheStats stats;
+} ShaderCache;
+
+bool        shaderCache_isSupported(void);
+ShaderCache shaderCache_create(const char* directory);
+GLuint      shaderCache_load(ShaderCache* cache, const GLenum* stages, const char* const* sources, uint32_t stageCount);
+void        shaderCache_store(ShaderCache* cache, const GLenum* stages, const char* const* sources, uint32_t stageCount, GLuint program, double compileMilliseconds);
+bool        shaderCache_wantsBinaries(const ShaderCache* cache);
+Shader      shaderCache_createProgram(ShaderCache* cache, const GLenum* stages, const char* const* sources, uint32_t stageCount);
+Shader      shaderCache_createShader(ShaderCache* cache, const char* vertexShaderSource, const char* fragmentShaderSource);
+Shader      shaderCache_createCompute(ShaderCache* cache, const char* computeShaderSource);
+void        shaderCache_log(const ShaderCache* cache);
+
+#endif // SHADER_CACHE_H
@@ -0,0 +1,99 @@
+#ifndef SHADER_COMPILER_H
+#define SHADER_COMPILER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <GL/glew.h>
+
+#include "./Graphics.h"
+#include "./ShaderCache.h"
+
+#define SHADER_COMPILER_INVALID_HANDLE UINT32_MAX
+
+typedef uint32_t ShaderProgramHandle;
+
+typedef enum
+{
+    SHADER_PROGRAM_PENDING,
+    SHADER_PROGRAM_READY,
+    SHADER_PROGRAM_FAILED,
+} ShaderProgramState;
+
+typedef enum
+{
+    SHADER_COMPILER_SYNCHRONOUS,
+    SHADER_COMPILER_PARALLEL,
+    SHADER_COMPILER_THREADED,
+} ShaderCompilerMode;
+
+typedef void (*ShaderContextMakeCurrent)(void* context);
+
+typedef struct
+{
+    ShaderProgramState state;
+    GLenum stages[SHADER_MAX_STAGES];
+    char* sources[SHADER_MAX_STAGES];
+    uint32_t stageCount;
+    GLuint shaders[SHADER_MAX_STAGES];
+    GLuint program;
+    bool linking;
+    bool queued;
+    bool finished;
+    double submitTime;
+    double compileMilliseconds;
+    Shader shader;
+} ShaderJob;
+
+typedef struct
+{
+    uint64_t submitted;
+    uint64_t cacheHits;
+    uint64_t ready;
+    uint64_t failed;
+    double waitMilliseconds;
+    double maxWaitMilliseconds;
+} ShaderCompilerStats;
+
+// Builds programs without blocking the render thread. With
+// GL_KHR_parallel_shader_compile the driver compiles in the background and
+// each poll checks GL_COMPLETION_STATUS_KHR; otherwise a worker thread builds
+// programs one by one on a context shared with the renderer. Without either
+// programs are built on submit. Cached programs are ready on submit in every
+// mode.
+//
+// The worker holds a pointer to the compiler, so it lives on the heap rather
+// than being returned by value.
+typedef struct
+{
+    ShaderCompilerMode mode;
+    ShaderCache* cache;
+    ShaderJob* jobs;
+    uint32_t jobCount;
+    uint32_t jobCapacity;
+    uint32_t pendingCount;
+    ShaderCompilerStats stats;
+
+    void* workerContext;
+    ShaderContextMakeCurrent makeCurrent;
+    pthread_t worker;
+    pthread_mutex_t mutex;
+    pthread_cond_t wake;
+    pthread_cond_t done;
+    uint32_t workerCursor;
+    bool quit;
+} ShaderCompiler;
+
+bool                shaderCompiler_isParallelSupported(void);
+ShaderCompiler*     shaderCompiler_create(ShaderCache* cache, void* workerContext, ShaderContextMakeCurrent makeCurrent);
+ShaderProgramHandle shaderCompiler_submit(ShaderCompiler* compiler, const GLenum* stages, const char* const* sources, uint32_t stageCount);
+ShaderProgramHandle shaderCompiler_submitShader(ShaderCompiler* compiler, const char* vertexShaderSource, const char* fragmentShaderSource);
+ShaderProgramHandle shaderCompiler_submitCompute(ShaderCompiler* compiler, const char* computeShaderSource);
+void                shaderCompiler_poll(ShaderCompiler* compiler);
+ShaderProgramState  shaderCompiler_wait(ShaderCompiler* compiler, ShaderProgramHandle handle);
+ShaderProgramState  shaderCompiler_state(const ShaderCompiler* compiler, ShaderProgramHandle handle);
+Shader*             shaderCompiler_get(ShaderCompiler* compiler, ShaderProgramHandle handle);
+void                shaderCompiler_log(const ShaderCompiler* compiler);
+void                shaderCompiler_delete(ShaderCompiler* compiler);
+
+#endif // SHADER_COMPILER_H
@@ -0,0 +1,190 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <stdint.h>
+
+#include "./Space.h"
+
+#if defined(__SSE2__)
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#define SIMD_WIDTH 4
+
+typedef __m128 SimdFloat;
+
+static inline SimdFloat simd_load(const float* source) { return _mm_loadu_ps(source); }
+static inline void simd_store(float* target, SimdFloat value) { _mm_storeu_ps(target, value); }
+static inline SimdFloat simd_set(float value) { return _mm_set1_ps(value); }
+static inline SimdFloat simd_add(SimdFloat a, SimdFloat b) { return _mm_add_ps(a, b); }
+static inline SimdFloat simd_sub(SimdFloat a, SimdFloat b) { return _mm_sub_ps(a, b); }
+static inline SimdFloat simd_mul(SimdFloat a, SimdFloat b) { return _mm_mul_ps(a, b); }
+static inline SimdFloat simd_div(SimdFloat a, SimdFloat b) { return _mm_div_ps(a, b); }
+static inline SimdFloat simd_sqrt(SimdFloat a) { return _mm_sqrt_ps(a); }
+static inline SimdFloat simd_min(SimdFloat a, SimdFloat b) { return _mm_min_ps(a, b); }
+static inline SimdFloat simd_max(SimdFloat a, SimdFloat b) { return _mm_max_ps(a, b); }
+static inline SimdFloat simd_abs(SimdFloat a) { return _mm_andnot_ps(_mm_set1_ps(-0.f), a); }
+static inline SimdFloat simd_lessThan(SimdFloat a, SimdFloat b) { return _mm_cmplt_ps(a, b); }
+static inline SimdFloat simd_or(SimdFloat a, SimdFloat b) { return _mm_or_ps(a, b); }
+static inline int simd_mask(SimdFloat mask) { return _mm_movemask_ps(mask); }
+static inline SimdFloat simd_unzipEven(SimdFloat a, SimdFloat b) { return _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)); }
+static inline SimdFloat simd_unzipOdd(SimdFloat a, SimdFloat b) { return _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)); }
+
+static inline SimdFloat simd_zeroIfZero(SimdFloat value, SimdFloat test)
+{
+    return _mm_and_ps(value, _mm_cmpneq_ps(test, _mm_setzero_ps()));
+}
+
+static inline float simd_reduceMin(SimdFloat a)
+{
+    a = _mm_min_ps(a, _mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 0, 3, 2)));
+    a = _mm_min_ps(a, _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(a);
+}
+
+static inline float simd_reduceMax(SimdFloat a)
+{
+    a = _mm_max_ps(a, _mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 0, 3, 2)));
+    a = _mm_max_ps(a, _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtss_f32(a);
+}
+
+static inline void simd_load4(const float* source, SimdFloat* a, SimdFloat* b, SimdFloat* c, SimdFloat* d)
+{
+    __m128 rowZero = _mm_loadu_ps(source);
+    __m128 rowOne = _mm_loadu_ps(source + 4);
+    __m128 rowTwo = _mm_loadu_ps(source + 8);
+    __m128 rowThree = _mm_loadu_ps(source + 12);
+    _MM_TRANSPOSE4_PS(rowZero, rowOne, rowTwo, rowThree);
+    *a = rowZero;
+    *b = rowOne;
+    *c = rowTwo;
+    *d = rowThree;
+}
+
+static inline void simd_store4(float* target, SimdFloat a, SimdFloat b, SimdFloat c, SimdFloat d)
+{
+    _MM_TRANSPOSE4_PS(a, b, c, d);
+    _mm_storeu_ps(target, a);
+    _mm_storeu_ps(target + 4, b);
+    _mm_storeu_ps(target + 8, c);
+    _mm_storeu_ps(target + 12, d);
+}
+
+// Gathers four packed Vec3 (x0 y0 z0 x1 | y1 z1 x2 y2 | z2 x3 y3 z3) into
+// one register per component.
+static inline void simd_load3(const Vec3* source, SimdFloat* x, SimdFloat* y, SimdFloat* z)
+{
+    const float* data = (const float*)source;
+    const __m128 a = _mm_loadu_ps(data);
+    const __m128 b = _mm_loadu_ps(data + 4);
+    const __m128 c = _mm_loadu_ps(data + 8);
+
+    *x = _mm_shuffle_ps(a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 3, 0));
+    *y = _mm_shuffle_ps(
+        _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 1, 1)),
+        _mm_shuffle_ps(b, c, _MM_SHUFFLE(2, 2, 3, 3)),
+        _MM_SHUFFLE(2, 0, 2, 0)
+    );
+    *z = _mm_shuffle_ps(
+        _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 1, 2, 2)),
+        _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 0, 0)),
+        _MM_SHUFFLE(2, 0, 2, 0)
+    );
+}
+
+static inline void simd_store3(Vec3* target, SimdFloat x, SimdFloat y, SimdFloat z)
+{
+    float* data = (float*)target;
+    const __m128 a = _mm_shuffle_ps(
+        _mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 0, 0, 0)),
+        _mm_shuffle_ps(z, x, _MM_SHUFFLE(1, 1, 0, 0)),
+        _MM_SHUFFLE(2, 0, 2, 0)
+    );
+    const __m128 b = _mm_shuffle_ps(
+        _mm_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1)),
+        _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 2, 2, 2)),
+        _MM_SHUFFLE(2, 0, 2, 0)
+    );
+    const __m128 c = _mm_shuffle_ps(
+        _mm_shuffle_ps(z, x, _MM_SHUFFLE(3, 3, 2, 2)),
+        _mm_shuffle_ps(y, z, _MM_SHUFFLE(3, 3, 3, 3)),
+        _MM_SHUFFLE(2, 0, 2, 0)
+    );
+    _mm_storeu_ps(data, a);
+    _mm_storeu_ps(data + 4, b);
+    _mm_storeu_ps(data + 8, c);
+}
+
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define SIMD_WIDTH 4
+
+typedef float32x4_t SimdFloat;
+
+static inline SimdFloat simd_load(const float* source) { return vld1q_f32(source); }
+static inline void simd_store(float* target, SimdFloat value) { vst1q_f32(target, value); }
+static inline SimdFloat simd_set(float value) { return vdupq_n_f32(value); }
+static inline SimdFloat simd_add(SimdFloat a, SimdFloat b) { return vaddq_f32(a, b); }
+static inline SimdFloat simd_sub(SimdFloat a, SimdFloat b) { return vsubq_f32(a, b); }
+static inline SimdFloat simd_mul(SimdFloat a, SimdFloat b) { return vmulq_f32(a, b); }
+static inline SimdFloat simd_div(SimdFloat a, SimdFloat b) { return vdivq_f32(a, b); }
+static inline SimdFloat simd_sqrt(SimdFloat a) { return vsqrtq_f32(a); }
+static inline SimdFloat simd_min(SimdFloat a, SimdFloat b) { return vminq_f32(a, b); }
+static inline SimdFloat simd_max(SimdFloat a, SimdFloat b) { return vmaxq_f32(a, b); }
+static inline float simd_reduceMin(SimdFloat a) { return vminvq_f32(a); }
+static inline float simd_reduceMax(SimdFloat a) { return vmaxvq_f32(a); }
+static inline SimdFloat simd_abs(SimdFloat a) { return vabsq_f32(a); }
+static inline SimdFloat simd_lessThan(SimdFloat a, SimdFloat b) { return vreinterpretq_f32_u32(vcltq_f32(a, b)); }
+static inline SimdFloat simd_unzipEven(SimdFloat a, SimdFloat b) { return vuzp1q_f32(a, b); }
+static inline SimdFloat simd_unzipOdd(SimdFloat a, SimdFloat b) { return vuzp2q_f32(a, b); }
+
+static inline SimdFloat simd_or(SimdFloat a, SimdFloat b)
+{
+    return vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b)));
+}
+
+static inline int simd_mask(SimdFloat mask)
+{
+    static const uint32_t laneBits[4] = { 1, 2, 4, 8 };
+    const uint32x4_t bits = vandq_u32(vshrq_n_u32(vreinterpretq_u32_f32(mask), 31), vld1q_u32(laneBits));
+    return (int)vaddvq_u32(bits);
+}
+
+static inline SimdFloat simd_zeroIfZero(SimdFloat value, SimdFloat test)
+{
+    const uint32x4_t mask = vmvnq_u32(vceqq_f32(test, vdupq_n_f32(0.f)));
+    return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(value), mask));
+}
+
+static inline void simd_load4(const float* source, SimdFloat* a, SimdFloat* b, SimdFloat* c, SimdFloat* d)
+{
+    const float32x4x4_t components = vld4q_f32(source);
+    *a = components.val[0];
+    *b = components.val[1];
+    *c = components.val[2];
+    *d = components.val[3];
+}
+
+static inline void simd_store4(float* target, SimdFloat a, SimdFloat b, SimdFloat c, SimdFloat d)
+{
+    const float32x4x4_t components = { { a, b, c, d } };
+    vst4q_f32(target, components);
+}
+
+static inline void simd_load3(const Vec3* source, SimdFloat* x, SimdFloat* y, SimdFloat* z)
+{
+    const float32x4x3_t components = vld3q_f32((const float*)source);
+    *x = components.val[0];
+    *y = components.val[1];
+    *z = components.val[2];
+}
+
+static inline void simd_store3(Vec3* target, SimdFloat x, SimdFloat y, SimdFloat z)
+{
+    const float32x4x3_t components = { { x, y, z } };
+    vst3q_f32((float*)target, components);
+}
+
+#endif
+
+#endif // SIMD_H
@@ -2,10 +2,14 @@
 #define SPACE_H
 
 #include <stdlib.h>
+#include <stdbool.h>
 #include <math.h>
 #include <stdarg.h>
 #include <stdio.h>
 
+// vec*_length and vec*_normalize take sqrtf of the float sum of squares and
+// fall back to double when that sum overflows or underflows a float.
+
 extern const float PI;
 
 float radians(float degrees);
@@ -22,7 +26,29 @@ typedef struct {
     float z;
 } Vec3;
 
-typedef float Mat4[4][4];
+typedef struct {
+    Vec3 min;
+    Vec3 max;
+} Aabb;
+
+// Unit quaternion (x, y, z) + w for orientations, rotating right-handed
+// about the axis. Angles are in degrees. mat4_rotate builds the transposed
+// matrix, so it matches quat_fromAxisAngle with the angle negated.
+typedef struct {
+    float x;
+    float y;
+    float z;
+    float w;
+} Quat;
+
+typedef float Mat4[4][4] __attribute__((aligned(16)));
+
+typedef float Mat3[3][3];
+
+// Affine transform with an implicit (0, 0, 0, 1) bottom row, stored
+// column-major like Mat4: columns 0-2 hold the linear part, column 3 the
+// translation. Uploads directly as a GLSL mat4x3.
+typedef float Affine[4][3];
 
 Vec2  vec2(float x, float y);
 float vec2_length(Vec2 vec);
@@ -56,23 +82,73 @@ Vec3  vec3_cross(Vec3 vecOne, Vec3 vecTwo);
 void  vec3_log(Vec3 vec);
 
 Mat4* mat4(float diagonalValue);
+void  mat4_load_diagonal(Mat4* mat, float diagonalValue);
 void  mat4_load_identity(Mat4* mat);
 void  mat4_copy(Mat4* source, Mat4* target);
 Mat4* mat4_scale(Mat4* mat, float scalar);
+void  mat4_scale_inplace(Mat4* mat, float scalar);
+void  mat4_scale_to(Mat4* mat, float scalar, Mat4* target);
 Mat4* mat4_multiply(Mat4* matOne, Mat4* matTwo);
 void  mat4_multiply_inplace(Mat4* matOne, Mat4* matTwo);
+void  mat4_multiply_to(Mat4* matOne, Mat4* matTwo, Mat4* target);
+void  mat4_transpose_inplace(Mat4* mat);
+void  mat4_transpose_to(Mat4* mat, Mat4* target);
+Vec3  mat4_transform_point(Mat4* mat, Vec3 point);
+Mat4* mat4_inverse(Mat4* mat);
+bool  mat4_inverse_inplace(Mat4* mat);
+bool  mat4_inverse_to(Mat4* mat, Mat4* target);
+bool  mat4_normal_matrix_to(Mat4* mat, Mat3* target);
+bool  mat4_decompose(Mat4* mat, Vec3* translation, Mat3* rotation, Vec3* scale);
 Mat4* mat4_multiply_many(int count, ...);
 void  mat4_multiply_many_inplace(Mat4* mat, int count, ...);
 Mat4* mat4_translate(Mat4* mat, Vec3 vec);
 void  mat4_translate_inplace(Mat4* mat, Vec3 vec);
+void  mat4_translate_to(Mat4* mat, Vec3 vec, Mat4* target);
 Mat4* mat4_rotate(Mat4* mat, float degrees, Vec3 rotationVec);
 void  mat4_rotate_inplace(Mat4* mat, float degrees, Vec3 rotationVec);
+void  mat4_rotate_to(Mat4* mat, float degrees, Vec3 rotationVec, Mat4* target);
 Mat4* mat4_ortho(float left, float right, float bottom, float top, float zNear, float zFar);
 void  mat4_ortho_inplace(Mat4* mat, float left, float right, float bottom, float top, float zNear, float zFar);
 Mat4* mat4_perspective(float fov, float aspect, float zNear, float zFar);
 void  mat4_perspective_inplace(Mat4* mat, float fov, float aspect, float zNear, float zFar);
 Mat4* mat4_lookAt(Vec3 eye, Vec3 target, Vec3 up);
 void  mat4_lookAt_inplace(Mat4* mat, Vec3 eye, Vec3 target, Vec3 up);
+void  mat4_view_inplace(Mat4* mat, Vec3 eye, Quat orientation);
 void  mat4_log(Mat4* mat);
 
+Affine* affine(void);
+void  affine_load_identity(Affine* mat);
+void  affine_copy(Affine* source, Affine* target);
+void  affine_from_mat4(Mat4* mat, Affine* target);
+void  affine_to_mat4(Affine* mat, Mat4* target);
+void  affine_multiply_inplace(Affine* matOne, Affine* matTwo);
+void  affine_multiply_to(Affine* matOne, Affine* matTwo, Affine* target);
+Vec3  affine_transform_point(Affine* mat, Vec3 point);
+Vec3  affine_transform_direction(Affine* mat, Vec3 direction);
+void  affine_translate_inplace(Affine* mat, Vec3 vec);
+void  affine_inverse_rigid_to(Affine* mat, Affine* target);
+bool  affine_inverse_to(Affine* mat, Affine* target);
+bool  affine_normal_matrix_to(Affine* mat, Mat3* target);
+void  affine_log(Affine* mat);
+
+Quat  quat(float x, float y, float z, float w);
+Quat  quat_identity(void);
+Quat  quat_fromAxisAngle(Vec3 axis, float degrees);
+Quat  quat_fromAxisAngle_fast(Vec3 axis, float degrees);
+Quat  quat_fromMat3(Mat3* mat);
+Quat  quat_fromMat4(Mat4* mat);
+void  quat_toMat3(Quat quat, Mat3* target);
+void  quat_toMat4(Quat quat, Mat4* target);
+void  quat_toAffine(Quat quat, Vec3 translation, Affine* target);
+Quat  quat_multiply(Quat quatOne, Quat quatTwo);
+void  quat_multiply_inplace(Quat* quatOne, Quat quatTwo);
+Quat  quat_conjugate(Quat quat);
+float quat_dot(Quat quatOne, Quat quatTwo);
+Quat  quat_normalize(Quat quat);
+void  quat_normalize_inplace(Quat* quat);
+Vec3  quat_rotate(Quat quat, Vec3 vec);
+Quat  quat_nlerp(Quat quatOne, Quat quatTwo, float t);
+Quat  quat_slerp(Quat quatOne, Quat quatTwo, float t);
+void  quat_log(Quat quat);
+
 #endif // SPACE_H
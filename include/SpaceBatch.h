@@ -0,0 +1,41 @@
+#ifndef SPACE_BATCH_H
+#define SPACE_BATCH_H
+
+#include <stddef.h>
+
+#include "./Space.h"
+
+typedef struct
+{
+    float* x;
+    float* y;
+} Vec2Soa;
+
+typedef struct
+{
+    float* x;
+    float* y;
+    float* z;
+} Vec3Soa;
+
+void vec2soa_normalize(Vec2Soa vecs, Vec2Soa target, size_t count);
+void vec2soa_dot(Vec2Soa vecsOne, Vec2Soa vecsTwo, float* target, size_t count);
+
+void vec3soa_transform_points(Mat4* mat, Vec3Soa points, Vec3Soa target, size_t count);
+void vec3soa_normalize(Vec3Soa vecs, Vec3Soa target, size_t count);
+void vec3soa_dot(Vec3Soa vecsOne, Vec3Soa vecsTwo, float* target, size_t count);
+void vec3soa_cross(Vec3Soa vecsOne, Vec3Soa vecsTwo, Vec3Soa target, size_t count);
+Aabb vec3soa_aabb(Vec3Soa points, size_t count);
+
+void vec3_batch_transform_points(Mat4* mat, const Vec3* points, Vec3* target, size_t count);
+void vec3_batch_normalize(const Vec3* vecs, Vec3* target, size_t count);
+void vec3_batch_dot(const Vec3* vecsOne, const Vec3* vecsTwo, float* target, size_t count);
+void vec3_batch_cross(const Vec3* vecsOne, const Vec3* vecsTwo, Vec3* target, size_t count);
+Aabb vec3_batch_aabb(const Vec3* points, size_t count);
+
+size_t mat4_batch_inverse(Mat4* mats, Mat4* target, size_t count);
+
+void quat_batch_multiply(const Quat* quatsOne, const Quat* quatsTwo, Quat* target, size_t count);
+void quat_batch_toAffine(const Quat* quats, const Vec3* translations, Affine* target, size_t count);
+
+#endif // SPACE_BATCH_H
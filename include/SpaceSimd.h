@@ -0,0 +1,24 @@
+#ifndef SPACE_SIMD_H
+#define SPACE_SIMD_H
+
+#include <stdbool.h>
+
+#include "./Space.h"
+
+typedef struct
+{
+    const char* name;
+    void (*multiply)(Mat4* matOne, Mat4* matTwo, Mat4* target);
+    void (*transpose)(Mat4* mat, Mat4* target);
+    Vec3 (*transformPoint)(Mat4* mat, Vec3 point);
+    void (*affineMultiply)(Affine* matOne, Affine* matTwo, Affine* target);
+    bool (*inverse)(Mat4* mat, Mat4* target);
+} Mat4Kernels;
+
+const Mat4Kernels* mat4_kernels(void);
+const Mat4Kernels* mat4_kernels_scalar(void);
+const Mat4Kernels* mat4_kernels_find(const char* name);
+void               mat4_kernels_use(const Mat4Kernels* kernels);
+
+bool space_cpuHasAvx2(void);
+#endif // SPACE_SIMD_H
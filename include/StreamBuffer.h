@@ -0,0 +1,47 @@
+#ifndef STREAM_BUFFER_H
+#define STREAM_BUFFER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <GL/glew.h>
+
+#define STREAM_BUFFER_MAX_REGIONS 4
+
+typedef enum
+{
+    STREAM_BUFFER_AUTO,
+    // glBufferStorage, mapped once with persistent and coherent bits.
+    STREAM_BUFFER_PERSISTENT,
+    // Fenced regions written through unsynchronized glMapBufferRange.
+    STREAM_BUFFER_UNSYNCHRONIZED,
+    // One region whose storage is orphaned at the start of every frame.
+    STREAM_BUFFER_ORPHAN,
+} StreamBufferMode;
+
+// Ring of frames-in-flight regions. Each frame writes into its own region,
+// which is fenced at the end of the frame and only reused once the GPU has
+// signalled that fence, so the CPU never overwrites data still being read.
+typedef struct
+{
+    GLuint ID;
+    StreamBufferMode mode;
+    GLsizeiptr regionSize;
+    uint32_t regionCount;
+    uint32_t region;
+    GLsizeiptr head;
+    uint8_t* persistent;
+    bool mapped;
+    GLsync fences[STREAM_BUFFER_MAX_REGIONS];
+    uint64_t frameCount;
+    uint64_t stallCount;
+} StreamBuffer;
+
+StreamBuffer streamBuffer_create(GLsizeiptr regionSize, uint32_t regionCount, StreamBufferMode mode);
+void         streamBuffer_beginFrame(StreamBuffer* buffer);
+void*        streamBuffer_allocate(StreamBuffer* buffer, GLsizeiptr size, GLsizeiptr alignment, GLintptr* offset);
+void         streamBuffer_unmap(StreamBuffer* buffer);
+void         streamBuffer_endFrame(StreamBuffer* buffer);
+void         streamBuffer_delete(StreamBuffer* buffer);
+void         streamBuffer_log(StreamBuffer* buffer);
+
+#endif // STREAM_BUFFER_H
@@ -0,0 +1,128 @@
+#ifndef TEXTURE_H
+#define TEXTURE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <GL/glew.h>
+
+#include "./Image.h"
+#include "./StreamBuffer.h"
+
+#define TEXTURE_INVALID_HANDLE      UINT32_MAX
+#define TEXTURE_MAX_PATH            256
+#define TEXTURE_ARRAY_LAYERS        8
+#define TEXTURE_MAX_DECODE_THREADS  8
+
+typedef uint32_t TextureHandle;
+
+typedef enum
+{
+    // Precomputed levels where the files exist, generated otherwise.
+    TEXTURE_FLAG_MIPMAPS = 1 << 0,
+    TEXTURE_FLAG_SRGB    = 1 << 1,
+} TextureFlags;
+
+typedef enum
+{
+    TEXTURE_QUEUED,
+    TEXTURE_UPLOADING,
+    TEXTURE_RESIDENT,
+    TEXTURE_EVICTED,
+    TEXTURE_FAILED,
+} TextureState;
+
+// Layers of one size, level count and format, allocated up front with
+// glTexStorage3D. Textures sharing an array draw without rebinding; the
+// array is freed once its last layer is evicted.
+typedef struct
+{
+    GLuint ID;
+    uint32_t width;
+    uint32_t height;
+    uint32_t levelCount;
+    GLenum internalFormat;
+    uint32_t layerMask;
+    size_t size;
+} TextureArray;
+
+typedef struct
+{
+    char path[TEXTURE_MAX_PATH];
+    uint32_t flags;
+    TextureState state;
+    Image image;
+    bool decodeFailed;
+    float decodeMilliseconds;
+    uint32_t array;
+    uint32_t layer;
+    uint32_t uploadLevel;
+    uint32_t uploadRow;
+    uint64_t lastUsedFrame;
+    uint32_t lruPrev;
+    uint32_t lruNext;
+} Texture;
+
+typedef struct
+{
+    uint32_t* items;
+    uint32_t head;
+    uint32_t count;
+    uint32_t capacity;
+} TextureQueue;
+
+typedef struct
+{
+    uint64_t decoded;
+    uint64_t failed;
+    uint64_t evictions;
+    uint64_t reloads;
+    uint64_t uploadedBytes;
+    uint64_t overBudgetArrays;
+    double decodeMilliseconds;
+} TextureStats;
+
+// Image files are decoded on a pool of worker threads and streamed into
+// texture arrays through a fenced pixel-unpack stream buffer, a bounded
+// number of bytes per frame, so neither decoding nor uploading shows up as
+// a frame spike. Resident textures past the memory budget are evicted
+// least recently used first and decoded again when next bound.
+//
+// The workers hold a pointer to the cache, so it lives on the heap.
+typedef struct
+{
+    Texture* textures;
+    uint32_t textureCount;
+    uint32_t textureCapacity;
+    TextureArray* arrays;
+    uint32_t arrayCount;
+    uint32_t arrayCapacity;
+
+    TextureQueue decodeQueue;
+    TextureQueue decodedQueue;
+    TextureQueue uploadQueue;
+    StreamBuffer staging;
+    size_t budget;
+    size_t residentSize;
+    uint64_t frame;
+    uint32_t lruHead;
+    uint32_t lruTail;
+    TextureStats stats;
+
+    pthread_t threads[TEXTURE_MAX_DECODE_THREADS];
+    uint32_t threadCount;
+    pthread_mutex_t mutex;
+    pthread_cond_t wake;
+    bool quit;
+} TextureCache;
+
+TextureCache* textureCache_create(uint32_t threadCount, size_t budget, GLsizeiptr uploadBytesPerFrame, uint32_t framesInFlight);
+TextureHandle textureCache_load(TextureCache* cache, const char* path, uint32_t flags);
+void          textureCache_update(TextureCache* cache);
+bool          textureCache_bind(TextureCache* cache, TextureHandle handle, GLuint unit, uint32_t* layer);
+TextureState  textureCache_state(const TextureCache* cache, TextureHandle handle);
+void          textureCache_log(const TextureCache* cache);
+void          textureCache_delete(TextureCache* cache);
+
+#endif // TEXTURE_H
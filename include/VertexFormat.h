@@ -0,0 +1,25 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "./Mesh.h"
+
+uint16_t vertexFormat_packHalf(float value);
+float    vertexFormat_unpackHalf(uint16_t value);
+uint32_t vertexFormat_packSnorm1010102(float x, float y, float z, float w);
+uint32_t vertexFormat_packUnorm8888(float x, float y, float z, float w);
+
+uint32_t vertexFormat_attribSize(const MeshAttrib* attrib);
+void     vertexFormat_encode(const MeshAttrib* attrib, void* vertex, const float* values);
+void     vertexFormat_decode(const MeshAttrib* attrib, const void* vertex, float* values);
+void     vertexFormat_convert(
+    void* target, const MeshAttrib* targetAttribs, uint32_t targetAttribCount, uint32_t targetStride,
+    const void* source, const MeshAttrib* sourceAttribs, uint32_t sourceAttribCount, uint32_t sourceStride,
+    uint32_t vertexCount
+);
+bool     vertexFormat_narrowIndices(uint16_t* target, const uint32_t* source, size_t count);
+
+#endif // VERTEX_FORMAT_H
@@ -9,6 +9,8 @@
 
 #include "./Space.h"
 
+// A headless window has no GLFW window; it renders into a framebuffer
+// object on an EGL context instead, and reports no input.
 typedef struct
 {
     GLFWwindow* glfwWindow;
@@ -16,13 +18,28 @@ typedef struct
     int height;
     float deltaTime;
     float _lastTime;
+    bool headless;
+    bool _closing;
+    double _startTime;
+    void* _eglDisplay;
+    void* _eglContext;
+    void* _eglSurface;
+    GLuint framebuffer;
+    GLuint _colorBuffer;
+    GLuint _depthBuffer;
 } Window;
 
 Window window_create(int width, int height, const char* title);
+Window window_createHeadless(int width, int height);
+GLFWwindow* window_createSharedContext(Window* window);
+void   window_makeContextCurrent(void* context);
 void   window_swapBuffers(Window* window);
 void   window_updateDeltaTime(Window* window);
 void   window_destroy(Window* window);
 bool   window_shouldClose(Window* window);
+void   window_close(Window* window);
+void   window_pollEvents(Window* window);
+bool   window_saveScreenshot(Window* window, const char* path);
 bool   window_isKeyPressed(Window* window, int key);
 
 void window_showCursor(Window* window);
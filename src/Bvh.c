@@ -0,0 +1,611 @@
+#include <float.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "../include/Bvh.h"
+
+#define BVH_BIN_COUNT 16
+#define BVH_SAH_MAX_DEPTH 64
+#define BVH_STACK_SIZE 128
+
+// Nodes are stored in one flat array. Inner nodes keep their two children
+// side by side at offset and offset + 1, and children always come after
+// their parent, so a reverse sweep over the array visits children first.
+
+typedef struct
+{
+    BvhNode* data;
+    uint32_t count;
+    uint32_t capacity;
+} NodeArray;
+
+// Primitives are copied into references that are partitioned in place, so
+// every pass over a node's range reads memory sequentially.
+typedef struct
+{
+    Aabb bounds;
+    Vec3 centroid;
+    uint32_t primitive;
+} BuildReference;
+
+typedef struct
+{
+    BuildReference* references;
+} BuildContext;
+
+typedef struct
+{
+    uint32_t nodeIndex;
+    uint32_t first;
+    uint32_t count;
+    NodeArray nodes;
+} BuildTask;
+
+typedef struct
+{
+    BuildTask* tasks;
+    uint32_t count;
+    uint32_t capacity;
+    int splitDepth;
+} BuildTaskList;
+
+typedef struct
+{
+    BuildContext* context;
+    BuildTaskList* taskList;
+    atomic_uint nextTask;
+} BuildWorker;
+
+static inline float minf(float a, float b)
+{
+    return a < b ? a : b;
+}
+
+static inline float maxf(float a, float b)
+{
+    return a > b ? a : b;
+}
+
+static Aabb aabb_empty(void)
+{
+    Aabb aabb =
+    {
+        .min = vec3(FLT_MAX, FLT_MAX, FLT_MAX),
+        .max = vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX),
+    };
+    return aabb;
+}
+
+static inline Aabb aabb_union(Aabb a, Aabb b)
+{
+    Aabb result =
+    {
+        .min = vec3(minf(a.min.x, b.min.x), minf(a.min.y, b.min.y), minf(a.min.z, b.min.z)),
+        .max = vec3(maxf(a.max.x, b.max.x), maxf(a.max.y, b.max.y), maxf(a.max.z, b.max.z)),
+    };
+    return result;
+}
+
+static inline Aabb aabb_extend(Aabb a, Vec3 point)
+{
+    Aabb result =
+    {
+        .min = vec3(minf(a.min.x, point.x), minf(a.min.y, point.y), minf(a.min.z, point.z)),
+        .max = vec3(maxf(a.max.x, point.x), maxf(a.max.y, point.y), maxf(a.max.z, point.z)),
+    };
+    return result;
+}
+
+static float aabb_surfaceArea(Aabb aabb)
+{
+    const Vec3 size = vec3_sub(aabb.max, aabb.min);
+    if (size.x < 0.f || size.y < 0.f || size.z < 0.f)
+    {
+        return 0.f;
+    }
+    return 2.f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+static bool aabb_overlaps(Aabb a, Aabb b)
+{
+    return a.min.x <= b.max.x && a.max.x >= b.min.x
+        && a.min.y <= b.max.y && a.max.y >= b.min.y
+        && a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+static float vec3_component(Vec3 vec, int axis)
+{
+    return (axis == 0) ? vec.x : (axis == 1) ? vec.y : vec.z;
+}
+
+static uint32_t nodeArray_push(NodeArray* nodes, uint32_t count)
+{
+    if (nodes->count + count > nodes->capacity)
+    {
+        uint32_t capacity = nodes->capacity ? nodes->capacity * 2 : 64;
+        while (capacity < nodes->count + count)
+            capacity *= 2;
+        BvhNode* data = realloc(nodes->data, capacity * sizeof(BvhNode));
+        if (data == NULL)
+        {
+            fprintf(stderr, "Failed to allocate BVH nodes!\n");
+            exit(EXIT_FAILURE);
+        }
+        nodes->data = data;
+        nodes->capacity = capacity;
+    }
+    const uint32_t index = nodes->count;
+    nodes->count += count;
+    return index;
+}
+
+static uint32_t partitionBySah(BuildContext* context, uint32_t first, uint32_t count, Aabb centroidBounds, int* splitAxis)
+{
+    float bestCost = FLT_MAX;
+    int bestAxis = -1;
+    int bestBin = 0;
+
+    // Bin all three axes in one pass so every primitive is loaded once.
+    Aabb binBounds[3][BVH_BIN_COUNT];
+    uint32_t binCounts[3][BVH_BIN_COUNT] = { { 0 } };
+    float axisMins[3];
+    float scales[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        const float extent = vec3_component(centroidBounds.max, axis) - vec3_component(centroidBounds.min, axis);
+        axisMins[axis] = vec3_component(centroidBounds.min, axis);
+        scales[axis] = (extent > 0.f) ? BVH_BIN_COUNT / extent : 0.f;
+        for (int bin = 0; bin < BVH_BIN_COUNT; bin++)
+            binBounds[axis][bin] = aabb_empty();
+    }
+
+    for (uint32_t i = first; i < first + count; i++)
+    {
+        const Aabb primitiveBounds = context->references[i].bounds;
+        const Vec3 centroid = context->references[i].centroid;
+        const float components[3] = { centroid.x, centroid.y, centroid.z };
+        for (int axis = 0; axis < 3; axis++)
+        {
+            int bin = (int)((components[axis] - axisMins[axis]) * scales[axis]);
+            bin = bin < BVH_BIN_COUNT ? bin : BVH_BIN_COUNT - 1;
+            binCounts[axis][bin]++;
+            binBounds[axis][bin] = aabb_union(binBounds[axis][bin], primitiveBounds);
+        }
+    }
+
+    for (int axis = 0; axis < 3; axis++)
+    {
+        if (scales[axis] == 0.f)
+            continue;
+
+        // Sweep from the right to get the cost of every split plane in O(bins).
+        float rightAreas[BVH_BIN_COUNT];
+        uint32_t rightCounts[BVH_BIN_COUNT];
+        Aabb right = aabb_empty();
+        uint32_t rightCount = 0;
+        for (int bin = BVH_BIN_COUNT - 1; bin > 0; bin--)
+        {
+            right = aabb_union(right, binBounds[axis][bin]);
+            rightCount += binCounts[axis][bin];
+            rightAreas[bin] = aabb_surfaceArea(right);
+            rightCounts[bin] = rightCount;
+        }
+
+        Aabb left = aabb_empty();
+        uint32_t leftCount = 0;
+        for (int bin = 0; bin < BVH_BIN_COUNT - 1; bin++)
+        {
+            left = aabb_union(left, binBounds[axis][bin]);
+            leftCount += binCounts[axis][bin];
+            if (leftCount == 0 || rightCounts[bin + 1] == 0)
+                continue;
+            const float cost = aabb_surfaceArea(left) * leftCount + rightAreas[bin + 1] * rightCounts[bin + 1];
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestBin = bin;
+            }
+        }
+    }
+
+    if (bestAxis < 0)
+    {
+        *splitAxis = 0;
+        return count / 2;
+    }
+
+    const float axisMin = axisMins[bestAxis];
+    const float scale = scales[bestAxis];
+    uint32_t i = first;
+    uint32_t j = first + count;
+    while (i < j)
+    {
+        const BuildReference reference = context->references[i];
+        int bin = (int)((vec3_component(reference.centroid, bestAxis) - axisMin) * scale);
+        bin = bin < BVH_BIN_COUNT ? bin : BVH_BIN_COUNT - 1;
+        if (bin <= bestBin)
+        {
+            i++;
+        }
+        else
+        {
+            j--;
+            context->references[i] = context->references[j];
+            context->references[j] = reference;
+        }
+    }
+
+    *splitAxis = bestAxis;
+    const uint32_t leftCount = i - first;
+    return (leftCount == 0 || leftCount == count) ? count / 2 : leftCount;
+}
+
+static void buildNode(BuildContext* context, NodeArray* nodes, uint32_t nodeIndex, uint32_t first, uint32_t count, int depth, BuildTaskList* taskList)
+{
+    Aabb bounds = aabb_empty();
+    Aabb centroidBounds = aabb_empty();
+    for (uint32_t i = first; i < first + count; i++)
+    {
+        bounds = aabb_union(bounds, context->references[i].bounds);
+        centroidBounds = aabb_extend(centroidBounds, context->references[i].centroid);
+    }
+
+    BvhNode* node = &nodes->data[nodeIndex];
+    node->bounds = bounds;
+    node->axis = 0;
+
+    if (count <= BVH_MAX_LEAF_SIZE)
+    {
+        node->offset = first;
+        node->count = (uint16_t)count;
+        return;
+    }
+    node->count = 0;
+
+    if (taskList != NULL && depth == taskList->splitDepth)
+    {
+        BuildTask task =
+        {
+            .nodeIndex = nodeIndex,
+            .first = first,
+            .count = count,
+        };
+        taskList->tasks[taskList->count++] = task;
+        return;
+    }
+
+    int axis = 0;
+    uint32_t leftCount = count / 2;
+    if (depth < BVH_SAH_MAX_DEPTH)
+    {
+        leftCount = partitionBySah(context, first, count, centroidBounds, &axis);
+    }
+
+    const uint32_t children = nodeArray_push(nodes, 2);
+    nodes->data[nodeIndex].offset = children;
+    nodes->data[nodeIndex].axis = (uint16_t)axis;
+
+    buildNode(context, nodes, children, first, leftCount, depth + 1, taskList);
+    buildNode(context, nodes, children + 1, first + leftCount, count - leftCount, depth + 1, taskList);
+}
+
+static void* buildWorker(void* argument)
+{
+    BuildWorker* worker = argument;
+    for (;;)
+    {
+        const uint32_t taskIndex = atomic_fetch_add(&worker->nextTask, 1);
+        if (taskIndex >= worker->taskList->count)
+            break;
+
+        BuildTask* task = &worker->taskList->tasks[taskIndex];
+        memset(&task->nodes, 0, sizeof(NodeArray));
+        nodeArray_push(&task->nodes, 1);
+        buildNode(worker->context, &task->nodes, 0, task->first, task->count, 0, NULL);
+    }
+    return NULL;
+}
+
+static void mergeTask(NodeArray* nodes, BuildTask* task)
+{
+    // Local node k > 0 lands at base + k - 1; the local root replaces the
+    // placeholder left in the shared tree.
+    const uint32_t base = nodeArray_push(nodes, task->nodes.count - 1);
+    for (uint32_t k = 0; k < task->nodes.count; k++)
+    {
+        BvhNode node = task->nodes.data[k];
+        if (node.count == 0)
+        {
+            node.offset = node.offset - 1 + base;
+        }
+        nodes->data[(k == 0) ? task->nodeIndex : base + k - 1] = node;
+    }
+    free(task->nodes.data);
+}
+
+Bvh bvh_build(const Aabb* bounds, uint32_t count, int threadCount)
+{
+    Bvh bvh =
+    {
+        .nodes = NULL,
+        .nodeCount = 0,
+        .primitiveIndices = NULL,
+        .primitiveCount = count,
+    };
+    if (count == 0)
+    {
+        return bvh;
+    }
+
+    BuildContext context =
+    {
+        .references = malloc(count * sizeof(BuildReference)),
+    };
+    bvh.primitiveIndices = malloc(count * sizeof(uint32_t));
+    if (context.references == NULL || bvh.primitiveIndices == NULL)
+    {
+        fprintf(stderr, "Failed to allocate BVH build data!\n");
+        exit(EXIT_FAILURE);
+    }
+    for (uint32_t i = 0; i < count; i++)
+    {
+        context.references[i].bounds = bounds[i];
+        context.references[i].centroid = vec3_scale(vec3_add(bounds[i].min, bounds[i].max), 0.5f);
+        context.references[i].primitive = i;
+    }
+
+    NodeArray nodes = { 0 };
+    nodeArray_push(&nodes, 1);
+
+    if (threadCount <= 1)
+    {
+        buildNode(&context, &nodes, 0, 0, count, 0, NULL);
+    }
+    else
+    {
+        // Build the top of the tree serially, then hand each subtree below
+        // splitDepth to a worker that builds it into its own node array.
+        int splitDepth = 1;
+        while ((1 << splitDepth) < threadCount * 2)
+            splitDepth++;
+
+        BuildTaskList taskList =
+        {
+            .tasks = malloc(sizeof(BuildTask) << splitDepth),
+            .count = 0,
+            .capacity = 1u << splitDepth,
+            .splitDepth = splitDepth,
+        };
+        if (taskList.tasks == NULL)
+        {
+            fprintf(stderr, "Failed to allocate BVH build tasks!\n");
+            exit(EXIT_FAILURE);
+        }
+        buildNode(&context, &nodes, 0, 0, count, 0, &taskList);
+
+        BuildWorker worker =
+        {
+            .context = &context,
+            .taskList = &taskList,
+        };
+        atomic_init(&worker.nextTask, 0);
+
+        pthread_t threads[threadCount];
+        int startedThreads = 0;
+        for (int i = 1; i < threadCount && (uint32_t)i < taskList.count; i++)
+        {
+            if (pthread_create(&threads[startedThreads], NULL, buildWorker, &worker) == 0)
+                startedThreads++;
+        }
+        buildWorker(&worker);
+        for (int i = 0; i < startedThreads; i++)
+            pthread_join(threads[i], NULL);
+
+        for (uint32_t i = 0; i < taskList.count; i++)
+            mergeTask(&nodes, &taskList.tasks[i]);
+        free(taskList.tasks);
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+        bvh.primitiveIndices[i] = context.references[i].primitive;
+    free(context.references);
+
+    bvh.nodes = nodes.data;
+    bvh.nodeCount = nodes.count;
+    return bvh;
+}
+
+void bvh_refit(Bvh* bvh, const Aabb* bounds)
+{
+    for (uint32_t i = bvh->nodeCount; i-- > 0;)
+    {
+        BvhNode* node = &bvh->nodes[i];
+        if (node->count > 0)
+        {
+            Aabb leafBounds = aabb_empty();
+            for (uint32_t j = node->offset; j < node->offset + node->count; j++)
+                leafBounds = aabb_union(leafBounds, bounds[bvh->primitiveIndices[j]]);
+            node->bounds = leafBounds;
+        }
+        else
+        {
+            node->bounds = aabb_union(bvh->nodes[node->offset].bounds, bvh->nodes[node->offset + 1].bounds);
+        }
+    }
+}
+
+// Returns -1 when the box is outside one of the planes in planeMask,
+// otherwise the subset of planes the box still straddles.
+static int classifyAabb(Frustum* frustum, Aabb aabb, int planeMask)
+{
+    const Vec3 center = vec3_scale(vec3_add(aabb.min, aabb.max), 0.5f);
+    const Vec3 extent = vec3_scale(vec3_sub(aabb.max, aabb.min), 0.5f);
+    int straddling = 0;
+    for (int plane = 0; plane < FRUSTUM_PLANE_COUNT; plane++)
+    {
+        if (!(planeMask & (1 << plane)))
+            continue;
+        const float distance = vec3_dot(frustum->planes[plane].normal, center) + frustum->planes[plane].distance;
+        const float radius = vec3_dot(frustum->absNormals[plane], extent);
+        if (distance + radius < 0.f)
+            return -1;
+        if (distance - radius < 0.f)
+            straddling |= 1 << plane;
+    }
+    return straddling;
+}
+
+size_t bvh_cullFrustum(Bvh* bvh, const Aabb* bounds, Frustum* frustum, uint32_t* visibleIndices)
+{
+    if (bvh->nodeCount == 0)
+        return 0;
+
+    size_t visibleCount = 0;
+    uint32_t stack[BVH_STACK_SIZE];
+    uint8_t maskStack[BVH_STACK_SIZE];
+    int top = 0;
+    stack[top] = 0;
+    maskStack[top++] = (1 << FRUSTUM_PLANE_COUNT) - 1;
+
+    while (top > 0)
+    {
+        top--;
+        const BvhNode* node = &bvh->nodes[stack[top]];
+        int planeMask = maskStack[top];
+        if (planeMask != 0)
+        {
+            planeMask = classifyAabb(frustum, node->bounds, planeMask);
+            if (planeMask < 0)
+                continue;
+        }
+
+        if (node->count > 0)
+        {
+            for (uint32_t i = node->offset; i < node->offset + node->count; i++)
+            {
+                const uint32_t primitive = bvh->primitiveIndices[i];
+                if (planeMask == 0 || classifyAabb(frustum, bounds[primitive], planeMask) >= 0)
+                    visibleIndices[visibleCount++] = primitive;
+            }
+            continue;
+        }
+
+        stack[top] = node->offset + 1;
+        maskStack[top++] = (uint8_t)planeMask;
+        stack[top] = node->offset;
+        maskStack[top++] = (uint8_t)planeMask;
+    }
+    return visibleCount;
+}
+
+static bool rayIntersectsAabb(Vec3 origin, Vec3 inverseDirection, Aabb aabb, float maxDistance, float* distance)
+{
+    const float x1 = (aabb.min.x - origin.x) * inverseDirection.x;
+    const float x2 = (aabb.max.x - origin.x) * inverseDirection.x;
+    const float y1 = (aabb.min.y - origin.y) * inverseDirection.y;
+    const float y2 = (aabb.max.y - origin.y) * inverseDirection.y;
+    const float z1 = (aabb.min.z - origin.z) * inverseDirection.z;
+    const float z2 = (aabb.max.z - origin.z) * inverseDirection.z;
+
+    const float near = fmaxf(fmaxf(fminf(x1, x2), fminf(y1, y2)), fmaxf(fminf(z1, z2), 0.f));
+    const float far = fminf(fminf(fmaxf(x1, x2), fmaxf(y1, y2)), fminf(fmaxf(z1, z2), maxDistance));
+    *distance = near;
+    return near <= far;
+}
+
+bool bvh_raycast(Bvh* bvh, const Aabb* bounds, Ray ray, float maxDistance, BvhRayTest test, void* userData, BvhHit* hit)
+{
+    if (bvh->nodeCount == 0)
+        return false;
+
+    const Vec3 inverseDirection = vec3(1.f / ray.direction.x, 1.f / ray.direction.y, 1.f / ray.direction.z);
+    const bool negative[3] = { ray.direction.x < 0.f, ray.direction.y < 0.f, ray.direction.z < 0.f };
+
+    float closest = maxDistance;
+    bool found = false;
+    uint32_t stack[BVH_STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top > 0)
+    {
+        const BvhNode* node = &bvh->nodes[stack[--top]];
+        float distance;
+        if (!rayIntersectsAabb(ray.origin, inverseDirection, node->bounds, closest, &distance))
+            continue;
+
+        if (node->count > 0)
+        {
+            for (uint32_t i = node->offset; i < node->offset + node->count; i++)
+            {
+                const uint32_t primitive = bvh->primitiveIndices[i];
+                if (!rayIntersectsAabb(ray.origin, inverseDirection, bounds[primitive], closest, &distance))
+                    continue;
+                if (test != NULL && !test(userData, primitive, ray, &distance))
+                    continue;
+                if (distance <= closest)
+                {
+                    closest = distance;
+                    found = true;
+                    if (hit != NULL)
+                    {
+                        hit->primitive = primitive;
+                        hit->distance = distance;
+                    }
+                }
+            }
+            continue;
+        }
+
+        // Push the far child first so the near one is visited next.
+        const bool rightFirst = negative[node->axis];
+        stack[top++] = rightFirst ? node->offset : node->offset + 1;
+        stack[top++] = rightFirst ? node->offset + 1 : node->offset;
+    }
+    return found;
+}
+
+size_t bvh_queryOverlap(Bvh* bvh, const Aabb* bounds, Aabb query, uint32_t* results, size_t maxResults)
+{
+    if (bvh->nodeCount == 0)
+        return 0;
+
+    size_t resultCount = 0;
+    uint32_t stack[BVH_STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top > 0 && resultCount < maxResults)
+    {
+        const BvhNode* node = &bvh->nodes[stack[--top]];
+        if (!aabb_overlaps(node->bounds, query))
+            continue;
+
+        if (node->count > 0)
+        {
+            for (uint32_t i = node->offset; i < node->offset + node->count && resultCount < maxResults; i++)
+            {
+                const uint32_t primitive = bvh->primitiveIndices[i];
+                if (aabb_overlaps(bounds[primitive], query))
+                    results[resultCount++] = primitive;
+            }
+            continue;
+        }
+
+        stack[top++] = node->offset + 1;
+        stack[top++] = node->offset;
+    }
+    return resultCount;
+}
+
+void bvh_delete(Bvh* bvh)
+{
+    free(bvh->nodes);
+    free(bvh->primitiveIndices);
+    bvh->nodes = NULL;
+    bvh->nodeCount = 0;
+    bvh->primitiveIndices = NULL;
+    bvh->primitiveCount = 0;
+}
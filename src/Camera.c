@@ -6,6 +6,7 @@ Camera camera_create(float fov, float speed, float sensitivity, float aspectRati
     {
         .position = vec3(0.f, 0.f, 0.f),
         .front = vec3(0.f, 0.f, -1.f),
+        .orientation = quat_identity(),
         .yaw = -90.f,
         .pitch = 0.f,
         .fov = fov,
@@ -13,6 +14,7 @@ Camera camera_create(float fov, float speed, float sensitivity, float aspectRati
         .sensitivity = sensitivity,
         .aspectRatio = aspectRatio,
         .locked = false,
+        .quaternion = false,
     };
     mat4_load_identity(&camera.matrix);
     return camera;
@@ -58,6 +60,54 @@ void camera_unlock(Camera* camera)
     camera->locked = false;
 }
 
+void camera_enableQuaternion(Camera* camera)
+{
+    // Yaw -90 looks down -Z, which is the identity orientation.
+    camera->orientation = quat_multiply(
+        quat_fromAxisAngle(vec3(0.f, 1.f, 0.f), -(camera->yaw + 90.f)),
+        quat_fromAxisAngle(vec3(1.f, 0.f, 0.f), camera->pitch)
+    );
+    camera->front = quat_rotate(camera->orientation, vec3(0.f, 0.f, -1.f));
+    camera->quaternion = true;
+}
+
+void camera_disableQuaternion(Camera* camera)
+{
+    camera->quaternion = false;
+}
+
+static Quat camera_incrementalRotation(Vec3 axis, float degrees)
+{
+    // Mouse deltas are small from frame to frame, so the trig-free
+    // approximation is exact to well under a thousandth of a degree.
+    return fabsf(degrees) < 2.f
+        ? quat_fromAxisAngle_fast(axis, degrees)
+        : quat_fromAxisAngle(axis, degrees);
+}
+
+static void camera_rotateQuaternion(Camera* camera, float deltaYaw, float deltaPitch)
+{
+    // Yaw about the world up axis, pitch about the camera's own right axis.
+    // The accumulated pitch is still tracked so it can be clamped.
+    float pitch = camera->pitch + deltaPitch;
+    if (pitch > 89.f)
+    {
+        pitch = 89.f;
+    }
+    else if (pitch < -89.f)
+    {
+        pitch = -89.f;
+    }
+    deltaPitch = pitch - camera->pitch;
+    camera->pitch = pitch;
+    camera->yaw = fmod(camera->yaw + deltaYaw, 360.f);
+
+    Quat orientation = quat_multiply(camera_incrementalRotation(vec3(0.f, 1.f, 0.f), -deltaYaw), camera->orientation);
+    orientation = quat_multiply(orientation, camera_incrementalRotation(vec3(1.f, 0.f, 0.f), deltaPitch));
+    camera->orientation = quat_normalize(orientation);
+    camera->front = quat_rotate(camera->orientation, vec3(0.f, 0.f, -1.f));
+}
+
 void camera_recomputePosition(Camera* camera, Window* window)
 {
     if (!camera->locked) return;
@@ -89,6 +139,12 @@ void camera_recomputeRotation(Camera* camera, Window* window)
     const float deltaX = (float)(mouseX - (float)windowWidth / 2.f) * camera->sensitivity;
     const float deltaY = (float)(mouseY - (float)windowHeight / 2.f) * camera->sensitivity;
 
+    if (camera->quaternion)
+    {
+        camera_rotateQuaternion(camera, deltaX * camera->sensitivity, -deltaY * camera->sensitivity);
+        return;
+    }
+
     camera->yaw += deltaX * camera->sensitivity;
     camera->pitch -= deltaY * camera->sensitivity;
 
@@ -111,21 +167,39 @@ void camera_recomputeRotation(Camera* camera, Window* window)
 
 void camera_recomputeMatrix(Camera* camera)
 {
-    Mat4* view = mat4_lookAt(
-        camera->position,
-        vec3_add(camera->position, camera->front),
-        vec3(0.f, 1.f, 0.f)
-    );
-    Mat4* projection = mat4_perspective(
+    Mat4 view;
+    Mat4 projection;
+    if (camera->quaternion)
+    {
+        mat4_view_inplace(&view, camera->position, camera->orientation);
+    }
+    else
+    {
+        mat4_lookAt_inplace(
+            &view,
+            camera->position,
+            vec3_add(camera->position, camera->front),
+            vec3(0.f, 1.f, 0.f)
+        );
+    }
+    mat4_perspective_inplace(
+        &projection,
         camera->fov,
         camera->aspectRatio,
         0.01f,
         100.f
     );
 
-    mat4_load_identity(&camera->matrix);
-    mat4_multiply_many_inplace(&camera->matrix, 2, view, projection);
+    mat4_multiply_to(&view, &projection, &camera->matrix);
+}
 
-    free(view);
-    free(projection);
+void camera_upload(Camera* camera, UBO UBO)
+{
+    CameraBlock block;
+    mat4_copy(&camera->matrix, &block.matrix);
+    block.position[0] = camera->position.x;
+    block.position[1] = camera->position.y;
+    block.position[2] = camera->position.z;
+    block.position[3] = 1.f;
+    ubo_update(UBO, 0, sizeof(CameraBlock), &block);
 }
@@ -0,0 +1,224 @@
+#include "../include/Culling.h"
+#include "../include/Simd.h"
+
+// Objects are culled in groups of four. A group that was fully rejected by
+// a plane caches that plane in planeCache so the next frame tests it first.
+
+static Plane normalizePlane(float x, float y, float z, float w)
+{
+    const float length = sqrtf(x * x + y * y + z * z);
+    const float inverseLength = (length == 0.f) ? 0.f : 1.f / length;
+    Plane plane =
+    {
+        .normal = vec3(x * inverseLength, y * inverseLength, z * inverseLength),
+        .distance = w * inverseLength,
+    };
+    return plane;
+}
+
+void frustum_extract(Frustum* frustum, Mat4* mat)
+{
+    // Rows of the clip matrix; Mat4 is stored column by column.
+    float rows[4][4];
+    for (int row = 0; row < 4; row++)
+        for (int column = 0; column < 4; column++)
+            rows[row][column] = (*mat)[column][row];
+
+    for (int i = 0; i < 3; i++)
+    {
+        frustum->planes[i * 2] = normalizePlane(
+            rows[3][0] + rows[i][0],
+            rows[3][1] + rows[i][1],
+            rows[3][2] + rows[i][2],
+            rows[3][3] + rows[i][3]
+        );
+        frustum->planes[i * 2 + 1] = normalizePlane(
+            rows[3][0] - rows[i][0],
+            rows[3][1] - rows[i][1],
+            rows[3][2] - rows[i][2],
+            rows[3][3] - rows[i][3]
+        );
+    }
+
+    for (int i = 0; i < FRUSTUM_PLANE_COUNT; i++)
+    {
+        const Vec3 normal = frustum->planes[i].normal;
+        frustum->absNormals[i] = vec3(fabsf(normal.x), fabsf(normal.y), fabsf(normal.z));
+        frustum->octants[i] = (normal.x >= 0.f ? 1 : 0) | (normal.y >= 0.f ? 2 : 0) | (normal.z >= 0.f ? 4 : 0);
+    }
+}
+
+static float planeDistance(Plane plane, Vec3 point)
+{
+    return vec3_dot(plane.normal, point) + plane.distance;
+}
+
+static int sphereRejectingPlane(Frustum* frustum, Sphere sphere, int firstPlane)
+{
+    for (int i = 0; i < FRUSTUM_PLANE_COUNT; i++)
+    {
+        const int plane = (firstPlane + i) % FRUSTUM_PLANE_COUNT;
+        if (planeDistance(frustum->planes[plane], sphere.center) < -sphere.radius)
+        {
+            return plane;
+        }
+    }
+    return -1;
+}
+
+static int aabbRejectingPlane(Frustum* frustum, Aabb aabb, int firstPlane)
+{
+    for (int i = 0; i < FRUSTUM_PLANE_COUNT; i++)
+    {
+        const int plane = (firstPlane + i) % FRUSTUM_PLANE_COUNT;
+        const uint8_t octant = frustum->octants[plane];
+        const Vec3 positiveVertex = vec3(
+            (octant & 1) ? aabb.max.x : aabb.min.x,
+            (octant & 2) ? aabb.max.y : aabb.min.y,
+            (octant & 4) ? aabb.max.z : aabb.min.z
+        );
+        if (planeDistance(frustum->planes[plane], positiveVertex) < 0.f)
+        {
+            return plane;
+        }
+    }
+    return -1;
+}
+
+bool frustum_testSphere(Frustum* frustum, Sphere sphere)
+{
+    return sphereRejectingPlane(frustum, sphere, 0) < 0;
+}
+
+bool frustum_testAabb(Frustum* frustum, Aabb aabb)
+{
+    return aabbRejectingPlane(frustum, aabb, 0) < 0;
+}
+
+size_t frustum_cullSpheres(Frustum* frustum, const Sphere* spheres, size_t count, uint8_t* planeCache, uint32_t* visibleIndices)
+{
+    size_t visibleCount = 0;
+    size_t i = 0;
+#if defined(SIMD_WIDTH)
+    for (; i + SIMD_WIDTH <= count; i += SIMD_WIDTH)
+    {
+        SimdFloat x, y, z, radius;
+        simd_load4((const float*)(spheres + i), &x, &y, &z, &radius);
+        const SimdFloat negativeRadius = simd_sub(simd_set(0.f), radius);
+
+        const size_t group = i / SIMD_WIDTH;
+        const int firstPlane = (planeCache != NULL) ? planeCache[group] : 0;
+        int outsideMask = 0;
+        for (int j = 0; j < FRUSTUM_PLANE_COUNT && outsideMask != 0xF; j++)
+        {
+            const int plane = (firstPlane + j) % FRUSTUM_PLANE_COUNT;
+            const Plane p = frustum->planes[plane];
+            SimdFloat distance = simd_mul(simd_set(p.normal.x), x);
+            distance = simd_add(distance, simd_mul(simd_set(p.normal.y), y));
+            distance = simd_add(distance, simd_mul(simd_set(p.normal.z), z));
+            distance = simd_add(distance, simd_set(p.distance));
+            outsideMask |= simd_mask(simd_lessThan(distance, negativeRadius));
+            if (outsideMask == 0xF && planeCache != NULL)
+            {
+                planeCache[group] = (uint8_t)plane;
+            }
+        }
+
+        for (int lane = 0; lane < SIMD_WIDTH; lane++)
+        {
+            if (!(outsideMask & (1 << lane)))
+            {
+                visibleIndices[visibleCount++] = (uint32_t)(i + lane);
+            }
+        }
+    }
+#endif
+    for (; i < count; i++)
+    {
+        const int firstPlane = (planeCache != NULL) ? planeCache[i / 4] : 0;
+        const int plane = sphereRejectingPlane(frustum, spheres[i], firstPlane);
+        if (plane < 0)
+        {
+            visibleIndices[visibleCount++] = (uint32_t)i;
+        }
+        else if (planeCache != NULL)
+        {
+            planeCache[i / 4] = (uint8_t)plane;
+        }
+    }
+    return visibleCount;
+}
+
+size_t frustum_cullAabbs(Frustum* frustum, const Aabb* aabbs, size_t count, uint8_t* planeCache, uint32_t* visibleIndices)
+{
+    size_t visibleCount = 0;
+    size_t i = 0;
+#if defined(SIMD_WIDTH)
+    const SimdFloat half = simd_set(0.5f);
+    for (; i + SIMD_WIDTH <= count; i += SIMD_WIDTH)
+    {
+        // Each Aabb is a (min, max) pair of Vec3, so two packed gathers
+        // yield interleaved min/max lanes that are then unzipped.
+        SimdFloat xLow, yLow, zLow, xHigh, yHigh, zHigh;
+        simd_load3(&aabbs[i].min, &xLow, &yLow, &zLow);
+        simd_load3(&aabbs[i + 2].min, &xHigh, &yHigh, &zHigh);
+        const SimdFloat minX = simd_unzipEven(xLow, xHigh), maxX = simd_unzipOdd(xLow, xHigh);
+        const SimdFloat minY = simd_unzipEven(yLow, yHigh), maxY = simd_unzipOdd(yLow, yHigh);
+        const SimdFloat minZ = simd_unzipEven(zLow, zHigh), maxZ = simd_unzipOdd(zLow, zHigh);
+
+        const SimdFloat centerX = simd_mul(simd_add(minX, maxX), half);
+        const SimdFloat centerY = simd_mul(simd_add(minY, maxY), half);
+        const SimdFloat centerZ = simd_mul(simd_add(minZ, maxZ), half);
+        const SimdFloat extentX = simd_mul(simd_sub(maxX, minX), half);
+        const SimdFloat extentY = simd_mul(simd_sub(maxY, minY), half);
+        const SimdFloat extentZ = simd_mul(simd_sub(maxZ, minZ), half);
+
+        const size_t group = i / SIMD_WIDTH;
+        const int firstPlane = (planeCache != NULL) ? planeCache[group] : 0;
+        int outsideMask = 0;
+        for (int j = 0; j < FRUSTUM_PLANE_COUNT && outsideMask != 0xF; j++)
+        {
+            const int plane = (firstPlane + j) % FRUSTUM_PLANE_COUNT;
+            const Plane p = frustum->planes[plane];
+            const Vec3 absNormal = frustum->absNormals[plane];
+
+            SimdFloat distance = simd_mul(simd_set(p.normal.x), centerX);
+            distance = simd_add(distance, simd_mul(simd_set(p.normal.y), centerY));
+            distance = simd_add(distance, simd_mul(simd_set(p.normal.z), centerZ));
+            distance = simd_add(distance, simd_set(p.distance));
+
+            SimdFloat radius = simd_mul(simd_set(absNormal.x), extentX);
+            radius = simd_add(radius, simd_mul(simd_set(absNormal.y), extentY));
+            radius = simd_add(radius, simd_mul(simd_set(absNormal.z), extentZ));
+
+            outsideMask |= simd_mask(simd_lessThan(simd_add(distance, radius), simd_set(0.f)));
+            if (outsideMask == 0xF && planeCache != NULL)
+            {
+                planeCache[group] = (uint8_t)plane;
+            }
+        }
+
+        for (int lane = 0; lane < SIMD_WIDTH; lane++)
+        {
+            if (!(outsideMask & (1 << lane)))
+            {
+                visibleIndices[visibleCount++] = (uint32_t)(i + lane);
+            }
+        }
+    }
+#endif
+    for (; i < count; i++)
+    {
+        const int firstPlane = (planeCache != NULL) ? planeCache[i / 4] : 0;
+        const int plane = aabbRejectingPlane(frustum, aabbs[i], firstPlane);
+        if (plane < 0)
+        {
+            visibleIndices[visibleCount++] = (uint32_t)i;
+        }
+        else if (planeCache != NULL)
+        {
+            planeCache[i / 4] = (uint8_t)plane;
+        }
+    }
+    return visibleCount;
+}
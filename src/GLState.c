@@ -0,0 +1,485 @@
+#include "../include/GLState.h"
+
+#include <stdio.h>
+
+#define GL_STATE_UNKNOWN 0xFFFFFFFFu
+
+typedef enum
+{
+    GL_STATE_BUFFER_ARRAY,
+    GL_STATE_BUFFER_ELEMENT_ARRAY,
+    GL_STATE_BUFFER_UNIFORM,
+    GL_STATE_BUFFER_SHADER_STORAGE,
+    GL_STATE_BUFFER_DRAW_INDIRECT,
+    GL_STATE_BUFFER_DISPATCH_INDIRECT,
+    GL_STATE_BUFFER_COPY_READ,
+    GL_STATE_BUFFER_COPY_WRITE,
+    GL_STATE_BUFFER_PIXEL_PACK,
+    GL_STATE_BUFFER_PIXEL_UNPACK,
+    GL_STATE_BUFFER_COUNT,
+} GLStateBuffer;
+
+typedef enum
+{
+    GL_STATE_TEXTURE_2D,
+    GL_STATE_TEXTURE_2D_ARRAY,
+    GL_STATE_TEXTURE_3D,
+    GL_STATE_TEXTURE_CUBE_MAP,
+    GL_STATE_TEXTURE_COUNT,
+} GLStateTexture;
+
+typedef enum
+{
+    GL_STATE_CAPABILITY_DEPTH_TEST,
+    GL_STATE_CAPABILITY_BLEND,
+    GL_STATE_CAPABILITY_CULL_FACE,
+    GL_STATE_CAPABILITY_SCISSOR_TEST,
+    GL_STATE_CAPABILITY_COUNT,
+} GLStateCapability;
+
+typedef struct
+{
+    GLuint buffer;
+    GLintptr offset;
+    GLsizeiptr size;
+} GLStateIndexedBuffer;
+
+typedef struct
+{
+    GLuint program;
+    GLuint vertexArray;
+    GLuint buffers[GL_STATE_BUFFER_COUNT];
+    GLStateIndexedBuffer uniformBuffers[GL_STATE_INDEXED_BUFFERS];
+    GLStateIndexedBuffer storageBuffers[GL_STATE_INDEXED_BUFFERS];
+    GLuint activeTexture;
+    GLuint textures[GL_STATE_TEXTURE_UNITS][GL_STATE_TEXTURE_COUNT];
+    int8_t capabilities[GL_STATE_CAPABILITY_COUNT];
+    GLenum depthFunc;
+    GLint depthMask;
+    GLenum blendSource;
+    GLenum blendDestination;
+    GLenum cullFace;
+    GLint viewport[4];
+    GLStateStats stats;
+} GLStateCache;
+
+static GLStateCache cache;
+static bool cacheValid = false;
+
+static int glState_bufferIndex(GLenum target)
+{
+    switch (target)
+    {
+        case GL_ARRAY_BUFFER:             return GL_STATE_BUFFER_ARRAY;
+        case GL_ELEMENT_ARRAY_BUFFER:     return GL_STATE_BUFFER_ELEMENT_ARRAY;
+        case GL_UNIFORM_BUFFER:           return GL_STATE_BUFFER_UNIFORM;
+        case GL_SHADER_STORAGE_BUFFER:    return GL_STATE_BUFFER_SHADER_STORAGE;
+        case GL_DRAW_INDIRECT_BUFFER:     return GL_STATE_BUFFER_DRAW_INDIRECT;
+        case GL_DISPATCH_INDIRECT_BUFFER: return GL_STATE_BUFFER_DISPATCH_INDIRECT;
+        case GL_COPY_READ_BUFFER:         return GL_STATE_BUFFER_COPY_READ;
+        case GL_COPY_WRITE_BUFFER:        return GL_STATE_BUFFER_COPY_WRITE;
+        case GL_PIXEL_PACK_BUFFER:        return GL_STATE_BUFFER_PIXEL_PACK;
+        case GL_PIXEL_UNPACK_BUFFER:      return GL_STATE_BUFFER_PIXEL_UNPACK;
+        default:                          return -1;
+    }
+}
+
+static int glState_textureIndex(GLenum target)
+{
+    switch (target)
+    {
+        case GL_TEXTURE_2D:       return GL_STATE_TEXTURE_2D;
+        case GL_TEXTURE_2D_ARRAY: return GL_STATE_TEXTURE_2D_ARRAY;
+        case GL_TEXTURE_3D:       return GL_STATE_TEXTURE_3D;
+        case GL_TEXTURE_CUBE_MAP: return GL_STATE_TEXTURE_CUBE_MAP;
+        default:                  return -1;
+    }
+}
+
+static int glState_capabilityIndex(GLenum capability)
+{
+    switch (capability)
+    {
+        case GL_DEPTH_TEST:   return GL_STATE_CAPABILITY_DEPTH_TEST;
+        case GL_BLEND:        return GL_STATE_CAPABILITY_BLEND;
+        case GL_CULL_FACE:    return GL_STATE_CAPABILITY_CULL_FACE;
+        case GL_SCISSOR_TEST: return GL_STATE_CAPABILITY_SCISSOR_TEST;
+        default:              return -1;
+    }
+}
+
+static GLStateIndexedBuffer* glState_indexedBuffer(GLenum target, GLuint index)
+{
+    if (index >= GL_STATE_INDEXED_BUFFERS)
+    {
+        return NULL;
+    }
+    switch (target)
+    {
+        case GL_UNIFORM_BUFFER:        return &cache.uniformBuffers[index];
+        case GL_SHADER_STORAGE_BUFFER: return &cache.storageBuffers[index];
+        default:                       return NULL;
+    }
+}
+
+static inline bool glState_skip(bool unchanged)
+{
+    if (unchanged)
+    {
+        cache.stats.skipped++;
+        return true;
+    }
+    cache.stats.issued++;
+    return false;
+}
+
+void glState_reset(void)
+{
+    GLStateStats stats = cacheValid ? cache.stats : (GLStateStats){ 0, 0 };
+
+    cache.program = GL_STATE_UNKNOWN;
+    cache.vertexArray = GL_STATE_UNKNOWN;
+    for (int i = 0; i < GL_STATE_BUFFER_COUNT; i++)
+    {
+        cache.buffers[i] = GL_STATE_UNKNOWN;
+    }
+    for (int i = 0; i < GL_STATE_INDEXED_BUFFERS; i++)
+    {
+        cache.uniformBuffers[i].buffer = GL_STATE_UNKNOWN;
+        cache.storageBuffers[i].buffer = GL_STATE_UNKNOWN;
+    }
+    cache.activeTexture = GL_STATE_UNKNOWN;
+    for (int unit = 0; unit < GL_STATE_TEXTURE_UNITS; unit++)
+    {
+        for (int i = 0; i < GL_STATE_TEXTURE_COUNT; i++)
+        {
+            cache.textures[unit][i] = GL_STATE_UNKNOWN;
+        }
+    }
+    for (int i = 0; i < GL_STATE_CAPABILITY_COUNT; i++)
+    {
+        cache.capabilities[i] = -1;
+    }
+    cache.depthFunc = GL_STATE_UNKNOWN;
+    cache.depthMask = -1;
+    cache.blendSource = GL_STATE_UNKNOWN;
+    cache.blendDestination = GL_STATE_UNKNOWN;
+    cache.cullFace = GL_STATE_UNKNOWN;
+    cache.viewport[0] = cache.viewport[1] = cache.viewport[2] = cache.viewport[3] = -1;
+
+    cache.stats = stats;
+    cacheValid = true;
+}
+
+static void glState_ensureValid(void)
+{
+    if (!cacheValid)
+    {
+        glState_reset();
+    }
+}
+
+void glState_useProgram(GLuint program)
+{
+    glState_ensureValid();
+    if (glState_skip(cache.program == program))
+    {
+        return;
+    }
+    glUseProgram(program);
+    cache.program = program;
+}
+
+void glState_bindVertexArray(GLuint vertexArray)
+{
+    glState_ensureValid();
+    if (glState_skip(cache.vertexArray == vertexArray))
+    {
+        return;
+    }
+    glBindVertexArray(vertexArray);
+    cache.vertexArray = vertexArray;
+    // The element array binding belongs to the VAO, not the context.
+    cache.buffers[GL_STATE_BUFFER_ELEMENT_ARRAY] = GL_STATE_UNKNOWN;
+}
+
+void glState_bindBuffer(GLenum target, GLuint buffer)
+{
+    glState_ensureValid();
+    const int index = glState_bufferIndex(target);
+    if (index < 0)
+    {
+        cache.stats.issued++;
+        glBindBuffer(target, buffer);
+        return;
+    }
+    if (glState_skip(cache.buffers[index] == buffer))
+    {
+        return;
+    }
+    glBindBuffer(target, buffer);
+    cache.buffers[index] = buffer;
+}
+
+void glState_bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+    glState_ensureValid();
+    GLStateIndexedBuffer* binding = glState_indexedBuffer(target, index);
+    if (binding != NULL && glState_skip(binding->buffer == buffer && binding->offset == offset && binding->size == size))
+    {
+        return;
+    }
+    if (binding == NULL)
+    {
+        cache.stats.issued++;
+    }
+
+    // A size of -1 marks a whole-buffer binding.
+    if (size < 0)
+    {
+        glBindBufferBase(target, index, buffer);
+    }
+    else
+    {
+        glBindBufferRange(target, index, buffer, offset, size);
+    }
+    if (binding != NULL)
+    {
+        binding->buffer = buffer;
+        binding->offset = offset;
+        binding->size = size;
+    }
+
+    // Indexed binds also replace the generic binding for the target.
+    const int generic = glState_bufferIndex(target);
+    if (generic >= 0)
+    {
+        cache.buffers[generic] = buffer;
+    }
+}
+
+void glState_bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+    glState_bindBufferRange(target, index, buffer, 0, -1);
+}
+
+void glState_bindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+    glState_ensureValid();
+    const int index = glState_textureIndex(target);
+    if (unit >= GL_STATE_TEXTURE_UNITS || index < 0)
+    {
+        cache.stats.issued += 2;
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(target, texture);
+        cache.activeTexture = unit;
+        return;
+    }
+    if (glState_skip(cache.textures[unit][index] == texture))
+    {
+        return;
+    }
+    if (cache.activeTexture != unit)
+    {
+        cache.stats.issued++;
+        glActiveTexture(GL_TEXTURE0 + unit);
+        cache.activeTexture = unit;
+    }
+    glBindTexture(target, texture);
+    cache.textures[unit][index] = texture;
+}
+
+static void glState_setCapability(GLenum capability, bool enabled)
+{
+    glState_ensureValid();
+    const int index = glState_capabilityIndex(capability);
+    if (index >= 0 && glState_skip(cache.capabilities[index] == enabled))
+    {
+        return;
+    }
+    if (index < 0)
+    {
+        cache.stats.issued++;
+    }
+    else
+    {
+        cache.capabilities[index] = enabled;
+    }
+    enabled ? glEnable(capability) : glDisable(capability);
+}
+
+void glState_enable(GLenum capability)
+{
+    glState_setCapability(capability, true);
+}
+
+void glState_disable(GLenum capability)
+{
+    glState_setCapability(capability, false);
+}
+
+void glState_depthFunc(GLenum func)
+{
+    glState_ensureValid();
+    if (glState_skip(cache.depthFunc == func))
+    {
+        return;
+    }
+    glDepthFunc(func);
+    cache.depthFunc = func;
+}
+
+void glState_depthMask(GLboolean mask)
+{
+    glState_ensureValid();
+    if (glState_skip(cache.depthMask == mask))
+    {
+        return;
+    }
+    glDepthMask(mask);
+    cache.depthMask = mask;
+}
+
+void glState_blendFunc(GLenum source, GLenum destination)
+{
+    glState_ensureValid();
+    if (glState_skip(cache.blendSource == source && cache.blendDestination == destination))
+    {
+        return;
+    }
+    glBlendFunc(source, destination);
+    cache.blendSource = source;
+    cache.blendDestination = destination;
+}
+
+void glState_cullFace(GLenum face)
+{
+    glState_ensureValid();
+    if (glState_skip(cache.cullFace == face))
+    {
+        return;
+    }
+    glCullFace(face);
+    cache.cullFace = face;
+}
+
+void glState_viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    glState_ensureValid();
+    const bool unchanged =
+        cache.viewport[0] == x &&
+        cache.viewport[1] == y &&
+        cache.viewport[2] == width &&
+        cache.viewport[3] == height;
+    if (glState_skip(unchanged))
+    {
+        return;
+    }
+    glViewport(x, y, width, height);
+    cache.viewport[0] = x;
+    cache.viewport[1] = y;
+    cache.viewport[2] = width;
+    cache.viewport[3] = height;
+}
+
+void glState_deleteProgram(GLuint program)
+{
+    glState_ensureValid();
+    // A deleted program stays in use until another one is installed, but its
+    // name may be recycled, so the cached value can no longer be trusted.
+    if (cache.program == program)
+    {
+        cache.program = GL_STATE_UNKNOWN;
+    }
+    glDeleteProgram(program);
+}
+
+void glState_deleteVertexArrays(GLsizei count, const GLuint* vertexArrays)
+{
+    glState_ensureValid();
+    for (GLsizei i = 0; i < count; i++)
+    {
+        if (vertexArrays[i] != 0 && cache.vertexArray == vertexArrays[i])
+        {
+            cache.vertexArray = 0;
+            cache.buffers[GL_STATE_BUFFER_ELEMENT_ARRAY] = GL_STATE_UNKNOWN;
+        }
+    }
+    glDeleteVertexArrays(count, vertexArrays);
+}
+
+void glState_deleteBuffers(GLsizei count, const GLuint* buffers)
+{
+    glState_ensureValid();
+    for (GLsizei i = 0; i < count; i++)
+    {
+        if (buffers[i] == 0)
+        {
+            continue;
+        }
+        for (int target = 0; target < GL_STATE_BUFFER_COUNT; target++)
+        {
+            if (cache.buffers[target] == buffers[i])
+            {
+                cache.buffers[target] = 0;
+            }
+        }
+        for (int index = 0; index < GL_STATE_INDEXED_BUFFERS; index++)
+        {
+            if (cache.uniformBuffers[index].buffer == buffers[i])
+            {
+                cache.uniformBuffers[index].buffer = GL_STATE_UNKNOWN;
+            }
+            if (cache.storageBuffers[index].buffer == buffers[i])
+            {
+                cache.storageBuffers[index].buffer = GL_STATE_UNKNOWN;
+            }
+        }
+    }
+    glDeleteBuffers(count, buffers);
+}
+
+void glState_deleteTextures(GLsizei count, const GLuint* textures)
+{
+    glState_ensureValid();
+    for (GLsizei i = 0; i < count; i++)
+    {
+        if (textures[i] == 0)
+        {
+            continue;
+        }
+        for (int unit = 0; unit < GL_STATE_TEXTURE_UNITS; unit++)
+        {
+            for (int target = 0; target < GL_STATE_TEXTURE_COUNT; target++)
+            {
+                if (cache.textures[unit][target] == textures[i])
+                {
+                    cache.textures[unit][target] = 0;
+                }
+            }
+        }
+    }
+    glDeleteTextures(count, textures);
+}
+
+GLStateStats glState_getStats(void)
+{
+    return cache.stats;
+}
+
+void glState_resetStats(void)
+{
+    cache.stats.issued = 0;
+    cache.stats.skipped = 0;
+}
+
+void glState_log(void)
+{
+    const uint64_t total = cache.stats.issued + cache.stats.skipped;
+    printf(
+        "GL state: %llu calls issued, %llu skipped (%.1f%% redundant)\n",
+        (unsigned long long)cache.stats.issued,
+        (unsigned long long)cache.stats.skipped,
+        total > 0 ? 100.0 * cache.stats.skipped / total : 0.0
+    );
+}
@@ -0,0 +1,340 @@
+#include "../include/GpuArena.h"
+#include "../include/GLState.h"
+#include "../include/Profiler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define GPU_ARENA_INITIAL_MESHES 64
+
+static void* gpuArena_grow(void* pointer, uint32_t capacity, size_t size)
+{
+    void* grown = realloc(pointer, capacity * size);
+    if (grown == NULL)
+    {
+        fprintf(stderr, "Failed to grow the GPU arena tables!\n");
+        exit(EXIT_FAILURE);
+    }
+    return grown;
+}
+
+// Replaces a buffer with a larger one holding the same leading bytes.
+static GLuint gpuArena_resizeBuffer(GLuint buffer, GLsizeiptr oldSize, GLsizeiptr newSize)
+{
+    GLuint resized;
+    glGenBuffers(1, &resized);
+    glState_bindBuffer(GL_COPY_WRITE_BUFFER, resized);
+    glBufferData(GL_COPY_WRITE_BUFFER, newSize, NULL, GL_STATIC_DRAW);
+    glState_bindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, oldSize);
+    glState_deleteBuffers(1, &buffer);
+    return resized;
+}
+
+static void gpuArena_copyWithin(GLuint buffer, GLintptr source, GLintptr target, GLsizeiptr size)
+{
+    glState_bindBuffer(GL_COPY_READ_BUFFER, buffer);
+    glState_bindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, source, target, size);
+}
+
+static void gpuArena_growVertices(GpuArena* arena, GLuint required)
+{
+    const GLuint capacity = arena->vertices.capacity;
+    const GLuint grown = capacity * 2 > capacity + required ? capacity * 2 : capacity + required;
+    arena->vertexBuffer = gpuArena_resizeBuffer(
+        arena->vertexBuffer,
+        (GLsizeiptr)arena->vertexStride * capacity,
+        (GLsizeiptr)arena->vertexStride * grown
+    );
+    rangeAllocator_grow(&arena->vertices, grown);
+
+    // Attribute pointers capture the buffer name, so they follow it over.
+    vao_bind(arena->VAO);
+    for (uint32_t i = 0; i < arena->attribCount; i++)
+    {
+        const GpuArenaAttrib* attrib = &arena->attribs[i];
+        vao_linkAttribFormat(arena->vertexBuffer, attrib->index, attrib->size, attrib->type, attrib->normalized, arena->vertexStride, attrib->offset);
+    }
+    arena->grows++;
+    arena->generation++;
+}
+
+static void gpuArena_growIndices(GpuArena* arena, GLuint required)
+{
+    const GLuint capacity = arena->indices.capacity;
+    const GLuint grown = capacity * 2 > capacity + required ? capacity * 2 : capacity + required;
+    arena->indexBuffer = gpuArena_resizeBuffer(
+        arena->indexBuffer,
+        (GLsizeiptr)sizeof(GLuint) * capacity,
+        (GLsizeiptr)sizeof(GLuint) * grown
+    );
+    rangeAllocator_grow(&arena->indices, grown);
+
+    vao_bind(arena->VAO);
+    ebo_bind(arena->indexBuffer);
+    arena->grows++;
+    arena->generation++;
+}
+
+GpuArena gpuArena_create(GLsizei vertexStride, GLuint vertexCapacity, GLuint indexCapacity)
+{
+    GpuArena arena =
+    {
+        .vertexStride = vertexStride,
+        .vertices = rangeAllocator_create(vertexCapacity),
+        .indices = rangeAllocator_create(indexCapacity),
+        .meshes = gpuArena_grow(NULL, GPU_ARENA_INITIAL_MESHES, sizeof(GpuArenaMesh)),
+        .meshCount = 0,
+        .meshCapacity = GPU_ARENA_INITIAL_MESHES,
+        .freeHandles = gpuArena_grow(NULL, GPU_ARENA_INITIAL_MESHES, sizeof(uint32_t)),
+        .freeHandleCount = 0,
+        .attribCount = 0,
+        .generation = 0,
+        .moves = 0,
+        .bytesMoved = 0,
+        .grows = 0,
+    };
+
+    arena.vertexBuffer = vbo_create(NULL, (GLsizeiptr)vertexStride * vertexCapacity);
+    arena.indexBuffer = ebo_create(NULL, (GLsizeiptr)sizeof(GLuint) * indexCapacity);
+    arena.VAO = vao_create();
+    vao_bind(arena.VAO);
+    ebo_bind(arena.indexBuffer);
+
+    return arena;
+}
+
+void gpuArena_linkAttrib(GpuArena* arena, GLuint index, GLuint size, GLenum type, GLboolean normalized, const void* offset)
+{
+    if (arena->attribCount == GPU_ARENA_MAX_ATTRIBS)
+    {
+        fprintf(stderr, "Failed to link a GPU arena attribute!\n");
+        return;
+    }
+    arena->attribs[arena->attribCount++] = (GpuArenaAttrib){ index, size, type, normalized, offset };
+    vao_bind(arena->VAO);
+    vao_linkAttribFormat(arena->vertexBuffer, index, size, type, normalized, arena->vertexStride, offset);
+}
+
+// An empty range takes no space and sits at offset zero. Freeing and
+// defragmenting already skip it, since both ignore zero sizes.
+static bool gpuArena_allocateRange(RangeAllocator* allocator, GLuint count, GLuint* offset)
+{
+    *offset = 0;
+    return count == 0 || rangeAllocator_allocate(allocator, count, 1, offset);
+}
+
+GpuMeshHandle gpuArena_allocate(GpuArena* arena, GLuint vertexCount, GLuint indexCount)
+{
+    GLuint vertexOffset;
+    GLuint indexOffset;
+    if (!gpuArena_allocateRange(&arena->vertices, vertexCount, &vertexOffset))
+    {
+        gpuArena_growVertices(arena, vertexCount);
+        if (!gpuArena_allocateRange(&arena->vertices, vertexCount, &vertexOffset))
+            return GPU_ARENA_INVALID_HANDLE;
+    }
+    if (!gpuArena_allocateRange(&arena->indices, indexCount, &indexOffset))
+    {
+        gpuArena_growIndices(arena, indexCount);
+        if (!gpuArena_allocateRange(&arena->indices, indexCount, &indexOffset))
+        {
+            rangeAllocator_free(&arena->vertices, vertexOffset, vertexCount);
+            return GPU_ARENA_INVALID_HANDLE;
+        }
+    }
+
+    GpuMeshHandle handle;
+    if (arena->freeHandleCount > 0)
+    {
+        handle = arena->freeHandles[--arena->freeHandleCount];
+    }
+    else
+    {
+        if (arena->meshCount == arena->meshCapacity)
+        {
+            arena->meshCapacity *= 2;
+            arena->meshes = gpuArena_grow(arena->meshes, arena->meshCapacity, sizeof(GpuArenaMesh));
+            arena->freeHandles = gpuArena_grow(arena->freeHandles, arena->meshCapacity, sizeof(uint32_t));
+        }
+        handle = arena->meshCount++;
+    }
+
+    arena->meshes[handle] = (GpuArenaMesh)
+    {
+        .vertexOffset = vertexOffset,
+        .vertexCount = vertexCount,
+        .indexOffset = indexOffset,
+        .indexCount = indexCount,
+        .live = true,
+    };
+    return handle;
+}
+
+void gpuArena_upload(GpuArena* arena, GpuMeshHandle handle, const void* vertices, const GLuint* indices)
+{
+    const GpuArenaMesh* mesh = &arena->meshes[handle];
+    if (vertices != NULL)
+    {
+        vbo_update(
+            arena->vertexBuffer,
+            (GLintptr)arena->vertexStride * mesh->vertexOffset,
+            (GLsizeiptr)arena->vertexStride * mesh->vertexCount,
+            vertices
+        );
+    }
+    if (indices != NULL)
+    {
+        ebo_update(
+            arena->indexBuffer,
+            (GLintptr)sizeof(GLuint) * mesh->indexOffset,
+            (GLsizeiptr)sizeof(GLuint) * mesh->indexCount,
+            indices
+        );
+    }
+}
+
+void gpuArena_free(GpuArena* arena, GpuMeshHandle handle)
+{
+    GpuArenaMesh* mesh = &arena->meshes[handle];
+    if (!mesh->live)
+    {
+        return;
+    }
+    rangeAllocator_free(&arena->vertices, mesh->vertexOffset, mesh->vertexCount);
+    rangeAllocator_free(&arena->indices, mesh->indexOffset, mesh->indexCount);
+    mesh->live = false;
+    arena->freeHandles[arena->freeHandleCount++] = handle;
+}
+
+uint32_t gpuArena_defragment(GpuArena* arena, uint32_t maxMoves)
+{
+    // Moves meshes into free ranges closer to the start of each buffer. The
+    // copies are queued on the GPU behind any draw still reading the old
+    // range, so a small budget can run every frame.
+    uint32_t moves = 0;
+    for (uint32_t handle = 0; handle < arena->meshCount && moves < maxMoves; handle++)
+    {
+        GpuArenaMesh* mesh = &arena->meshes[handle];
+        if (!mesh->live)
+        {
+            continue;
+        }
+
+        GLuint offset;
+        if (rangeAllocator_allocateBelow(&arena->vertices, mesh->vertexCount, 1, mesh->vertexOffset, &offset))
+        {
+            const GLsizeiptr size = (GLsizeiptr)arena->vertexStride * mesh->vertexCount;
+            gpuArena_copyWithin(
+                arena->vertexBuffer,
+                (GLintptr)arena->vertexStride * mesh->vertexOffset,
+                (GLintptr)arena->vertexStride * offset,
+                size
+            );
+            rangeAllocator_free(&arena->vertices, mesh->vertexOffset, mesh->vertexCount);
+            mesh->vertexOffset = offset;
+            arena->bytesMoved += size;
+            moves++;
+        }
+        if (moves < maxMoves && rangeAllocator_allocateBelow(&arena->indices, mesh->indexCount, 1, mesh->indexOffset, &offset))
+        {
+            const GLsizeiptr size = (GLsizeiptr)sizeof(GLuint) * mesh->indexCount;
+            gpuArena_copyWithin(
+                arena->indexBuffer,
+                (GLintptr)sizeof(GLuint) * mesh->indexOffset,
+                (GLintptr)sizeof(GLuint) * offset,
+                size
+            );
+            rangeAllocator_free(&arena->indices, mesh->indexOffset, mesh->indexCount);
+            mesh->indexOffset = offset;
+            arena->bytesMoved += size;
+            moves++;
+        }
+    }
+
+    if (moves > 0)
+    {
+        arena->moves += moves;
+        arena->generation++;
+    }
+    return moves;
+}
+
+void gpuArena_draw(GpuArena* arena, GpuMeshHandle handle)
+{
+    const GpuArenaMesh* mesh = &arena->meshes[handle];
+    vao_bind(arena->VAO);
+    glDrawElementsBaseVertex(
+        GL_TRIANGLES,
+        (GLsizei)mesh->indexCount,
+        GL_UNSIGNED_INT,
+        (const void*)(uintptr_t)(sizeof(GLuint) * mesh->indexOffset),
+        (GLint)mesh->vertexOffset
+    );
+    PROFILE_COUNT(drawCalls, 1);
+    PROFILE_COUNT(triangles, mesh->indexCount / 3);
+}
+
+void gpuArena_fillCommand(GpuArena* arena, GpuMeshHandle handle, RenderCommand* command)
+{
+    const GpuArenaMesh* mesh = &arena->meshes[handle];
+    command->vertexArray = arena->VAO;
+    command->mode = GL_TRIANGLES;
+    command->indexType = GL_UNSIGNED_INT;
+    command->indexOffset = sizeof(GLuint) * mesh->indexOffset;
+    command->count = mesh->indexCount;
+    command->baseVertex = (int32_t)mesh->vertexOffset;
+    command->instanceCount = command->instanceCount > 0 ? command->instanceCount : 1;
+}
+
+GpuArenaStats gpuArena_getStats(GpuArena* arena)
+{
+    return (GpuArenaStats)
+    {
+        .vertexCapacity = arena->vertices.capacity,
+        .vertexUsed = arena->vertices.used,
+        .indexCapacity = arena->indices.capacity,
+        .indexUsed = arena->indices.used,
+        .meshCount = arena->meshCount - arena->freeHandleCount,
+        .vertexFragmentation = rangeAllocator_fragmentation(&arena->vertices),
+        .indexFragmentation = rangeAllocator_fragmentation(&arena->indices),
+        .moves = arena->moves,
+        .bytesMoved = arena->bytesMoved,
+        .grows = arena->grows,
+    };
+}
+
+void gpuArena_log(GpuArena* arena)
+{
+    const GpuArenaStats stats = gpuArena_getStats(arena);
+    printf(
+        "GPU arena: %u meshes, vertices %u/%u (%.1f%% fragmented), indices %u/%u (%.1f%% fragmented), "
+        "%llu moves (%llu bytes), %u grows\n",
+        stats.meshCount,
+        stats.vertexUsed,
+        stats.vertexCapacity,
+        100.f * stats.vertexFragmentation,
+        stats.indexUsed,
+        stats.indexCapacity,
+        100.f * stats.indexFragmentation,
+        (unsigned long long)stats.moves,
+        (unsigned long long)stats.bytesMoved,
+        stats.grows
+    );
+}
+
+void gpuArena_delete(GpuArena* arena)
+{
+    vao_delete(&arena->VAO);
+    vbo_delete(&arena->vertexBuffer);
+    ebo_delete(&arena->indexBuffer);
+    rangeAllocator_delete(&arena->vertices);
+    rangeAllocator_delete(&arena->indices);
+    free(arena->meshes);
+    free(arena->freeHandles);
+    arena->meshes = NULL;
+    arena->freeHandles = NULL;
+    arena->meshCount = 0;
+    arena->freeHandleCount = 0;
+}
@@ -0,0 +1,398 @@
+#include "../include/GpuScene.h"
+#include "../include/GLState.h"
+#include "../include/Profiler.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GPU_SCENE_INVALID UINT32_MAX
+
+static const char* cullShaderSource =
+    "#version 430 core\n"
+    "layout (local_size_x = 64) in;\n"
+    "struct Object\n"
+    "{\n"
+    "  vec4 rows[3];\n"
+    "  vec3 boundsMin;\n"
+    "  uint mesh;\n"
+    "  vec3 boundsMax;\n"
+    "  uint color;\n"
+    "};\n"
+    "struct DrawCommand\n"
+    "{\n"
+    "  uint count;\n"
+    "  uint instanceCount;\n"
+    "  uint firstIndex;\n"
+    "  int baseVertex;\n"
+    "  uint baseInstance;\n"
+    "};\n"
+    "struct MeshInfo\n"
+    "{\n"
+    "  uint commandBase;\n"
+    "  uint lodCount;\n"
+    "  uvec2 padding;\n"
+    "  float errors[8];\n"
+    "};\n"
+    "layout (std430, binding = 0) readonly buffer Objects { Object objects[]; };\n"
+    "layout (std430, binding = 1) buffer Commands { DrawCommand commands[]; };\n"
+    "layout (std430, binding = 2) writeonly buffer Visible { uint visible[]; };\n"
+    "layout (std430, binding = 3) readonly buffer Meshes { MeshInfo meshes[]; };\n"
+    "layout (std430, binding = 4) buffer Levels { uint levels[]; };\n"
+    "uniform vec4 planes[6];\n"
+    "uniform int objectCount;\n"
+    "uniform vec4 lodView;\n"
+    "uniform float lodThreshold;\n"
+    "uniform float lodHysteresis;\n"
+    "void main()\n"
+    "{\n"
+    "  uint id = gl_GlobalInvocationID.x;\n"
+    "  if (id >= uint(objectCount))\n"
+    "    return;\n"
+    "  vec3 center = (objects[id].boundsMin + objects[id].boundsMax) * 0.5;\n"
+    "  vec3 extent = (objects[id].boundsMax - objects[id].boundsMin) * 0.5;\n"
+    "  for (int i = 0; i < 6; i++)\n"
+    "  {\n"
+    "    if (dot(planes[i].xyz, center) + planes[i].w < -dot(extent, abs(planes[i].xyz)))\n"
+    "      return;\n"
+    "  }\n"
+    "  uint mesh = objects[id].mesh;\n"
+    "  uint level = 0u;\n"
+    "  if (lodView.w > 0.0 && meshes[mesh].lodCount > 1u)\n"
+    "  {\n"
+    "    float scale = lodView.w / max(length(center - lodView.xyz) - length(extent), 1e-3);\n"
+    "    uint current = levels[id];\n"
+    "    for (uint i = 1u; i < meshes[mesh].lodCount; i++)\n"
+    "    {\n"
+    "      float limit = lodThreshold * (i > current ? 1.0 - lodHysteresis : 1.0 + lodHysteresis);\n"
+    "      if (meshes[mesh].errors[i] * scale > limit)\n"
+    "        break;\n"
+    "      level = i;\n"
+    "    }\n"
+    "    levels[id] = level;\n"
+    "  }\n"
+    "  uint command = meshes[mesh].commandBase + level;\n"
+    "  uint slot = atomicAdd(commands[command].instanceCount, 1u);\n"
+    "  visible[commands[command].baseInstance + slot] = id;\n"
+    "}\0";
+
+static void* gpuScene_allocate(size_t count, size_t size)
+{
+    void* pointer = calloc(count, size);
+    if (pointer == NULL)
+    {
+        fprintf(stderr, "Failed to allocate a GPU scene!\n");
+        exit(EXIT_FAILURE);
+    }
+    return pointer;
+}
+
+static void gpuScene_linkVisible(GpuScene* scene)
+{
+    vao_bind(scene->arena.VAO);
+    vbo_bind(scene->visibleBuffer);
+    glVertexAttribIPointer(GPU_SCENE_OBJECT_ID_LOCATION, 1, GL_UNSIGNED_INT, sizeof(GLuint), NULL);
+    glEnableVertexAttribArray(GPU_SCENE_OBJECT_ID_LOCATION);
+    glVertexAttribDivisor(GPU_SCENE_OBJECT_ID_LOCATION, 1);
+}
+
+bool gpuScene_isSupported(void)
+{
+    return GLEW_VERSION_4_3 || (
+        GLEW_ARB_multi_draw_indirect &&
+        GLEW_ARB_compute_shader &&
+        GLEW_ARB_shader_storage_buffer_object);
+}
+
+GpuScene gpuScene_create(GLsizei vertexStride, GLuint vertexCapacity, GLuint indexCapacity, uint32_t meshCapacity, uint32_t objectCapacity, ShaderCache* shaderCache)
+{
+    GpuScene scene =
+    {
+        .arena = gpuArena_create(vertexStride, vertexCapacity, indexCapacity),
+        .meshes = gpuScene_allocate(meshCapacity, sizeof(GpuMesh)),
+        .meshCount = 0,
+        .meshCapacity = meshCapacity,
+        .objects = gpuScene_allocate(objectCapacity, sizeof(GpuObject)),
+        .objectCount = 0,
+        .objectCapacity = objectCapacity,
+        .dirtyBegin = GPU_SCENE_INVALID,
+        .dirtyEnd = 0,
+        .layoutDirty = false,
+        .commands = gpuScene_allocate((size_t)meshCapacity * MESH_MAX_LODS, sizeof(DrawElementsIndirectCommand)),
+        .commandCount = 0,
+        .meshInfos = gpuScene_allocate(meshCapacity, sizeof(GpuMeshInfo)),
+        .visibleCapacity = objectCapacity,
+    };
+
+    // Levels start at zero so the first frame's hysteresis is well defined.
+    GLuint* levels = gpuScene_allocate(objectCapacity, sizeof(GLuint));
+    scene.objectBuffer = ssbo_create((GLsizeiptr)sizeof(GpuObject) * objectCapacity, NULL);
+    scene.commandBuffer = ssbo_create((GLsizeiptr)sizeof(DrawElementsIndirectCommand) * meshCapacity * MESH_MAX_LODS, NULL);
+    scene.visibleBuffer = ssbo_create((GLsizeiptr)sizeof(GLuint) * objectCapacity, NULL);
+    scene.meshBuffer = ssbo_create((GLsizeiptr)sizeof(GpuMeshInfo) * meshCapacity, NULL);
+    scene.levelBuffer = ssbo_create((GLsizeiptr)sizeof(GLuint) * objectCapacity, levels);
+    free(levels);
+
+    scene.arenaGeneration = scene.arena.generation;
+    gpuScene_linkVisible(&scene);
+
+    scene.cullShader = shaderCache_createCompute(shaderCache, cullShaderSource);
+    scene.planesUniform = shader_getUniform(&scene.cullShader, "planes");
+    scene.objectCountUniform = shader_getUniform(&scene.cullShader, "objectCount");
+    scene.lodViewUniform = shader_getUniform(&scene.cullShader, "lodView");
+    scene.lodThresholdUniform = shader_getUniform(&scene.cullShader, "lodThreshold");
+    scene.lodHysteresisUniform = shader_getUniform(&scene.cullShader, "lodHysteresis");
+
+    return scene;
+}
+
+void gpuScene_linkAttrib(GpuScene* scene, GLuint index, GLuint size, GLenum type, GLboolean normalized, const void* offset)
+{
+    gpuArena_linkAttrib(&scene->arena, index, size, type, normalized, offset);
+}
+
+uint32_t gpuScene_addMesh(GpuScene* scene, const void* vertices, GLuint vertexCount, const GLuint* indices, GLuint indexCount)
+{
+    const MeshLod lod = { 0, indexCount, 0.f, 0 };
+    return gpuScene_addMeshLods(scene, vertices, vertexCount, indices, indexCount, &lod, 1);
+}
+
+// indices holds every level back to back as described by lods, all of them
+// indexing the same vertices.
+uint32_t gpuScene_addMeshLods(GpuScene* scene, const void* vertices, GLuint vertexCount, const GLuint* indices, GLuint indexCount, const MeshLod* lods, uint32_t lodCount)
+{
+    if (scene->meshCount == scene->meshCapacity || lodCount == 0 || lodCount > MESH_MAX_LODS)
+    {
+        fprintf(stderr, "Failed to add a mesh to the GPU scene!\n");
+        return GPU_SCENE_INVALID;
+    }
+
+    const GpuMeshHandle handle = gpuArena_allocate(&scene->arena, vertexCount, indexCount);
+    if (handle == GPU_ARENA_INVALID_HANDLE)
+    {
+        fprintf(stderr, "Failed to add a mesh to the GPU scene!\n");
+        return GPU_SCENE_INVALID;
+    }
+    gpuArena_upload(&scene->arena, handle, vertices, indices);
+
+    const uint32_t mesh = scene->meshCount++;
+    GpuMesh* gpuMesh = &scene->meshes[mesh];
+    *gpuMesh = (GpuMesh){ .handle = handle, .objectCount = 0, .commandBase = scene->commandCount, .lodCount = lodCount };
+    memcpy(gpuMesh->lods, lods, lodCount * sizeof(MeshLod));
+    scene->commandCount += lodCount;
+
+    GpuMeshInfo* info = &scene->meshInfos[mesh];
+    *info = (GpuMeshInfo){ .commandBase = gpuMesh->commandBase, .lodCount = lodCount };
+    for (uint32_t i = 0; i < lodCount; i++)
+    {
+        info->errors[i] = lods[i].error;
+    }
+    ssbo_update(scene->meshBuffer, (GLintptr)sizeof(GpuMeshInfo) * mesh, sizeof(GpuMeshInfo), info);
+
+    scene->layoutDirty = true;
+    return mesh;
+}
+
+static void gpuScene_markDirty(GpuScene* scene, uint32_t object)
+{
+    scene->dirtyBegin = object < scene->dirtyBegin ? object : scene->dirtyBegin;
+    scene->dirtyEnd = object + 1 > scene->dirtyEnd ? object + 1 : scene->dirtyEnd;
+}
+
+static void gpuScene_storeObject(GpuObject* object, Affine* model, Aabb bounds)
+{
+    for (int row = 0; row < 3; row++)
+    {
+        for (int column = 0; column < 4; column++)
+        {
+            object->rows[row][column] = (*model)[column][row];
+        }
+    }
+    object->boundsMin[0] = bounds.min.x;
+    object->boundsMin[1] = bounds.min.y;
+    object->boundsMin[2] = bounds.min.z;
+    object->boundsMax[0] = bounds.max.x;
+    object->boundsMax[1] = bounds.max.y;
+    object->boundsMax[2] = bounds.max.z;
+}
+
+uint32_t gpuScene_addObject(GpuScene* scene, uint32_t mesh, Affine* model, Aabb bounds, GLuint color)
+{
+    if (scene->objectCount == scene->objectCapacity || mesh >= scene->meshCount)
+    {
+        fprintf(stderr, "Failed to add an object to the GPU scene!\n");
+        return GPU_SCENE_INVALID;
+    }
+
+    const uint32_t object = scene->objectCount++;
+    GpuObject* gpuObject = &scene->objects[object];
+    gpuScene_storeObject(gpuObject, model, bounds);
+    gpuObject->mesh = mesh;
+    gpuObject->color = color;
+
+    scene->meshes[mesh].objectCount++;
+    scene->layoutDirty = true;
+    gpuScene_markDirty(scene, object);
+    return object;
+}
+
+void gpuScene_setObject(GpuScene* scene, uint32_t object, Affine* model, Aabb bounds)
+{
+    gpuScene_storeObject(&scene->objects[object], model, bounds);
+    gpuScene_markDirty(scene, object);
+}
+
+static void gpuScene_flush(GpuScene* scene)
+{
+    if (scene->dirtyBegin < scene->dirtyEnd)
+    {
+        ssbo_update(
+            scene->objectBuffer,
+            (GLintptr)sizeof(GpuObject) * scene->dirtyBegin,
+            (GLsizeiptr)sizeof(GpuObject) * (scene->dirtyEnd - scene->dirtyBegin),
+            &scene->objects[scene->dirtyBegin]
+        );
+        scene->dirtyBegin = GPU_SCENE_INVALID;
+        scene->dirtyEnd = 0;
+    }
+
+    // Each mesh LOD owns a slice of the visible list as large as the mesh's
+    // object count, since every object may pick any level. Arena growth or
+    // defragmentation moves mesh ranges, so those rebuild the commands as
+    // well.
+    if (scene->layoutDirty || scene->arenaGeneration != scene->arena.generation)
+    {
+        GLuint baseInstance = 0;
+        for (uint32_t i = 0; i < scene->meshCount; i++)
+        {
+            const GpuMesh* gpuMesh = &scene->meshes[i];
+            const GpuArenaMesh* mesh = &scene->arena.meshes[gpuMesh->handle];
+            for (uint32_t lod = 0; lod < gpuMesh->lodCount; lod++)
+            {
+                scene->commands[gpuMesh->commandBase + lod] = (DrawElementsIndirectCommand)
+                {
+                    .count = gpuMesh->lods[lod].indexCount,
+                    .instanceCount = 0,
+                    .firstIndex = mesh->indexOffset + gpuMesh->lods[lod].firstIndex,
+                    .baseVertex = (GLint)mesh->vertexOffset,
+                    .baseInstance = baseInstance,
+                };
+                baseInstance += gpuMesh->objectCount;
+            }
+        }
+
+        if (baseInstance > scene->visibleCapacity)
+        {
+            ssbo_delete(&scene->visibleBuffer);
+            scene->visibleBuffer = ssbo_create((GLsizeiptr)sizeof(GLuint) * baseInstance, NULL);
+            scene->visibleCapacity = baseInstance;
+            gpuScene_linkVisible(scene);
+        }
+        scene->layoutDirty = false;
+        scene->arenaGeneration = scene->arena.generation;
+    }
+}
+
+// A NULL lodView draws every object at full detail.
+void gpuScene_cull(GpuScene* scene, Frustum* frustum, const LodView* lodView)
+{
+    gpuScene_flush(scene);
+
+    // Resetting the commands costs one small upload per mesh LOD, independent
+    // of how many objects the scene holds.
+    ssbo_update(scene->commandBuffer, 0, (GLsizeiptr)sizeof(DrawElementsIndirectCommand) * scene->commandCount, scene->commands);
+    if (scene->objectCount == 0)
+    {
+        return;
+    }
+
+    GLfloat planes[FRUSTUM_PLANE_COUNT][4];
+    for (int i = 0; i < FRUSTUM_PLANE_COUNT; i++)
+    {
+        planes[i][0] = frustum->planes[i].normal.x;
+        planes[i][1] = frustum->planes[i].normal.y;
+        planes[i][2] = frustum->planes[i].normal.z;
+        planes[i][3] = frustum->planes[i].distance;
+    }
+
+    shader_use(&scene->cullShader);
+    shader_setUniformVec4Array(scene->planesUniform, &planes[0][0], FRUSTUM_PLANE_COUNT);
+    shader_setUniformInt(scene->objectCountUniform, (int)scene->objectCount);
+    // A zero projection scale in lodView.w turns selection off.
+    const GLfloat view[4] =
+    {
+        lodView != NULL ? lodView->position.x : 0.f,
+        lodView != NULL ? lodView->position.y : 0.f,
+        lodView != NULL ? lodView->position.z : 0.f,
+        lodView != NULL ? lodView->projectionScale : 0.f,
+    };
+    shader_setUniformVec4Array(scene->lodViewUniform, view, 1);
+    shader_setUniformFloat(scene->lodThresholdUniform, lodView != NULL ? lodView->threshold : 0.f);
+    shader_setUniformFloat(scene->lodHysteresisUniform, lodView != NULL ? lodView->hysteresis : 0.f);
+    ssbo_bindBase(scene->objectBuffer, GPU_SCENE_OBJECT_BINDING);
+    ssbo_bindBase(scene->commandBuffer, GPU_SCENE_COMMAND_BINDING);
+    ssbo_bindBase(scene->visibleBuffer, GPU_SCENE_VISIBLE_BINDING);
+    ssbo_bindBase(scene->meshBuffer, GPU_SCENE_MESH_BINDING);
+    ssbo_bindBase(scene->levelBuffer, GPU_SCENE_LEVEL_BINDING);
+
+    glDispatchCompute((scene->objectCount + GPU_SCENE_CULL_GROUP_SIZE - 1) / GPU_SCENE_CULL_GROUP_SIZE, 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void gpuScene_draw(GpuScene* scene)
+{
+    if (scene->commandCount == 0)
+    {
+        return;
+    }
+    vao_bind(scene->arena.VAO);
+    ssbo_bindBase(scene->objectBuffer, GPU_SCENE_OBJECT_BINDING);
+    glState_bindBuffer(GL_DRAW_INDIRECT_BUFFER, scene->commandBuffer);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, NULL, (GLsizei)scene->commandCount, 0);
+    // The instance counts are written by the cull shader, so triangles
+    // drawn here are not known on the CPU.
+    PROFILE_COUNT(drawCalls, 1);
+}
+
+// Sums the instance counts the last cull wrote. Reading them back waits for
+// the GPU, so this is for checks and diagnostics, not the frame loop.
+uint32_t gpuScene_countVisible(GpuScene* scene)
+{
+    uint32_t visible = 0;
+    glState_bindBuffer(GL_COPY_READ_BUFFER, scene->commandBuffer);
+    for (uint32_t i = 0; i < scene->commandCount; i++)
+    {
+        GLuint instanceCount;
+        glGetBufferSubData(
+            GL_COPY_READ_BUFFER,
+            (GLintptr)(sizeof(DrawElementsIndirectCommand) * i + offsetof(DrawElementsIndirectCommand, instanceCount)),
+            sizeof(GLuint),
+            &instanceCount
+        );
+        visible += instanceCount;
+    }
+    return visible;
+}
+
+void gpuScene_delete(GpuScene* scene)
+{
+    shader_delete(&scene->cullShader);
+    gpuArena_delete(&scene->arena);
+    ssbo_delete(&scene->objectBuffer);
+    ssbo_delete(&scene->commandBuffer);
+    ssbo_delete(&scene->visibleBuffer);
+    ssbo_delete(&scene->meshBuffer);
+    ssbo_delete(&scene->levelBuffer);
+    free(scene->meshes);
+    free(scene->objects);
+    free(scene->commands);
+    free(scene->meshInfos);
+    scene->meshes = NULL;
+    scene->objects = NULL;
+    scene->commands = NULL;
+    scene->meshInfos = NULL;
+    scene->meshCount = 0;
+    scene->commandCount = 0;
+    scene->objectCount = 0;
+}
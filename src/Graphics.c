@@ -1,67 +1,336 @@
+#include <string.h>
+
 #include "../include/Graphics.h"
+#include "../include/GLState.h"
+#include "../include/Profiler.h"
 
-Shader shader_create(const char* vertexShaderSource, const char* fragmentShaderSource)
+static uint32_t shader_hashName(const char* name)
+{
+    uint32_t hash = 2166136261u;
+    for (; *name != '\0'; name++)
+    {
+        hash ^= (uint8_t)*name;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void shader_insertUniform(Shader* shader, const ShaderUniformInfo* info)
 {
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+    const uint32_t mask = shader->uniformCapacity - 1;
+    uint32_t slot = info->hash & mask;
+    while (shader->uniforms[slot].name[0] != '\0')
+        slot = (slot + 1) & mask;
+    shader->uniforms[slot] = *info;
+    shader->uniformCount++;
+}
 
-    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
-    glCompileShader(vertexShader);
-    glCompileShader(fragmentShader);
+static void shader_reflect(Shader* shader)
+{
+    GLint uniformCount = 0;
+    GLint blockCount = 0;
+    glGetProgramiv(shader->ID, GL_ACTIVE_UNIFORMS, &uniformCount);
+    glGetProgramiv(shader->ID, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
 
-    char infoLog[512];
-    int success = 0;
+    // Keep the table at most half full so probe sequences stay short.
+    uint32_t capacity = 8;
+    while (capacity < (uint32_t)uniformCount * 2)
+        capacity <<= 1;
 
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-    if (!success)
+    shader->uniforms = calloc(capacity, sizeof(ShaderUniformInfo));
+    shader->blocks = blockCount > 0 ? calloc((size_t)blockCount, sizeof(ShaderBlockInfo)) : NULL;
+    if (shader->uniforms == NULL || (blockCount > 0 && shader->blocks == NULL))
     {
-        glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
-        fprintf(stderr, "Failed to compile the vertex shader!\n");
-        fprintf(stderr, "Error:\n%s\n", infoLog);
+        fprintf(stderr, "Failed to allocate the shader reflection tables!\n");
+        exit(EXIT_FAILURE);
     }
+    shader->uniformCapacity = capacity;
 
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-    if (!success)
+    for (GLint i = 0; i < uniformCount; i++)
     {
-        glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
-        fprintf(stderr, "Failed to compile the fragment shader!\n");
-        fprintf(stderr, "Error:\n%s\n", infoLog);
+        ShaderUniformInfo info = { 0 };
+        GLsizei length = 0;
+        glGetActiveUniform(shader->ID, (GLuint)i, SHADER_MAX_NAME_LENGTH, &length, &info.size, &info.type, info.name);
+
+        // Members of uniform blocks have no location and are set through the
+        // block's buffer instead.
+        info.location = glGetUniformLocation(shader->ID, info.name);
+        if (info.location < 0)
+            continue;
+
+        // Arrays are reported as "name[0]"; store them under the bare name.
+        char* bracket = strchr(info.name, '[');
+        if (bracket != NULL)
+            *bracket = '\0';
+        info.hash = shader_hashName(info.name);
+        shader_insertUniform(shader, &info);
     }
 
-    GLuint shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
+    for (GLint i = 0; i < blockCount; i++)
+    {
+        ShaderBlockInfo* block = &shader->blocks[shader->blockCount++];
+        block->index = (GLuint)i;
+        glGetActiveUniformBlockName(shader->ID, (GLuint)i, SHADER_MAX_NAME_LENGTH, NULL, block->name);
+        glGetActiveUniformBlockiv(shader->ID, (GLuint)i, GL_UNIFORM_BLOCK_DATA_SIZE, &block->dataSize);
+    }
+}
 
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
+static const char* shader_stageName(GLenum stage)
+{
+    switch (stage)
+    {
+        case GL_VERTEX_SHADER:
+            return "vertex";
+        case GL_FRAGMENT_SHADER:
+            return "fragment";
+        case GL_COMPUTE_SHADER:
+            return "compute";
+        default:
+            return "unknown";
+    }
+}
+
+// Logs are sized with GL_INFO_LOG_LENGTH so long error lists are not cut off.
+static void shader_printLog(GLuint object, bool program)
+{
+    GLint length = 0;
+    program
+        ? glGetProgramiv(object, GL_INFO_LOG_LENGTH, &length)
+        : glGetShaderiv(object, GL_INFO_LOG_LENGTH, &length);
+    if (length <= 1)
+    {
+        return;
+    }
+    char* infoLog = malloc((size_t)length);
+    if (infoLog == NULL)
+    {
+        return;
+    }
+    program
+        ? glGetProgramInfoLog(object, length, NULL, infoLog)
+        : glGetShaderInfoLog(object, length, NULL, infoLog);
+    fprintf(stderr, "Error:\n%s\n", infoLog);
+    free(infoLog);
+}
+
+// Both block until the driver is done with the object, and print the full
+// log when it failed.
+bool shader_compileStatus(GLuint shader, GLenum stage)
+{
+    GLint success = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success)
+    {
+        fprintf(stderr, "Failed to compile the %s shader!\n", shader_stageName(stage));
+        shader_printLog(shader, false);
+    }
+    return success == GL_TRUE;
+}
+
+bool shader_linkStatus(GLuint program)
+{
+    GLint success = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
     if (!success)
     {
-        glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
         fprintf(stderr, "Failed to link the shader program!\n");
-        fprintf(stderr, "Error:\n%s\n", infoLog);
+        shader_printLog(program, true);
     }
+    return success == GL_TRUE;
+}
 
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+// Returns the program once it linked, or 0 after printing every log that
+// explains why not. retrievable asks the driver to keep the binary around
+// for glGetProgramBinary.
+GLuint shader_linkProgram(const GLenum* stages, const char* const* sources, uint32_t stageCount, bool retrievable)
+{
+    GLuint shaders[SHADER_MAX_STAGES] = { 0 };
+    bool compiled = stageCount > 0 && stageCount <= SHADER_MAX_STAGES;
+    for (uint32_t i = 0; i < stageCount && i < SHADER_MAX_STAGES; i++)
+    {
+        shaders[i] = glCreateShader(stages[i]);
+        glShaderSource(shaders[i], 1, &sources[i], NULL);
+        glCompileShader(shaders[i]);
+    }
 
-    return shaderProgram;
+    // Status is queried only after every stage was submitted so drivers that
+    // compile in the background can work on all of them at once.
+    for (uint32_t i = 0; i < stageCount && i < SHADER_MAX_STAGES; i++)
+    {
+        compiled = shader_compileStatus(shaders[i], stages[i]) && compiled;
+    }
+
+    GLuint program = 0;
+    if (compiled)
+    {
+        program = glCreateProgram();
+        for (uint32_t i = 0; i < stageCount; i++)
+        {
+            glAttachShader(program, shaders[i]);
+        }
+        if (retrievable)
+        {
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+        glLinkProgram(program);
+
+        if (!shader_linkStatus(program))
+        {
+            glDeleteProgram(program);
+            program = 0;
+        }
+        else
+        {
+            for (uint32_t i = 0; i < stageCount; i++)
+            {
+                glDetachShader(program, shaders[i]);
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < stageCount && i < SHADER_MAX_STAGES; i++)
+    {
+        glDeleteShader(shaders[i]);
+    }
+    return program;
+}
+
+// Takes ownership of a linked program. A program of 0 gives an empty Shader
+// whose ID callers can test.
+Shader shader_fromProgram(GLuint program)
+{
+    Shader shader =
+    {
+        .ID = program,
+    };
+    if (program != 0)
+    {
+        shader_reflect(&shader);
+    }
+    return shader;
+}
+
+Shader shader_create(const char* vertexShaderSource, const char* fragmentShaderSource)
+{
+    const GLenum stages[] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+    const char* sources[] = { vertexShaderSource, fragmentShaderSource };
+    return shader_fromProgram(shader_linkProgram(stages, sources, 2, false));
+}
+
+Shader shader_createCompute(const char* computeShaderSource)
+{
+    const GLenum stages[] = { GL_COMPUTE_SHADER };
+    const char* sources[] = { computeShaderSource };
+    return shader_fromProgram(shader_linkProgram(stages, sources, 1, false));
+}
+
+void shader_use(Shader* shader)
+{
+    glState_useProgram(shader->ID);
+}
+
+void shader_delete(Shader* shader)
+{
+    glState_deleteProgram(shader->ID);
+    free(shader->uniforms);
+    free(shader->blocks);
+    shader->ID = 0;
+    shader->uniforms = NULL;
+    shader->blocks = NULL;
+    shader->uniformCapacity = 0;
+    shader->uniformCount = 0;
+    shader->blockCount = 0;
+}
+
+ShaderUniform shader_getUniform(Shader* shader, const char* uniformName)
+{
+    if (shader->uniformCapacity == 0)
+    {
+        return -1;
+    }
+
+    const uint32_t hash = shader_hashName(uniformName);
+    const uint32_t mask = shader->uniformCapacity - 1;
+    for (uint32_t slot = hash & mask; shader->uniforms[slot].name[0] != '\0'; slot = (slot + 1) & mask)
+    {
+        const ShaderUniformInfo* uniform = &shader->uniforms[slot];
+        if (uniform->hash == hash && strcmp(uniform->name, uniformName) == 0)
+        {
+            return uniform->location;
+        }
+    }
+    return -1;
+}
+
+bool shader_bindBlock(Shader* shader, const char* blockName, GLuint bindingPoint)
+{
+    for (uint32_t i = 0; i < shader->blockCount; i++)
+    {
+        if (strcmp(shader->blocks[i].name, blockName) == 0)
+        {
+            glUniformBlockBinding(shader->ID, shader->blocks[i].index, bindingPoint);
+            return true;
+        }
+    }
+    return false;
+}
+
+void shader_setMat4(Shader* shader, const char* uniformName, Mat4* mat)
+{
+    shader_setUniformMat4(shader_getUniform(shader, uniformName), mat);
+}
+
+void shader_setMat3(Shader* shader, const char* uniformName, Mat3* mat)
+{
+    shader_setUniformMat3(shader_getUniform(shader, uniformName), mat);
+}
+
+void shader_setAffine(Shader* shader, const char* uniformName, Affine* mat)
+{
+    shader_setUniformAffine(shader_getUniform(shader, uniformName), mat);
 }
 
-void shader_use(Shader ID)
+void shader_setUniformMat4(ShaderUniform uniform, Mat4* mat)
 {
-    glUseProgram(ID);
+    PROFILE_COUNT(uniformUpdates, 1);
+    glUniformMatrix4fv(uniform, 1, GL_FALSE, (const GLfloat*)(mat));
 }
 
-void shader_delete(Shader ID)
+void shader_setUniformMat3(ShaderUniform uniform, Mat3* mat)
 {
-    glDeleteProgram(ID);
+    PROFILE_COUNT(uniformUpdates, 1);
+    glUniformMatrix3fv(uniform, 1, GL_FALSE, (const GLfloat*)(mat));
 }
 
-void shader_setMat4(Shader ID, const char* uniformName, Mat4* mat)
+void shader_setUniformAffine(ShaderUniform uniform, Affine* mat)
 {
-    GLuint mvpLoc = glGetUniformLocation(ID, uniformName);
-    glUniformMatrix4fv(mvpLoc, 1, GL_FALSE, (const GLfloat*)(mat));
+    // Affine is column-major 4 columns of 3 rows, i.e. a GLSL mat4x3.
+    PROFILE_COUNT(uniformUpdates, 1);
+    glUniformMatrix4x3fv(uniform, 1, GL_FALSE, (const GLfloat*)(mat));
+}
+
+void shader_setUniformVec3(ShaderUniform uniform, Vec3 vec)
+{
+    PROFILE_COUNT(uniformUpdates, 1);
+    glUniform3f(uniform, vec.x, vec.y, vec.z);
+}
+
+void shader_setUniformFloat(ShaderUniform uniform, float value)
+{
+    PROFILE_COUNT(uniformUpdates, 1);
+    glUniform1f(uniform, value);
+}
+
+void shader_setUniformInt(ShaderUniform uniform, int value)
+{
+    PROFILE_COUNT(uniformUpdates, 1);
+    glUniform1i(uniform, value);
+}
+
+void shader_setUniformVec4Array(ShaderUniform uniform, const GLfloat* values, GLsizei count)
+{
+    PROFILE_COUNT(uniformUpdates, 1);
+    glUniform4fv(uniform, count, values);
 }
 
 VAO vao_create()
@@ -72,77 +341,285 @@ VAO vao_create()
 }
 
 void vao_linkAttrib(VBO VBO, GLuint index, GLuint size, GLenum type, GLsizei stride, const void* offset)
+{
+    vao_linkAttribFormat(VBO, index, size, type, GL_FALSE, stride, offset);
+}
+
+// Integer types with normalized set reach the shader as floats in [0, 1]
+// (unsigned) or [-1, 1] (signed), which is what packed colors and normals use.
+void vao_linkAttribFormat(VBO VBO, GLuint index, GLuint size, GLenum type, GLboolean normalized, GLsizei stride, const void* offset)
+{
+    vbo_bind(VBO);
+    glVertexAttribPointer(index, size, type, normalized, stride, offset);
+    glEnableVertexAttribArray(index);
+}
+
+void vao_linkInstanceAttrib(VBO VBO, GLuint index, GLuint size, GLenum type, GLsizei stride, const void* offset, GLuint divisor)
 {
     vbo_bind(VBO);
     glVertexAttribPointer(index, size, type, GL_FALSE, stride, offset);
     glEnableVertexAttribArray(index);
-    vbo_unbind(VBO);
+    glVertexAttribDivisor(index, divisor);
+}
+
+void vao_linkInstanceMat4(VBO VBO, GLuint index, GLsizei stride, const void* offset)
+{
+    // A mat4 attribute takes four consecutive locations, one vec4 column each.
+    for (GLuint column = 0; column < 4; column++)
+    {
+        const char* columnOffset = (const char*)offset + column * 4 * sizeof(GLfloat);
+        vao_linkInstanceAttrib(VBO, index + column, 4, GL_FLOAT, stride, columnOffset, 1);
+    }
+}
+
+void vao_linkInstanceAffine(VBO VBO, GLuint index, GLsizei stride, const void* offset)
+{
+    // Read in GLSL as a mat4x3: four consecutive vec3 columns.
+    for (GLuint column = 0; column < 4; column++)
+    {
+        const char* columnOffset = (const char*)offset + column * 3 * sizeof(GLfloat);
+        vao_linkInstanceAttrib(VBO, index + column, 3, GL_FLOAT, stride, columnOffset, 1);
+    }
 }
 
 void vao_bind(VAO VAO)
 {
-    glBindVertexArray(VAO);
+    glState_bindVertexArray(VAO);
 }
 
 void vao_unbind(VAO VAO)
 {
     (void)VAO;
-    glBindVertexArray(0);
+    glState_bindVertexArray(0);
 }
 
 void vao_delete(VAO* VAO)
 {
-    glDeleteVertexArrays(1, VAO);
+    glState_deleteVertexArrays(1, VAO);
 }
 
 VBO vbo_create(const GLfloat* vertices, GLsizeiptr verticesSize)
 {
     GLuint VBO;
     glGenBuffers(1, &VBO);
-    vbo_bind(VBO);
-    glBufferData(GL_ARRAY_BUFFER, verticesSize, vertices, GL_STATIC_DRAW);
-    vbo_unbind(VBO);
+    glState_bindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+    glBufferData(GL_COPY_WRITE_BUFFER, verticesSize, vertices, GL_STATIC_DRAW);
     return VBO;
 }
 
+void vbo_update(VBO VBO, GLintptr offset, GLsizeiptr size, const void* data)
+{
+    glState_bindBuffer(GL_COPY_WRITE_BUFFER, VBO);
+    PROFILE_COUNT(uploadedBytes, size);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+}
+
 void vbo_bind(VBO VBO)
 {
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glState_bindBuffer(GL_ARRAY_BUFFER, VBO);
 }
 
 void vbo_unbind(VBO VBO)
 {
     (void)VBO;
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glState_bindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 void vbo_delete(VBO* VBO)
 {
-    glDeleteBuffers(1, VBO);
+    glState_deleteBuffers(1, VBO);
 }
 
-EBO ebo_create(const GLuint* indices, GLsizeiptr indicesSize)
+EBO ebo_create(const void* indices, GLsizeiptr indicesSize)
 {
     GLuint EBO;
     glGenBuffers(1, &EBO);
-    ebo_bind(EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indicesSize, indices, GL_STATIC_DRAW);
-    ebo_unbind(EBO);
+    // Uploading through the copy target leaves the bound VAO's index buffer alone.
+    glState_bindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+    glBufferData(GL_COPY_WRITE_BUFFER, indicesSize, indices, GL_STATIC_DRAW);
     return EBO;
 }
 
+void ebo_update(EBO EBO, GLintptr offset, GLsizeiptr size, const void* data)
+{
+    glState_bindBuffer(GL_COPY_WRITE_BUFFER, EBO);
+    PROFILE_COUNT(uploadedBytes, size);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+}
+
 void ebo_bind(EBO EBO)
 {
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glState_bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
 }
 
 void ebo_unbind(EBO EBO)
 {
     (void)EBO;
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glState_bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
 void ebo_delete(EBO* EBO)
 {
-    glDeleteBuffers(1, EBO);
+    glState_deleteBuffers(1, EBO);
+}
+
+UBO ubo_create(GLsizeiptr size)
+{
+    GLuint UBO;
+    glGenBuffers(1, &UBO);
+    glState_bindBuffer(GL_COPY_WRITE_BUFFER, UBO);
+    glBufferData(GL_COPY_WRITE_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+    return UBO;
+}
+
+void ubo_update(UBO UBO, GLintptr offset, GLsizeiptr size, const void* data)
+{
+    glState_bindBuffer(GL_COPY_WRITE_BUFFER, UBO);
+    PROFILE_COUNT(uploadedBytes, size);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+}
+
+void ubo_bindBase(UBO UBO, GLuint bindingPoint)
+{
+    glState_bindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, UBO);
+}
+
+void ubo_delete(UBO* UBO)
+{
+    glState_deleteBuffers(1, UBO);
+}
+
+SSBO ssbo_create(GLsizeiptr size, const void* data)
+{
+    GLuint SSBO;
+    glGenBuffers(1, &SSBO);
+    glState_bindBuffer(GL_COPY_WRITE_BUFFER, SSBO);
+    glBufferData(GL_COPY_WRITE_BUFFER, size, data, GL_DYNAMIC_DRAW);
+    return SSBO;
+}
+
+void ssbo_update(SSBO SSBO, GLintptr offset, GLsizeiptr size, const void* data)
+{
+    glState_bindBuffer(GL_COPY_WRITE_BUFFER, SSBO);
+    PROFILE_COUNT(uploadedBytes, size);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+}
+
+void ssbo_bindBase(SSBO SSBO, GLuint bindingPoint)
+{
+    glState_bindBufferBase(GL_SHADER_STORAGE_BUFFER, bindingPoint, SSBO);
+}
+
+void ssbo_delete(SSBO* SSBO)
+{
+    glState_deleteBuffers(1, SSBO);
+}
+
+InstanceBuffer instanceBuffer_create(GLsizei stride, GLsizei capacity)
+{
+    InstanceBuffer buffer =
+    {
+        .stride = stride,
+        .capacity = capacity,
+        .count = 0,
+    };
+    glGenBuffers(1, &buffer.VBO);
+    glState_bindBuffer(GL_COPY_WRITE_BUFFER, buffer.VBO);
+    glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)stride * capacity, NULL, GL_STREAM_DRAW);
+    return buffer;
+}
+
+void instanceBuffer_upload(InstanceBuffer* buffer, const void* instances, GLsizei count)
+{
+    // Growing keeps the same buffer name, so attribute bindings stay valid.
+    if (count > buffer->capacity)
+    {
+        buffer->capacity = buffer->capacity * 2 > count ? buffer->capacity * 2 : count;
+    }
+
+    glState_bindBuffer(GL_COPY_WRITE_BUFFER, buffer->VBO);
+    glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)buffer->stride * buffer->capacity, NULL, GL_STREAM_DRAW);
+    if (count > 0)
+    {
+        glBufferSubData(GL_COPY_WRITE_BUFFER, 0, (GLsizeiptr)buffer->stride * count, instances);
+        PROFILE_COUNT(uploadedBytes, (GLsizeiptr)buffer->stride * count);
+    }
+    buffer->count = count;
+}
+
+void instanceBuffer_delete(InstanceBuffer* buffer)
+{
+    vbo_delete(&buffer->VBO);
+    buffer->capacity = 0;
+    buffer->count = 0;
+}
+
+void draw_instanced(VAO VAO, GLenum mode, GLsizei indexCount, GLenum indexType, GLsizei instanceCount)
+{
+    if (instanceCount <= 0)
+    {
+        return;
+    }
+    // The VAO stays bound; the state cache turns the next bind into a no-op.
+    vao_bind(VAO);
+    glDrawElementsInstanced(mode, indexCount, indexType, NULL, instanceCount);
+    PROFILE_COUNT(drawCalls, 1);
+    PROFILE_COUNT(triangles, mode == GL_TRIANGLES ? (uint64_t)(indexCount / 3) * instanceCount : 0);
+}
+
+void draw_renderQueue(RenderQueue* queue)
+{
+    uint32_t program = 0;
+    uint32_t vertexArray = 0;
+    uint32_t uniformBuffer = 0;
+    uint32_t uniformOffset = 0;
+    uint32_t uniformSize = 0;
+
+    for (uint32_t i = 0; i < queue->count; i++)
+    {
+        const RenderCommand* command = &queue->commands[queue->entries[i].index];
+        if (i == 0 || command->program != program)
+        {
+            program = command->program;
+            glState_useProgram(program);
+            queue->stats.programChanges++;
+        }
+        if (i == 0 || command->vertexArray != vertexArray)
+        {
+            vertexArray = command->vertexArray;
+            glState_bindVertexArray(vertexArray);
+            queue->stats.vertexArrayChanges++;
+        }
+        if (command->uniformBuffer != 0 && (
+            command->uniformBuffer != uniformBuffer ||
+            command->uniformOffset != uniformOffset ||
+            command->uniformSize != uniformSize))
+        {
+            uniformBuffer = command->uniformBuffer;
+            uniformOffset = command->uniformOffset;
+            uniformSize = command->uniformSize;
+            glState_bindBufferRange(GL_UNIFORM_BUFFER, RENDER_QUEUE_DRAW_BINDING, uniformBuffer, uniformOffset, uniformSize);
+            queue->stats.bufferChanges++;
+        }
+
+        if (command->indexType != 0)
+        {
+            glDrawElementsInstancedBaseVertex(
+                command->mode,
+                command->count,
+                command->indexType,
+                (const void*)(uintptr_t)command->indexOffset,
+                command->instanceCount,
+                command->baseVertex
+            );
+        }
+        else
+        {
+            glDrawArraysInstanced(command->mode, command->baseVertex, command->count, command->instanceCount);
+        }
+        queue->stats.drawCalls++;
+        PROFILE_COUNT(drawCalls, 1);
+        PROFILE_COUNT(triangles, command->mode == GL_TRIANGLES ? (uint64_t)(command->count / 3) * command->instanceCount : 0);
+    }
+    queue->stats.commands += queue->count;
 }
@@ -0,0 +1,412 @@
+#include "../include/Image.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define IMAGE_MAX_DIMENSION 16384
+
+#define TGA_HEADER_SIZE      18
+#define TGA_TRUECOLOR        2
+#define TGA_GRAYSCALE        3
+#define TGA_RLE_TRUECOLOR    10
+#define TGA_RLE_GRAYSCALE    11
+#define TGA_ORIGIN_TOP       0x20
+
+uint32_t image_mipCount(uint32_t width, uint32_t height)
+{
+    uint32_t count = 1;
+    while ((width > 1 || height > 1) && count < IMAGE_MAX_LEVELS)
+    {
+        width = width > 1 ? width / 2 : 1;
+        height = height > 1 ? height / 2 : 1;
+        count++;
+    }
+    return count;
+}
+
+uint32_t image_levelWidth(const Image* image, uint32_t level)
+{
+    const uint32_t width = image->width >> level;
+    return width > 0 ? width : 1;
+}
+
+uint32_t image_levelHeight(const Image* image, uint32_t level)
+{
+    const uint32_t height = image->height >> level;
+    return height > 0 ? height : 1;
+}
+
+uint8_t* image_level(const Image* image, uint32_t level)
+{
+    return image->pixels + image->levelOffsets[level];
+}
+
+// Keeps the levels already present; new ones are left uninitialised.
+bool image_setLevelCount(Image* image, uint32_t levelCount)
+{
+    size_t size = 0;
+    for (uint32_t level = 0; level < levelCount; level++)
+    {
+        image->levelOffsets[level] = size;
+        size += (size_t)image_levelWidth(image, level) * image_levelHeight(image, level) * IMAGE_CHANNELS;
+    }
+    uint8_t* pixels = realloc(image->pixels, size);
+    if (pixels == NULL)
+    {
+        return false;
+    }
+    image->pixels = pixels;
+    image->size = size;
+    image->levelCount = levelCount;
+    return true;
+}
+
+bool image_create(Image* image, uint32_t width, uint32_t height)
+{
+    if (width == 0 || height == 0 || width > IMAGE_MAX_DIMENSION || height > IMAGE_MAX_DIMENSION)
+    {
+        return false;
+    }
+    *image = (Image){ .width = width, .height = height };
+    return image_setLevelCount(image, 1);
+}
+
+// Skips whitespace and comment lines, then reads a decimal field.
+static bool ppm_readField(const uint8_t* data, size_t size, size_t* cursor, uint32_t* value)
+{
+    while (*cursor < size)
+    {
+        const uint8_t c = data[*cursor];
+        if (c == '#')
+        {
+            while (*cursor < size && data[*cursor] != '\n')
+            {
+                (*cursor)++;
+            }
+        }
+        else if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+        {
+            (*cursor)++;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    uint64_t result = 0;
+    const size_t start = *cursor;
+    while (*cursor < size && data[*cursor] >= '0' && data[*cursor] <= '9' && result <= UINT32_MAX)
+    {
+        result = result * 10 + (data[*cursor] - '0');
+        (*cursor)++;
+    }
+    *value = (uint32_t)result;
+    return *cursor > start && result <= UINT32_MAX;
+}
+
+// Binary P5 (grey) and P6 (RGB) with 8-bit samples.
+static bool image_decodePpm(Image* image, const uint8_t* data, size_t size)
+{
+    const uint32_t channels = data[1] == '6' ? 3 : 1;
+    size_t cursor = 2;
+    uint32_t width, height, maxValue;
+    if (!ppm_readField(data, size, &cursor, &width) ||
+        !ppm_readField(data, size, &cursor, &height) ||
+        !ppm_readField(data, size, &cursor, &maxValue) ||
+        maxValue == 0 || maxValue > 255 || cursor >= size)
+    {
+        return false;
+    }
+    cursor++;
+
+    if (size - cursor < (uint64_t)width * height * channels || !image_create(image, width, height))
+    {
+        return false;
+    }
+    for (uint32_t y = 0; y < height; y++)
+    {
+        const uint8_t* source = data + cursor + (size_t)y * width * channels;
+        uint8_t* target = image->pixels + (size_t)(height - 1 - y) * width * IMAGE_CHANNELS;
+        for (uint32_t x = 0; x < width; x++, source += channels, target += IMAGE_CHANNELS)
+        {
+            target[0] = (uint8_t)(source[0] * 255u / maxValue);
+            target[1] = (uint8_t)(source[channels == 3 ? 1 : 0] * 255u / maxValue);
+            target[2] = (uint8_t)(source[channels == 3 ? 2 : 0] * 255u / maxValue);
+            target[3] = 255;
+        }
+    }
+    return true;
+}
+
+static void tga_readPixel(const uint8_t* source, uint32_t bytesPerPixel, uint8_t* target)
+{
+    switch (bytesPerPixel)
+    {
+        case 1:
+            target[0] = target[1] = target[2] = source[0];
+            target[3] = 255;
+            break;
+        case 3:
+            target[0] = source[2];
+            target[1] = source[1];
+            target[2] = source[0];
+            target[3] = 255;
+            break;
+        default:
+            target[0] = source[2];
+            target[1] = source[1];
+            target[2] = source[0];
+            target[3] = source[3];
+            break;
+    }
+}
+
+// Uncompressed and run-length encoded true-colour (24/32-bit) and
+// greyscale (8-bit) images; colour-mapped ones are not supported.
+static bool image_decodeTga(Image* image, const uint8_t* data, size_t size)
+{
+    if (size < TGA_HEADER_SIZE)
+    {
+        return false;
+    }
+    const uint8_t idLength = data[0];
+    const uint8_t colorMapType = data[1];
+    const uint8_t imageType = data[2];
+    const uint32_t colorMapLength = data[5] | (uint32_t)data[6] << 8;
+    const uint32_t colorMapEntryBits = data[7];
+    const uint32_t width = data[12] | (uint32_t)data[13] << 8;
+    const uint32_t height = data[14] | (uint32_t)data[15] << 8;
+    const uint32_t bytesPerPixel = data[16] / 8;
+    const bool topDown = (data[17] & TGA_ORIGIN_TOP) != 0;
+
+    const bool grey = imageType == TGA_GRAYSCALE || imageType == TGA_RLE_GRAYSCALE;
+    const bool rle = imageType == TGA_RLE_TRUECOLOR || imageType == TGA_RLE_GRAYSCALE;
+    if (colorMapType > 1 ||
+        (imageType != TGA_TRUECOLOR && imageType != TGA_GRAYSCALE && !rle) ||
+        (grey && bytesPerPixel != 1) ||
+        (!grey && bytesPerPixel != 3 && bytesPerPixel != 4))
+    {
+        return false;
+    }
+
+    size_t cursor = TGA_HEADER_SIZE + idLength + (colorMapType == 1 ? (size_t)colorMapLength * ((colorMapEntryBits + 7) / 8) : 0);
+    if (cursor > size || !image_create(image, width, height))
+    {
+        return false;
+    }
+
+    const size_t pixelCount = (size_t)width * height;
+    size_t pixel = 0;
+    while (pixel < pixelCount)
+    {
+        size_t run = 1;
+        bool repeat = false;
+        if (rle)
+        {
+            if (cursor >= size)
+            {
+                break;
+            }
+            const uint8_t packet = data[cursor++];
+            run = (packet & 0x7F) + 1u;
+            repeat = (packet & 0x80) != 0;
+        }
+        if (run > pixelCount - pixel)
+        {
+            run = pixelCount - pixel;
+        }
+        if (size - cursor < (repeat ? 1 : run) * bytesPerPixel)
+        {
+            break;
+        }
+
+        for (size_t i = 0; i < run; i++, pixel++)
+        {
+            const size_t x = pixel % width;
+            const size_t y = topDown ? height - 1 - pixel / width : pixel / width;
+            tga_readPixel(data + cursor, bytesPerPixel, image->pixels + (y * width + x) * IMAGE_CHANNELS);
+            if (!repeat)
+            {
+                cursor += bytesPerPixel;
+            }
+        }
+        if (repeat)
+        {
+            cursor += bytesPerPixel;
+        }
+    }
+
+    if (pixel < pixelCount)
+    {
+        image_free(image);
+        return false;
+    }
+    return true;
+}
+
+bool image_decode(Image* image, const uint8_t* data, size_t size)
+{
+    *image = (Image){ 0 };
+    if (size >= 2 && data[0] == 'P' && (data[1] == '5' || data[1] == '6'))
+    {
+        return image_decodePpm(image, data, size);
+    }
+    return image_decodeTga(image, data, size);
+}
+
+bool image_load(Image* image, const char* path)
+{
+    *image = (Image){ 0 };
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    uint8_t* data = NULL;
+    long size = -1;
+    if (fseek(file, 0, SEEK_END) == 0 && (size = ftell(file)) > 0 && fseek(file, 0, SEEK_SET) == 0)
+    {
+        data = malloc((size_t)size);
+    }
+    const bool read = data != NULL && fread(data, (size_t)size, 1, file) == 1;
+    fclose(file);
+
+    const bool decoded = read && image_decode(image, data, (size_t)size);
+    free(data);
+    return decoded;
+}
+
+// Writes the base level as binary P6, flipping the rows back to top-down and
+// dropping alpha.
+bool image_savePpm(const Image* image, const char* path)
+{
+    FILE* file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    uint8_t* row = malloc((size_t)image->width * 3);
+    bool written = row != NULL && fprintf(file, "P6\n%u %u\n255\n", image->width, image->height) > 0;
+    for (uint32_t y = 0; written && y < image->height; y++)
+    {
+        const uint8_t* source = image->pixels + (size_t)(image->height - 1 - y) * image->width * IMAGE_CHANNELS;
+        for (uint32_t x = 0; x < image->width; x++, source += IMAGE_CHANNELS)
+        {
+            memcpy(row + (size_t)x * 3, source, 3);
+        }
+        written = fwrite(row, (size_t)image->width * 3, 1, file) == 1;
+    }
+    free(row);
+    written = fclose(file) == 0 && written;
+    if (!written)
+    {
+        remove(path);
+    }
+    return written;
+}
+
+// 2x2 box filter from each level to the next, clamping at odd edges.
+void image_generateMipmaps(Image* image, uint32_t firstLevel)
+{
+    for (uint32_t level = firstLevel > 0 ? firstLevel : 1; level < image->levelCount; level++)
+    {
+        const uint32_t sourceWidth = image_levelWidth(image, level - 1);
+        const uint32_t sourceHeight = image_levelHeight(image, level - 1);
+        const uint32_t width = image_levelWidth(image, level);
+        const uint32_t height = image_levelHeight(image, level);
+        const uint8_t* source = image_level(image, level - 1);
+        uint8_t* target = image_level(image, level);
+
+        for (uint32_t y = 0; y < height; y++)
+        {
+            const uint32_t y0 = y * 2 < sourceHeight ? y * 2 : sourceHeight - 1;
+            const uint32_t y1 = y * 2 + 1 < sourceHeight ? y * 2 + 1 : y0;
+            for (uint32_t x = 0; x < width; x++)
+            {
+                const uint32_t x0 = x * 2 < sourceWidth ? x * 2 : sourceWidth - 1;
+                const uint32_t x1 = x * 2 + 1 < sourceWidth ? x * 2 + 1 : x0;
+                const uint8_t* a = source + ((size_t)y0 * sourceWidth + x0) * IMAGE_CHANNELS;
+                const uint8_t* b = source + ((size_t)y0 * sourceWidth + x1) * IMAGE_CHANNELS;
+                const uint8_t* c = source + ((size_t)y1 * sourceWidth + x0) * IMAGE_CHANNELS;
+                const uint8_t* d = source + ((size_t)y1 * sourceWidth + x1) * IMAGE_CHANNELS;
+                uint8_t* pixel = target + ((size_t)y * width + x) * IMAGE_CHANNELS;
+                for (uint32_t channel = 0; channel < IMAGE_CHANNELS; channel++)
+                {
+                    pixel[channel] = (uint8_t)((a[channel] + b[channel] + c[channel] + d[channel] + 2) / 4);
+                }
+            }
+        }
+    }
+}
+
+// Precomputed levels sit next to the base image as name.mip1.ext,
+// name.mip2.ext and so on. The chain stops at the first missing or
+// mis-sized level; the rest is generated when asked to, and otherwise the
+// image keeps only the levels found.
+bool image_loadMipmapped(Image* image, const char* path, bool generate)
+{
+    if (!image_load(image, path))
+    {
+        return false;
+    }
+
+    const uint32_t mipCount = image_mipCount(image->width, image->height);
+    if (mipCount == 1)
+    {
+        return true;
+    }
+
+    const char* extension = strrchr(path, '.');
+    const char* slash = strrchr(path, '/');
+    const int stemLength = extension != NULL && (slash == NULL || extension > slash) ? (int)(extension - path) : (int)strlen(path);
+    extension = path + stemLength;
+
+    uint32_t loaded = 1;
+    for (; loaded < mipCount; loaded++)
+    {
+        char levelPath[512];
+        snprintf(levelPath, sizeof(levelPath), "%.*s.mip%u%s", stemLength, path, loaded, extension);
+        Image level;
+        if (!image_load(&level, levelPath))
+        {
+            break;
+        }
+        const bool fits = level.width == image_levelWidth(image, loaded) && level.height == image_levelHeight(image, loaded);
+        if (fits && image_setLevelCount(image, loaded + 1))
+        {
+            memcpy(image_level(image, loaded), level.pixels, level.size);
+        }
+        image_free(&level);
+        if (!fits)
+        {
+            fprintf(stderr, "Failed to use %s, it is not %ux%u!\n", levelPath, image_levelWidth(image, loaded), image_levelHeight(image, loaded));
+            break;
+        }
+        if (image->levelCount != loaded + 1)
+        {
+            image_free(image);
+            return false;
+        }
+    }
+
+    if (generate && loaded < mipCount)
+    {
+        if (!image_setLevelCount(image, mipCount))
+        {
+            image_free(image);
+            return false;
+        }
+        image_generateMipmaps(image, loaded);
+    }
+    return true;
+}
+
+void image_free(Image* image)
+{
+    free(image->pixels);
+    *image = (Image){ 0 };
+}
@@ -0,0 +1,61 @@
+#include "../include/Lod.h"
+
+#include <math.h>
+
+#define LOD_MIN_DISTANCE 1e-3f
+
+// Camera.fov is vertical, so the horizontal extent of the viewport covers
+// 2 * tan(fov / 2) * aspectRatio units at distance 1.
+LodView lodView_create(Vec3 position, float fov, float aspectRatio, float viewportWidth, float thresholdPixels, float hysteresis)
+{
+    return (LodView)
+    {
+        .position = position,
+        .projectionScale = viewportWidth / (2.f * tanf(radians(fov) * 0.5f) * aspectRatio),
+        .threshold = thresholdPixels,
+        .hysteresis = hysteresis,
+    };
+}
+
+// Measured from the nearest point of the bounding sphere, so the error is
+// never underestimated for large objects.
+float lod_projectedError(const LodView* view, float error, Vec3 center, float radius)
+{
+    const float distance = vec3_length(vec3_sub(center, view->position)) - radius;
+    return error * view->projectionScale / (distance > LOD_MIN_DISTANCE ? distance : LOD_MIN_DISTANCE);
+}
+
+// Picks the coarsest level whose error stays under the pixel threshold.
+// Switching to a coarser level than the current one needs the error to be
+// clearly under it and staying needs it only loosely under, so objects near
+// a boundary do not flicker between levels.
+uint8_t lod_select(const LodView* view, const MeshLod* lods, uint32_t lodCount, Vec3 center, float radius, uint8_t current)
+{
+    const float distance = vec3_length(vec3_sub(center, view->position)) - radius;
+    const float scale = view->projectionScale / (distance > LOD_MIN_DISTANCE ? distance : LOD_MIN_DISTANCE);
+    uint8_t level = 0;
+    for (uint32_t i = 1; i < lodCount; i++)
+    {
+        const float limit = view->threshold * (i > current ? 1.f - view->hysteresis : 1.f + view->hysteresis);
+        if (lods[i].error * scale > limit)
+        {
+            break;
+        }
+        level = (uint8_t)i;
+    }
+    return level;
+}
+
+// levels is indexed by object, like bounds, and keeps last frame's choice for
+// objects not in visibleIndices.
+void lod_selectBatch(const LodView* view, const MeshLod* lods, uint32_t lodCount, const Aabb* bounds, const uint32_t* visibleIndices, size_t count, uint8_t* levels)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        const uint32_t index = visibleIndices[i];
+        const Aabb aabb = bounds[index];
+        const Vec3 center = vec3_scale(vec3_add(aabb.min, aabb.max), 0.5f);
+        const float radius = 0.5f * vec3_length(vec3_sub(aabb.max, aabb.min));
+        levels[index] = lod_select(view, lods, lodCount, center, radius, levels[index]);
+    }
+}
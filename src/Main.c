@@ -5,40 +5,149 @@
 #include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
 
 #include "../include/Window.h"
 #include "../include/Camera.h"
 #include "../include/Graphics.h"
 #include "../include/Space.h"
+#include "../include/Culling.h"
+#include "../include/Bvh.h"
+#include "../include/StreamBuffer.h"
+#include "../include/GLState.h"
+#include "../include/RenderQueue.h"
+#include "../include/GpuScene.h"
+#include "../include/Mesh.h"
+#include "../include/VertexFormat.h"
+#include "../include/Lod.h"
+#include "../include/ShaderCache.h"
+#include "../include/ShaderCompiler.h"
+#include "../include/Texture.h"
+#include "../include/Image.h"
+#include "../include/Profiler.h"
 
 const unsigned int WINDOW_WIDTH  = 800;
 const unsigned int WINDOW_HEIGHT = 600;
 const char*        WINDOW_TITLE  = "GL";
 
 const float CAMERA_FOV            = 60.f;
-const float CAMERA_INITIAL_ASPECT = (float)WINDOW_WIDTH / WINDOW_HEIGHT;
 const float CAMERA_SPEED          = 10.f;
 const float CAMERA_SENSITIVITY    = 0.25f;
 
+const int   GRID_WIDTH   = 100;
+const int   GRID_HEIGHT  = 10;
+const int   GRID_DEPTH   = 100;
+const float GRID_SPACING = 1.5f;
+
+const uint32_t FRAMES_IN_FLIGHT = 3;
+
+const char* SHADER_CACHE_DIRECTORY = "build/shader-cache";
+
+const char* PROFILER_TRACE_PATH = "build/trace.json";
+
+const int      HEADLESS_WIDTH         = 1280;
+const int      HEADLESS_HEIGHT        = 720;
+const uint32_t HEADLESS_FRAMES        = 300;
+const uint32_t HEADLESS_WARMUP_FRAMES = 10;
+const float    HEADLESS_ORBIT_RADIUS  = 60.f;
+const float    HEADLESS_ORBIT_HEIGHT  = 20.f;
+const float    HEADLESS_ORBIT_PERIOD  = 600.f;
+
+const uint32_t   TEXTURE_DECODE_THREADS         = 2;
+const size_t     TEXTURE_BUDGET                 = 256u << 20;
+const GLsizeiptr TEXTURE_UPLOAD_BYTES_PER_FRAME = 4 << 20;
+const char*      TEXTURE_PATH                   = "build/checker.ppm";
+const uint32_t   TEXTURE_SIZE                   = 256;
+const uint32_t   TEXTURE_CHECKER_SIZE           = 32;
+const GLuint     TEXTURE_UNIT                   = 0;
+
 const char* vertexShaderSource =
     "#version 330 core\n"
     "layout (location = 0) in vec3 aPos;\n"
     "layout (location = 1) in vec3 aCol;\n"
+    "layout (location = 2) in mat4x3 aModel;\n"
+    "layout (location = 6) in vec3 aTint;\n"
     "out vec3 vertCol;\n"
-    "uniform mat4 cameraMatrix;\n"
-    "uniform mat4 modelMatrix;\n"
+    "out vec2 vertTexCoord;\n"
+    "layout (std140) uniform Camera\n"
+    "{\n"
+    "  mat4 cameraMatrix;\n"
+    "  vec4 cameraPosition;\n"
+    "};\n"
     "void main()\n"
     "{\n"
-    "  vertCol = aCol;\n"
-    "  gl_Position = cameraMatrix * modelMatrix * vec4(aPos, 1.f);\n"
+    "  vertCol = aCol * aTint;\n"
+    "  vertTexCoord = aPos.xy + aPos.z + 0.5f;\n"
+    "  gl_Position = cameraMatrix * vec4(aModel * vec4(aPos, 1.f), 1.f);\n"
     "}\0";
+const char* gpuVertexShaderSource =
+    "#version 430 core\n"
+    "layout (location = 0) in vec3 aPos;\n"
+    "layout (location = 1) in vec3 aCol;\n"
+    "layout (location = 7) in uint aObject;\n"
+    "out vec3 vertCol;\n"
+    "out vec2 vertTexCoord;\n"
+    "struct Object\n"
+    "{\n"
+    "  vec4 rows[3];\n"
+    "  vec3 boundsMin;\n"
+    "  uint mesh;\n"
+    "  vec3 boundsMax;\n"
+    "  uint color;\n"
+    "};\n"
+    "layout (std430, binding = 0) readonly buffer Objects { Object objects[]; };\n"
+    "layout (std140) uniform Camera\n"
+    "{\n"
+    "  mat4 cameraMatrix;\n"
+    "  vec4 cameraPosition;\n"
+    "};\n"
+    "void main()\n"
+    "{\n"
+    "  vec4 position = vec4(aPos, 1.f);\n"
+    "  vec3 world = vec3(\n"
+    "    dot(objects[aObject].rows[0], position),\n"
+    "    dot(objects[aObject].rows[1], position),\n"
+    "    dot(objects[aObject].rows[2], position));\n"
+    "  vertCol = aCol * unpackUnorm4x8(objects[aObject].color).rgb;\n"
+    "  vertTexCoord = aPos.xy + aPos.z + 0.5f;\n"
+    "  gl_Position = cameraMatrix * vec4(world, 1.f);\n"
+    "}\0";
+// The texture is mixed out while it is still streaming in.
 const char* fragmentShaderSource =
     "#version 330 core\n"
     "in vec3 vertCol;\n"
+    "in vec2 vertTexCoord;\n"
+    "out vec4 FragColor;\n"
+    "uniform sampler2DArray textureArray;\n"
+    "uniform float textureLayer;\n"
+    "uniform float textured;\n"
+    "void main()\n"
+    "{\n"
+    "  vec3 texel = texture(textureArray, vec3(vertTexCoord, textureLayer)).rgb;\n"
+    "  FragColor = vec4(vertCol * mix(vec3(1.f), texel, textured), 1.f);\n"
+    "}\0";
+// Drawn with while the real programs are still compiling.
+const char* fallbackVertexShaderSource =
+    "#version 330 core\n"
+    "layout (location = 0) in vec3 aPos;\n"
+    "layout (location = 2) in mat4x3 aModel;\n"
+    "layout (std140) uniform Camera\n"
+    "{\n"
+    "  mat4 cameraMatrix;\n"
+    "  vec4 cameraPosition;\n"
+    "};\n"
+    "void main()\n"
+    "{\n"
+    "  gl_Position = cameraMatrix * vec4(aModel * vec4(aPos, 1.f), 1.f);\n"
+    "}\0";
+const char* fallbackFragmentShaderSource =
+    "#version 330 core\n"
     "out vec4 FragColor;\n"
     "void main()\n"
     "{\n"
-    "  FragColor = vec4(vertCol, 1.f);\n"
+    "  FragColor = vec4(0.5f, 0.5f, 0.5f, 1.f);\n"
     "}\0";
 
 const GLfloat vertices[] =
@@ -68,56 +177,669 @@ const GLuint indices[] =
     5, 0, 1, // Bottom
 };
 
-int main()
+const GLfloat pyramidVertices[] =
+{
+    -0.5f, -0.5f,  0.5f, 1.f, 0.f, 0.f,
+     0.5f, -0.5f,  0.5f, 0.f, 1.f, 0.f,
+     0.5f, -0.5f, -0.5f, 0.f, 0.f, 1.f,
+    -0.5f, -0.5f, -0.5f, 1.f, 1.f, 0.f,
+     0.0f,  0.5f,  0.0f, 1.f, 1.f, 1.f,
+};
+const GLuint pyramidIndices[] =
+{
+    0, 1, 4, // Front
+    1, 2, 4, // Right
+    2, 3, 4, // Back
+    3, 0, 4, // Left
+    0, 3, 2, // Bottom
+    0, 2, 1, // Bottom
+};
+
+// Layout of the tables above, and the packed layout they are drawn with: a
+// half-float position and an RGBA8 color, 12 bytes a vertex instead of 24.
+const MeshAttrib floatAttribs[] =
+{
+    { 0, 3, MESH_TYPE_FLOAT, 0, 0 },
+    { 1, 3, MESH_TYPE_FLOAT, 0, 3 * sizeof(GLfloat) },
+};
+const MeshAttrib packedAttribs[] =
+{
+    { 0, 3, MESH_TYPE_HALF_FLOAT, 0, 0 },
+    { 1, 4, MESH_TYPE_UNSIGNED_BYTE, 1, 4 * sizeof(GLhalf) },
+};
+
+typedef struct
+{
+    const MeshAttrib* attribs;
+    uint32_t attribCount;
+    uint32_t stride;
+} VertexLayout;
+
+typedef struct
+{
+    Affine model;
+    GLfloat tint[3];
+} Instance;
+
+typedef struct
+{
+    const char* meshPath;
+    bool headless;
+    bool cpuCulling;
+    int width;
+    int height;
+    uint32_t frames;
+    const char* screenshotPath;
+    const char* statsPath;
+} Options;
+
+static void printUsage(const char* program)
+{
+    fprintf(
+        stderr,
+        "Usage: %s [mesh] [--headless] [--cpu-culling] [--size WxH] [--frames N] [--screenshot file.ppm] [--stats file.csv]\n",
+        program
+    );
+}
+
+// Headless runs stop after a fixed number of frames unless told otherwise;
+// windowed runs only stop early when asked to.
+static bool parseOptions(Options* options, int argc, char** argv)
+{
+    *options = (Options){ 0 };
+    bool framesSet = false;
+    for (int i = 1; i < argc; i++)
+    {
+        const char* argument = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(argument, "--headless") == 0)
+        {
+            options->headless = true;
+            continue;
+        }
+        if (strcmp(argument, "--cpu-culling") == 0)
+        {
+            options->cpuCulling = true;
+            continue;
+        }
+        if (argument[0] != '-')
+        {
+            options->meshPath = argument;
+            continue;
+        }
+        if (value == NULL)
+        {
+            fprintf(stderr, "Failed to parse %s, it needs a value!\n", argument);
+            return false;
+        }
+        i++;
+        if (strcmp(argument, "--size") == 0)
+        {
+            if (sscanf(value, "%dx%d", &options->width, &options->height) != 2 || options->width <= 0 || options->height <= 0)
+            {
+                fprintf(stderr, "Failed to parse the size %s!\n", value);
+                return false;
+            }
+        }
+        else if (strcmp(argument, "--frames") == 0)
+        {
+            char* end;
+            const unsigned long frames = strtoul(value, &end, 10);
+            if (*end != '\0' || frames == 0 || frames > UINT32_MAX)
+            {
+                fprintf(stderr, "Failed to parse the frame count %s!\n", value);
+                return false;
+            }
+            options->frames = (uint32_t)frames;
+            framesSet = true;
+        }
+        else if (strcmp(argument, "--screenshot") == 0)
+        {
+            options->screenshotPath = value;
+        }
+        else if (strcmp(argument, "--stats") == 0)
+        {
+            options->statsPath = value;
+        }
+        else
+        {
+            fprintf(stderr, "Failed to parse the unknown option %s!\n", argument);
+            return false;
+        }
+    }
+
+    if (options->width == 0)
+    {
+        options->width = options->headless ? HEADLESS_WIDTH : (int)WINDOW_WIDTH;
+        options->height = options->headless ? HEADLESS_HEIGHT : (int)WINDOW_HEIGHT;
+    }
+    if (!framesSet && options->headless)
+    {
+        options->frames = HEADLESS_FRAMES;
+    }
+    return true;
+}
+
+// Orbits the grid at a fixed step per frame rather than per second, so every
+// run draws the same frames whatever the frame rate.
+static void scriptCamera(Camera* camera, uint32_t frame)
+{
+    const float angle = radians(360.f * (float)frame / HEADLESS_ORBIT_PERIOD);
+    camera->position = vec3(
+        HEADLESS_ORBIT_RADIUS * cosf(angle),
+        HEADLESS_ORBIT_HEIGHT,
+        HEADLESS_ORBIT_RADIUS * sinf(angle)
+    );
+    const Vec3 direction = vec3_normalize(vec3_scale(camera->position, -1.f));
+    camera_updateYaw(camera, degrees(atan2f(direction.z, direction.x)));
+    camera_updatePitch(camera, degrees(asinf(direction.y)));
+    if (camera->quaternion)
+    {
+        camera_enableQuaternion(camera);
+    }
+    else
+    {
+        camera->front = direction;
+    }
+}
+
+static int compareFloats(const void* a, const void* b)
+{
+    const float left = *(const float*)a;
+    const float right = *(const float*)b;
+    return (left > right) - (left < right);
+}
+
+static float percentile(const float* sorted, uint32_t count, float fraction)
+{
+    const uint32_t index = (uint32_t)(fraction * (float)(count - 1) + 0.5f);
+    return sorted[index];
+}
+
+// Frame times are in milliseconds, in the order the frames ran.
+static void logFrameTimes(const float* frameTimes, uint32_t count, const char* statsPath)
+{
+    if (count == 0)
+    {
+        printf("Frame times: no frames measured\n");
+        return;
+    }
+    if (statsPath != NULL)
+    {
+        FILE* file = fopen(statsPath, "w");
+        bool written = file != NULL && fprintf(file, "frame,milliseconds\n") > 0;
+        for (uint32_t i = 0; written && i < count; i++)
+        {
+            written = fprintf(file, "%u,%.4f\n", i, frameTimes[i]) > 0;
+        }
+        if (file != NULL)
+        {
+            written = fclose(file) == 0 && written;
+        }
+        if (!written)
+        {
+            fprintf(stderr, "Failed to write the frame times to %s!\n", statsPath);
+        }
+    }
+
+    float* sorted = malloc(count * sizeof(float));
+    if (sorted == NULL)
+    {
+        fprintf(stderr, "Failed to allocate frame times!\n");
+        return;
+    }
+    memcpy(sorted, frameTimes, count * sizeof(float));
+    qsort(sorted, count, sizeof(float), compareFloats);
+    double total = 0.0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        total += sorted[i];
+    }
+    const double mean = total / count;
+    printf(
+        "Frame times over %u frames: %.3f ms mean (%.1f fps), %.3f min, %.3f median, %.3f p95, %.3f p99, %.3f max\n",
+        count,
+        mean,
+        mean > 0.0 ? 1e3 / mean : 0.0,
+        sorted[0],
+        percentile(sorted, count, 0.5f),
+        percentile(sorted, count, 0.95f),
+        percentile(sorted, count, 0.99f),
+        sorted[count - 1]
+    );
+    free(sorted);
+}
+
+static void createGrid(Instance* instances, Aabb* bounds, Aabb localBounds)
+{
+    const Vec3 origin = vec3(
+        -0.5f * GRID_SPACING * (GRID_WIDTH - 1),
+        -0.5f * GRID_SPACING * (GRID_HEIGHT - 1),
+        -0.5f * GRID_SPACING * (GRID_DEPTH - 1)
+    );
+
+    size_t i = 0;
+    for (int x = 0; x < GRID_WIDTH; x++)
+    {
+        for (int y = 0; y < GRID_HEIGHT; y++)
+        {
+            for (int z = 0; z < GRID_DEPTH; z++, i++)
+            {
+                const Vec3 center = vec3(
+                    origin.x + x * GRID_SPACING,
+                    origin.y + y * GRID_SPACING,
+                    origin.z + z * GRID_SPACING
+                );
+                affine_load_identity(&instances[i].model);
+                affine_translate_inplace(&instances[i].model, center);
+                instances[i].tint[0] = (float)x / (GRID_WIDTH - 1);
+                instances[i].tint[1] = (float)y / (GRID_HEIGHT - 1);
+                instances[i].tint[2] = (float)z / (GRID_DEPTH - 1);
+
+                bounds[i].min = vec3_add(center, localBounds.min);
+                bounds[i].max = vec3_add(center, localBounds.max);
+            }
+        }
+    }
+}
+
+static GLuint packColor(const GLfloat* color)
+{
+    return (GLuint)(color[0] * 255.f + 0.5f)
+        | (GLuint)(color[1] * 255.f + 0.5f) << 8
+        | (GLuint)(color[2] * 255.f + 0.5f) << 16
+        | 255u << 24;
+}
+
+// Converted meshes bring their own layout; the shaders read attribute 0 as
+// the position and attribute 1 as the color. Files come from the command
+// line, so their indices are checked before GL reads through them.
+static bool loadMesh(Mesh* mesh, const char* path)
+{
+    if (!mesh_load(mesh, path, MESH_LOAD_CHECK_INDICES))
+    {
+        return false;
+    }
+    uint32_t found = 0;
+    for (uint32_t i = 0; i < mesh->header->attribCount; i++)
+    {
+        found |= mesh->header->attribs[i].location < 2 ? 1u << mesh->header->attribs[i].location : 0u;
+    }
+    if (found != 3u)
+    {
+        fprintf(stderr, "Failed to use mesh %s, it needs attributes 0 and 1!\n", path);
+        mesh_unload(mesh);
+        return false;
+    }
+    return true;
+}
+
+static MeshData packGeometry(const GLfloat* vertices, GLuint vertexCount, const GLuint* indices, GLuint indexCount, VertexLayout layout)
+{
+    MeshData data =
+    {
+        .vertices = malloc(vertexCount * 6 * sizeof(GLfloat)),
+        .vertexCount = vertexCount,
+        .vertexStride = 6 * sizeof(GLfloat),
+        .indices = malloc(indexCount * sizeof(GLuint)),
+        .indexCount = indexCount,
+        .indexSize = sizeof(GLuint),
+        .attribCount = 2,
+    };
+    if (data.vertices == NULL || data.indices == NULL)
+    {
+        fprintf(stderr, "Failed to allocate geometry!\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(data.vertices, vertices, vertexCount * 6 * sizeof(GLfloat));
+    memcpy(data.indices, indices, indexCount * sizeof(GLuint));
+    memcpy(data.attribs, floatAttribs, sizeof(floatAttribs));
+    meshData_convert(&data, layout.attribs, layout.attribCount, layout.stride);
+    return data;
+}
+
+// Locations from 2 up belong to the instance attributes.
+static void linkLayout(VBO VBO, VertexLayout layout)
+{
+    for (uint32_t i = 0; i < layout.attribCount; i++)
+    {
+        const MeshAttrib* attrib = &layout.attribs[i];
+        if (attrib->location < 2)
+        {
+            vao_linkAttribFormat(VBO, attrib->location, attrib->size, attrib->type, (GLboolean)attrib->normalized, layout.stride, (void*)(uintptr_t)attrib->offset);
+        }
+    }
+}
+
+static GpuScene createGpuScene(Instance* instances, const Aabb* bounds, uint32_t count, VertexLayout layout, const MeshData* cube, const MeshData* pyramid, const Mesh* mesh, ShaderCache* shaderCache)
+{
+    const void* secondVertices = pyramid->vertices;
+    const GLuint* secondIndices = pyramid->indices;
+    GLuint secondVertexCount = pyramid->vertexCount;
+    GLuint secondIndexCount = pyramid->indexCount;
+    MeshLod secondLod = { 0, pyramid->indexCount, 0.f, 0 };
+    const MeshLod* secondLods = &secondLod;
+    uint32_t secondLodCount = 1;
+    GLuint* widenedIndices = NULL;
+    if (mesh->mapping != NULL)
+    {
+        secondVertices = mesh->vertices;
+        secondVertexCount = mesh->header->vertexCount;
+        secondIndexCount = mesh->header->indexCount;
+        secondIndices = mesh->indices;
+        secondLod.indexCount = secondIndexCount;
+        if (mesh->header->lodCount > 0)
+        {
+            secondLods = mesh->lods;
+            secondLodCount = mesh->header->lodCount;
+        }
+
+        // The arena holds 32-bit indices, so 16-bit meshes are widened here.
+        if (mesh->header->indexSize == sizeof(GLushort))
+        {
+            const GLushort* shortIndices = mesh->indices;
+            widenedIndices = malloc(secondIndexCount * sizeof(GLuint));
+            if (widenedIndices == NULL)
+            {
+                fprintf(stderr, "Failed to allocate geometry!\n");
+                exit(EXIT_FAILURE);
+            }
+            for (GLuint i = 0; i < secondIndexCount; i++)
+            {
+                widenedIndices[i] = shortIndices[i];
+            }
+            secondIndices = widenedIndices;
+        }
+    }
+
+    GpuScene scene = gpuScene_create(
+        layout.stride,
+        cube->vertexCount + secondVertexCount,
+        cube->indexCount + secondIndexCount,
+        2,
+        count,
+        shaderCache
+    );
+    for (uint32_t i = 0; i < layout.attribCount; i++)
+    {
+        const MeshAttrib* attrib = &layout.attribs[i];
+        if (attrib->location < 2)
+        {
+            gpuScene_linkAttrib(&scene, attrib->location, attrib->size, attrib->type, (GLboolean)attrib->normalized, (void*)(uintptr_t)attrib->offset);
+        }
+    }
+
+    const uint32_t meshes[2] =
+    {
+        gpuScene_addMesh(&scene, cube->vertices, cube->vertexCount, cube->indices, cube->indexCount),
+        gpuScene_addMeshLods(&scene, secondVertices, secondVertexCount, secondIndices, secondIndexCount, secondLods, secondLodCount),
+    };
+    free(widenedIndices);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        gpuScene_addObject(&scene, meshes[i % 2], &instances[i].model, bounds[i], packColor(instances[i].tint));
+    }
+    return scene;
+}
+
+// A grey checkerboard for the demo to stream through the texture cache.
+static bool writeCheckerTexture(const char* path)
+{
+    Image image;
+    if (!image_create(&image, TEXTURE_SIZE, TEXTURE_SIZE))
+    {
+        return false;
+    }
+    for (uint32_t y = 0; y < image.height; y++)
+    {
+        for (uint32_t x = 0; x < image.width; x++)
+        {
+            uint8_t* pixel = image.pixels + ((size_t)y * image.width + x) * IMAGE_CHANNELS;
+            const uint8_t value = ((x / TEXTURE_CHECKER_SIZE) + (y / TEXTURE_CHECKER_SIZE)) % 2 == 0 ? 255 : 160;
+            pixel[0] = pixel[1] = pixel[2] = value;
+            pixel[3] = 255;
+        }
+    }
+    const bool saved = image_savePpm(&image, path);
+    image_free(&image);
+    return saved;
+}
+
+// Binds the texture for the program and tells it whether to sample it,
+// which also keeps the texture from being evicted while it is drawn.
+static void useTexture(Shader* shader, TextureCache* cache, TextureHandle handle)
+{
+    uint32_t layer = 0;
+    const bool bound = textureCache_bind(cache, handle, TEXTURE_UNIT, &layer);
+    shader_use(shader);
+    shader_setUniformFloat(shader_getUniform(shader, "textureLayer"), (float)layer);
+    shader_setUniformFloat(shader_getUniform(shader, "textured"), bound ? 1.f : 0.f);
+}
+
+// The program once it is built, with its camera block bound the first time,
+// or NULL while it is still compiling.
+static Shader* acquireShader(ShaderCompiler* compiler, ShaderProgramHandle handle, bool* bound)
+{
+    Shader* shader = shaderCompiler_get(compiler, handle);
+    if (shader != NULL && !*bound)
+    {
+        shader_bindBlock(shader, CAMERA_BLOCK_NAME, CAMERA_BLOCK_BINDING);
+        *bound = true;
+    }
+    return shader;
+}
+
+int main(int argc, char** argv)
 {
-    if (!glfwInit())
+    Options options;
+    if (!parseOptions(&options, argc, argv))
+    {
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // Headless runs draw into an offscreen framebuffer on EGL and never
+    // touch GLFW, so they work without a display or a GPU.
+    Window window;
+    if (options.headless)
+    {
+        window = window_createHeadless(options.width, options.height);
+    }
+    else
+    {
+        if (!glfwInit())
+        {
+            fprintf(stderr, "Failed to initialize GLFW!\n");
+            return EXIT_FAILURE;
+        }
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+        window = window_create(
+            options.width,
+            options.height,
+            WINDOW_TITLE
+        );
+    }
+
+    // Before the shader compiler starts, so its worker thread and first
+    // program builds are recorded too.
+    profiler_init();
+    PROFILE_THREAD("Main");
+
+    // Programs build in the background and the scene draws with a flat
+    // fallback until they are ready. Drivers without parallel compiles get
+    // a worker thread on a hidden shared context instead.
+    ShaderCache shaderCache = shaderCache_create(SHADER_CACHE_DIRECTORY);
+    GLFWwindow* compilerContext = shaderCompiler_isParallelSupported() ? NULL : window_createSharedContext(&window);
+    ShaderCompiler* shaderCompiler = shaderCompiler_create(&shaderCache, compilerContext, window_makeContextCurrent);
+    const ShaderProgramHandle shaderHandle = shaderCompiler_submitShader(shaderCompiler, vertexShaderSource, fragmentShaderSource);
+    bool shaderBound = false;
+    Shader fallbackShader = shaderCache_createShader(&shaderCache, fallbackVertexShaderSource, fallbackFragmentShaderSource);
+    if (fallbackShader.ID == 0)
     {
-        fprintf(stderr, "Failed to initialize GLFW!\n");
+        fprintf(stderr, "Failed to create the fallback shader program!\n");
         return EXIT_FAILURE;
     }
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    shader_bindBlock(&fallbackShader, CAMERA_BLOCK_NAME, CAMERA_BLOCK_BINDING);
 
-    Window window = window_create(
-        WINDOW_WIDTH,
-        WINDOW_HEIGHT,
-        WINDOW_TITLE
+    TextureCache* textureCache = textureCache_create(
+        TEXTURE_DECODE_THREADS,
+        TEXTURE_BUDGET,
+        TEXTURE_UPLOAD_BYTES_PER_FRAME,
+        FRAMES_IN_FLIGHT
     );
+    if (!writeCheckerTexture(TEXTURE_PATH))
+    {
+        fprintf(stderr, "Failed to write the texture %s!\n", TEXTURE_PATH);
+    }
+    const TextureHandle checkerTexture = textureCache_load(textureCache, TEXTURE_PATH, TEXTURE_FLAG_MIPMAPS | TEXTURE_FLAG_SRGB);
 
-    Shader shader = shader_create(vertexShaderSource, fragmentShaderSource);
-    VAO VAO = vao_create();
-    VBO VBO = vbo_create(vertices, sizeof(vertices));
-    EBO EBO = ebo_create(indices, sizeof(indices));
+    UBO cameraUBO = ubo_create(sizeof(CameraBlock));
+    ubo_bindBase(cameraUBO, CAMERA_BLOCK_BINDING);
+    // An optional converted mesh replaces the cube, and the pyramid on the
+    // GPU-driven path. Its blobs go to GL straight from the file mapping.
+    Mesh mesh = { 0 };
+    Aabb localBounds = { vec3(-0.5f, -0.5f, -0.5f), vec3(0.5f, 0.5f, 0.5f) };
+    if (options.meshPath != NULL && loadMesh(&mesh, options.meshPath))
+    {
+        localBounds.min = vec3(fminf(localBounds.min.x, mesh.bounds.min.x), fminf(localBounds.min.y, mesh.bounds.min.y), fminf(localBounds.min.z, mesh.bounds.min.z));
+        localBounds.max = vec3(fmaxf(localBounds.max.x, mesh.bounds.max.x), fmaxf(localBounds.max.y, mesh.bounds.max.y), fmaxf(localBounds.max.z, mesh.bounds.max.z));
+    }
+    const bool meshLoaded = mesh.mapping != NULL;
+    const VertexLayout layout = meshLoaded
+        ? (VertexLayout){ mesh.header->attribs, mesh.header->attribCount, mesh.header->vertexStride }
+        : (VertexLayout){ packedAttribs, sizeof(packedAttribs) / sizeof(packedAttribs[0]), 4 * sizeof(GLhalf) + 4 };
 
-    vao_bind(VAO);
-    vbo_bind(VBO);
-    ebo_bind(EBO);
+    // The built-in shapes are packed into the same layout so both paths can
+    // share one vertex format; the cube's indices fit in 16 bits.
+    MeshData cube = packGeometry(vertices, sizeof(vertices) / (6 * sizeof(GLfloat)), indices, sizeof(indices) / sizeof(GLuint), layout);
+    MeshData pyramid = packGeometry(pyramidVertices, sizeof(pyramidVertices) / (6 * sizeof(GLfloat)), pyramidIndices, sizeof(pyramidIndices) / sizeof(GLuint), layout);
+    GLushort cubeIndices[sizeof(indices) / sizeof(GLuint)];
+    vertexFormat_narrowIndices(cubeIndices, cube.indices, cube.indexCount);
 
-    vao_linkAttrib(VBO, 0, 3, GL_FLOAT, 6 * sizeof(GLfloat), (void*)(0));
-    vao_linkAttrib(VBO, 1, 3, GL_FLOAT, 6 * sizeof(GLfloat), (void*)(3 * sizeof(GLfloat)));
+    const GLenum meshIndexType = meshLoaded && mesh.header->indexSize == sizeof(GLuint) ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+    const uint32_t meshIndexSize = meshIndexType == GL_UNSIGNED_INT ? sizeof(GLuint) : sizeof(GLushort);
 
-    vao_unbind(VAO);
-    vbo_unbind(VBO);
-    ebo_unbind(EBO);
+    // Converted meshes may carry coarser index ranges after the full one.
+    // Each level gets a VAO of its own, since every level's draw reads its
+    // instances from a different part of the stream.
+    const MeshLod baseLod = { 0, meshLoaded ? mesh.header->indexCount : cube.indexCount, 0.f, 0 };
+    const bool meshHasLods = meshLoaded && mesh.header->lodCount > 0;
+    const MeshLod* lods = meshHasLods ? mesh.lods : &baseLod;
+    const uint32_t lodCount = meshHasLods ? mesh.header->lodCount : 1;
+    VAO lodVAOs[MESH_MAX_LODS];
+    VBO VBO = meshLoaded
+        ? vbo_create(mesh.vertices, (GLsizeiptr)mesh.header->vertexCount * mesh.header->vertexStride)
+        : vbo_create(cube.vertices, (GLsizeiptr)cube.vertexCount * cube.vertexStride);
+    EBO EBO = meshLoaded
+        ? ebo_create(mesh.indices, (GLsizeiptr)mesh.header->indexCount * mesh.header->indexSize)
+        : ebo_create(cubeIndices, sizeof(cubeIndices));
+
+    const uint32_t instanceCount = GRID_WIDTH * GRID_HEIGHT * GRID_DEPTH;
+    Instance* instances = malloc(instanceCount * sizeof(Instance));
+    Aabb* instanceBounds = malloc(instanceCount * sizeof(Aabb));
+    uint32_t* visibleIndices = malloc(instanceCount * sizeof(uint32_t));
+    uint8_t* instanceLevels = calloc(instanceCount, sizeof(uint8_t));
+    if (!instances || !instanceBounds || !visibleIndices || !instanceLevels)
+    {
+        fprintf(stderr, "Failed to allocate instances!\n");
+        exit(EXIT_FAILURE);
+    }
+    createGrid(instances, instanceBounds, localBounds);
+    Bvh bvh = bvh_build(instanceBounds, instanceCount, 0);
+    StreamBuffer instanceStream = streamBuffer_create(
+        instanceCount * sizeof(Instance),
+        FRAMES_IN_FLIGHT,
+        STREAM_BUFFER_AUTO
+    );
+
+    for (uint32_t i = 0; i < lodCount; i++)
+    {
+        lodVAOs[i] = vao_create();
+        vao_bind(lodVAOs[i]);
+        vbo_bind(VBO);
+        ebo_bind(EBO);
+
+        linkLayout(VBO, layout);
+
+        vao_unbind(lodVAOs[i]);
+        vbo_unbind(VBO);
+        ebo_unbind(EBO);
+    }
 
     bool lockPressed = false;
+    bool tracePressed = false;
 
     Camera camera = camera_create(
         CAMERA_FOV,
         CAMERA_SPEED,
         CAMERA_SENSITIVITY,
-        CAMERA_INITIAL_ASPECT
+        (float)options.width / (float)options.height
     );
+    camera_enableQuaternion(&camera);
+
+    // Frames before the warm-up is over still compile programs and fill
+    // caches, so they stay out of the statistics.
+    float* frameTimes = options.frames > 0 ? malloc(options.frames * sizeof(float)) : NULL;
+    if (options.frames > 0 && frameTimes == NULL)
+    {
+        fprintf(stderr, "Failed to allocate frame times!\n");
+        exit(EXIT_FAILURE);
+    }
+    const uint32_t warmupFrames = options.frames > HEADLESS_WARMUP_FRAMES * 2 ? HEADLESS_WARMUP_FRAMES : 0;
+    uint32_t measuredFrames = 0;
+    uint32_t frame = 0;
+
+    Frustum frustum;
+    RenderQueue renderQueue = renderQueue_create(1);
+    uint64_t submittedTriangles = 0;
+    uint64_t fullDetailTriangles = 0;
+    // What survived culling on the last frame, to compare the two paths.
+    uint32_t visibleInstances = 0;
+    bool visibleOnGpu = false;
 
-    Mat4 model;
-    mat4_load_identity(&model);
+    // Compute culling and multi-draw indirect need GL 4.3; older contexts
+    // keep the CPU-culled instanced path, as does --cpu-culling.
+    // A driver that fails to build either program falls back the same way,
+    // and the CPU path also covers the frames before the draw program is in.
+    bool gpuDriven = !options.cpuCulling && gpuScene_isSupported();
+    ShaderProgramHandle gpuShaderHandle = SHADER_COMPILER_INVALID_HANDLE;
+    bool gpuShaderBound = false;
+    GpuScene gpuScene = { 0 };
+    if (gpuDriven)
+    {
+        gpuShaderHandle = shaderCompiler_submitShader(shaderCompiler, gpuVertexShaderSource, fragmentShaderSource);
+        gpuScene = createGpuScene(instances, instanceBounds, instanceCount, layout, &cube, &pyramid, &mesh, &shaderCache);
+        if (gpuScene.cullShader.ID == 0)
+        {
+            gpuScene_delete(&gpuScene);
+            gpuDriven = false;
+        }
+    }
 
     while (!window_shouldClose(&window))
     {
-        shader_use(shader);
+        profiler_beginFrame();
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         window_updateDeltaTime(&window);
+        if (frameTimes != NULL && frame > warmupFrames)
+        {
+            frameTimes[measuredFrames++] = window.deltaTime * 1e3f;
+        }
+
+        // T writes the frames still in the profiler history as a trace.
+        if (window_isKeyPressed(&window, GLFW_KEY_T))
+        {
+            if (!tracePressed && profiler_exportTrace(PROFILER_TRACE_PATH))
+            {
+                printf("Wrote %u frames to %s\n", profiler_frameCount(), PROFILER_TRACE_PATH);
+            }
+            tracePressed = true;
+        } else {
+            tracePressed = false;
+        }
 
         if (window_isKeyPressed(&window, GLFW_KEY_E))
         {
@@ -135,7 +857,11 @@ int main()
             lockPressed = false;
         }
 
-        if (camera.locked)
+        if (window.headless)
+        {
+            scriptCamera(&camera, frame);
+        }
+        else if (camera.locked)
         {
             camera_recomputePosition(&camera, &window);
             camera_recomputeRotation(&camera, &window);
@@ -143,23 +869,206 @@ int main()
         }
 
         camera_recomputeMatrix(&camera);
-        shader_setMat4(shader, "cameraMatrix", &camera.matrix);
-        shader_setMat4(shader, "modelMatrix", &model);
+        frustum_extract(&frustum, &camera.matrix);
+        camera_upload(&camera, cameraUBO);
+        const LodView lodView = lodView_create(
+            camera.position,
+            camera.fov,
+            camera.aspectRatio,
+            (float)window.width,
+            LOD_DEFAULT_THRESHOLD,
+            LOD_DEFAULT_HYSTERESIS
+        );
+
+        shaderCompiler_poll(shaderCompiler);
+        textureCache_update(textureCache);
+        if (shaderCompiler_state(shaderCompiler, shaderHandle) == SHADER_PROGRAM_FAILED)
+        {
+            fprintf(stderr, "Failed to create the shader program!\n");
+            window_close(&window);
+        }
+        if (gpuDriven && shaderCompiler_state(shaderCompiler, gpuShaderHandle) == SHADER_PROGRAM_FAILED)
+        {
+            gpuScene_delete(&gpuScene);
+            gpuDriven = false;
+        }
+        Shader* gpuShader = gpuDriven ? acquireShader(shaderCompiler, gpuShaderHandle, &gpuShaderBound) : NULL;
 
-        vao_bind(VAO);
-        glDrawElements(GL_TRIANGLES, sizeof(indices) / sizeof(GLuint), GL_UNSIGNED_INT, NULL);
-        vao_unbind(VAO);
+        if (gpuShader != NULL)
+        {
+            PROFILE_GPU_BEGIN("GPU cull");
+            gpuScene_cull(&gpuScene, &frustum, &lodView);
+            PROFILE_GPU_END();
+            PROFILE_GPU_BEGIN("Draw");
+            useTexture(gpuShader, textureCache, checkerTexture);
+            gpuScene_draw(&gpuScene);
+            PROFILE_GPU_END();
+            if (frame + 1 == options.frames)
+            {
+                visibleInstances = gpuScene_countVisible(&gpuScene);
+                visibleOnGpu = true;
+            }
+        }
+        else
+        {
+            Shader* shader = acquireShader(shaderCompiler, shaderHandle, &shaderBound);
+            shader = shader != NULL ? shader : &fallbackShader;
+            useTexture(shader, textureCache, checkerTexture);
+
+            streamBuffer_beginFrame(&instanceStream);
+            PROFILE_BEGIN("Cull");
+            const size_t visibleCount = bvh_cullFrustum(&bvh, instanceBounds, &frustum, visibleIndices);
+            PROFILE_END();
+            visibleInstances = (uint32_t)visibleCount;
+            visibleOnGpu = false;
+            GLintptr instanceOffset;
+            Instance* streamedInstances = streamBuffer_allocate(
+                &instanceStream,
+                visibleCount * sizeof(Instance),
+                sizeof(GLfloat),
+                &instanceOffset
+            );
+            if (streamedInstances != NULL)
+            {
+                // Bucket the visible instances by level so each level is a
+                // single instanced draw over a contiguous run of the stream.
+                PROFILE_BEGIN("LOD");
+                lod_selectBatch(&lodView, lods, lodCount, instanceBounds, visibleIndices, visibleCount, instanceLevels);
+                uint32_t levelCounts[MESH_MAX_LODS] = { 0 };
+                uint32_t levelOffsets[MESH_MAX_LODS];
+                for (size_t i = 0; i < visibleCount; i++)
+                {
+                    levelCounts[instanceLevels[visibleIndices[i]]]++;
+                }
+                for (uint32_t level = 0, offset = 0; level < lodCount; level++)
+                {
+                    levelOffsets[level] = offset;
+                    offset += levelCounts[level];
+                }
+                for (size_t i = 0; i < visibleCount; i++)
+                {
+                    streamedInstances[levelOffsets[instanceLevels[visibleIndices[i]]]++] = instances[visibleIndices[i]];
+                }
+                streamBuffer_unmap(&instanceStream);
+                PROFILE_END();
+
+                GLintptr levelOffset = instanceOffset;
+                for (uint32_t level = 0; level < lodCount; level++)
+                {
+                    if (levelCounts[level] == 0)
+                    {
+                        continue;
+                    }
+                    vao_bind(lodVAOs[level]);
+                    vao_linkInstanceAffine(instanceStream.ID, 2, sizeof(Instance), (void*)(levelOffset + offsetof(Instance, model)));
+                    vao_linkInstanceAttrib(instanceStream.ID, 6, 3, GL_FLOAT, sizeof(Instance), (void*)(levelOffset + offsetof(Instance, tint)), 1);
+                    levelOffset += (GLintptr)levelCounts[level] * sizeof(Instance);
+
+                    const RenderCommand command =
+                    {
+                        .key = renderKey(RENDER_PASS_OPAQUE, shader->ID, lodVAOs[level], 0, 0),
+                        .program = shader->ID,
+                        .vertexArray = lodVAOs[level],
+                        .mode = GL_TRIANGLES,
+                        .indexType = meshIndexType,
+                        .indexOffset = lods[level].firstIndex * meshIndexSize,
+                        .count = lods[level].indexCount,
+                        .instanceCount = levelCounts[level],
+                    };
+                    renderCommandBuffer_push(renderQueue_getBuffer(&renderQueue, 0), &command);
+                    submittedTriangles += (uint64_t)levelCounts[level] * (lods[level].indexCount / 3);
+                }
+                fullDetailTriangles += (uint64_t)visibleCount * (lods[0].indexCount / 3);
+            }
+
+            PROFILE_BEGIN("Draw");
+            PROFILE_GPU_BEGIN("Draw");
+            renderQueue_sort(&renderQueue);
+            draw_renderQueue(&renderQueue);
+            renderQueue_clear(&renderQueue);
+            PROFILE_GPU_END();
+            PROFILE_END();
+            streamBuffer_endFrame(&instanceStream);
+        }
+
+        frame++;
+        if (frame == options.frames)
+        {
+            if (options.screenshotPath != NULL && window_saveScreenshot(&window, options.screenshotPath))
+            {
+                printf("Wrote frame %u to %s\n", frame, options.screenshotPath);
+            }
+            window_close(&window);
+        }
 
+        PROFILE_BEGIN("Swap");
         window_swapBuffers(&window);
-        glfwPollEvents();
+        PROFILE_END();
+        window_pollEvents(&window);
+        profiler_endFrame();
     }
 
-    vao_delete(&VAO);
+    for (uint32_t i = 0; i < lodCount; i++)
+    {
+        vao_delete(&lodVAOs[i]);
+    }
     vbo_delete(&VBO);
     ebo_delete(&EBO);
+    shaderCompiler_log(shaderCompiler);
+    shaderCache_log(&shaderCache);
+    textureCache_log(textureCache);
+    streamBuffer_log(&instanceStream);
+    renderQueue_log(&renderQueue);
+    if (fullDetailTriangles > 0)
+    {
+        printf(
+            "LOD: %u levels, %.1f%% of full-detail triangles submitted\n",
+            lodCount,
+            100.0 * (double)submittedTriangles / (double)fullDetailTriangles
+        );
+    }
+    glState_log();
+    profiler_log();
+    if (options.frames > 0)
+    {
+        printf("Visible instances on the last frame: %u (%s)\n", visibleInstances, visibleOnGpu ? "GPU-driven" : "CPU-culled");
+    }
+    if (frameTimes != NULL)
+    {
+        logFrameTimes(frameTimes, measuredFrames, options.statsPath);
+        free(frameTimes);
+    }
+    renderQueue_delete(&renderQueue);
+    if (gpuDriven)
+    {
+        gpuArena_log(&gpuScene.arena);
+        gpuScene_delete(&gpuScene);
+    }
+    streamBuffer_delete(&instanceStream);
+
+    bvh_delete(&bvh);
+    free(instances);
+    free(instanceBounds);
+    free(visibleIndices);
+    free(instanceLevels);
+    mesh_unload(&mesh);
+    meshData_free(&cube);
+    meshData_free(&pyramid);
 
-    shader_delete(shader);
+    ubo_delete(&cameraUBO);
+    textureCache_delete(textureCache);
+    shaderCompiler_delete(shaderCompiler);
+    shader_delete(&fallbackShader);
+    profiler_shutdown();
+    if (compilerContext != NULL)
+    {
+        glfwDestroyWindow(compilerContext);
+    }
+    const bool headless = window.headless;
     window_destroy(&window);
-    glfwTerminate();
+    if (!headless)
+    {
+        glfwTerminate();
+    }
     return EXIT_SUCCESS;
 }
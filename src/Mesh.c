@@ -0,0 +1,735 @@
+#include "../include/Mesh.h"
+#include "../include/MeshOptimize.h"
+#include "../include/VertexFormat.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define OBJ_INITIAL_CAPACITY 1024
+
+typedef struct
+{
+    int32_t position;
+    int32_t texcoord;
+    int32_t normal;
+    uint32_t vertex;
+} ObjCorner;
+
+typedef struct
+{
+    float* positions;
+    size_t positionCount;
+    size_t positionCapacity;
+    float* texcoords;
+    size_t texcoordCount;
+    size_t texcoordCapacity;
+    float* normals;
+    size_t normalCount;
+    size_t normalCapacity;
+
+    float* vertices;
+    bool* missingNormals;
+    uint32_t vertexCount;
+    uint32_t vertexCapacity;
+    uint32_t vertexComponents;
+    uint32_t* indices;
+    uint32_t indexCount;
+    uint32_t indexCapacity;
+
+    // Open-addressed map from (position, texcoord, normal) to output vertex,
+    // so shared corners are emitted once.
+    ObjCorner* corners;
+    uint32_t cornerCapacity;
+} ObjParser;
+
+static uint64_t alignOffset(uint64_t offset)
+{
+    return (offset + MESH_FILE_ALIGNMENT - 1) / MESH_FILE_ALIGNMENT * MESH_FILE_ALIGNMENT;
+}
+
+static bool fitsInFile(uint64_t offset, uint64_t size, uint64_t fileSize)
+{
+    return offset % MESH_FILE_ALIGNMENT == 0 && offset <= fileSize && size <= fileSize - offset;
+}
+
+// Every attribute has to lie inside the vertex, or GL would read into the
+// next one or past the end of the buffer.
+static bool mesh_checkAttribs(const MeshFileHeader* header)
+{
+    for (uint32_t i = 0; i < header->attribCount; i++)
+    {
+        const MeshAttrib* attrib = &header->attribs[i];
+        if (attrib->size < 1 || attrib->size > 4 ||
+            (uint64_t)attrib->offset + vertexFormat_attribSize(attrib) > header->vertexStride)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool mesh_checkIndices(const void* indices, uint32_t indexCount, uint32_t indexSize, uint32_t vertexCount)
+{
+    for (uint32_t i = 0; i < indexCount; i++)
+    {
+        const uint32_t index = indexSize == sizeof(uint16_t) ? ((const uint16_t*)indices)[i] : ((const uint32_t*)indices)[i];
+        if (index >= vertexCount)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool mesh_load(Mesh* mesh, const char* path, uint32_t flags)
+{
+    const int file = open(path, O_RDONLY);
+    if (file < 0)
+    {
+        fprintf(stderr, "Failed to open mesh %s!\n", path);
+        return false;
+    }
+
+    struct stat status;
+    if (fstat(file, &status) != 0 || (size_t)status.st_size < sizeof(MeshFileHeader))
+    {
+        fprintf(stderr, "Failed to read mesh %s!\n", path);
+        close(file);
+        return false;
+    }
+
+    const size_t size = (size_t)status.st_size;
+    void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (mapping == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to map mesh %s!\n", path);
+        return false;
+    }
+    madvise(mapping, size, MADV_WILLNEED);
+
+    const MeshFileHeader* header = mapping;
+    const bool valid =
+        header->magic == MESH_FILE_MAGIC &&
+        header->version == MESH_FILE_VERSION &&
+        header->headerSize == sizeof(MeshFileHeader) &&
+        header->fileSize == size &&
+        header->attribCount <= MESH_MAX_ATTRIBS &&
+        header->lodCount <= MESH_MAX_LODS &&
+        (header->indexSize == 2 || header->indexSize == 4) &&
+        fitsInFile(header->vertexOffset, (uint64_t)header->vertexCount * header->vertexStride, size) &&
+        fitsInFile(header->indexOffset, (uint64_t)header->indexCount * header->indexSize, size) &&
+        fitsInFile(header->lodOffset, (uint64_t)header->lodCount * sizeof(MeshLod), size) &&
+        mesh_checkAttribs(header) &&
+        (!(flags & MESH_LOAD_CHECK_INDICES) ||
+            mesh_checkIndices((const char*)mapping + header->indexOffset, header->indexCount, header->indexSize, header->vertexCount));
+    if (!valid)
+    {
+        fprintf(stderr, "Failed to validate mesh %s!\n", path);
+        munmap(mapping, size);
+        return false;
+    }
+
+    const MeshLod* lods = (const MeshLod*)((const char*)mapping + header->lodOffset);
+    for (uint32_t i = 0; i < header->lodCount; i++)
+    {
+        if ((uint64_t)lods[i].firstIndex + lods[i].indexCount > header->indexCount)
+        {
+            fprintf(stderr, "Failed to validate mesh %s!\n", path);
+            munmap(mapping, size);
+            return false;
+        }
+    }
+
+    *mesh = (Mesh)
+    {
+        .header = header,
+        .vertices = (const char*)mapping + header->vertexOffset,
+        .indices = (const char*)mapping + header->indexOffset,
+        .lods = lods,
+        .bounds =
+        {
+            .min = vec3(header->boundsMin[0], header->boundsMin[1], header->boundsMin[2]),
+            .max = vec3(header->boundsMax[0], header->boundsMax[1], header->boundsMax[2]),
+        },
+        .mapping = mapping,
+        .mappingSize = size,
+    };
+    return true;
+}
+
+void mesh_unload(Mesh* mesh)
+{
+    if (mesh->mapping != NULL)
+    {
+        munmap(mesh->mapping, mesh->mappingSize);
+    }
+    *mesh = (Mesh){ 0 };
+}
+
+static void* obj_reserve(void* pointer, size_t* capacity, size_t needed, size_t size)
+{
+    if (needed <= *capacity)
+    {
+        return pointer;
+    }
+    size_t grown = *capacity > 0 ? *capacity : OBJ_INITIAL_CAPACITY;
+    while (grown < needed)
+    {
+        grown *= 2;
+    }
+    void* reserved = realloc(pointer, grown * size);
+    if (reserved == NULL)
+    {
+        fprintf(stderr, "Failed to allocate OBJ data!\n");
+        exit(EXIT_FAILURE);
+    }
+    *capacity = grown;
+    return reserved;
+}
+
+static const char* obj_parseFloats(const char* cursor, float* values, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        char* end;
+        values[i] = strtof(cursor, &end);
+        cursor = end;
+    }
+    return cursor;
+}
+
+static uint32_t obj_hashCorner(int32_t position, int32_t texcoord, int32_t normal)
+{
+    uint32_t hash = (uint32_t)position * 0x9E3779B1u;
+    hash ^= (uint32_t)texcoord * 0x85EBCA77u + (hash << 6) + (hash >> 2);
+    hash ^= (uint32_t)normal * 0xC2B2AE3Du + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+static void obj_growCorners(ObjParser* parser)
+{
+    const uint32_t oldCapacity = parser->cornerCapacity;
+    ObjCorner* oldCorners = parser->corners;
+
+    parser->cornerCapacity = oldCapacity > 0 ? oldCapacity * 2 : OBJ_INITIAL_CAPACITY;
+    parser->corners = malloc(parser->cornerCapacity * sizeof(ObjCorner));
+    if (parser->corners == NULL)
+    {
+        fprintf(stderr, "Failed to allocate OBJ data!\n");
+        exit(EXIT_FAILURE);
+    }
+    for (uint32_t i = 0; i < parser->cornerCapacity; i++)
+    {
+        parser->corners[i].position = -1;
+    }
+
+    const uint32_t mask = parser->cornerCapacity - 1;
+    for (uint32_t i = 0; i < oldCapacity; i++)
+    {
+        const ObjCorner corner = oldCorners[i];
+        if (corner.position < 0)
+        {
+            continue;
+        }
+        uint32_t slot = obj_hashCorner(corner.position, corner.texcoord, corner.normal) & mask;
+        while (parser->corners[slot].position >= 0)
+        {
+            slot = (slot + 1) & mask;
+        }
+        parser->corners[slot] = corner;
+    }
+    free(oldCorners);
+}
+
+static uint32_t obj_emitVertex(ObjParser* parser, int32_t position, int32_t texcoord, int32_t normal)
+{
+    if (2 * (parser->vertexCount + 1) > parser->cornerCapacity)
+    {
+        obj_growCorners(parser);
+    }
+
+    const uint32_t mask = parser->cornerCapacity - 1;
+    uint32_t slot = obj_hashCorner(position, texcoord, normal) & mask;
+    while (parser->corners[slot].position >= 0)
+    {
+        const ObjCorner* corner = &parser->corners[slot];
+        if (corner->position == position && corner->texcoord == texcoord && corner->normal == normal)
+        {
+            return corner->vertex;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    if (parser->vertexCount == parser->vertexCapacity)
+    {
+        parser->vertexCapacity = parser->vertexCapacity > 0 ? parser->vertexCapacity * 2 : OBJ_INITIAL_CAPACITY;
+        parser->vertices = realloc(parser->vertices, (size_t)parser->vertexCapacity * parser->vertexComponents * sizeof(float));
+        parser->missingNormals = realloc(parser->missingNormals, parser->vertexCapacity * sizeof(bool));
+        if (parser->vertices == NULL || parser->missingNormals == NULL)
+        {
+            fprintf(stderr, "Failed to allocate OBJ data!\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    const uint32_t vertex = parser->vertexCount++;
+    float* out = &parser->vertices[(size_t)vertex * parser->vertexComponents];
+    memcpy(out, &parser->positions[3 * position], 3 * sizeof(float));
+    if (normal >= 0)
+    {
+        memcpy(out + 3, &parser->normals[3 * normal], 3 * sizeof(float));
+    }
+    else
+    {
+        out[3] = out[4] = out[5] = 0.f;
+    }
+    parser->missingNormals[vertex] = normal < 0;
+    if (parser->vertexComponents == 8)
+    {
+        out[6] = texcoord >= 0 ? parser->texcoords[2 * texcoord] : 0.f;
+        out[7] = texcoord >= 0 ? parser->texcoords[2 * texcoord + 1] : 0.f;
+    }
+
+    parser->corners[slot] = (ObjCorner){ position, texcoord, normal, vertex };
+    return vertex;
+}
+
+// Resolves a one-based or negative (relative) OBJ index; -1 if absent or out
+// of range.
+static int32_t obj_resolveIndex(long index, size_t count)
+{
+    if (index > 0 && (size_t)index <= count)
+        return (int32_t)(index - 1);
+    if (index < 0 && (size_t)-index <= count)
+        return (int32_t)(count + index);
+    return -1;
+}
+
+static bool obj_parseFace(ObjParser* parser, const char* cursor)
+{
+    uint32_t first = 0;
+    uint32_t previous = 0;
+    uint32_t cornerCount = 0;
+
+    while (true)
+    {
+        while (*cursor == ' ' || *cursor == '\t')
+        {
+            cursor++;
+        }
+        if (*cursor == '\0' || *cursor == '\n' || *cursor == '\r' || *cursor == '#')
+        {
+            break;
+        }
+
+        char* end;
+        const int32_t position = obj_resolveIndex(strtol(cursor, &end, 10), parser->positionCount);
+        if (end == cursor || position < 0)
+        {
+            return false;
+        }
+        cursor = end;
+
+        int32_t texcoord = -1;
+        int32_t normal = -1;
+        if (*cursor == '/')
+        {
+            cursor++;
+            if (*cursor != '/')
+            {
+                texcoord = obj_resolveIndex(strtol(cursor, &end, 10), parser->texcoordCount);
+                if (end == cursor || texcoord < 0)
+                {
+                    return false;
+                }
+                cursor = end;
+            }
+            if (*cursor == '/')
+            {
+                cursor++;
+                normal = obj_resolveIndex(strtol(cursor, &end, 10), parser->normalCount);
+                if (end == cursor || normal < 0)
+                {
+                    return false;
+                }
+                cursor = end;
+            }
+        }
+
+        // Polygons are fanned around their first corner.
+        const uint32_t vertex = obj_emitVertex(parser, position, texcoord, normal);
+        if (cornerCount == 0)
+        {
+            first = vertex;
+        }
+        else if (cornerCount >= 2)
+        {
+            size_t capacity = parser->indexCapacity;
+            parser->indices = obj_reserve(parser->indices, &capacity, parser->indexCount + 3, sizeof(uint32_t));
+            parser->indexCapacity = (uint32_t)capacity;
+            parser->indices[parser->indexCount++] = first;
+            parser->indices[parser->indexCount++] = previous;
+            parser->indices[parser->indexCount++] = vertex;
+        }
+        previous = vertex;
+        cornerCount++;
+    }
+    return cornerCount >= 3;
+}
+
+// Area-weighted smooth normals for every vertex the file gave none.
+static void obj_generateNormals(ObjParser* parser)
+{
+    const uint32_t stride = parser->vertexComponents;
+    for (uint32_t i = 0; i + 2 < parser->indexCount; i += 3)
+    {
+        float* corners[3];
+        for (int j = 0; j < 3; j++)
+        {
+            corners[j] = &parser->vertices[(size_t)parser->indices[i + j] * stride];
+        }
+        const Vec3 a = vec3(corners[0][0], corners[0][1], corners[0][2]);
+        const Vec3 b = vec3(corners[1][0], corners[1][1], corners[1][2]);
+        const Vec3 c = vec3(corners[2][0], corners[2][1], corners[2][2]);
+        const Vec3 normal = vec3_cross(vec3_sub(b, a), vec3_sub(c, a));
+        for (int j = 0; j < 3; j++)
+        {
+            if (parser->missingNormals[parser->indices[i + j]])
+            {
+                corners[j][3] += normal.x;
+                corners[j][4] += normal.y;
+                corners[j][5] += normal.z;
+            }
+        }
+    }
+    for (uint32_t i = 0; i < parser->vertexCount; i++)
+    {
+        float* vertex = &parser->vertices[(size_t)i * stride];
+        const Vec3 normal = vec3(vertex[3], vertex[4], vertex[5]);
+        if (parser->missingNormals[i] && vec3_dot(normal, normal) > 0.f)
+        {
+            const Vec3 unit = vec3_normalize(normal);
+            vertex[3] = unit.x;
+            vertex[4] = unit.y;
+            vertex[5] = unit.z;
+        }
+    }
+}
+
+static void obj_freeParser(ObjParser* parser)
+{
+    free(parser->positions);
+    free(parser->texcoords);
+    free(parser->normals);
+    free(parser->missingNormals);
+    free(parser->corners);
+}
+
+bool meshData_parseObj(MeshData* data, const char* path, bool texcoords)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Failed to open OBJ %s!\n", path);
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    const long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char* text = length >= 0 ? malloc((size_t)length + 1) : NULL;
+    if (text == NULL || fread(text, 1, (size_t)length, file) != (size_t)length)
+    {
+        fprintf(stderr, "Failed to read OBJ %s!\n", path);
+        free(text);
+        fclose(file);
+        return false;
+    }
+    fclose(file);
+    text[length] = '\0';
+
+    ObjParser parser = { .vertexComponents = texcoords ? 8 : 6 };
+    size_t line = 0;
+    bool valid = true;
+    for (const char* cursor = text; *cursor != '\0' && valid;)
+    {
+        line++;
+        while (*cursor == ' ' || *cursor == '\t')
+        {
+            cursor++;
+        }
+
+        if (cursor[0] == 'v' && (cursor[1] == ' ' || cursor[1] == '\t'))
+        {
+            parser.positions = obj_reserve(parser.positions, &parser.positionCapacity, parser.positionCount + 1, 3 * sizeof(float));
+            cursor = obj_parseFloats(cursor + 2, &parser.positions[3 * parser.positionCount++], 3);
+        }
+        else if (cursor[0] == 'v' && cursor[1] == 't' && (cursor[2] == ' ' || cursor[2] == '\t'))
+        {
+            parser.texcoords = obj_reserve(parser.texcoords, &parser.texcoordCapacity, parser.texcoordCount + 1, 2 * sizeof(float));
+            cursor = obj_parseFloats(cursor + 3, &parser.texcoords[2 * parser.texcoordCount++], 2);
+        }
+        else if (cursor[0] == 'v' && cursor[1] == 'n' && (cursor[2] == ' ' || cursor[2] == '\t'))
+        {
+            parser.normals = obj_reserve(parser.normals, &parser.normalCapacity, parser.normalCount + 1, 3 * sizeof(float));
+            cursor = obj_parseFloats(cursor + 3, &parser.normals[3 * parser.normalCount++], 3);
+        }
+        else if (cursor[0] == 'f' && (cursor[1] == ' ' || cursor[1] == '\t'))
+        {
+            valid = obj_parseFace(&parser, cursor + 2);
+        }
+
+        cursor = strchr(cursor, '\n');
+        if (cursor == NULL)
+            break;
+        cursor++;
+    }
+    free(text);
+
+    if (!valid || parser.indexCount == 0)
+    {
+        if (!valid)
+            fprintf(stderr, "Failed to parse OBJ %s at line %zu!\n", path, line);
+        else
+            fprintf(stderr, "Failed to find faces in OBJ %s!\n", path);
+        obj_freeParser(&parser);
+        free(parser.vertices);
+        free(parser.indices);
+        return false;
+    }
+    obj_generateNormals(&parser);
+
+    *data = (MeshData)
+    {
+        .vertices = parser.vertices,
+        .vertexCount = parser.vertexCount,
+        .vertexStride = parser.vertexComponents * sizeof(float),
+        .indices = parser.indices,
+        .indexCount = parser.indexCount,
+        .indexSize = sizeof(uint32_t),
+        .attribs =
+        {
+            { 0, 3, MESH_TYPE_FLOAT, 0, 0 },
+            { 1, 3, MESH_TYPE_FLOAT, 0, 3 * sizeof(float) },
+            { 2, 2, MESH_TYPE_FLOAT, 0, 6 * sizeof(float) },
+        },
+        .attribCount = texcoords ? 3 : 2,
+        .lods = { { 0, parser.indexCount, 0.f, 0 } },
+        .lodCount = 1,
+    };
+    obj_freeParser(&parser);
+    meshData_computeBounds(data);
+    return true;
+}
+
+void meshData_computeBounds(MeshData* data)
+{
+    // Positions are always the first three floats of a vertex.
+    Aabb bounds = { vec3(0.f, 0.f, 0.f), vec3(0.f, 0.f, 0.f) };
+    for (uint32_t i = 0; i < data->vertexCount; i++)
+    {
+        const float* position = (const float*)((const char*)data->vertices + (size_t)i * data->vertexStride);
+        if (i == 0)
+        {
+            bounds.min = bounds.max = vec3(position[0], position[1], position[2]);
+            continue;
+        }
+        bounds.min.x = position[0] < bounds.min.x ? position[0] : bounds.min.x;
+        bounds.min.y = position[1] < bounds.min.y ? position[1] : bounds.min.y;
+        bounds.min.z = position[2] < bounds.min.z ? position[2] : bounds.min.z;
+        bounds.max.x = position[0] > bounds.max.x ? position[0] : bounds.max.x;
+        bounds.max.y = position[1] > bounds.max.y ? position[1] : bounds.max.y;
+        bounds.max.z = position[2] > bounds.max.z ? position[2] : bounds.max.z;
+    }
+    data->bounds = bounds;
+}
+
+// Reorders each LOD's triangles for the post-transform cache, then the
+// vertices for fetch locality. Expects 32-bit indices.
+void meshData_optimize(MeshData* data)
+{
+    if (data->indexSize != sizeof(uint32_t))
+    {
+        return;
+    }
+
+    uint32_t* indices = data->indices;
+    uint32_t* reordered = malloc((size_t)data->indexCount * sizeof(uint32_t));
+    void* vertices = malloc((size_t)data->vertexCount * data->vertexStride);
+    if (reordered == NULL || vertices == NULL)
+    {
+        fprintf(stderr, "Failed to allocate mesh optimization buffers!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(reordered, indices, (size_t)data->indexCount * sizeof(uint32_t));
+    for (uint32_t i = 0; i < data->lodCount; i++)
+    {
+        const MeshLod* lod = &data->lods[i];
+        meshOptimize_vertexCache(&reordered[lod->firstIndex], &indices[lod->firstIndex], lod->indexCount, data->vertexCount);
+    }
+    data->vertexCount = meshOptimize_vertexFetch(vertices, reordered, data->indexCount, data->vertices, data->vertexCount, data->vertexStride);
+
+    free(data->indices);
+    free(data->vertices);
+    data->indices = reordered;
+    data->vertices = vertices;
+}
+
+// Appends up to levelCount - 1 simplified index ranges after LOD 0, each
+// aiming for ratio times the triangles of the one before. Every level is
+// simplified from the full mesh so errors do not compound, and all of them
+// share the vertex buffer. Stops early once a level no longer shrinks.
+// Expects 32-bit indices and float positions at location 0.
+uint32_t meshData_generateLods(MeshData* data, uint32_t levelCount, float ratio)
+{
+    const MeshAttrib* position = &data->attribs[0];
+    if (data->indexSize != sizeof(uint32_t) || position->location != 0 || position->type != MESH_TYPE_FLOAT || position->size < 3)
+    {
+        fprintf(stderr, "Failed to generate LODs: expected 32-bit indices and float positions!\n");
+        return data->lodCount;
+    }
+    levelCount = levelCount < MESH_MAX_LODS ? levelCount : MESH_MAX_LODS;
+
+    const uint32_t baseCount = data->lods[0].indexCount;
+    uint32_t* levels = malloc((size_t)baseCount * levelCount * sizeof(uint32_t));
+    if (levels == NULL)
+    {
+        fprintf(stderr, "Failed to allocate mesh LODs!\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(levels, (uint32_t*)data->indices + data->lods[0].firstIndex, (size_t)baseCount * sizeof(uint32_t));
+
+    const float* positions = (const float*)((const char*)data->vertices + position->offset);
+    uint32_t lodCount = 1;
+    uint32_t indexCount = baseCount;
+    size_t targetCount = baseCount;
+    for (uint32_t level = 1; level < levelCount; level++)
+    {
+        targetCount = (size_t)((float)targetCount * ratio) / 3 * 3;
+        float error = 0.f;
+        const size_t count = meshOptimize_simplify(
+            &levels[indexCount], levels, baseCount,
+            positions, data->vertexCount, data->vertexStride,
+            targetCount, &error
+        );
+        if (count == 0 || count >= data->lods[lodCount - 1].indexCount)
+        {
+            break;
+        }
+        data->lods[lodCount++] = (MeshLod){ indexCount, (uint32_t)count, error, 0 };
+        indexCount += (uint32_t)count;
+    }
+
+    free(data->indices);
+    data->indices = levels;
+    data->indexCount = indexCount;
+    data->lods[0].firstIndex = 0;
+    data->lodCount = lodCount;
+    return lodCount;
+}
+
+void meshData_convert(MeshData* data, const MeshAttrib* attribs, uint32_t attribCount, uint32_t stride)
+{
+    void* vertices = malloc((size_t)data->vertexCount * stride);
+    if (vertices == NULL)
+    {
+        fprintf(stderr, "Failed to allocate converted vertices!\n");
+        exit(EXIT_FAILURE);
+    }
+    vertexFormat_convert(
+        vertices, attribs, attribCount, stride,
+        data->vertices, data->attribs, data->attribCount, data->vertexStride,
+        data->vertexCount
+    );
+
+    free(data->vertices);
+    data->vertices = vertices;
+    data->vertexStride = stride;
+    memset(data->attribs, 0, sizeof(data->attribs));
+    memcpy(data->attribs, attribs, attribCount * sizeof(MeshAttrib));
+    data->attribCount = attribCount;
+}
+
+// Switches to 16-bit indices when every index fits.
+bool meshData_narrowIndices(MeshData* data)
+{
+    if (data->indexSize != sizeof(uint32_t) || data->vertexCount > UINT16_MAX + 1u)
+    {
+        return false;
+    }
+    uint16_t* narrowed = malloc((size_t)data->indexCount * sizeof(uint16_t));
+    if (narrowed == NULL || !vertexFormat_narrowIndices(narrowed, data->indices, data->indexCount))
+    {
+        free(narrowed);
+        return false;
+    }
+    free(data->indices);
+    data->indices = narrowed;
+    data->indexSize = sizeof(uint16_t);
+    return true;
+}
+
+static bool writePadded(FILE* file, const void* data, size_t size, uint64_t paddedSize)
+{
+    static const char zeros[MESH_FILE_ALIGNMENT] = { 0 };
+    return fwrite(data, 1, size, file) == size &&
+        fwrite(zeros, 1, (size_t)(paddedSize - size), file) == paddedSize - size;
+}
+
+bool meshData_save(const MeshData* data, const char* path)
+{
+    const uint64_t vertexBytes = (uint64_t)data->vertexCount * data->vertexStride;
+    const uint64_t indexBytes = (uint64_t)data->indexCount * data->indexSize;
+
+    MeshFileHeader header =
+    {
+        .magic = MESH_FILE_MAGIC,
+        .version = MESH_FILE_VERSION,
+        .headerSize = sizeof(MeshFileHeader),
+        .flags = 0,
+        .vertexCount = data->vertexCount,
+        .vertexStride = data->vertexStride,
+        .indexCount = data->indexCount,
+        .indexSize = data->indexSize,
+        .attribCount = data->attribCount,
+        .lodCount = data->lodCount,
+        .boundsMin = { data->bounds.min.x, data->bounds.min.y, data->bounds.min.z },
+        .boundsMax = { data->bounds.max.x, data->bounds.max.y, data->bounds.max.z },
+    };
+    header.vertexOffset = alignOffset(sizeof(MeshFileHeader));
+    header.indexOffset = alignOffset(header.vertexOffset + vertexBytes);
+    header.lodOffset = alignOffset(header.indexOffset + indexBytes);
+    header.fileSize = header.lodOffset + data->lodCount * sizeof(MeshLod);
+    memcpy(header.attribs, data->attribs, sizeof(header.attribs));
+
+    FILE* file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Failed to create mesh %s!\n", path);
+        return false;
+    }
+    const bool written =
+        writePadded(file, &header, sizeof(header), header.vertexOffset) &&
+        writePadded(file, data->vertices, vertexBytes, header.indexOffset - header.vertexOffset) &&
+        writePadded(file, data->indices, indexBytes, header.lodOffset - header.indexOffset) &&
+        fwrite(data->lods, sizeof(MeshLod), data->lodCount, file) == data->lodCount;
+    if (fclose(file) != 0 || !written)
+    {
+        fprintf(stderr, "Failed to write mesh %s!\n", path);
+        return false;
+    }
+    return true;
+}
+
+void meshData_free(MeshData* data)
+{
+    free(data->vertices);
+    free(data->indices);
+    *data = (MeshData){ 0 };
+}
@@ -0,0 +1,600 @@
+#include "../include/MeshOptimize.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FORSYTH_VALENCE_TABLE_SIZE 64
+#define FORSYTH_NONE UINT32_MAX
+
+// Scoring constants from Tom Forsyth's "Linear-Speed Vertex Cache
+// Optimisation": recently used vertices score higher, the three just emitted
+// slightly less so strips do not run away, and vertices with few triangles
+// left are boosted so they get finished off.
+#define FORSYTH_CACHE_DECAY_POWER   1.5f
+#define FORSYTH_LAST_TRIANGLE_SCORE 0.75f
+#define FORSYTH_VALENCE_BOOST_SCALE 2.f
+#define FORSYTH_VALENCE_BOOST_POWER 0.5f
+
+typedef struct
+{
+    float cache[MESH_OPTIMIZE_CACHE_SIZE];
+    float valence[FORSYTH_VALENCE_TABLE_SIZE];
+} ForsythTables;
+
+static void* meshOptimize_allocate(size_t count, size_t size)
+{
+    void* pointer = calloc(count > 0 ? count : 1, size);
+    if (pointer == NULL)
+    {
+        fprintf(stderr, "Failed to allocate mesh optimization data!\n");
+        exit(EXIT_FAILURE);
+    }
+    return pointer;
+}
+
+static void forsyth_buildTables(ForsythTables* tables)
+{
+    for (int i = 0; i < MESH_OPTIMIZE_CACHE_SIZE; i++)
+    {
+        tables->cache[i] = i < 3
+            ? FORSYTH_LAST_TRIANGLE_SCORE
+            : powf(1.f - (float)(i - 3) / (MESH_OPTIMIZE_CACHE_SIZE - 3), FORSYTH_CACHE_DECAY_POWER);
+    }
+    tables->valence[0] = 0.f;
+    for (int i = 1; i < FORSYTH_VALENCE_TABLE_SIZE; i++)
+    {
+        tables->valence[i] = FORSYTH_VALENCE_BOOST_SCALE * powf((float)i, -FORSYTH_VALENCE_BOOST_POWER);
+    }
+}
+
+static float forsyth_score(const ForsythTables* tables, int32_t cachePosition, uint32_t remaining)
+{
+    if (remaining == 0)
+    {
+        return -1.f;
+    }
+    const float cacheScore = cachePosition >= 0 ? tables->cache[cachePosition] : 0.f;
+    const float valenceScore = remaining < FORSYTH_VALENCE_TABLE_SIZE
+        ? tables->valence[remaining]
+        : FORSYTH_VALENCE_BOOST_SCALE * powf((float)remaining, -FORSYTH_VALENCE_BOOST_POWER);
+    return cacheScore + valenceScore;
+}
+
+void meshOptimize_vertexCache(uint32_t* target, const uint32_t* indices, size_t indexCount, uint32_t vertexCount)
+{
+    const size_t triangleCount = indexCount / 3;
+    ForsythTables tables;
+    forsyth_buildTables(&tables);
+
+    // Per-vertex lists of triangles not yet emitted; the live part of each
+    // list is its first remaining[v] entries.
+    uint32_t* remaining = meshOptimize_allocate(vertexCount, sizeof(uint32_t));
+    uint32_t* offsets = meshOptimize_allocate((size_t)vertexCount + 1, sizeof(uint32_t));
+    uint32_t* adjacency = meshOptimize_allocate(triangleCount * 3, sizeof(uint32_t));
+    for (size_t i = 0; i < triangleCount * 3; i++)
+    {
+        remaining[indices[i]]++;
+    }
+    for (uint32_t v = 0; v < vertexCount; v++)
+    {
+        offsets[v + 1] = offsets[v] + remaining[v];
+        remaining[v] = 0;
+    }
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            const uint32_t v = indices[3 * t + k];
+            adjacency[offsets[v] + remaining[v]++] = (uint32_t)t;
+        }
+    }
+
+    int32_t* cachePosition = meshOptimize_allocate(vertexCount, sizeof(int32_t));
+    float* vertexScore = meshOptimize_allocate(vertexCount, sizeof(float));
+    float* triangleScore = meshOptimize_allocate(triangleCount, sizeof(float));
+    bool* emitted = meshOptimize_allocate(triangleCount, sizeof(bool));
+    for (uint32_t v = 0; v < vertexCount; v++)
+    {
+        cachePosition[v] = -1;
+        vertexScore[v] = forsyth_score(&tables, -1, remaining[v]);
+    }
+
+    uint32_t best = FORSYTH_NONE;
+    float bestScore = -1.f;
+    for (size_t t = 0; t < triangleCount; t++)
+    {
+        triangleScore[t] = vertexScore[indices[3 * t]] + vertexScore[indices[3 * t + 1]] + vertexScore[indices[3 * t + 2]];
+        if (triangleScore[t] > bestScore)
+        {
+            best = (uint32_t)t;
+            bestScore = triangleScore[t];
+        }
+    }
+
+    uint32_t cache[MESH_OPTIMIZE_CACHE_SIZE + 3];
+    uint32_t nextCache[MESH_OPTIMIZE_CACHE_SIZE + 3];
+    uint32_t cacheCount = 0;
+    size_t scan = 0;
+
+    for (size_t out = 0; out < triangleCount; out++)
+    {
+        // Nothing left touching the cache: restart from any unemitted triangle.
+        if (best == FORSYTH_NONE)
+        {
+            while (emitted[scan])
+            {
+                scan++;
+            }
+            best = (uint32_t)scan;
+        }
+
+        const uint32_t* triangle = &indices[3 * (size_t)best];
+        memcpy(&target[3 * out], triangle, 3 * sizeof(uint32_t));
+        emitted[best] = true;
+
+        uint32_t nextCount = 0;
+        for (int k = 0; k < 3; k++)
+        {
+            const uint32_t v = triangle[k];
+            uint32_t* list = &adjacency[offsets[v]];
+            for (uint32_t i = 0; i < remaining[v]; i++)
+            {
+                if (list[i] == best)
+                {
+                    list[i] = list[--remaining[v]];
+                    break;
+                }
+            }
+
+            bool cached = false;
+            for (uint32_t i = 0; i < nextCount; i++)
+            {
+                cached |= nextCache[i] == v;
+            }
+            if (!cached)
+            {
+                nextCache[nextCount++] = v;
+            }
+        }
+        for (uint32_t i = 0; i < cacheCount; i++)
+        {
+            const uint32_t v = cache[i];
+            if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+            {
+                nextCache[nextCount++] = v;
+            }
+        }
+
+        // Rescore every vertex whose cache slot changed, including the ones
+        // just pushed out, and move their triangles' scores by the difference.
+        for (uint32_t i = 0; i < nextCount; i++)
+        {
+            const uint32_t v = nextCache[i];
+            cachePosition[v] = i < MESH_OPTIMIZE_CACHE_SIZE ? (int32_t)i : -1;
+            const float score = forsyth_score(&tables, cachePosition[v], remaining[v]);
+            const float difference = score - vertexScore[v];
+            vertexScore[v] = score;
+            const uint32_t* list = &adjacency[offsets[v]];
+            for (uint32_t j = 0; j < remaining[v]; j++)
+            {
+                triangleScore[list[j]] += difference;
+            }
+        }
+
+        cacheCount = nextCount < MESH_OPTIMIZE_CACHE_SIZE ? nextCount : MESH_OPTIMIZE_CACHE_SIZE;
+        memcpy(cache, nextCache, cacheCount * sizeof(uint32_t));
+
+        best = FORSYTH_NONE;
+        bestScore = -1.f;
+        for (uint32_t i = 0; i < cacheCount; i++)
+        {
+            const uint32_t v = cache[i];
+            const uint32_t* list = &adjacency[offsets[v]];
+            for (uint32_t j = 0; j < remaining[v]; j++)
+            {
+                if (triangleScore[list[j]] > bestScore)
+                {
+                    best = list[j];
+                    bestScore = triangleScore[list[j]];
+                }
+            }
+        }
+    }
+
+    free(remaining);
+    free(offsets);
+    free(adjacency);
+    free(cachePosition);
+    free(vertexScore);
+    free(triangleScore);
+    free(emitted);
+}
+
+// Renumbers vertices in first-use order so fetches walk memory forwards.
+// Unreferenced vertices are dropped; returns the new vertex count.
+uint32_t meshOptimize_vertexFetch(void* targetVertices, uint32_t* indices, size_t indexCount, const void* vertices, uint32_t vertexCount, uint32_t stride)
+{
+    uint32_t* remap = meshOptimize_allocate(vertexCount, sizeof(uint32_t));
+    memset(remap, 0xFF, (size_t)vertexCount * sizeof(uint32_t));
+
+    uint32_t next = 0;
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        const uint32_t v = indices[i];
+        if (remap[v] == UINT32_MAX)
+        {
+            memcpy((char*)targetVertices + (size_t)next * stride, (const char*)vertices + (size_t)v * stride, stride);
+            remap[v] = next++;
+        }
+        indices[i] = remap[v];
+    }
+
+    free(remap);
+    return next;
+}
+
+// Average cache miss ratio: vertex shader invocations per triangle for a
+// FIFO post-transform cache. 0.5 is the floor for a regular grid, 3 means
+// no reuse at all.
+float meshOptimize_acmr(const uint32_t* indices, size_t indexCount, uint32_t vertexCount, uint32_t cacheSize)
+{
+    if (indexCount < 3)
+    {
+        return 0.f;
+    }
+
+    uint32_t* insertedAt = meshOptimize_allocate(vertexCount, sizeof(uint32_t));
+    uint32_t time = cacheSize + 1;
+    size_t misses = 0;
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        const uint32_t v = indices[i];
+        if (time - insertedAt[v] > cacheSize)
+        {
+            insertedAt[v] = time++;
+            misses++;
+        }
+    }
+
+    free(insertedAt);
+    return (float)misses / (float)(indexCount / 3);
+}
+
+typedef struct
+{
+    float a00, a11, a22;
+    float a01, a02, a12;
+    float b0, b1, b2;
+    float c;
+    float weight;
+} Quadric;
+
+typedef struct
+{
+    uint32_t vertex;
+    uint32_t target;
+    float cost;
+} Collapse;
+
+static const float* simplify_position(const float* positions, size_t stride, uint32_t vertex)
+{
+    return (const float*)((const char*)positions + (size_t)vertex * stride);
+}
+
+static void quadric_add(Quadric* quadric, const Quadric* other)
+{
+    quadric->a00 += other->a00;
+    quadric->a11 += other->a11;
+    quadric->a22 += other->a22;
+    quadric->a01 += other->a01;
+    quadric->a02 += other->a02;
+    quadric->a12 += other->a12;
+    quadric->b0 += other->b0;
+    quadric->b1 += other->b1;
+    quadric->b2 += other->b2;
+    quadric->c += other->c;
+    quadric->weight += other->weight;
+}
+
+// Area-weighted squared distance to the plane through the triangle.
+static Quadric quadric_fromTriangle(const float* p0, const float* p1, const float* p2)
+{
+    const float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+    const float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+    float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+    const float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    if (length <= 0.f)
+    {
+        return (Quadric){ 0 };
+    }
+    n[0] /= length;
+    n[1] /= length;
+    n[2] /= length;
+    const float d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+    const float w = 0.5f * length;
+    return (Quadric)
+    {
+        w * n[0] * n[0], w * n[1] * n[1], w * n[2] * n[2],
+        w * n[0] * n[1], w * n[0] * n[2], w * n[1] * n[2],
+        w * n[0] * d, w * n[1] * d, w * n[2] * d,
+        w * d * d,
+        w,
+    };
+}
+
+static float quadric_error(const Quadric* q, const float* p)
+{
+    const float x = p[0], y = p[1], z = p[2];
+    const float error =
+        q->a00 * x * x + q->a11 * y * y + q->a22 * z * z +
+        2.f * (q->a01 * x * y + q->a02 * x * z + q->a12 * y * z) +
+        2.f * (q->b0 * x + q->b1 * y + q->b2 * z) +
+        q->c;
+    return q->weight > 0.f ? fabsf(error) / q->weight : 0.f;
+}
+
+static void simplify_normal(const float* a, const float* b, const float* c, float* normal)
+{
+    const float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+    const float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+    normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+// Moving vertex onto target must not turn any surviving triangle around it
+// upside down.
+static bool simplify_flips(const uint32_t* indices, const uint32_t* triangles, uint32_t triangleCount, const float* positions, size_t stride, uint32_t vertex, uint32_t target)
+{
+    const float* moved = simplify_position(positions, stride, target);
+    for (uint32_t i = 0; i < triangleCount; i++)
+    {
+        const uint32_t* triangle = &indices[3 * (size_t)triangles[i]];
+        if (triangle[0] == target || triangle[1] == target || triangle[2] == target)
+        {
+            continue;
+        }
+        const float* before[3];
+        const float* after[3];
+        for (int k = 0; k < 3; k++)
+        {
+            before[k] = simplify_position(positions, stride, triangle[k]);
+            after[k] = triangle[k] == vertex ? moved : before[k];
+        }
+        float normalBefore[3];
+        float normalAfter[3];
+        simplify_normal(before[0], before[1], before[2], normalBefore);
+        simplify_normal(after[0], after[1], after[2], normalAfter);
+        const float dot = normalBefore[0] * normalAfter[0] + normalBefore[1] * normalAfter[1] + normalBefore[2] * normalAfter[2];
+        if (dot <= 0.f)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int simplify_compareCollapses(const void* a, const void* b)
+{
+    const float costA = ((const Collapse*)a)->cost;
+    const float costB = ((const Collapse*)b)->cost;
+    return (costA > costB) - (costA < costB);
+}
+
+// Vertices on a border of the index topology stay put. That covers open
+// boundaries and attribute seams, where split vertices share a position, so
+// LODs cannot open cracks.
+static void simplify_lockBorders(bool* locked, const uint32_t* indices, size_t indexCount, uint32_t vertexCount)
+{
+    uint32_t* counts = meshOptimize_allocate((size_t)vertexCount + 1, sizeof(uint32_t));
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        counts[indices[i] + 1]++;
+    }
+    for (uint32_t v = 0; v < vertexCount; v++)
+    {
+        counts[v + 1] += counts[v];
+    }
+
+    // Outgoing half-edges grouped by their start vertex.
+    uint32_t* ends = meshOptimize_allocate(indexCount, sizeof(uint32_t));
+    uint32_t* fill = meshOptimize_allocate(vertexCount, sizeof(uint32_t));
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        const uint32_t start = indices[i];
+        const uint32_t end = indices[i - i % 3 + (i % 3 + 1) % 3];
+        ends[counts[start] + fill[start]++] = end;
+    }
+
+    for (uint32_t start = 0; start < vertexCount; start++)
+    {
+        for (uint32_t i = counts[start]; i < counts[start + 1]; i++)
+        {
+            const uint32_t end = ends[i];
+            bool twin = false;
+            for (uint32_t j = counts[end]; j < counts[end + 1] && !twin; j++)
+            {
+                twin = ends[j] == start;
+            }
+            if (!twin)
+            {
+                locked[start] = true;
+                locked[end] = true;
+            }
+        }
+    }
+
+    free(counts);
+    free(ends);
+    free(fill);
+}
+
+// Quadric error edge collapse after Garland and Heckbert, collapsing each
+// vertex onto a neighbour so the simplified indices keep using the original
+// vertex buffer. Runs in passes of independent collapses, cheapest first,
+// until the triangle budget is met or nothing more can go. Returns the new
+// index count and, through error, the largest collapse error in position
+// units.
+size_t meshOptimize_simplify(
+    uint32_t* target, const uint32_t* indices, size_t indexCount,
+    const float* positions, uint32_t vertexCount, size_t positionStride,
+    size_t targetIndexCount, float* error)
+{
+    memcpy(target, indices, indexCount * sizeof(uint32_t));
+    size_t count = indexCount - indexCount % 3;
+    float maxError = 0.f;
+
+    Quadric* quadrics = meshOptimize_allocate(vertexCount, sizeof(Quadric));
+    for (size_t i = 0; i < count; i += 3)
+    {
+        const Quadric quadric = quadric_fromTriangle(
+            simplify_position(positions, positionStride, target[i]),
+            simplify_position(positions, positionStride, target[i + 1]),
+            simplify_position(positions, positionStride, target[i + 2])
+        );
+        for (int k = 0; k < 3; k++)
+        {
+            quadric_add(&quadrics[target[i + k]], &quadric);
+        }
+    }
+
+    bool* locked = meshOptimize_allocate(vertexCount, sizeof(bool));
+    simplify_lockBorders(locked, target, count, vertexCount);
+
+    uint32_t* offsets = meshOptimize_allocate((size_t)vertexCount + 1, sizeof(uint32_t));
+    uint32_t* adjacency = meshOptimize_allocate(count, sizeof(uint32_t));
+    uint32_t* fill = meshOptimize_allocate(vertexCount, sizeof(uint32_t));
+    Collapse* collapses = meshOptimize_allocate(vertexCount, sizeof(Collapse));
+    uint32_t* remap = meshOptimize_allocate(vertexCount, sizeof(uint32_t));
+    bool* touched = meshOptimize_allocate(vertexCount, sizeof(bool));
+
+    while (count > targetIndexCount)
+    {
+        memset(offsets, 0, ((size_t)vertexCount + 1) * sizeof(uint32_t));
+        memset(fill, 0, (size_t)vertexCount * sizeof(uint32_t));
+        for (size_t i = 0; i < count; i++)
+        {
+            offsets[target[i] + 1]++;
+        }
+        for (uint32_t v = 0; v < vertexCount; v++)
+        {
+            offsets[v + 1] += offsets[v];
+        }
+        for (size_t i = 0; i < count; i++)
+        {
+            adjacency[offsets[target[i]] + fill[target[i]]++] = (uint32_t)(i / 3);
+        }
+
+        // Cheapest collapse per vertex along any of its edges.
+        uint32_t collapseCount = 0;
+        for (uint32_t v = 0; v < vertexCount; v++)
+        {
+            if (locked[v] || offsets[v] == offsets[v + 1])
+            {
+                continue;
+            }
+            Collapse best = { v, v, INFINITY };
+            for (uint32_t i = offsets[v]; i < offsets[v + 1]; i++)
+            {
+                const uint32_t* triangle = &target[3 * (size_t)adjacency[i]];
+                for (int k = 0; k < 3; k++)
+                {
+                    const uint32_t other = triangle[k];
+                    if (other == v)
+                    {
+                        continue;
+                    }
+                    Quadric merged = quadrics[v];
+                    quadric_add(&merged, &quadrics[other]);
+                    const float cost = quadric_error(&merged, simplify_position(positions, positionStride, other));
+                    if (cost < best.cost)
+                    {
+                        best = (Collapse){ v, other, cost };
+                    }
+                }
+            }
+            if (best.target != v)
+            {
+                collapses[collapseCount++] = best;
+            }
+        }
+        if (collapseCount == 0)
+        {
+            break;
+        }
+        qsort(collapses, collapseCount, sizeof(Collapse), simplify_compareCollapses);
+
+        // Each collapse removes about two triangles; stop once the budget is
+        // met so the error stays as low as possible.
+        const size_t needed = (count - targetIndexCount) / 6 + 1;
+        size_t applied = 0;
+        for (uint32_t v = 0; v < vertexCount; v++)
+        {
+            remap[v] = v;
+        }
+        memset(touched, 0, (size_t)vertexCount * sizeof(bool));
+        for (uint32_t i = 0; i < collapseCount && applied < needed; i++)
+        {
+            const Collapse collapse = collapses[i];
+            if (touched[collapse.vertex] || touched[collapse.target])
+            {
+                continue;
+            }
+            const uint32_t first = offsets[collapse.vertex];
+            const uint32_t triangleCount = offsets[collapse.vertex + 1] - first;
+            if (simplify_flips(target, &adjacency[first], triangleCount, positions, positionStride, collapse.vertex, collapse.target))
+            {
+                continue;
+            }
+
+            // Neighbours are frozen for the rest of the pass, so no two
+            // collapses edit the same triangle.
+            for (uint32_t j = 0; j < triangleCount; j++)
+            {
+                const uint32_t* triangle = &target[3 * (size_t)adjacency[first + j]];
+                touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+            }
+            remap[collapse.vertex] = collapse.target;
+            quadric_add(&quadrics[collapse.target], &quadrics[collapse.vertex]);
+            maxError = collapse.cost > maxError ? collapse.cost : maxError;
+            applied++;
+        }
+        if (applied == 0)
+        {
+            break;
+        }
+
+        size_t write = 0;
+        for (size_t i = 0; i < count; i += 3)
+        {
+            const uint32_t a = remap[target[i]];
+            const uint32_t b = remap[target[i + 1]];
+            const uint32_t c = remap[target[i + 2]];
+            if (a != b && b != c && a != c)
+            {
+                target[write++] = a;
+                target[write++] = b;
+                target[write++] = c;
+            }
+        }
+        count = write;
+    }
+
+    free(quadrics);
+    free(locked);
+    free(offsets);
+    free(adjacency);
+    free(fill);
+    free(collapses);
+    free(remap);
+    free(touched);
+
+    if (error != NULL)
+    {
+        *error = sqrtf(maxError);
+    }
+    return count;
+}
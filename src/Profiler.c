@@ -0,0 +1,624 @@
+#include "../include/Profiler.h"
+#include "../include/GLState.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define PROFILER_GPU_THREAD   PROFILER_MAX_THREADS
+#define PROFILER_FRAME_THREAD (PROFILER_MAX_THREADS + 1)
+#define PROFILER_NO_ZONE      UINT32_MAX
+
+typedef struct
+{
+    const char* name;
+    uint64_t start;
+} ProfilerOpenZone;
+
+// Events are written only by the owning thread and read only by
+// profiler_endFrame, so the ring needs no lock: the writer publishes with a
+// release store of head, the reader hands slots back with one of tail.
+typedef struct
+{
+    ProfilerEvent events[PROFILER_RING_SIZE];
+    atomic_uint_fast64_t head;
+    atomic_uint_fast64_t tail;
+    atomic_uint_fast64_t dropped;
+    _Atomic(const char*) name;
+    ProfilerOpenZone stack[PROFILER_MAX_DEPTH];
+    uint32_t depth;
+    uint32_t index;
+} ProfilerThread;
+
+// Queries for one frame. A slot is read back PROFILER_GPU_FRAMES frames
+// later, when it is reused, and only if the results are already there.
+typedef struct
+{
+    GLuint timestamps[PROFILER_MAX_GPU_ZONES * 2];
+    const char* names[PROFILER_MAX_GPU_ZONES];
+    uint32_t depths[PROFILER_MAX_GPU_ZONES];
+    uint32_t count;
+    GLuint elapsed;
+    uint64_t frame;
+    bool pending;
+} ProfilerGpuFrame;
+
+typedef struct
+{
+    atomic_bool enabled;
+    bool initialized;
+    bool gpuSupported;
+    uint64_t baseTime;
+    int64_t gpuOffset;
+
+    _Atomic(ProfilerThread*) threads[PROFILER_MAX_THREADS];
+    atomic_uint threadCount;
+
+    ProfilerGpuFrame gpuFrames[PROFILER_GPU_FRAMES];
+    uint32_t gpuStack[PROFILER_MAX_DEPTH];
+    uint32_t gpuDepth;
+    bool gpuFrameOpen;
+    uint64_t gpuDropped;
+
+    ProfilerFrame frames[PROFILER_HISTORY_FRAMES];
+    uint64_t frameCount;
+    uint64_t frameStart;
+    bool frameOpen;
+    uint64_t stateChanges;
+
+    ProfilerEvent* history;
+    uint64_t historyHead;
+} Profiler;
+
+ProfilerCounters profilerCounters;
+
+static Profiler profiler;
+static _Thread_local ProfilerThread* profilerThread;
+static _Thread_local bool profilerThreadRejected;
+
+static uint64_t profiler_now(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t)time.tv_sec * 1000000000ull + (uint64_t)time.tv_nsec;
+}
+
+// Threads claim a ring the first time they open a zone. Past
+// PROFILER_MAX_THREADS they are simply not profiled.
+static ProfilerThread* profiler_thread(void)
+{
+    if (profilerThread != NULL || profilerThreadRejected)
+    {
+        return profilerThread;
+    }
+    const uint32_t index = atomic_fetch_add(&profiler.threadCount, 1);
+    ProfilerThread* thread = index < PROFILER_MAX_THREADS ? calloc(1, sizeof(ProfilerThread)) : NULL;
+    if (thread == NULL)
+    {
+        profilerThreadRejected = true;
+        return NULL;
+    }
+    thread->index = index;
+    atomic_store_explicit(&profiler.threads[index], thread, memory_order_release);
+    profilerThread = thread;
+    return thread;
+}
+
+static uint32_t profiler_threadCount(void)
+{
+    const uint32_t count = atomic_load(&profiler.threadCount);
+    return count < PROFILER_MAX_THREADS ? count : PROFILER_MAX_THREADS;
+}
+
+static void profiler_record(const ProfilerEvent* event)
+{
+    profiler.history[profiler.historyHead % PROFILER_HISTORY_EVENTS] = *event;
+    profiler.historyHead++;
+}
+
+// Needs a current context for the GPU queries. Without PROFILER_ENABLED
+// this does nothing and every other call returns at once.
+void profiler_init(void)
+{
+#if defined(PROFILER_ENABLED)
+    if (profiler.initialized)
+    {
+        return;
+    }
+    profiler.history = malloc(PROFILER_HISTORY_EVENTS * sizeof(ProfilerEvent));
+    if (profiler.history == NULL)
+    {
+        fprintf(stderr, "Failed to allocate the profiler history!\n");
+        exit(EXIT_FAILURE);
+    }
+    profiler.baseTime = profiler_now();
+
+    profiler.gpuSupported = GLEW_ARB_timer_query;
+    if (profiler.gpuSupported)
+    {
+        for (uint32_t i = 0; i < PROFILER_GPU_FRAMES; i++)
+        {
+            glGenQueries(PROFILER_MAX_GPU_ZONES * 2, profiler.gpuFrames[i].timestamps);
+            glGenQueries(1, &profiler.gpuFrames[i].elapsed);
+        }
+        // GPU timestamps are moved onto the CPU clock with a single offset
+        // taken here, which is close enough to line the two up in a trace.
+        GLint64 gpuTime = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+        profiler.gpuOffset = (int64_t)profiler_now() - (int64_t)gpuTime;
+    }
+    profiler.stateChanges = glState_getStats().issued;
+    profiler.initialized = true;
+    atomic_store(&profiler.enabled, true);
+#endif
+}
+
+// Call once every other profiled thread has stopped.
+void profiler_shutdown(void)
+{
+    if (!profiler.initialized)
+    {
+        return;
+    }
+    atomic_store(&profiler.enabled, false);
+    if (profiler.gpuSupported)
+    {
+        if (profiler.gpuFrameOpen)
+        {
+            glEndQuery(GL_TIME_ELAPSED);
+        }
+        for (uint32_t i = 0; i < PROFILER_GPU_FRAMES; i++)
+        {
+            glDeleteQueries(PROFILER_MAX_GPU_ZONES * 2, profiler.gpuFrames[i].timestamps);
+            glDeleteQueries(1, &profiler.gpuFrames[i].elapsed);
+        }
+    }
+    for (uint32_t i = 0; i < profiler_threadCount(); i++)
+    {
+        free(atomic_load(&profiler.threads[i]));
+        atomic_store(&profiler.threads[i], NULL);
+    }
+    free(profiler.history);
+    profilerThread = NULL;
+    profiler = (Profiler){ 0 };
+}
+
+// Meant to be toggled between frames; a zone left open on another thread
+// across the switch may be closed against the wrong begin once.
+void profiler_setEnabled(bool enabled)
+{
+    atomic_store(&profiler.enabled, enabled && profiler.initialized);
+}
+
+bool profiler_isEnabled(void)
+{
+    return atomic_load_explicit(&profiler.enabled, memory_order_relaxed);
+}
+
+// name labels the calling thread's track in exported traces.
+void profiler_setThreadName(const char* name)
+{
+    if (!profiler_isEnabled())
+    {
+        return;
+    }
+    ProfilerThread* thread = profiler_thread();
+    if (thread != NULL)
+    {
+        atomic_store_explicit(&thread->name, name, memory_order_relaxed);
+    }
+}
+
+void profiler_zoneBegin(const char* name)
+{
+    if (!atomic_load_explicit(&profiler.enabled, memory_order_relaxed))
+    {
+        return;
+    }
+    ProfilerThread* thread = profiler_thread();
+    if (thread == NULL)
+    {
+        return;
+    }
+    // Zones deeper than the stack are counted but not recorded so their
+    // ends still pair up.
+    if (thread->depth < PROFILER_MAX_DEPTH)
+    {
+        thread->stack[thread->depth] = (ProfilerOpenZone){ name, profiler_now() };
+    }
+    thread->depth++;
+}
+
+void profiler_zoneEnd(void)
+{
+    ProfilerThread* thread = profilerThread;
+    if (thread == NULL || thread->depth == 0)
+    {
+        return;
+    }
+    const uint32_t depth = --thread->depth;
+    if (depth >= PROFILER_MAX_DEPTH)
+    {
+        return;
+    }
+
+    const ProfilerOpenZone* zone = &thread->stack[depth];
+    const uint64_t head = atomic_load_explicit(&thread->head, memory_order_relaxed);
+    const uint64_t tail = atomic_load_explicit(&thread->tail, memory_order_acquire);
+    if (head - tail >= PROFILER_RING_SIZE)
+    {
+        atomic_fetch_add_explicit(&thread->dropped, 1, memory_order_relaxed);
+        return;
+    }
+    thread->events[head % PROFILER_RING_SIZE] = (ProfilerEvent)
+    {
+        .name = zone->name,
+        .start = zone->start,
+        .duration = profiler_now() - zone->start,
+        .thread = thread->index,
+        .depth = depth,
+    };
+    atomic_store_explicit(&thread->head, head + 1, memory_order_release);
+}
+
+void profiler_scopeEnd(int* scope)
+{
+    (void)scope;
+    profiler_zoneEnd();
+}
+
+void profiler_gpuZoneBegin(const char* name)
+{
+    if (!profiler.gpuFrameOpen)
+    {
+        return;
+    }
+    ProfilerGpuFrame* frame = &profiler.gpuFrames[profiler.frameCount % PROFILER_GPU_FRAMES];
+    uint32_t zone = PROFILER_NO_ZONE;
+    if (frame->count < PROFILER_MAX_GPU_ZONES)
+    {
+        zone = frame->count++;
+        frame->names[zone] = name;
+        frame->depths[zone] = profiler.gpuDepth;
+        glQueryCounter(frame->timestamps[zone * 2], GL_TIMESTAMP);
+    }
+    if (profiler.gpuDepth < PROFILER_MAX_DEPTH)
+    {
+        profiler.gpuStack[profiler.gpuDepth] = zone;
+    }
+    profiler.gpuDepth++;
+}
+
+void profiler_gpuZoneEnd(void)
+{
+    if (!profiler.gpuFrameOpen || profiler.gpuDepth == 0)
+    {
+        return;
+    }
+    profiler.gpuDepth--;
+    const uint32_t zone = profiler.gpuDepth < PROFILER_MAX_DEPTH ? profiler.gpuStack[profiler.gpuDepth] : PROFILER_NO_ZONE;
+    if (zone != PROFILER_NO_ZONE)
+    {
+        ProfilerGpuFrame* frame = &profiler.gpuFrames[profiler.frameCount % PROFILER_GPU_FRAMES];
+        glQueryCounter(frame->timestamps[zone * 2 + 1], GL_TIMESTAMP);
+    }
+}
+
+static bool profiler_queryAvailable(GLuint query)
+{
+    GLint available = GL_FALSE;
+    glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+    return available == GL_TRUE;
+}
+
+// Never waits: a frame whose queries are still in flight is dropped.
+static void profiler_resolveGpu(ProfilerGpuFrame* frame)
+{
+    frame->pending = false;
+    bool available = profiler_queryAvailable(frame->elapsed);
+    for (uint32_t i = 0; i < frame->count * 2 && available; i++)
+    {
+        available = profiler_queryAvailable(frame->timestamps[i]);
+    }
+    if (!available)
+    {
+        profiler.gpuDropped++;
+        return;
+    }
+
+    GLuint64 elapsed = 0;
+    glGetQueryObjectui64v(frame->elapsed, GL_QUERY_RESULT, &elapsed);
+    ProfilerFrame* history = &profiler.frames[frame->frame % PROFILER_HISTORY_FRAMES];
+    if (history->index == frame->frame)
+    {
+        history->gpuMilliseconds = (double)elapsed * 1e-6;
+    }
+
+    for (uint32_t i = 0; i < frame->count; i++)
+    {
+        GLuint64 start = 0;
+        GLuint64 end = 0;
+        glGetQueryObjectui64v(frame->timestamps[i * 2], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(frame->timestamps[i * 2 + 1], GL_QUERY_RESULT, &end);
+        const ProfilerEvent event =
+        {
+            .name = frame->names[i],
+            .start = (uint64_t)((int64_t)start + profiler.gpuOffset),
+            .duration = end > start ? end - start : 0,
+            .thread = PROFILER_GPU_THREAD,
+            .depth = frame->depths[i],
+        };
+        profiler_record(&event);
+    }
+}
+
+void profiler_beginFrame(void)
+{
+    if (!profiler_isEnabled())
+    {
+        return;
+    }
+    profiler.frameStart = profiler_now();
+    profiler.frameOpen = true;
+
+    if (profiler.gpuSupported)
+    {
+        ProfilerGpuFrame* frame = &profiler.gpuFrames[profiler.frameCount % PROFILER_GPU_FRAMES];
+        if (frame->pending)
+        {
+            profiler_resolveGpu(frame);
+        }
+        frame->count = 0;
+        frame->frame = profiler.frameCount;
+        frame->pending = true;
+        profiler.gpuDepth = 0;
+        glBeginQuery(GL_TIME_ELAPSED, frame->elapsed);
+        profiler.gpuFrameOpen = true;
+    }
+}
+
+// Closes the frame: ends its GPU queries, collects the zones every thread
+// finished since the last call and snapshots the counters.
+void profiler_endFrame(void)
+{
+    const uint64_t stateChanges = glState_getStats().issued;
+    const uint64_t stateDelta = stateChanges >= profiler.stateChanges ? stateChanges - profiler.stateChanges : stateChanges;
+    profiler.stateChanges = stateChanges;
+    const ProfilerCounters counters = profilerCounters;
+    profilerCounters = (ProfilerCounters){ 0 };
+    if (!profiler.frameOpen)
+    {
+        return;
+    }
+
+    if (profiler.gpuFrameOpen)
+    {
+        while (profiler.gpuDepth > 0)
+        {
+            profiler_gpuZoneEnd();
+        }
+        glEndQuery(GL_TIME_ELAPSED);
+        profiler.gpuFrameOpen = false;
+    }
+
+    for (uint32_t i = 0; i < profiler_threadCount(); i++)
+    {
+        ProfilerThread* thread = atomic_load_explicit(&profiler.threads[i], memory_order_acquire);
+        if (thread == NULL)
+        {
+            continue;
+        }
+        uint64_t tail = atomic_load_explicit(&thread->tail, memory_order_relaxed);
+        const uint64_t head = atomic_load_explicit(&thread->head, memory_order_acquire);
+        for (; tail < head; tail++)
+        {
+            profiler_record(&thread->events[tail % PROFILER_RING_SIZE]);
+        }
+        atomic_store_explicit(&thread->tail, tail, memory_order_release);
+    }
+
+    ProfilerFrame* frame = &profiler.frames[profiler.frameCount % PROFILER_HISTORY_FRAMES];
+    *frame = (ProfilerFrame)
+    {
+        .index = profiler.frameCount,
+        .start = profiler.frameStart,
+        .end = profiler_now(),
+        .gpuMilliseconds = -1.0,
+        .counters = counters,
+    };
+    frame->counters.stateChanges += stateDelta;
+    profiler.frameCount++;
+    profiler.frameOpen = false;
+}
+
+uint32_t profiler_frameCount(void)
+{
+    return profiler.frameCount < PROFILER_HISTORY_FRAMES ? (uint32_t)profiler.frameCount : PROFILER_HISTORY_FRAMES;
+}
+
+// 0 is the last finished frame. NULL past the history.
+const ProfilerFrame* profiler_getFrame(uint32_t framesAgo)
+{
+    if (framesAgo >= profiler_frameCount())
+    {
+        return NULL;
+    }
+    return &profiler.frames[(profiler.frameCount - 1 - framesAgo) % PROFILER_HISTORY_FRAMES];
+}
+
+static double profiler_traceTime(uint64_t time)
+{
+    return (double)((int64_t)time - (int64_t)profiler.baseTime) * 1e-3;
+}
+
+static void profiler_writeString(FILE* file, const char* string)
+{
+    fputc('"', file);
+    for (const char* c = string != NULL ? string : ""; *c != '\0'; c++)
+    {
+        if (*c == '"' || *c == '\\')
+        {
+            fputc('\\', file);
+            fputc(*c, file);
+        }
+        else if ((unsigned char)*c < 0x20)
+        {
+            fprintf(file, "\\u%04x", (unsigned char)*c);
+        }
+        else
+        {
+            fputc(*c, file);
+        }
+    }
+    fputc('"', file);
+}
+
+static void profiler_writeThreadName(FILE* file, uint32_t thread, const char* name)
+{
+    fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", thread);
+    profiler_writeString(file, name);
+    fprintf(file, "}},\n");
+}
+
+// Writes the zones and frames still in the history in the Chrome
+// trace_event format, with counters as counter tracks.
+bool profiler_exportTrace(const char* path)
+{
+    if (!profiler.initialized)
+    {
+        return false;
+    }
+    FILE* file = fopen(path, "w");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Failed to open %s for the trace!\n", path);
+        return false;
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (uint32_t i = 0; i < profiler_threadCount(); i++)
+    {
+        ProfilerThread* thread = atomic_load_explicit(&profiler.threads[i], memory_order_acquire);
+        if (thread != NULL)
+        {
+            char fallback[32];
+            snprintf(fallback, sizeof(fallback), "Thread %u", i);
+            const char* name = atomic_load_explicit(&thread->name, memory_order_relaxed);
+            profiler_writeThreadName(file, i, name != NULL ? name : fallback);
+        }
+    }
+    profiler_writeThreadName(file, PROFILER_GPU_THREAD, "GPU");
+    profiler_writeThreadName(file, PROFILER_FRAME_THREAD, "Frames");
+
+    const uint64_t first = profiler.historyHead > PROFILER_HISTORY_EVENTS ? profiler.historyHead - PROFILER_HISTORY_EVENTS : 0;
+    for (uint64_t i = first; i < profiler.historyHead; i++)
+    {
+        const ProfilerEvent* event = &profiler.history[i % PROFILER_HISTORY_EVENTS];
+        fprintf(file, "{\"name\":");
+        profiler_writeString(file, event->name);
+        fprintf(
+            file,
+            ",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"depth\":%u}},\n",
+            event->thread == PROFILER_GPU_THREAD ? "gpu" : "cpu",
+            event->thread,
+            profiler_traceTime(event->start),
+            (double)event->duration * 1e-3,
+            event->depth
+        );
+    }
+
+    for (uint32_t i = profiler_frameCount(); i > 0; i--)
+    {
+        const ProfilerFrame* frame = profiler_getFrame(i - 1);
+        fprintf(
+            file,
+            "{\"name\":\"Frame %llu\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"gpuMs\":%.3f}},\n",
+            (unsigned long long)frame->index,
+            PROFILER_FRAME_THREAD,
+            profiler_traceTime(frame->start),
+            (double)(frame->end - frame->start) * 1e-3,
+            frame->gpuMilliseconds
+        );
+        fprintf(
+            file,
+            "{\"name\":\"Counters\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"drawCalls\":%llu,\"triangles\":%llu,\"stateChanges\":%llu,\"uploadedBytes\":%llu,\"uniformUpdates\":%llu}},\n",
+            profiler_traceTime(frame->start),
+            (unsigned long long)frame->counters.drawCalls,
+            (unsigned long long)frame->counters.triangles,
+            (unsigned long long)frame->counters.stateChanges,
+            (unsigned long long)frame->counters.uploadedBytes,
+            (unsigned long long)frame->counters.uniformUpdates
+        );
+    }
+    // The metadata record closes the array without a trailing comma.
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"gl\"}}\n]}\n");
+
+    const bool written = !ferror(file);
+    if (fclose(file) != 0 || !written)
+    {
+        fprintf(stderr, "Failed to write the trace %s!\n", path);
+        return false;
+    }
+    return true;
+}
+
+void profiler_log(void)
+{
+    const uint32_t count = profiler_frameCount();
+    if (!profiler.initialized || count == 0)
+    {
+        return;
+    }
+
+    double cpu = 0.0;
+    double cpuMax = 0.0;
+    double gpu = 0.0;
+    uint32_t gpuCount = 0;
+    ProfilerCounters total = { 0 };
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const ProfilerFrame* frame = profiler_getFrame(i);
+        const double milliseconds = (double)(frame->end - frame->start) * 1e-6;
+        cpu += milliseconds;
+        cpuMax = milliseconds > cpuMax ? milliseconds : cpuMax;
+        if (frame->gpuMilliseconds >= 0.0)
+        {
+            gpu += frame->gpuMilliseconds;
+            gpuCount++;
+        }
+        total.drawCalls += frame->counters.drawCalls;
+        total.triangles += frame->counters.triangles;
+        total.stateChanges += frame->counters.stateChanges;
+        total.uploadedBytes += frame->counters.uploadedBytes;
+        total.uniformUpdates += frame->counters.uniformUpdates;
+    }
+    printf(
+        "Profiler (last %u frames): %.2f ms CPU (max %.2f), %.2f ms GPU, per frame %.0f draws, %.0f triangles, %.0f state changes, %.1f KB uploaded, %.0f uniform updates\n",
+        count,
+        cpu / count,
+        cpuMax,
+        gpuCount > 0 ? gpu / gpuCount : 0.0,
+        (double)total.drawCalls / count,
+        (double)total.triangles / count,
+        (double)total.stateChanges / count,
+        (double)total.uploadedBytes / count / 1024.0,
+        (double)total.uniformUpdates / count
+    );
+
+    uint64_t dropped = 0;
+    for (uint32_t i = 0; i < profiler_threadCount(); i++)
+    {
+        ProfilerThread* thread = atomic_load(&profiler.threads[i]);
+        dropped += thread != NULL ? atomic_load(&thread->dropped) : 0;
+    }
+    if (dropped > 0 || profiler.gpuDropped > 0)
+    {
+        fprintf(
+            stderr,
+            "Failed to record %llu profiler zones and %llu GPU frames!\n",
+            (unsigned long long)dropped,
+            (unsigned long long)profiler.gpuDropped
+        );
+    }
+}
@@ -0,0 +1,251 @@
+#include "../include/RangeAllocator.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RANGE_ALLOCATOR_INITIAL_BLOCKS 16
+
+static uint32_t alignUp(uint32_t value, uint32_t alignment)
+{
+    return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+}
+
+static void rangeAllocator_insertBlock(RangeAllocator* allocator, uint32_t index, RangeBlock block)
+{
+    if (allocator->freeCount == allocator->freeCapacity)
+    {
+        const uint32_t capacity = allocator->freeCapacity * 2;
+        RangeBlock* blocks = realloc(allocator->freeBlocks, capacity * sizeof(RangeBlock));
+        if (blocks == NULL)
+        {
+            fprintf(stderr, "Failed to grow the range allocator!\n");
+            exit(EXIT_FAILURE);
+        }
+        allocator->freeBlocks = blocks;
+        allocator->freeCapacity = capacity;
+    }
+    memmove(
+        &allocator->freeBlocks[index + 1],
+        &allocator->freeBlocks[index],
+        (allocator->freeCount - index) * sizeof(RangeBlock)
+    );
+    allocator->freeBlocks[index] = block;
+    allocator->freeCount++;
+}
+
+static void rangeAllocator_removeBlock(RangeAllocator* allocator, uint32_t index)
+{
+    memmove(
+        &allocator->freeBlocks[index],
+        &allocator->freeBlocks[index + 1],
+        (allocator->freeCount - index - 1) * sizeof(RangeBlock)
+    );
+    allocator->freeCount--;
+}
+
+// Splits the chosen block around [start, start + size), keeping any
+// alignment padding in front and the remainder behind as free blocks.
+static void rangeAllocator_carve(RangeAllocator* allocator, uint32_t index, uint32_t start, uint32_t size)
+{
+    const RangeBlock block = allocator->freeBlocks[index];
+    const uint32_t padding = start - block.offset;
+    const uint32_t remainder = block.size - padding - size;
+
+    if (padding > 0 && remainder > 0)
+    {
+        allocator->freeBlocks[index].size = padding;
+        rangeAllocator_insertBlock(allocator, index + 1, (RangeBlock){ start + size, remainder });
+    }
+    else if (padding > 0)
+    {
+        allocator->freeBlocks[index].size = padding;
+    }
+    else if (remainder > 0)
+    {
+        allocator->freeBlocks[index].offset = start + size;
+        allocator->freeBlocks[index].size = remainder;
+    }
+    else
+    {
+        rangeAllocator_removeBlock(allocator, index);
+    }
+
+    allocator->used += size;
+    allocator->allocationCount++;
+}
+
+RangeAllocator rangeAllocator_create(uint32_t capacity)
+{
+    RangeAllocator allocator =
+    {
+        .freeBlocks = malloc(RANGE_ALLOCATOR_INITIAL_BLOCKS * sizeof(RangeBlock)),
+        .freeCount = 0,
+        .freeCapacity = RANGE_ALLOCATOR_INITIAL_BLOCKS,
+        .capacity = capacity,
+        .used = 0,
+        .allocationCount = 0,
+    };
+    if (allocator.freeBlocks == NULL)
+    {
+        fprintf(stderr, "Failed to allocate the range allocator!\n");
+        exit(EXIT_FAILURE);
+    }
+    if (capacity > 0)
+    {
+        allocator.freeBlocks[0] = (RangeBlock){ 0, capacity };
+        allocator.freeCount = 1;
+    }
+    return allocator;
+}
+
+bool rangeAllocator_allocate(RangeAllocator* allocator, uint32_t size, uint32_t alignment, uint32_t* offset)
+{
+    if (size == 0)
+    {
+        return false;
+    }
+
+    uint32_t best = UINT32_MAX;
+    uint32_t bestStart = 0;
+    uint32_t bestSize = UINT32_MAX;
+    for (uint32_t i = 0; i < allocator->freeCount; i++)
+    {
+        const RangeBlock block = allocator->freeBlocks[i];
+        const uint32_t start = alignUp(block.offset, alignment);
+        if (start - block.offset + (uint64_t)size <= block.size && block.size < bestSize)
+        {
+            best = i;
+            bestStart = start;
+            bestSize = block.size;
+            if (block.size == size)
+            {
+                break;
+            }
+        }
+    }
+    if (best == UINT32_MAX)
+    {
+        return false;
+    }
+
+    rangeAllocator_carve(allocator, best, bestStart, size);
+    *offset = bestStart;
+    return true;
+}
+
+bool rangeAllocator_allocateBelow(RangeAllocator* allocator, uint32_t size, uint32_t alignment, uint32_t limit, uint32_t* offset)
+{
+    if (size == 0)
+    {
+        return false;
+    }
+
+    // First fit from the front, for compaction towards offset zero.
+    for (uint32_t i = 0; i < allocator->freeCount && allocator->freeBlocks[i].offset < limit; i++)
+    {
+        const RangeBlock block = allocator->freeBlocks[i];
+        const uint32_t start = alignUp(block.offset, alignment);
+        if (start - block.offset + (uint64_t)size <= block.size && (uint64_t)start + size <= limit)
+        {
+            rangeAllocator_carve(allocator, i, start, size);
+            *offset = start;
+            return true;
+        }
+    }
+    return false;
+}
+
+void rangeAllocator_free(RangeAllocator* allocator, uint32_t offset, uint32_t size)
+{
+    if (size == 0)
+    {
+        return;
+    }
+
+    uint32_t low = 0;
+    uint32_t high = allocator->freeCount;
+    while (low < high)
+    {
+        const uint32_t middle = (low + high) / 2;
+        if (allocator->freeBlocks[middle].offset < offset)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    RangeBlock* previous = low > 0 ? &allocator->freeBlocks[low - 1] : NULL;
+    RangeBlock* next = low < allocator->freeCount ? &allocator->freeBlocks[low] : NULL;
+    const bool mergePrevious = previous != NULL && previous->offset + previous->size == offset;
+    const bool mergeNext = next != NULL && offset + size == next->offset;
+
+    if (mergePrevious && mergeNext)
+    {
+        previous->size += size + next->size;
+        rangeAllocator_removeBlock(allocator, low);
+    }
+    else if (mergePrevious)
+    {
+        previous->size += size;
+    }
+    else if (mergeNext)
+    {
+        next->offset = offset;
+        next->size += size;
+    }
+    else
+    {
+        rangeAllocator_insertBlock(allocator, low, (RangeBlock){ offset, size });
+    }
+
+    allocator->used -= size;
+    allocator->allocationCount--;
+}
+
+void rangeAllocator_grow(RangeAllocator* allocator, uint32_t capacity)
+{
+    if (capacity <= allocator->capacity)
+    {
+        return;
+    }
+
+    const uint32_t added = capacity - allocator->capacity;
+    RangeBlock* last = allocator->freeCount > 0 ? &allocator->freeBlocks[allocator->freeCount - 1] : NULL;
+    if (last != NULL && last->offset + last->size == allocator->capacity)
+    {
+        last->size += added;
+    }
+    else
+    {
+        rangeAllocator_insertBlock(allocator, allocator->freeCount, (RangeBlock){ allocator->capacity, added });
+    }
+    allocator->capacity = capacity;
+}
+
+uint32_t rangeAllocator_largestFree(RangeAllocator* allocator)
+{
+    uint32_t largest = 0;
+    for (uint32_t i = 0; i < allocator->freeCount; i++)
+    {
+        largest = allocator->freeBlocks[i].size > largest ? allocator->freeBlocks[i].size : largest;
+    }
+    return largest;
+}
+
+float rangeAllocator_fragmentation(RangeAllocator* allocator)
+{
+    // Share of the free space that the largest single allocation cannot use.
+    const uint32_t free = allocator->capacity - allocator->used;
+    return free > 0 ? 1.f - (float)rangeAllocator_largestFree(allocator) / (float)free : 0.f;
+}
+
+void rangeAllocator_delete(RangeAllocator* allocator)
+{
+    free(allocator->freeBlocks);
+    allocator->freeBlocks = NULL;
+    allocator->freeCount = 0;
+    allocator->freeCapacity = 0;
+    allocator->capacity = 0;
+    allocator->used = 0;
+    allocator->allocationCount = 0;
+}
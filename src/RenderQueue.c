@@ -0,0 +1,218 @@
+#include "../include/RenderQueue.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RENDER_QUEUE_INITIAL_CAPACITY 256
+#define RENDER_RADIX_BITS 8
+#define RENDER_RADIX_BUCKETS (1 << RENDER_RADIX_BITS)
+#define RENDER_RADIX_PASSES (64 / RENDER_RADIX_BITS)
+
+#define RENDER_KEY_FIELD(value, bits, shift) (((uint64_t)(value) & ((1ull << (bits)) - 1)) << (shift))
+
+uint64_t renderKey(RenderPass pass, uint32_t program, uint32_t vertexArray, uint32_t material, uint32_t depth)
+{
+    return RENDER_KEY_FIELD(pass, RENDER_KEY_PASS_BITS, RENDER_KEY_PASS_SHIFT)
+         | RENDER_KEY_FIELD(program, RENDER_KEY_PROGRAM_BITS, RENDER_KEY_PROGRAM_SHIFT)
+         | RENDER_KEY_FIELD(vertexArray, RENDER_KEY_VAO_BITS, RENDER_KEY_VAO_SHIFT)
+         | RENDER_KEY_FIELD(material, RENDER_KEY_MATERIAL_BITS, RENDER_KEY_MATERIAL_SHIFT)
+         | RENDER_KEY_FIELD(depth, RENDER_KEY_DEPTH_BITS, RENDER_KEY_DEPTH_SHIFT);
+}
+
+uint32_t renderKey_depth(float depth, bool backToFront)
+{
+    // Quantizes a [0, 1] depth; transparent passes invert it so far draws sort first.
+    const uint32_t maxDepth = (1u << RENDER_KEY_DEPTH_BITS) - 1;
+    depth = depth < 0.f ? 0.f : depth > 1.f ? 1.f : depth;
+    const uint32_t quantized = (uint32_t)(depth * (float)maxDepth);
+    return backToFront ? maxDepth - quantized : quantized;
+}
+
+static void* renderQueue_grow(void* pointer, uint32_t capacity, size_t size)
+{
+    void* grown = realloc(pointer, capacity * size);
+    if (grown == NULL)
+    {
+        fprintf(stderr, "Failed to grow a render queue!\n");
+        exit(EXIT_FAILURE);
+    }
+    return grown;
+}
+
+RenderQueue renderQueue_create(uint32_t threadCount)
+{
+    threadCount = threadCount > 0 ? threadCount : 1;
+    RenderQueue queue =
+    {
+        .buffers = calloc(threadCount, sizeof(RenderCommandBuffer)),
+        .bufferCount = threadCount,
+        .commands = NULL,
+        .entries = NULL,
+        .scratch = NULL,
+        .count = 0,
+        .capacity = 0,
+        .stats = { 0 },
+    };
+    if (queue.buffers == NULL)
+    {
+        fprintf(stderr, "Failed to allocate render command buffers!\n");
+        exit(EXIT_FAILURE);
+    }
+    return queue;
+}
+
+RenderCommandBuffer* renderQueue_getBuffer(RenderQueue* queue, uint32_t thread)
+{
+    return &queue->buffers[thread % queue->bufferCount];
+}
+
+void renderCommandBuffer_push(RenderCommandBuffer* buffer, const RenderCommand* command)
+{
+    if (buffer->count == buffer->capacity)
+    {
+        buffer->capacity = buffer->capacity > 0 ? buffer->capacity * 2 : RENDER_QUEUE_INITIAL_CAPACITY;
+        buffer->commands = renderQueue_grow(buffer->commands, buffer->capacity, sizeof(RenderCommand));
+    }
+    buffer->commands[buffer->count++] = *command;
+}
+
+static void renderQueue_reserve(RenderQueue* queue, uint32_t count)
+{
+    if (count <= queue->capacity)
+    {
+        return;
+    }
+    uint32_t capacity = queue->capacity > 0 ? queue->capacity : RENDER_QUEUE_INITIAL_CAPACITY;
+    while (capacity < count)
+    {
+        capacity *= 2;
+    }
+    queue->commands = renderQueue_grow(queue->commands, capacity, sizeof(RenderCommand));
+    queue->entries = renderQueue_grow(queue->entries, capacity, sizeof(RenderSortEntry));
+    queue->scratch = renderQueue_grow(queue->scratch, capacity, sizeof(RenderSortEntry));
+    queue->capacity = capacity;
+}
+
+static void renderQueue_radixSort(RenderQueue* queue)
+{
+    const uint32_t count = queue->count;
+    uint32_t histograms[RENDER_RADIX_PASSES][RENDER_RADIX_BUCKETS];
+    memset(histograms, 0, sizeof(histograms));
+
+    // One read pass fills the histograms for every digit.
+    for (uint32_t i = 0; i < count; i++)
+    {
+        const uint64_t key = queue->entries[i].key;
+        for (int pass = 0; pass < RENDER_RADIX_PASSES; pass++)
+        {
+            histograms[pass][(key >> (pass * RENDER_RADIX_BITS)) & (RENDER_RADIX_BUCKETS - 1)]++;
+        }
+    }
+
+    RenderSortEntry* source = queue->entries;
+    RenderSortEntry* target = queue->scratch;
+    for (int pass = 0; pass < RENDER_RADIX_PASSES; pass++)
+    {
+        uint32_t* histogram = histograms[pass];
+        const int shift = pass * RENDER_RADIX_BITS;
+
+        // Digits shared by every key (unused key fields) need no scatter.
+        if (histogram[(source[0].key >> shift) & (RENDER_RADIX_BUCKETS - 1)] == count)
+        {
+            continue;
+        }
+
+        uint32_t offset = 0;
+        for (int bucket = 0; bucket < RENDER_RADIX_BUCKETS; bucket++)
+        {
+            const uint32_t bucketCount = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucketCount;
+        }
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const uint32_t bucket = (source[i].key >> shift) & (RENDER_RADIX_BUCKETS - 1);
+            target[histogram[bucket]++] = source[i];
+        }
+
+        RenderSortEntry* swap = source;
+        source = target;
+        target = swap;
+    }
+
+    if (source != queue->entries)
+    {
+        queue->scratch = queue->entries;
+        queue->entries = source;
+    }
+}
+
+void renderQueue_sort(RenderQueue* queue)
+{
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < queue->bufferCount; i++)
+    {
+        total += queue->buffers[i].count;
+    }
+    renderQueue_reserve(queue, total);
+
+    queue->count = 0;
+    for (uint32_t i = 0; i < queue->bufferCount; i++)
+    {
+        RenderCommandBuffer* buffer = &queue->buffers[i];
+        memcpy(queue->commands + queue->count, buffer->commands, buffer->count * sizeof(RenderCommand));
+        queue->count += buffer->count;
+    }
+    for (uint32_t i = 0; i < queue->count; i++)
+    {
+        queue->entries[i].key = queue->commands[i].key;
+        queue->entries[i].index = i;
+    }
+
+    if (queue->count > 1)
+    {
+        renderQueue_radixSort(queue);
+    }
+}
+
+void renderQueue_clear(RenderQueue* queue)
+{
+    for (uint32_t i = 0; i < queue->bufferCount; i++)
+    {
+        queue->buffers[i].count = 0;
+    }
+    queue->count = 0;
+}
+
+void renderQueue_delete(RenderQueue* queue)
+{
+    for (uint32_t i = 0; i < queue->bufferCount; i++)
+    {
+        free(queue->buffers[i].commands);
+    }
+    free(queue->buffers);
+    free(queue->commands);
+    free(queue->entries);
+    free(queue->scratch);
+    queue->buffers = NULL;
+    queue->commands = NULL;
+    queue->entries = NULL;
+    queue->scratch = NULL;
+    queue->bufferCount = 0;
+    queue->count = 0;
+    queue->capacity = 0;
+}
+
+void renderQueue_log(RenderQueue* queue)
+{
+    const RenderQueueStats* stats = &queue->stats;
+    printf(
+        "Render queue: %llu commands, %llu draws, %llu program, %llu vertex array and %llu buffer changes\n",
+        (unsigned long long)stats->commands,
+        (unsigned long long)stats->drawCalls,
+        (unsigned long long)stats->programChanges,
+        (unsigned long long)stats->vertexArrayChanges,
+        (unsigned long long)stats->bufferChanges
+    );
+}
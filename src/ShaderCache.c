@@ -0,0 +1,306 @@
+#include "../include/ShaderCache.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define SHADER_CACHE_FNV_OFFSET 14695981039346656037ull
+#define SHADER_CACHE_FNV_PRIME  1099511628211ull
+
+static double shaderCache_now(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec * 1e3 + (double)time.tv_nsec * 1e-6;
+}
+
+// Strings are hashed with their terminator so ("ab", "c") and ("a", "bc")
+// give different keys.
+static uint64_t shaderCache_hash(uint64_t hash, const void* data, size_t size)
+{
+    const uint8_t* bytes = data;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= SHADER_CACHE_FNV_PRIME;
+    }
+    return hash;
+}
+
+static uint64_t shaderCache_hashString(uint64_t hash, const char* string)
+{
+    return shaderCache_hash(hash, string != NULL ? string : "", string != NULL ? strlen(string) + 1 : 1);
+}
+
+static void shaderCache_path(const ShaderCache* cache, uint64_t key, char* path, size_t size)
+{
+    snprintf(path, size, "%s/%016llx.bin", cache->directory, (unsigned long long)key);
+}
+
+// Creates each missing component of the directory path.
+static bool shaderCache_makeDirectory(const char* directory)
+{
+    char path[SHADER_CACHE_MAX_PATH];
+    snprintf(path, sizeof(path), "%s", directory);
+    for (char* cursor = path + 1; ; cursor++)
+    {
+        if (*cursor == '/' || *cursor == '\0')
+        {
+            const char separator = *cursor;
+            *cursor = '\0';
+            if (mkdir(path, 0755) != 0 && errno != EEXIST)
+            {
+                return false;
+            }
+            *cursor = separator;
+            if (separator == '\0')
+            {
+                return true;
+            }
+        }
+    }
+}
+
+bool shaderCache_isSupported(void)
+{
+    if (!GLEW_VERSION_4_1 && !GLEW_ARB_get_program_binary)
+    {
+        return false;
+    }
+    GLint formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    return formatCount > 0;
+}
+
+// Needs a current context. Without program binary support, or without a
+// usable directory, the cache stays disabled and simply compiles.
+ShaderCache shaderCache_create(const char* directory)
+{
+    ShaderCache cache = { 0 };
+    snprintf(cache.directory, sizeof(cache.directory), "%s", directory);
+
+    uint64_t hash = SHADER_CACHE_FNV_OFFSET;
+    hash = shaderCache_hashString(hash, (const char*)glGetString(GL_VENDOR));
+    hash = shaderCache_hashString(hash, (const char*)glGetString(GL_RENDERER));
+    hash = shaderCache_hashString(hash, (const char*)glGetString(GL_VERSION));
+    cache.driverHash = hash;
+
+    cache.enabled = shaderCache_isSupported();
+    if (cache.enabled && !shaderCache_makeDirectory(directory))
+    {
+        fprintf(stderr, "Failed to create the shader cache directory %s!\n", directory);
+        cache.enabled = false;
+    }
+    return cache;
+}
+
+static uint64_t shaderCache_key(const ShaderCache* cache, const GLenum* stages, const char* const* sources, uint32_t stageCount)
+{
+    uint64_t hash = cache->driverHash;
+    for (uint32_t i = 0; i < stageCount; i++)
+    {
+        hash = shaderCache_hash(hash, &stages[i], sizeof(stages[i]));
+        hash = shaderCache_hashString(hash, sources[i]);
+    }
+    return hash;
+}
+
+// Returns 0 when there is no entry or the driver turned the binary down.
+static GLuint shaderCache_read(ShaderCache* cache, uint64_t key, const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        return 0;
+    }
+
+    ShaderCacheHeader header;
+    void* binary = NULL;
+    bool valid = fread(&header, sizeof(header), 1, file) == 1 &&
+        header.magic == SHADER_CACHE_MAGIC &&
+        header.version == SHADER_CACHE_VERSION &&
+        header.key == key &&
+        header.binarySize > 0;
+    if (valid)
+    {
+        binary = malloc(header.binarySize);
+        valid = binary != NULL && fread(binary, header.binarySize, 1, file) == 1;
+    }
+    fclose(file);
+
+    GLuint program = 0;
+    if (valid)
+    {
+        program = glCreateProgram();
+        glProgramBinary(program, header.binaryFormat, binary, (GLsizei)header.binarySize);
+        GLint success = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            glDeleteProgram(program);
+            program = 0;
+        }
+    }
+    free(binary);
+
+    if (program == 0)
+    {
+        cache->stats.rejected++;
+        remove(path);
+        return 0;
+    }
+    cache->stats.savedMilliseconds += header.compileMilliseconds;
+    return program;
+}
+
+// Written to a temporary name first so a crash never leaves a torn entry
+// under the real one.
+static void shaderCache_write(ShaderCache* cache, uint64_t key, const char* path, GLuint program, double compileMilliseconds)
+{
+    GLint size = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &size);
+    void* binary = size > 0 ? malloc((size_t)size) : NULL;
+    if (binary == NULL)
+    {
+        cache->stats.writeFailures++;
+        return;
+    }
+
+    ShaderCacheHeader header =
+    {
+        .magic = SHADER_CACHE_MAGIC,
+        .version = SHADER_CACHE_VERSION,
+        .key = key,
+        .compileMilliseconds = (float)compileMilliseconds,
+    };
+    GLsizei length = 0;
+    GLenum format = 0;
+    glGetProgramBinary(program, size, &length, &format, binary);
+    header.binaryFormat = format;
+    header.binarySize = (uint32_t)length;
+
+    char temporary[SHADER_CACHE_MAX_PATH + 64];
+    snprintf(temporary, sizeof(temporary), "%s.%ld", path, (long)getpid());
+    FILE* file = length > 0 ? fopen(temporary, "wb") : NULL;
+    bool written = file != NULL &&
+        fwrite(&header, sizeof(header), 1, file) == 1 &&
+        fwrite(binary, (size_t)length, 1, file) == 1;
+    if (file != NULL)
+    {
+        written = fclose(file) == 0 && written;
+    }
+    if (!written || rename(temporary, path) != 0)
+    {
+        remove(temporary);
+        cache->stats.writeFailures++;
+    }
+    free(binary);
+}
+
+// Returns the linked program from the cache, or 0 when the caller has to
+// build it from source and hand it to shaderCache_store.
+GLuint shaderCache_load(ShaderCache* cache, const GLenum* stages, const char* const* sources, uint32_t stageCount)
+{
+    if (cache == NULL || !cache->enabled)
+    {
+        return 0;
+    }
+
+    const uint64_t key = shaderCache_key(cache, stages, sources, stageCount);
+    char path[SHADER_CACHE_MAX_PATH + 32];
+    shaderCache_path(cache, key, path, sizeof(path));
+
+    const double start = shaderCache_now();
+    const GLuint program = shaderCache_read(cache, key, path);
+    if (program == 0)
+    {
+        cache->stats.misses++;
+        return 0;
+    }
+    const double elapsed = shaderCache_now() - start;
+    cache->stats.hits++;
+    cache->stats.loadMilliseconds += elapsed;
+    cache->stats.savedMilliseconds -= elapsed;
+    return program;
+}
+
+// The program must have been linked with the retrievable hint, see
+// shaderCache_wantsBinaries.
+void shaderCache_store(ShaderCache* cache, const GLenum* stages, const char* const* sources, uint32_t stageCount, GLuint program, double compileMilliseconds)
+{
+    if (cache == NULL)
+    {
+        return;
+    }
+    // Counted with the cache disabled too, which is the baseline it saves on.
+    cache->stats.compileMilliseconds += compileMilliseconds;
+    if (!cache->enabled || program == 0)
+    {
+        return;
+    }
+
+    const uint64_t key = shaderCache_key(cache, stages, sources, stageCount);
+    char path[SHADER_CACHE_MAX_PATH + 32];
+    shaderCache_path(cache, key, path, sizeof(path));
+    shaderCache_write(cache, key, path, program, compileMilliseconds);
+}
+
+bool shaderCache_wantsBinaries(const ShaderCache* cache)
+{
+    return cache != NULL && cache->enabled;
+}
+
+Shader shaderCache_createProgram(ShaderCache* cache, const GLenum* stages, const char* const* sources, uint32_t stageCount)
+{
+    GLuint program = shaderCache_load(cache, stages, sources, stageCount);
+    if (program != 0)
+    {
+        return shader_fromProgram(program);
+    }
+
+    const double start = shaderCache_now();
+    program = shader_linkProgram(stages, sources, stageCount, shaderCache_wantsBinaries(cache));
+    shaderCache_store(cache, stages, sources, stageCount, program, shaderCache_now() - start);
+    return shader_fromProgram(program);
+}
+
+Shader shaderCache_createShader(ShaderCache* cache, const char* vertexShaderSource, const char* fragmentShaderSource)
+{
+    const GLenum stages[] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+    const char* sources[] = { vertexShaderSource, fragmentShaderSource };
+    return shaderCache_createProgram(cache, stages, sources, 2);
+}
+
+Shader shaderCache_createCompute(ShaderCache* cache, const char* computeShaderSource)
+{
+    const GLenum stages[] = { GL_COMPUTE_SHADER };
+    const char* sources[] = { computeShaderSource };
+    return shaderCache_createProgram(cache, stages, sources, 1);
+}
+
+void shaderCache_log(const ShaderCache* cache)
+{
+    if (!cache->enabled)
+    {
+        printf("Shader cache: disabled, %.2f ms compiling\n", cache->stats.compileMilliseconds);
+        return;
+    }
+    printf(
+        "Shader cache (%s): %llu hits, %llu misses, %llu rejected, %.2f ms loading, %.2f ms compiling, %.2f ms saved\n",
+        cache->directory,
+        (unsigned long long)cache->stats.hits,
+        (unsigned long long)cache->stats.misses,
+        (unsigned long long)cache->stats.rejected,
+        cache->stats.loadMilliseconds,
+        cache->stats.compileMilliseconds,
+        cache->stats.savedMilliseconds
+    );
+    if (cache->stats.writeFailures > 0)
+    {
+        fprintf(stderr, "Failed to write %llu shader cache entries!\n", (unsigned long long)cache->stats.writeFailures);
+    }
+}
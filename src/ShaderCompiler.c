@@ -0,0 +1,479 @@
+#include "../include/ShaderCompiler.h"
+#include "../include/Profiler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double shaderCompiler_now(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec * 1e3 + (double)time.tv_nsec * 1e-6;
+}
+
+static char* shaderCompiler_copySource(const char* source)
+{
+    const size_t size = strlen(source) + 1;
+    char* copy = malloc(size);
+    if (copy == NULL)
+    {
+        fprintf(stderr, "Failed to allocate a shader source!\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(copy, source, size);
+    return copy;
+}
+
+static void shaderCompiler_lock(ShaderCompiler* compiler)
+{
+    if (compiler->mode == SHADER_COMPILER_THREADED)
+    {
+        pthread_mutex_lock(&compiler->mutex);
+    }
+}
+
+static void shaderCompiler_unlock(ShaderCompiler* compiler)
+{
+    if (compiler->mode == SHADER_COMPILER_THREADED)
+    {
+        pthread_mutex_unlock(&compiler->mutex);
+    }
+}
+
+// Takes the built program, or 0 if building failed, and runs on the render
+// thread in every mode: reflection and the cache write need the main context.
+static void shaderCompiler_finish(ShaderCompiler* compiler, ShaderJob* job, GLuint program)
+{
+    const double wait = shaderCompiler_now() - job->submitTime;
+    shaderCache_store(
+        compiler->cache,
+        job->stages,
+        (const char* const*)job->sources,
+        job->stageCount,
+        program,
+        job->compileMilliseconds > 0.0 ? job->compileMilliseconds : wait
+    );
+
+    job->shader = shader_fromProgram(program);
+    job->state = program != 0 ? SHADER_PROGRAM_READY : SHADER_PROGRAM_FAILED;
+    job->program = 0;
+    for (uint32_t i = 0; i < job->stageCount; i++)
+    {
+        free(job->sources[i]);
+        job->sources[i] = NULL;
+    }
+
+    program != 0 ? compiler->stats.ready++ : compiler->stats.failed++;
+    compiler->stats.waitMilliseconds += wait;
+    compiler->stats.maxWaitMilliseconds = wait > compiler->stats.maxWaitMilliseconds ? wait : compiler->stats.maxWaitMilliseconds;
+    compiler->pendingCount--;
+}
+
+static bool shaderCompiler_isComplete(GLuint object, bool program)
+{
+    GLint complete = GL_FALSE;
+    program
+        ? glGetProgramiv(object, GL_COMPLETION_STATUS_KHR, &complete)
+        : glGetShaderiv(object, GL_COMPLETION_STATUS_KHR, &complete);
+    return complete == GL_TRUE;
+}
+
+static void shaderCompiler_deleteStages(ShaderJob* job)
+{
+    for (uint32_t i = 0; i < job->stageCount; i++)
+    {
+        glDeleteShader(job->shaders[i]);
+        job->shaders[i] = 0;
+    }
+}
+
+// Moves a parallel job from compiling to linking to done, stopping at the
+// first object the driver is still busy with unless block is set. Status
+// queries are only made once the completion status says they will not stall.
+static void shaderCompiler_advance(ShaderCompiler* compiler, ShaderJob* job, bool block)
+{
+    if (!job->linking)
+    {
+        for (uint32_t i = 0; i < job->stageCount; i++)
+        {
+            if (!block && !shaderCompiler_isComplete(job->shaders[i], false))
+            {
+                return;
+            }
+        }
+
+        bool compiled = true;
+        for (uint32_t i = 0; i < job->stageCount; i++)
+        {
+            compiled = shader_compileStatus(job->shaders[i], job->stages[i]) && compiled;
+        }
+        if (!compiled)
+        {
+            shaderCompiler_deleteStages(job);
+            shaderCompiler_finish(compiler, job, 0);
+            return;
+        }
+
+        job->program = glCreateProgram();
+        for (uint32_t i = 0; i < job->stageCount; i++)
+        {
+            glAttachShader(job->program, job->shaders[i]);
+        }
+        if (shaderCache_wantsBinaries(compiler->cache))
+        {
+            glProgramParameteri(job->program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+        glLinkProgram(job->program);
+        job->linking = true;
+    }
+
+    if (!block && !shaderCompiler_isComplete(job->program, true))
+    {
+        return;
+    }
+
+    GLuint program = job->program;
+    if (shader_linkStatus(program))
+    {
+        for (uint32_t i = 0; i < job->stageCount; i++)
+        {
+            glDetachShader(program, job->shaders[i]);
+        }
+    }
+    else
+    {
+        glDeleteProgram(program);
+        program = 0;
+    }
+    shaderCompiler_deleteStages(job);
+    shaderCompiler_finish(compiler, job, program);
+}
+
+// Builds queued jobs in submission order. glFinish makes the finished
+// program visible to the render context before it is handed over.
+static void* shaderCompiler_work(void* argument)
+{
+    ShaderCompiler* compiler = argument;
+    compiler->makeCurrent(compiler->workerContext);
+    PROFILE_THREAD("Shader compiler");
+
+    pthread_mutex_lock(&compiler->mutex);
+    while (!compiler->quit)
+    {
+        if (compiler->workerCursor == compiler->jobCount)
+        {
+            pthread_cond_wait(&compiler->wake, &compiler->mutex);
+            continue;
+        }
+        const uint32_t index = compiler->workerCursor++;
+        if (!compiler->jobs[index].queued)
+        {
+            continue;
+        }
+
+        GLenum stages[SHADER_MAX_STAGES];
+        const char* sources[SHADER_MAX_STAGES];
+        const uint32_t stageCount = compiler->jobs[index].stageCount;
+        memcpy(stages, compiler->jobs[index].stages, sizeof(stages));
+        memcpy(sources, compiler->jobs[index].sources, sizeof(sources));
+        const bool retrievable = shaderCache_wantsBinaries(compiler->cache);
+        pthread_mutex_unlock(&compiler->mutex);
+
+        PROFILE_BEGIN("Build program");
+        const double start = shaderCompiler_now();
+        const GLuint program = shader_linkProgram(stages, sources, stageCount, retrievable);
+        glFinish();
+        const double elapsed = shaderCompiler_now() - start;
+        PROFILE_END();
+
+        pthread_mutex_lock(&compiler->mutex);
+        ShaderJob* job = &compiler->jobs[index];
+        job->program = program;
+        job->compileMilliseconds = elapsed;
+        job->queued = false;
+        job->finished = true;
+        pthread_cond_broadcast(&compiler->done);
+    }
+    pthread_mutex_unlock(&compiler->mutex);
+
+    compiler->makeCurrent(NULL);
+    return NULL;
+}
+
+bool shaderCompiler_isParallelSupported(void)
+{
+    return GLEW_KHR_parallel_shader_compile;
+}
+
+// workerContext must share objects with the current context and not be
+// current anywhere; it is only used when the driver cannot compile in
+// parallel on its own, and may be NULL.
+ShaderCompiler* shaderCompiler_create(ShaderCache* cache, void* workerContext, ShaderContextMakeCurrent makeCurrent)
+{
+    ShaderCompiler* compiler = calloc(1, sizeof(ShaderCompiler));
+    if (compiler == NULL)
+    {
+        fprintf(stderr, "Failed to allocate the shader compiler!\n");
+        exit(EXIT_FAILURE);
+    }
+    compiler->cache = cache;
+    compiler->workerContext = workerContext;
+    compiler->makeCurrent = makeCurrent;
+
+    if (shaderCompiler_isParallelSupported())
+    {
+        compiler->mode = SHADER_COMPILER_PARALLEL;
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+    }
+    else if (workerContext != NULL && makeCurrent != NULL)
+    {
+        compiler->mode = SHADER_COMPILER_THREADED;
+        pthread_mutex_init(&compiler->mutex, NULL);
+        pthread_cond_init(&compiler->wake, NULL);
+        pthread_cond_init(&compiler->done, NULL);
+        if (pthread_create(&compiler->worker, NULL, shaderCompiler_work, compiler) != 0)
+        {
+            fprintf(stderr, "Failed to start the shader compiler thread!\n");
+            pthread_mutex_destroy(&compiler->mutex);
+            pthread_cond_destroy(&compiler->wake);
+            pthread_cond_destroy(&compiler->done);
+            compiler->mode = SHADER_COMPILER_SYNCHRONOUS;
+        }
+    }
+    else
+    {
+        compiler->mode = SHADER_COMPILER_SYNCHRONOUS;
+    }
+    return compiler;
+}
+
+ShaderProgramHandle shaderCompiler_submit(ShaderCompiler* compiler, const GLenum* stages, const char* const* sources, uint32_t stageCount)
+{
+    if (stageCount == 0 || stageCount > SHADER_MAX_STAGES)
+    {
+        fprintf(stderr, "Failed to submit a shader program!\n");
+        return SHADER_COMPILER_INVALID_HANDLE;
+    }
+
+    shaderCompiler_lock(compiler);
+    if (compiler->jobCount == compiler->jobCapacity)
+    {
+        const uint32_t capacity = compiler->jobCapacity > 0 ? compiler->jobCapacity * 2 : 16;
+        ShaderJob* jobs = realloc(compiler->jobs, capacity * sizeof(ShaderJob));
+        if (jobs == NULL)
+        {
+            fprintf(stderr, "Failed to allocate shader compiler jobs!\n");
+            exit(EXIT_FAILURE);
+        }
+        compiler->jobs = jobs;
+        compiler->jobCapacity = capacity;
+    }
+
+    const ShaderProgramHandle handle = compiler->jobCount;
+    ShaderJob* job = &compiler->jobs[handle];
+    *job = (ShaderJob)
+    {
+        .state = SHADER_PROGRAM_PENDING,
+        .stageCount = stageCount,
+        .submitTime = shaderCompiler_now(),
+    };
+    memcpy(job->stages, stages, stageCount * sizeof(GLenum));
+    compiler->stats.submitted++;
+
+    const GLuint cached = shaderCache_load(compiler->cache, stages, sources, stageCount);
+    if (cached != 0)
+    {
+        job->shader = shader_fromProgram(cached);
+        job->state = SHADER_PROGRAM_READY;
+        compiler->stats.cacheHits++;
+        compiler->stats.ready++;
+        compiler->jobCount++;
+        shaderCompiler_unlock(compiler);
+        return handle;
+    }
+
+    for (uint32_t i = 0; i < stageCount; i++)
+    {
+        job->sources[i] = shaderCompiler_copySource(sources[i]);
+    }
+    compiler->jobCount++;
+    compiler->pendingCount++;
+
+    switch (compiler->mode)
+    {
+        case SHADER_COMPILER_SYNCHRONOUS:
+        {
+            const double start = shaderCompiler_now();
+            const GLuint program = shader_linkProgram(stages, sources, stageCount, shaderCache_wantsBinaries(compiler->cache));
+            job->compileMilliseconds = shaderCompiler_now() - start;
+            shaderCompiler_finish(compiler, job, program);
+            break;
+        }
+        case SHADER_COMPILER_PARALLEL:
+            for (uint32_t i = 0; i < stageCount; i++)
+            {
+                job->shaders[i] = glCreateShader(stages[i]);
+                glShaderSource(job->shaders[i], 1, (const char* const*)&job->sources[i], NULL);
+                glCompileShader(job->shaders[i]);
+            }
+            break;
+        case SHADER_COMPILER_THREADED:
+            job->queued = true;
+            pthread_cond_signal(&compiler->wake);
+            break;
+    }
+    shaderCompiler_unlock(compiler);
+    return handle;
+}
+
+ShaderProgramHandle shaderCompiler_submitShader(ShaderCompiler* compiler, const char* vertexShaderSource, const char* fragmentShaderSource)
+{
+    const GLenum stages[] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+    const char* sources[] = { vertexShaderSource, fragmentShaderSource };
+    return shaderCompiler_submit(compiler, stages, sources, 2);
+}
+
+ShaderProgramHandle shaderCompiler_submitCompute(ShaderCompiler* compiler, const char* computeShaderSource)
+{
+    const GLenum stages[] = { GL_COMPUTE_SHADER };
+    const char* sources[] = { computeShaderSource };
+    return shaderCompiler_submit(compiler, stages, sources, 1);
+}
+
+// Call once a frame; never blocks on the driver.
+void shaderCompiler_poll(ShaderCompiler* compiler)
+{
+    if (compiler->pendingCount == 0)
+    {
+        return;
+    }
+    if (compiler->mode == SHADER_COMPILER_THREADED && pthread_mutex_trylock(&compiler->mutex) != 0)
+    {
+        return;
+    }
+
+    for (uint32_t i = 0; i < compiler->jobCount && compiler->pendingCount > 0; i++)
+    {
+        ShaderJob* job = &compiler->jobs[i];
+        if (job->state != SHADER_PROGRAM_PENDING)
+        {
+            continue;
+        }
+        if (compiler->mode == SHADER_COMPILER_PARALLEL)
+        {
+            shaderCompiler_advance(compiler, job, false);
+        }
+        else if (job->finished)
+        {
+            shaderCompiler_finish(compiler, job, job->program);
+        }
+    }
+    shaderCompiler_unlock(compiler);
+}
+
+// Blocks until the program is built, for programs nothing can be drawn
+// without.
+ShaderProgramState shaderCompiler_wait(ShaderCompiler* compiler, ShaderProgramHandle handle)
+{
+    if (handle >= compiler->jobCount)
+    {
+        return SHADER_PROGRAM_FAILED;
+    }
+
+    shaderCompiler_lock(compiler);
+    if (compiler->jobs[handle].state == SHADER_PROGRAM_PENDING)
+    {
+        if (compiler->mode == SHADER_COMPILER_PARALLEL)
+        {
+            shaderCompiler_advance(compiler, &compiler->jobs[handle], true);
+        }
+        else
+        {
+            while (!compiler->jobs[handle].finished)
+            {
+                pthread_cond_wait(&compiler->done, &compiler->mutex);
+            }
+            shaderCompiler_finish(compiler, &compiler->jobs[handle], compiler->jobs[handle].program);
+        }
+    }
+    const ShaderProgramState state = compiler->jobs[handle].state;
+    shaderCompiler_unlock(compiler);
+    return state;
+}
+
+ShaderProgramState shaderCompiler_state(const ShaderCompiler* compiler, ShaderProgramHandle handle)
+{
+    return handle < compiler->jobCount ? compiler->jobs[handle].state : SHADER_PROGRAM_FAILED;
+}
+
+// NULL until the program is ready. The pointer stays valid until the next
+// submit.
+Shader* shaderCompiler_get(ShaderCompiler* compiler, ShaderProgramHandle handle)
+{
+    return shaderCompiler_state(compiler, handle) == SHADER_PROGRAM_READY ? &compiler->jobs[handle].shader : NULL;
+}
+
+static const char* shaderCompiler_modeName(ShaderCompilerMode mode)
+{
+    switch (mode)
+    {
+        case SHADER_COMPILER_PARALLEL:
+            return "parallel";
+        case SHADER_COMPILER_THREADED:
+            return "threaded";
+        default:
+            return "synchronous";
+    }
+}
+
+void shaderCompiler_log(const ShaderCompiler* compiler)
+{
+    const uint64_t built = compiler->stats.ready + compiler->stats.failed;
+    printf(
+        "Shader compiler (%s): %llu programs, %llu from cache, %llu failed, %llu pending, %.2f ms mean wait, %.2f ms max wait\n",
+        shaderCompiler_modeName(compiler->mode),
+        (unsigned long long)compiler->stats.submitted,
+        (unsigned long long)compiler->stats.cacheHits,
+        (unsigned long long)compiler->stats.failed,
+        (unsigned long long)compiler->pendingCount,
+        built > 0 ? compiler->stats.waitMilliseconds / (double)built : 0.0,
+        compiler->stats.maxWaitMilliseconds
+    );
+}
+
+void shaderCompiler_delete(ShaderCompiler* compiler)
+{
+    if (compiler->mode == SHADER_COMPILER_THREADED)
+    {
+        pthread_mutex_lock(&compiler->mutex);
+        compiler->quit = true;
+        pthread_cond_broadcast(&compiler->wake);
+        pthread_mutex_unlock(&compiler->mutex);
+        pthread_join(compiler->worker, NULL);
+        pthread_mutex_destroy(&compiler->mutex);
+        pthread_cond_destroy(&compiler->wake);
+        pthread_cond_destroy(&compiler->done);
+    }
+
+    for (uint32_t i = 0; i < compiler->jobCount; i++)
+    {
+        ShaderJob* job = &compiler->jobs[i];
+        if (job->state == SHADER_PROGRAM_READY)
+        {
+            shader_delete(&job->shader);
+        }
+        shaderCompiler_deleteStages(job);
+        if (job->program != 0)
+        {
+            glDeleteProgram(job->program);
+        }
+        for (uint32_t j = 0; j < job->stageCount; j++)
+        {
+            free(job->sources[j]);
+        }
+    }
+    free(compiler->jobs);
+    free(compiler);
+}
@@ -1,4 +1,8 @@
+#include <stdint.h>
+#include <float.h>
+
 #include "../include/Space.h"
+#include "../include/SpaceSimd.h"
 
 const float PI = 3.141593f;
 
@@ -12,6 +16,36 @@ float degrees(float radians)
     return radians * 180.f / PI;
 }
 
+static inline float sumOfSquares2(float x, float y)
+{
+#if defined(__FP_FAST_FMAF)
+    return fmaf(x, x, y * y);
+#else
+    return x * x + y * y;
+#endif
+}
+
+static inline float sumOfSquares3(float x, float y, float z)
+{
+#if defined(__FP_FAST_FMAF)
+    return fmaf(x, x, fmaf(y, y, z * z));
+#else
+    return x * x + y * y + z * z;
+#endif
+}
+
+// False for a squared length of zero, one that underflowed to a denormal or
+// zero, and one that overflowed, where sqrtf of the float sum is wrong.
+static inline bool inFloatRange(float lengthSquared)
+{
+    return lengthSquared >= FLT_MIN && lengthSquared <= FLT_MAX;
+}
+
+static double lengthDouble3(float x, float y, float z)
+{
+    return sqrt((double)x * x + (double)y * y + (double)z * z);
+}
+
 Vec2 vec2(float x, float y)
 {
     Vec2 vec =
@@ -24,16 +58,19 @@ Vec2 vec2(float x, float y)
 
 float vec2_length(Vec2 vec)
 {
-    return (float)(sqrt(pow(vec.x, 2) + pow(vec.y, 2)));
+    const float lengthSquared = sumOfSquares2(vec.x, vec.y);
+    return inFloatRange(lengthSquared) ? sqrtf(lengthSquared) : (float)lengthDouble3(vec.x, vec.y, 0.f);
 }
 
 Vec2 vec2_normalize(Vec2 vec)
 {
-    float length = vec2_length(vec);
-    if (length == 0.f)
+    const float lengthSquared = sumOfSquares2(vec.x, vec.y);
+    if (!inFloatRange(lengthSquared))
     {
-        return vec2(0.f, 0.f);
+        const double length = lengthDouble3(vec.x, vec.y, 0.f);
+        return length > 0.0 ? vec2((float)(vec.x / length), (float)(vec.y / length)) : vec2(0.f, 0.f);
     }
+    const float length = sqrtf(lengthSquared);
     Vec2 normalizedVec =
     {
         .x = vec.x / length,
@@ -44,14 +81,7 @@ Vec2 vec2_normalize(Vec2 vec)
 
 void vec2_normalize_inplace(Vec2* vec)
 {
-    float length = vec2_length(*vec);
-    if (length == 0.f)
-    {
-        vec->x = 0.f;
-        vec->y = 0.f;
-    }
-    vec->x /= length;
-    vec->y /= length;
+    *vec = vec2_normalize(*vec);
 }
 
 Vec2 vec2_add(Vec2 vecOne, Vec2 vecTwo)
@@ -150,16 +180,19 @@ Vec3 vec3(float x, float y, float z)
 
 float vec3_length(Vec3 vec)
 {
-    return (float)(sqrt(pow(vec.x, 2) + pow(vec.y, 2) + pow(vec.z, 2)));
+    const float lengthSquared = sumOfSquares3(vec.x, vec.y, vec.z);
+    return inFloatRange(lengthSquared) ? sqrtf(lengthSquared) : (float)lengthDouble3(vec.x, vec.y, vec.z);
 }
 
 Vec3 vec3_normalize(Vec3 vec)
 {
-    float length = vec3_length(vec);
-    if (length == 0.f)
+    const float lengthSquared = sumOfSquares3(vec.x, vec.y, vec.z);
+    if (!inFloatRange(lengthSquared))
     {
-        return vec3(0.f, 0.f, 0.f);
+        const double length = lengthDouble3(vec.x, vec.y, vec.z);
+        return length > 0.0 ? vec3((float)(vec.x / length), (float)(vec.y / length), (float)(vec.z / length)) : vec3(0.f, 0.f, 0.f);
     }
+    const float length = sqrtf(lengthSquared);
     Vec3 normalizedVec =
     {
         .x = vec.x / length,
@@ -171,16 +204,7 @@ Vec3 vec3_normalize(Vec3 vec)
 
 void vec3_normalize_inplace(Vec3* vec)
 {
-    float length = vec3_length(*vec);
-    if (length == 0.f)
-    {
-        vec->x = 0.f;
-        vec->y = 0.f;
-        vec->z = 0.f;
-    }
-    vec->x /= length;
-    vec->y /= length;
-    vec->z /= length;
+    *vec = vec3_normalize(*vec);
 }
 
 Vec3 vec3_add(Vec3 vecOne, Vec3 vecTwo)
@@ -292,17 +316,20 @@ Mat4* mat4(float diagonalValue)
     {
         return NULL;
     }
+    mat4_load_diagonal(mat, diagonalValue);
+    return mat;
+}
+
+void mat4_load_diagonal(Mat4* mat, float diagonalValue)
+{
     for (int i = 0; i < 4; i++)
         for (int j = 0; j < 4; j++)
             (*mat)[i][j] = (i == j) ? diagonalValue : 0.f;
-    return mat;
 }
 
 void mat4_load_identity(Mat4* mat)
 {
-    for (int i = 0; i < 4; i++)
-        for (int j = 0; j < 4; j++)
-            (*mat)[i][j] = (i == j) ? 1.f : 0.f;
+    mat4_load_diagonal(mat, 1.f);
 }
 
 void mat4_copy(Mat4* source, Mat4* target)
@@ -331,35 +358,121 @@ Mat4* mat4_scale(Mat4* mat, float scalar)
     {
         return NULL;
     }
+    mat4_scale_to(mat, scalar, result);
+    return result;
+}
+
+void mat4_scale_inplace(Mat4* mat, float scalar)
+{
+    mat4_scale_to(mat, scalar, mat);
+}
+
+void mat4_scale_to(Mat4* mat, float scalar, Mat4* target)
+{
     for (int i = 0; i < 4; i++)
         for (int j = 0; j < 4; j++)
-            (*result)[i][j] = (*mat)[i][j] * scalar;
-    return result;
+            (*target)[i][j] = (*mat)[i][j] * scalar;
 }
 
 Mat4* mat4_multiply(Mat4* matOne, Mat4* matTwo)
 {
-    Mat4* result = mat4(0.f);
+    Mat4* result = malloc(sizeof(Mat4));
     if (result == NULL)
     {
         return NULL;
     }
-    for (int i = 0; i < 4; i++)
-        for (int j = 0; j < 4; j++)
-            for (int k = 0; k < 4; k++)
-                (*result)[i][j] += (*matOne)[i][k] * (*matTwo)[k][j];
+    mat4_multiply_to(matOne, matTwo, result);
     return result;
 }
 
 void mat4_multiply_inplace(Mat4* matOne, Mat4* matTwo)
 {
-    Mat4* temp = mat4(0.f);
-    for (int i = 0; i < 4; i++)
-        for (int j = 0; j < 4; j++)
-            for (int k = 0; k < 4; k++)
-                (*temp)[i][j] += (*matOne)[i][k] * (*matTwo)[k][j];
-    mat4_copy(temp, matOne);
-    free(temp);
+    mat4_multiply_to(matOne, matTwo, matOne);
+}
+
+void mat4_multiply_to(Mat4* matOne, Mat4* matTwo, Mat4* target)
+{
+    mat4_kernels()->multiply(matOne, matTwo, target);
+}
+
+void mat4_transpose_inplace(Mat4* mat)
+{
+    mat4_kernels()->transpose(mat, mat);
+}
+
+void mat4_transpose_to(Mat4* mat, Mat4* target)
+{
+    mat4_kernels()->transpose(mat, target);
+}
+
+Vec3 mat4_transform_point(Mat4* mat, Vec3 point)
+{
+    return mat4_kernels()->transformPoint(mat, point);
+}
+
+Mat4* mat4_inverse(Mat4* mat)
+{
+    Mat4* result = malloc(sizeof(Mat4));
+    if (result == NULL)
+    {
+        return NULL;
+    }
+    if (!mat4_inverse_to(mat, result))
+    {
+        free(result);
+        return NULL;
+    }
+    return result;
+}
+
+bool mat4_inverse_inplace(Mat4* mat)
+{
+    return mat4_kernels()->inverse(mat, mat);
+}
+
+bool mat4_inverse_to(Mat4* mat, Mat4* target)
+{
+    // Leaves target untouched and returns false for singular matrices.
+    return mat4_kernels()->inverse(mat, target);
+}
+
+bool mat4_normal_matrix_to(Mat4* mat, Mat3* target)
+{
+    Affine affine;
+    affine_from_mat4(mat, &affine);
+    return affine_normal_matrix_to(&affine, target);
+}
+
+bool mat4_decompose(Mat4* mat, Vec3* translation, Mat3* rotation, Vec3* scale)
+{
+    // Splits an affine matrix into translation, rotation and per-axis scale,
+    // ignoring the bottom row. Shear is not recovered, and a reflection is
+    // folded into a negative x scale so the rotation stays proper.
+    Vec3 columns[3];
+    for (int i = 0; i < 3; i++)
+        columns[i] = vec3((*mat)[i][0], (*mat)[i][1], (*mat)[i][2]);
+
+    Vec3 axisScale = vec3(vec3_length(columns[0]), vec3_length(columns[1]), vec3_length(columns[2]));
+    if (axisScale.x == 0.f || axisScale.y == 0.f || axisScale.z == 0.f)
+    {
+        return false;
+    }
+    if (vec3_dot(columns[0], vec3_cross(columns[1], columns[2])) < 0.f)
+    {
+        axisScale.x = -axisScale.x;
+    }
+
+    const float scales[3] = { axisScale.x, axisScale.y, axisScale.z };
+    for (int i = 0; i < 3; i++)
+    {
+        const Vec3 axis = vec3_div(columns[i], scales[i]);
+        (*rotation)[i][0] = axis.x;
+        (*rotation)[i][1] = axis.y;
+        (*rotation)[i][2] = axis.z;
+    }
+    *translation = vec3((*mat)[3][0], (*mat)[3][1], (*mat)[3][2]);
+    *scale = axisScale;
+    return true;
 }
 
 Mat4* mat4_multiply_many(int count, ...)
@@ -370,10 +483,15 @@ Mat4* mat4_multiply_many(int count, ...)
     va_list args;
     va_start(args, count);
 
-    Mat4* result = mat4(1.f);
     Mat4* first = va_arg(args, Mat4*);
+    if (first == NULL)
+    {
+        va_end(args);
+        return NULL;
+    }
 
-    if (result == NULL || first == NULL)
+    Mat4* result = malloc(sizeof(Mat4));
+    if (result == NULL)
     {
         va_end(args);
         return NULL;
@@ -384,9 +502,7 @@ Mat4* mat4_multiply_many(int count, ...)
     for (int i = 1; i < count; i++)
     {
         Mat4* next = va_arg(args, Mat4*);
-        Mat4* temp = mat4_multiply(result, next);
-        free(result);
-        result = temp;
+        mat4_multiply_inplace(result, next);
     }
 
     va_end(args);
@@ -414,12 +530,7 @@ void mat4_multiply_many_inplace(Mat4* mat, int count, ...)
     {
         if (matrices[i] != NULL)
         {
-            Mat4* newResult = mat4_multiply(matrices[i], &tempResult);
-            if (newResult != NULL)
-            {
-                mat4_copy(newResult, &tempResult);
-                free(newResult);
-            }
+            mat4_multiply_to(matrices[i], &tempResult, &tempResult);
         }
     }
 
@@ -434,10 +545,7 @@ Mat4* mat4_translate(Mat4* mat, Vec3 vec)
     {
         return NULL;
     }
-    mat4_copy(mat, result);
-    (*result)[3][0] += vec.x;
-    (*result)[3][1] += vec.y;
-    (*result)[3][2] += vec.z;
+    mat4_translate_to(mat, vec, result);
     return result;
 }
 
@@ -448,63 +556,74 @@ void mat4_translate_inplace(Mat4* mat, Vec3 vec)
     (*mat)[3][2] += vec.z;
 }
 
-Mat4* mat4_rotate(Mat4* mat, float degrees, Vec3 rotationVec)
+void mat4_translate_to(Mat4* mat, Vec3 vec, Mat4* target)
+{
+    if (target != mat)
+    {
+        mat4_copy(mat, target);
+    }
+    mat4_translate_inplace(target, vec);
+}
+
+static void mat4_rotation(Mat4* mat, float degrees, Vec3 rotationVec, Mat4* target)
 {
-    Mat4* result = mat4(0.f);
     Vec3 normalizedRotationVec = vec3_normalize(rotationVec);
-    mat4_copy(mat, result);
+    mat4_copy(mat, target);
 
     const float sinTheta = sinf(radians(degrees));
     const float cosTheta = cosf(radians(degrees));
     const float oneMinusCosTheta = 1.f - cosTheta;
 
-    (*result)[0][0] = cosTheta + normalizedRotationVec.x * normalizedRotationVec.x * oneMinusCosTheta;
-    (*result)[0][1] = normalizedRotationVec.x * normalizedRotationVec.y * oneMinusCosTheta - normalizedRotationVec.z * sinTheta;
-    (*result)[0][2] = normalizedRotationVec.x * normalizedRotationVec.z * oneMinusCosTheta + normalizedRotationVec.y * sinTheta;
-    (*result)[1][0] = normalizedRotationVec.y * normalizedRotationVec.x * oneMinusCosTheta + normalizedRotationVec.z * sinTheta;
-    (*result)[1][1] = cosTheta + normalizedRotationVec.y * normalizedRotationVec.y * oneMinusCosTheta;
-    (*result)[1][2] = normalizedRotationVec.y * normalizedRotationVec.z * oneMinusCosTheta - normalizedRotationVec.x * sinTheta;
-    (*result)[2][0] = normalizedRotationVec.z * normalizedRotationVec.x * oneMinusCosTheta - normalizedRotationVec.y * sinTheta;
-    (*result)[2][1] = normalizedRotationVec.z * normalizedRotationVec.y * oneMinusCosTheta + normalizedRotationVec.x * sinTheta;
-    (*result)[2][2] = cosTheta + normalizedRotationVec.z * normalizedRotationVec.z * oneMinusCosTheta;
-
-    mat4_multiply_inplace(result, mat);
+    (*target)[0][0] = cosTheta + normalizedRotationVec.x * normalizedRotationVec.x * oneMinusCosTheta;
+    (*target)[0][1] = normalizedRotationVec.x * normalizedRotationVec.y * oneMinusCosTheta - normalizedRotationVec.z * sinTheta;
+    (*target)[0][2] = normalizedRotationVec.x * normalizedRotationVec.z * oneMinusCosTheta + normalizedRotationVec.y * sinTheta;
+    (*target)[1][0] = normalizedRotationVec.y * normalizedRotationVec.x * oneMinusCosTheta + normalizedRotationVec.z * sinTheta;
+    (*target)[1][1] = cosTheta + normalizedRotationVec.y * normalizedRotationVec.y * oneMinusCosTheta;
+    (*target)[1][2] = normalizedRotationVec.y * normalizedRotationVec.z * oneMinusCosTheta - normalizedRotationVec.x * sinTheta;
+    (*target)[2][0] = normalizedRotationVec.z * normalizedRotationVec.x * oneMinusCosTheta - normalizedRotationVec.y * sinTheta;
+    (*target)[2][1] = normalizedRotationVec.z * normalizedRotationVec.y * oneMinusCosTheta + normalizedRotationVec.x * sinTheta;
+    (*target)[2][2] = cosTheta + normalizedRotationVec.z * normalizedRotationVec.z * oneMinusCosTheta;
+}
+
+Mat4* mat4_rotate(Mat4* mat, float degrees, Vec3 rotationVec)
+{
+    Mat4* result = malloc(sizeof(Mat4));
+    if (result == NULL)
+    {
+        return NULL;
+    }
+    mat4_rotate_to(mat, degrees, rotationVec, result);
     return result;
 }
 
 void mat4_rotate_inplace(Mat4* mat, float degrees, Vec3 rotationVec)
 {
-    Mat4* rotationMat = mat4(0.f);
-    Vec3 normalizedRotationVec = vec3_normalize(rotationVec);
-    mat4_copy(mat, rotationMat);
-
-    const float sinTheta = sinf(radians(degrees));
-    const float cosTheta = cosf(radians(degrees));
-    const float oneMinusCosTheta = 1.f - cosTheta;
-
-    (*rotationMat)[0][0] = cosTheta + normalizedRotationVec.x * normalizedRotationVec.x * oneMinusCosTheta;
-    (*rotationMat)[0][1] = normalizedRotationVec.x * normalizedRotationVec.y * oneMinusCosTheta - normalizedRotationVec.z * sinTheta;
-    (*rotationMat)[0][2] = normalizedRotationVec.x * normalizedRotationVec.z * oneMinusCosTheta + normalizedRotationVec.y * sinTheta;
-    (*rotationMat)[1][0] = normalizedRotationVec.y * normalizedRotationVec.x * oneMinusCosTheta + normalizedRotationVec.z * sinTheta;
-    (*rotationMat)[1][1] = cosTheta + normalizedRotationVec.y * normalizedRotationVec.y * oneMinusCosTheta;
-    (*rotationMat)[1][2] = normalizedRotationVec.y * normalizedRotationVec.z * oneMinusCosTheta - normalizedRotationVec.x * sinTheta;
-    (*rotationMat)[2][0] = normalizedRotationVec.z * normalizedRotationVec.x * oneMinusCosTheta - normalizedRotationVec.y * sinTheta;
-    (*rotationMat)[2][1] = normalizedRotationVec.z * normalizedRotationVec.y * oneMinusCosTheta + normalizedRotationVec.x * sinTheta;
-    (*rotationMat)[2][2] = cosTheta + normalizedRotationVec.z * normalizedRotationVec.z * oneMinusCosTheta;
+    Mat4 rotationMat;
+    mat4_rotation(mat, degrees, rotationVec, &rotationMat);
+    mat4_multiply_inplace(mat, &rotationMat);
+}
 
-    mat4_multiply_inplace(mat, rotationMat);
-    free(rotationMat);
+void mat4_rotate_to(Mat4* mat, float degrees, Vec3 rotationVec, Mat4* target)
+{
+    Mat4 rotationMat;
+    mat4_rotation(mat, degrees, rotationVec, &rotationMat);
+    mat4_multiply_to(&rotationMat, mat, target);
 }
 
 Mat4* mat4_ortho(float left, float right, float bottom, float top, float zNear, float zFar)
 {
-    Mat4* result = mat4(1.f);
+    Mat4* result = malloc(sizeof(Mat4));
+    if (result == NULL)
+    {
+        return NULL;
+    }
     mat4_ortho_inplace(result, left, right, bottom, top, zNear, zFar);
     return result;
 }
 
 void mat4_ortho_inplace(Mat4* mat, float left, float right, float bottom, float top, float zNear, float zFar)
 {
+    mat4_load_identity(mat);
     (*mat)[0][0] =  2.f / (right - left);
     (*mat)[1][1] =  2.f / (top - bottom);
     (*mat)[2][2] = -2.f / (zFar - zNear);
@@ -516,7 +635,11 @@ void mat4_ortho_inplace(Mat4* mat, float left, float right, float bottom, float
 
 Mat4* mat4_perspective(float fov, float aspect, float zNear, float zFar)
 {
-    Mat4* result = mat4(0.f);
+    Mat4* result = malloc(sizeof(Mat4));
+    if (result == NULL)
+    {
+        return NULL;
+    }
     mat4_perspective_inplace(result, fov, aspect, zNear, zFar);
     return result;
 }
@@ -524,6 +647,7 @@ Mat4* mat4_perspective(float fov, float aspect, float zNear, float zFar)
 void mat4_perspective_inplace(Mat4* mat, float fov, float aspect, float zNear, float zFar)
 {
     float halfTanFov = tanf(radians(fov) / 2.f);
+    mat4_load_diagonal(mat, 0.f);
     (*mat)[0][0] = 1.f / (halfTanFov * aspect);
     (*mat)[1][1] = 1.f / halfTanFov;
     (*mat)[2][2] = (zFar + zNear) / (zNear - zFar);
@@ -534,7 +658,11 @@ void mat4_perspective_inplace(Mat4* mat, float fov, float aspect, float zNear, f
 
 Mat4* mat4_lookAt(Vec3 eye, Vec3 target, Vec3 up)
 {
-    Mat4* result = mat4(0.f);
+    Mat4* result = malloc(sizeof(Mat4));
+    if (result == NULL)
+    {
+        return NULL;
+    }
     mat4_lookAt_inplace(result, eye, target, up);
     return result;
 }
@@ -560,3 +688,452 @@ void mat4_lookAt_inplace(Mat4* mat, Vec3 eye, Vec3 target, Vec3 up)
     (*mat)[3][2] = -vec3_dot(front, eye);
     (*mat)[3][3] = 1.f;
 }
+
+void mat4_view_inplace(Mat4* mat, Vec3 eye, Quat orientation)
+{
+    // Same layout as mat4_lookAt_inplace, with the camera axes taken from
+    // the orientation (the camera looks down its local -Z).
+    Mat3 rotation;
+    quat_toMat3(orientation, &rotation);
+    const Vec3 right = vec3(rotation[0][0], rotation[0][1], rotation[0][2]);
+    const Vec3 up = vec3(rotation[1][0], rotation[1][1], rotation[1][2]);
+    const Vec3 back = vec3(rotation[2][0], rotation[2][1], rotation[2][2]);
+
+    (*mat)[0][0] = right.x;
+    (*mat)[1][0] = right.y;
+    (*mat)[2][0] = right.z;
+    (*mat)[0][1] = up.x;
+    (*mat)[1][1] = up.y;
+    (*mat)[2][1] = up.z;
+    (*mat)[0][2] = back.x;
+    (*mat)[1][2] = back.y;
+    (*mat)[2][2] = back.z;
+    (*mat)[0][3] = 0.f;
+    (*mat)[1][3] = 0.f;
+    (*mat)[2][3] = 0.f;
+    (*mat)[3][0] = -vec3_dot(right, eye);
+    (*mat)[3][1] = -vec3_dot(up, eye);
+    (*mat)[3][2] = -vec3_dot(back, eye);
+    (*mat)[3][3] = 1.f;
+}
+
+Affine* affine(void)
+{
+    Affine* mat = malloc(sizeof(Affine));
+    if (mat == NULL)
+    {
+        return NULL;
+    }
+    affine_load_identity(mat);
+    return mat;
+}
+
+void affine_load_identity(Affine* mat)
+{
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 3; j++)
+            (*mat)[i][j] = (i == j) ? 1.f : 0.f;
+}
+
+void affine_copy(Affine* source, Affine* target)
+{
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 3; j++)
+            (*target)[i][j] = (*source)[i][j];
+}
+
+void affine_from_mat4(Mat4* mat, Affine* target)
+{
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 3; j++)
+            (*target)[i][j] = (*mat)[i][j];
+}
+
+void affine_to_mat4(Affine* mat, Mat4* target)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        for (int j = 0; j < 3; j++)
+            (*target)[i][j] = (*mat)[i][j];
+        (*target)[i][3] = (i == 3) ? 1.f : 0.f;
+    }
+}
+
+void affine_multiply_inplace(Affine* matOne, Affine* matTwo)
+{
+    affine_multiply_to(matOne, matTwo, matOne);
+}
+
+void affine_multiply_to(Affine* matOne, Affine* matTwo, Affine* target)
+{
+    // Same operand order as mat4_multiply_to, with the constant bottom row
+    // folded away: 36 multiplies instead of 64.
+    mat4_kernels()->affineMultiply(matOne, matTwo, target);
+}
+
+Vec3 affine_transform_point(Affine* mat, Vec3 point)
+{
+    return vec3(
+        (*mat)[0][0] * point.x + (*mat)[1][0] * point.y + (*mat)[2][0] * point.z + (*mat)[3][0],
+        (*mat)[0][1] * point.x + (*mat)[1][1] * point.y + (*mat)[2][1] * point.z + (*mat)[3][1],
+        (*mat)[0][2] * point.x + (*mat)[1][2] * point.y + (*mat)[2][2] * point.z + (*mat)[3][2]
+    );
+}
+
+Vec3 affine_transform_direction(Affine* mat, Vec3 direction)
+{
+    return vec3(
+        (*mat)[0][0] * direction.x + (*mat)[1][0] * direction.y + (*mat)[2][0] * direction.z,
+        (*mat)[0][1] * direction.x + (*mat)[1][1] * direction.y + (*mat)[2][1] * direction.z,
+        (*mat)[0][2] * direction.x + (*mat)[1][2] * direction.y + (*mat)[2][2] * direction.z
+    );
+}
+
+void affine_translate_inplace(Affine* mat, Vec3 vec)
+{
+    (*mat)[3][0] += vec.x;
+    (*mat)[3][1] += vec.y;
+    (*mat)[3][2] += vec.z;
+}
+
+static inline Vec3 affine_column(Affine* mat, int index)
+{
+    return vec3((*mat)[index][0], (*mat)[index][1], (*mat)[index][2]);
+}
+
+// Writes the 3x3 matrix with the given rows into the linear part of target.
+static inline void affine_store_rows(Affine* target, Vec3 rowZero, Vec3 rowOne, Vec3 rowTwo)
+{
+    (*target)[0][0] = rowZero.x; (*target)[1][0] = rowZero.y; (*target)[2][0] = rowZero.z;
+    (*target)[0][1] = rowOne.x;  (*target)[1][1] = rowOne.y;  (*target)[2][1] = rowOne.z;
+    (*target)[0][2] = rowTwo.x;  (*target)[1][2] = rowTwo.y;  (*target)[2][2] = rowTwo.z;
+}
+
+void affine_inverse_rigid_to(Affine* mat, Affine* target)
+{
+    // Only valid for rotation + translation: the inverse rotation is the
+    // transpose and the translation is rotated back and negated.
+    const Vec3 columnZero = affine_column(mat, 0);
+    const Vec3 columnOne = affine_column(mat, 1);
+    const Vec3 columnTwo = affine_column(mat, 2);
+    const Vec3 translation = affine_column(mat, 3);
+
+    affine_store_rows(target, columnZero, columnOne, columnTwo);
+    (*target)[3][0] = -vec3_dot(columnZero, translation);
+    (*target)[3][1] = -vec3_dot(columnOne, translation);
+    (*target)[3][2] = -vec3_dot(columnTwo, translation);
+}
+
+bool affine_inverse_to(Affine* mat, Affine* target)
+{
+    const Vec3 columnZero = affine_column(mat, 0);
+    const Vec3 columnOne = affine_column(mat, 1);
+    const Vec3 columnTwo = affine_column(mat, 2);
+    const Vec3 translation = affine_column(mat, 3);
+
+    // The rows of the inverse are the pairwise cross products of the
+    // columns divided by the determinant.
+    const Vec3 crossOneTwo = vec3_cross(columnOne, columnTwo);
+    const Vec3 crossTwoZero = vec3_cross(columnTwo, columnZero);
+    const Vec3 crossZeroOne = vec3_cross(columnZero, columnOne);
+    const float determinant = vec3_dot(columnZero, crossOneTwo);
+    if (fabsf(determinant) < 1e-12f)
+    {
+        return false;
+    }
+
+    const float inverseDeterminant = 1.f / determinant;
+    const Vec3 rowZero = vec3_scale(crossOneTwo, inverseDeterminant);
+    const Vec3 rowOne = vec3_scale(crossTwoZero, inverseDeterminant);
+    const Vec3 rowTwo = vec3_scale(crossZeroOne, inverseDeterminant);
+
+    affine_store_rows(target, rowZero, rowOne, rowTwo);
+    (*target)[3][0] = -vec3_dot(rowZero, translation);
+    (*target)[3][1] = -vec3_dot(rowOne, translation);
+    (*target)[3][2] = -vec3_dot(rowTwo, translation);
+    return true;
+}
+
+bool affine_normal_matrix_to(Affine* mat, Mat3* target)
+{
+    // Inverse transpose of the linear part, so its columns are the cross
+    // products that form the rows of the inverse.
+    const Vec3 columnZero = affine_column(mat, 0);
+    const Vec3 columnOne = affine_column(mat, 1);
+    const Vec3 columnTwo = affine_column(mat, 2);
+
+    const Vec3 crossOneTwo = vec3_cross(columnOne, columnTwo);
+    const float determinant = vec3_dot(columnZero, crossOneTwo);
+    if (fabsf(determinant) < 1e-12f)
+    {
+        return false;
+    }
+
+    const float inverseDeterminant = 1.f / determinant;
+    const Vec3 columns[3] =
+    {
+        vec3_scale(crossOneTwo, inverseDeterminant),
+        vec3_scale(vec3_cross(columnTwo, columnZero), inverseDeterminant),
+        vec3_scale(vec3_cross(columnZero, columnOne), inverseDeterminant),
+    };
+    for (int i = 0; i < 3; i++)
+    {
+        (*target)[i][0] = columns[i].x;
+        (*target)[i][1] = columns[i].y;
+        (*target)[i][2] = columns[i].z;
+    }
+    return true;
+}
+
+void affine_log(Affine* mat)
+{
+    for (int i = 0; i < 4; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            printf("%.2f ", (*mat)[i][j]);
+        }
+        printf("\n");
+    }
+}
+
+Quat quat(float x, float y, float z, float w)
+{
+    Quat result =
+    {
+        .x = x,
+        .y = y,
+        .z = z,
+        .w = w,
+    };
+    return result;
+}
+
+Quat quat_identity(void)
+{
+    return quat(0.f, 0.f, 0.f, 1.f);
+}
+
+Quat quat_fromAxisAngle(Vec3 axis, float degrees)
+{
+    const float halfAngle = radians(degrees) * 0.5f;
+    const Vec3 scaledAxis = vec3_scale(vec3_normalize(axis), sinf(halfAngle));
+    return quat(scaledAxis.x, scaledAxis.y, scaledAxis.z, cosf(halfAngle));
+}
+
+Quat quat_fromAxisAngle_fast(Vec3 axis, float degrees)
+{
+    // Trig-free: sin and cos of the half angle from their second-order
+    // Taylor terms, renormalised by the length of the pair. The angle
+    // error grows with the cube of the angle, so this is meant for
+    // small per-frame increments (under 0.1 degrees off at 10 degrees).
+    // Unlike quat_fromAxisAngle, the axis must already be unit length.
+    const float halfAngle = radians(degrees) * 0.5f;
+    const float cosine = 1.f - 0.5f * halfAngle * halfAngle;
+    const float scale = 1.f / sqrtf(halfAngle * halfAngle + cosine * cosine);
+    const float sine = halfAngle * scale;
+    return quat(axis.x * sine, axis.y * sine, axis.z * sine, cosine * scale);
+}
+
+Quat quat_fromMat3(Mat3* mat)
+{
+    // Shepperd's method: pivot on the largest diagonal term for stability.
+    const float (*m)[3] = (const float (*)[3])(*mat);
+    const float trace = m[0][0] + m[1][1] + m[2][2];
+    Quat result;
+    if (trace > 0.f)
+    {
+        const float s = sqrtf(trace + 1.f) * 2.f;
+        result = quat((m[1][2] - m[2][1]) / s, (m[2][0] - m[0][2]) / s, (m[0][1] - m[1][0]) / s, 0.25f * s);
+    }
+    else if (m[0][0] > m[1][1] && m[0][0] > m[2][2])
+    {
+        const float s = sqrtf(1.f + m[0][0] - m[1][1] - m[2][2]) * 2.f;
+        result = quat(0.25f * s, (m[1][0] + m[0][1]) / s, (m[2][0] + m[0][2]) / s, (m[1][2] - m[2][1]) / s);
+    }
+    else if (m[1][1] > m[2][2])
+    {
+        const float s = sqrtf(1.f + m[1][1] - m[0][0] - m[2][2]) * 2.f;
+        result = quat((m[1][0] + m[0][1]) / s, 0.25f * s, (m[2][1] + m[1][2]) / s, (m[2][0] - m[0][2]) / s);
+    }
+    else
+    {
+        const float s = sqrtf(1.f + m[2][2] - m[0][0] - m[1][1]) * 2.f;
+        result = quat((m[2][0] + m[0][2]) / s, (m[2][1] + m[1][2]) / s, 0.25f * s, (m[0][1] - m[1][0]) / s);
+    }
+    return quat_normalize(result);
+}
+
+Quat quat_fromMat4(Mat4* mat)
+{
+    // Expects a pure rotation in the upper 3x3; use mat4_decompose first if
+    // the matrix is scaled.
+    Mat3 rotation;
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            rotation[i][j] = (*mat)[i][j];
+    return quat_fromMat3(&rotation);
+}
+
+void quat_toMat3(Quat quat, Mat3* target)
+{
+    const float xx = quat.x * quat.x;
+    const float yy = quat.y * quat.y;
+    const float zz = quat.z * quat.z;
+    const float xy = quat.x * quat.y;
+    const float xz = quat.x * quat.z;
+    const float yz = quat.y * quat.z;
+    const float wx = quat.w * quat.x;
+    const float wy = quat.w * quat.y;
+    const float wz = quat.w * quat.z;
+
+    (*target)[0][0] = 1.f - 2.f * (yy + zz);
+    (*target)[0][1] = 2.f * (xy + wz);
+    (*target)[0][2] = 2.f * (xz - wy);
+    (*target)[1][0] = 2.f * (xy - wz);
+    (*target)[1][1] = 1.f - 2.f * (xx + zz);
+    (*target)[1][2] = 2.f * (yz + wx);
+    (*target)[2][0] = 2.f * (xz + wy);
+    (*target)[2][1] = 2.f * (yz - wx);
+    (*target)[2][2] = 1.f - 2.f * (xx + yy);
+}
+
+void quat_toMat4(Quat quat, Mat4* target)
+{
+    Mat3 rotation;
+    quat_toMat3(quat, &rotation);
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++)
+            (*target)[i][j] = (i < 3 && j < 3) ? rotation[i][j] : (i == j) ? 1.f : 0.f;
+}
+
+void quat_toAffine(Quat quat, Vec3 translation, Affine* target)
+{
+    Mat3 rotation;
+    quat_toMat3(quat, &rotation);
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            (*target)[i][j] = rotation[i][j];
+    (*target)[3][0] = translation.x;
+    (*target)[3][1] = translation.y;
+    (*target)[3][2] = translation.z;
+}
+
+Quat quat_multiply(Quat quatOne, Quat quatTwo)
+{
+    // Hamilton product: rotating by the result applies quatTwo, then quatOne.
+    return quat(
+        quatOne.w * quatTwo.x + quatOne.x * quatTwo.w + quatOne.y * quatTwo.z - quatOne.z * quatTwo.y,
+        quatOne.w * quatTwo.y - quatOne.x * quatTwo.z + quatOne.y * quatTwo.w + quatOne.z * quatTwo.x,
+        quatOne.w * quatTwo.z + quatOne.x * quatTwo.y - quatOne.y * quatTwo.x + quatOne.z * quatTwo.w,
+        quatOne.w * quatTwo.w - quatOne.x * quatTwo.x - quatOne.y * quatTwo.y - quatOne.z * quatTwo.z
+    );
+}
+
+void quat_multiply_inplace(Quat* quatOne, Quat quatTwo)
+{
+    *quatOne = quat_multiply(*quatOne, quatTwo);
+}
+
+Quat quat_conjugate(Quat quat)
+{
+    Quat result =
+    {
+        .x = -quat.x,
+        .y = -quat.y,
+        .z = -quat.z,
+        .w = quat.w,
+    };
+    return result;
+}
+
+float quat_dot(Quat quatOne, Quat quatTwo)
+{
+    return quatOne.x * quatTwo.x + quatOne.y * quatTwo.y + quatOne.z * quatTwo.z + quatOne.w * quatTwo.w;
+}
+
+Quat quat_normalize(Quat quat)
+{
+    const float lengthSquared = quat_dot(quat, quat);
+    if (!inFloatRange(lengthSquared))
+    {
+        const double length = sqrt((double)quat.x * quat.x + (double)quat.y * quat.y + (double)quat.z * quat.z + (double)quat.w * quat.w);
+        if (length == 0.0)
+        {
+            return quat_identity();
+        }
+        Quat result =
+        {
+            .x = (float)(quat.x / length),
+            .y = (float)(quat.y / length),
+            .z = (float)(quat.z / length),
+            .w = (float)(quat.w / length),
+        };
+        return result;
+    }
+    const float inverseLength = 1.f / sqrtf(lengthSquared);
+    Quat result =
+    {
+        .x = quat.x * inverseLength,
+        .y = quat.y * inverseLength,
+        .z = quat.z * inverseLength,
+        .w = quat.w * inverseLength,
+    };
+    return result;
+}
+
+void quat_normalize_inplace(Quat* quat)
+{
+    *quat = quat_normalize(*quat);
+}
+
+Vec3 quat_rotate(Quat quat, Vec3 vec)
+{
+    // v' = v + w t + q x t with t = 2 (q x v), cheaper than q v q*.
+    const Vec3 axis = vec3(quat.x, quat.y, quat.z);
+    const Vec3 t = vec3_scale(vec3_cross(axis, vec), 2.f);
+    return vec3_add(vec3_add(vec, vec3_scale(t, quat.w)), vec3_cross(axis, t));
+}
+
+Quat quat_nlerp(Quat quatOne, Quat quatTwo, float t)
+{
+    // Interpolates along the shorter arc; not constant speed, but close to
+    // slerp for small angles and much cheaper.
+    const float sign = quat_dot(quatOne, quatTwo) < 0.f ? -1.f : 1.f;
+    return quat_normalize(quat(
+        quatOne.x + (sign * quatTwo.x - quatOne.x) * t,
+        quatOne.y + (sign * quatTwo.y - quatOne.y) * t,
+        quatOne.z + (sign * quatTwo.z - quatOne.z) * t,
+        quatOne.w + (sign * quatTwo.w - quatOne.w) * t
+    ));
+}
+
+Quat quat_slerp(Quat quatOne, Quat quatTwo, float t)
+{
+    float cosTheta = quat_dot(quatOne, quatTwo);
+    if (cosTheta < 0.f)
+    {
+        quatTwo = quat(-quatTwo.x, -quatTwo.y, -quatTwo.z, -quatTwo.w);
+        cosTheta = -cosTheta;
+    }
+    if (cosTheta > 0.9995f)
+    {
+        return quat_nlerp(quatOne, quatTwo, t);
+    }
+
+    const float theta = acosf(cosTheta);
+    const float inverseSinTheta = 1.f / sinf(theta);
+    const float weightOne = sinf((1.f - t) * theta) * inverseSinTheta;
+    const float weightTwo = sinf(t * theta) * inverseSinTheta;
+    return quat(
+        quatOne.x * weightOne + quatTwo.x * weightTwo,
+        quatOne.y * weightOne + quatTwo.y * weightTwo,
+        quatOne.z * weightOne + quatTwo.z * weightTwo,
+        quatOne.w * weightOne + quatTwo.w * weightTwo
+    );
+}
+
+void quat_log(Quat quat)
+{
+    printf("X: %.2f; Y: %.2f; Z: %.2f; W: %.2f\n", quat.x, quat.y, quat.z, quat.w);
+}
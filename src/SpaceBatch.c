@@ -0,0 +1,371 @@
+#include <float.h>
+
+#include "../include/SpaceBatch.h"
+#include "../include/Simd.h"
+#include "../include/SpaceSimd.h"
+
+static inline float scalar_inverseLength(float lengthSquared)
+{
+    return (lengthSquared == 0.f) ? 0.f : 1.f / sqrtf(lengthSquared);
+}
+
+void vec2soa_normalize(Vec2Soa vecs, Vec2Soa target, size_t count)
+{
+    size_t i = 0;
+#if defined(SIMD_WIDTH)
+    for (; i + SIMD_WIDTH <= count; i += SIMD_WIDTH)
+    {
+        const SimdFloat x = simd_load(vecs.x + i);
+        const SimdFloat y = simd_load(vecs.y + i);
+        const SimdFloat lengthSquared = simd_add(simd_mul(x, x), simd_mul(y, y));
+        const SimdFloat inverseLength = simd_zeroIfZero(simd_div(simd_set(1.f), simd_sqrt(lengthSquared)), lengthSquared);
+        simd_store(target.x + i, simd_mul(x, inverseLength));
+        simd_store(target.y + i, simd_mul(y, inverseLength));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        const float inverseLength = scalar_inverseLength(vecs.x[i] * vecs.x[i] + vecs.y[i] * vecs.y[i]);
+        target.x[i] = vecs.x[i] * inverseLength;
+        target.y[i] = vecs.y[i] * inverseLength;
+    }
+}
+
+void vec2soa_dot(Vec2Soa vecsOne, Vec2Soa vecsTwo, float* target, size_t count)
+{
+    size_t i = 0;
+#if defined(SIMD_WIDTH)
+    for (; i + SIMD_WIDTH <= count; i += SIMD_WIDTH)
+    {
+        const SimdFloat x = simd_mul(simd_load(vecsOne.x + i), simd_load(vecsTwo.x + i));
+        const SimdFloat y = simd_mul(simd_load(vecsOne.y + i), simd_load(vecsTwo.y + i));
+        simd_store(target + i, simd_add(x, y));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        target[i] = vecsOne.x[i] * vecsTwo.x[i] + vecsOne.y[i] * vecsTwo.y[i];
+    }
+}
+
+void vec3soa_transform_points(Mat4* mat, Vec3Soa points, Vec3Soa target, size_t count)
+{
+    size_t i = 0;
+#if defined(SIMD_WIDTH)
+    SimdFloat m[4][3];
+    for (int column = 0; column < 4; column++)
+        for (int row = 0; row < 3; row++)
+            m[column][row] = simd_set((*mat)[column][row]);
+
+    for (; i + SIMD_WIDTH <= count; i += SIMD_WIDTH)
+    {
+        const SimdFloat x = simd_load(points.x + i);
+        const SimdFloat y = simd_load(points.y + i);
+        const SimdFloat z = simd_load(points.z + i);
+        SimdFloat result[3];
+        for (int row = 0; row < 3; row++)
+        {
+            SimdFloat sum = simd_mul(m[0][row], x);
+            sum = simd_add(sum, simd_mul(m[1][row], y));
+            sum = simd_add(sum, simd_mul(m[2][row], z));
+            result[row] = simd_add(sum, m[3][row]);
+        }
+        simd_store(target.x + i, result[0]);
+        simd_store(target.y + i, result[1]);
+        simd_store(target.z + i, result[2]);
+    }
+#endif
+    for (; i < count; i++)
+    {
+        const float x = points.x[i];
+        const float y = points.y[i];
+        const float z = points.z[i];
+        target.x[i] = (*mat)[0][0] * x + (*mat)[1][0] * y + (*mat)[2][0] * z + (*mat)[3][0];
+        target.y[i] = (*mat)[0][1] * x + (*mat)[1][1] * y + (*mat)[2][1] * z + (*mat)[3][1];
+        target.z[i] = (*mat)[0][2] * x + (*mat)[1][2] * y + (*mat)[2][2] * z + (*mat)[3][2];
+    }
+}
+
+void vec3soa_normalize(Vec3Soa vecs, Vec3Soa target, size_t count)
+{
+    size_t i = 0;
+#if defined(SIMD_WIDTH)
+    for (; i + SIMD_WIDTH <= count; i += SIMD_WIDTH)
+    {
+        const SimdFloat x = simd_load(vecs.x + i);
+        const SimdFloat y = simd_load(vecs.y + i);
+        const SimdFloat z = simd_load(vecs.z + i);
+        const SimdFloat lengthSquared = simd_add(simd_add(simd_mul(x, x), simd_mul(y, y)), simd_mul(z, z));
+        const SimdFloat inverseLength = simd_zeroIfZero(simd_div(simd_set(1.f), simd_sqrt(lengthSquared)), lengthSquared);
+        simd_store(target.x + i, simd_mul(x, inverseLength));
+        simd_store(target.y + i, simd_mul(y, inverseLength));
+        simd_store(target.z + i, simd_mul(z, inverseLength));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        const float inverseLength = scalar_inverseLength(
+            vecs.x[i] * vecs.x[i] + vecs.y[i] * vecs.y[i] + vecs.z[i] * vecs.z[i]
+        );
+        target.x[i] = vecs.x[i] * inverseLength;
+        target.y[i] = vecs.y[i] * inverseLength;
+        target.z[i] = vecs.z[i] * inverseLength;
+    }
+}
+
+void vec3soa_dot(Vec3Soa vecsOne, Vec3Soa vecsTwo, float* target, size_t count)
+{
+    size_t i = 0;
+#if defined(SIMD_WIDTH)
+    for (; i + SIMD_WIDTH <= count; i += SIMD_WIDTH)
+    {
+        SimdFloat sum = simd_mul(simd_load(vecsOne.x + i), simd_load(vecsTwo.x + i));
+        sum = simd_add(sum, simd_mul(simd_load(vecsOne.y + i), simd_load(vecsTwo.y + i)));
+        sum = simd_add(sum, simd_mul(simd_load(vecsOne.z + i), simd_load(vecsTwo.z + i)));
+        simd_store(target + i, sum);
+    }
+#endif
+    for (; i < count; i++)
+    {
+        target[i] = vecsOne.x[i] * vecsTwo.x[i] + vecsOne.y[i] * vecsTwo.y[i] + vecsOne.z[i] * vecsTwo.z[i];
+    }
+}
+
+void vec3soa_cross(Vec3Soa vecsOne, Vec3Soa vecsTwo, Vec3Soa target, size_t count)
+{
+    size_t i = 0;
+#if defined(SIMD_WIDTH)
+    for (; i + SIMD_WIDTH <= count; i += SIMD_WIDTH)
+    {
+        const SimdFloat ax = simd_load(vecsOne.x + i);
+        const SimdFloat ay = simd_load(vecsOne.y + i);
+        const SimdFloat az = simd_load(vecsOne.z + i);
+        const SimdFloat bx = simd_load(vecsTwo.x + i);
+        const SimdFloat by = simd_load(vecsTwo.y + i);
+        const SimdFloat bz = simd_load(vecsTwo.z + i);
+        simd_store(target.x + i, simd_sub(simd_mul(ay, bz), simd_mul(az, by)));
+        simd_store(target.y + i, simd_sub(simd_mul(az, bx), simd_mul(ax, bz)));
+        simd_store(target.z + i, simd_sub(simd_mul(ax, by), simd_mul(ay, bx)));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        const Vec3 result = vec3_cross(
+            vec3(vecsOne.x[i], vecsOne.y[i], vecsOne.z[i]),
+            vec3(vecsTwo.x[i], vecsTwo.y[i], vecsTwo.z[i])
+        );
+        target.x[i] = result.x;
+        target.y[i] = result.y;
+        target.z[i] = result.z;
+    }
+}
+
+Aabb vec3soa_aabb(Vec3Soa points, size_t count)
+{
+    Aabb aabb =
+    {
+        .min = vec3(FLT_MAX, FLT_MAX, FLT_MAX),
+        .max = vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX),
+    };
+
+    size_t i = 0;
+#if defined(SIMD_WIDTH)
+    if (count >= SIMD_WIDTH)
+    {
+        SimdFloat minX = simd_set(FLT_MAX), minY = simd_set(FLT_MAX), minZ = simd_set(FLT_MAX);
+        SimdFloat maxX = simd_set(-FLT_MAX), maxY = simd_set(-FLT_MAX), maxZ = simd_set(-FLT_MAX);
+        for (; i + SIMD_WIDTH <= count; i += SIMD_WIDTH)
+        {
+            const SimdFloat x = simd_load(points.x + i);
+            const SimdFloat y = simd_load(points.y + i);
+            const SimdFloat z = simd_load(points.z + i);
+            minX = simd_min(minX, x);
+            minY = simd_min(minY, y);
+            minZ = simd_min(minZ, z);
+            maxX = simd_max(maxX, x);
+            maxY = simd_max(maxY, y);
+            maxZ = simd_max(maxZ, z);
+        }
+        aabb.min = vec3(simd_reduceMin(minX), simd_reduceMin(minY), simd_reduceMin(minZ));
+        aabb.max = vec3(simd_reduceMax(maxX), simd_reduceMax(maxY), simd_reduceMax(maxZ));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        aabb.min = vec3(fminf(aabb.min.x, points.x[i]), fminf(aabb.min.y, points.y[i]), fminf(aabb.min.z, points.z[i]));
+        aabb.max = vec3(fmaxf(aabb.max.x, points.x[i]), fmaxf(aabb.max.y, points.y[i]), fmaxf(aabb.max.z, points.z[i]));
+    }
+    return aabb;
+}
+
+void vec3_batch_transform_points(Mat4* mat, const Vec3* points, Vec3* target, size_t count)
+{
+    size_t i = 0;
+#if defined(SIMD_WIDTH)
+    SimdFloat m[4][3];
+    for (int column = 0; column < 4; column++)
+        for (int row = 0; row < 3; row++)
+            m[column][row] = simd_set((*mat)[column][row]);
+
+    for (; i + SIMD_WIDTH <= count; i += SIMD_WIDTH)
+    {
+        SimdFloat x, y, z;
+        simd_load3(points + i, &x, &y, &z);
+        SimdFloat result[3];
+        for (int row = 0; row < 3; row++)
+        {
+            SimdFloat sum = simd_mul(m[0][row], x);
+            sum = simd_add(sum, simd_mul(m[1][row], y));
+            sum = simd_add(sum, simd_mul(m[2][row], z));
+            result[row] = simd_add(sum, m[3][row]);
+        }
+        simd_store3(target + i, result[0], result[1], result[2]);
+    }
+#endif
+    for (; i < count; i++)
+    {
+        const Vec3 point = points[i];
+        target[i] = vec3(
+            (*mat)[0][0] * point.x + (*mat)[1][0] * point.y + (*mat)[2][0] * point.z + (*mat)[3][0],
+            (*mat)[0][1] * point.x + (*mat)[1][1] * point.y + (*mat)[2][1] * point.z + (*mat)[3][1],
+            (*mat)[0][2] * point.x + (*mat)[1][2] * point.y + (*mat)[2][2] * point.z + (*mat)[3][2]
+        );
+    }
+}
+
+void vec3_batch_normalize(const Vec3* vecs, Vec3* target, size_t count)
+{
+    size_t i = 0;
+#if defined(SIMD_WIDTH)
+    for (; i + SIMD_WIDTH <= count; i += SIMD_WIDTH)
+    {
+        SimdFloat x, y, z;
+        simd_load3(vecs + i, &x, &y, &z);
+        const SimdFloat lengthSquared = simd_add(simd_add(simd_mul(x, x), simd_mul(y, y)), simd_mul(z, z));
+        const SimdFloat inverseLength = simd_zeroIfZero(simd_div(simd_set(1.f), simd_sqrt(lengthSquared)), lengthSquared);
+        simd_store3(target + i, simd_mul(x, inverseLength), simd_mul(y, inverseLength), simd_mul(z, inverseLength));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        const Vec3 vec = vecs[i];
+        target[i] = vec3_scale(vec, scalar_inverseLength(vec3_dot(vec, vec)));
+    }
+}
+
+void vec3_batch_dot(const Vec3* vecsOne, const Vec3* vecsTwo, float* target, size_t count)
+{
+    size_t i = 0;
+#if defined(SIMD_WIDTH)
+    for (; i + SIMD_WIDTH <= count; i += SIMD_WIDTH)
+    {
+        SimdFloat ax, ay, az, bx, by, bz;
+        simd_load3(vecsOne + i, &ax, &ay, &az);
+        simd_load3(vecsTwo + i, &bx, &by, &bz);
+        SimdFloat sum = simd_mul(ax, bx);
+        sum = simd_add(sum, simd_mul(ay, by));
+        sum = simd_add(sum, simd_mul(az, bz));
+        simd_store(target + i, sum);
+    }
+#endif
+    for (; i < count; i++)
+    {
+        target[i] = vec3_dot(vecsOne[i], vecsTwo[i]);
+    }
+}
+
+void vec3_batch_cross(const Vec3* vecsOne, const Vec3* vecsTwo, Vec3* target, size_t count)
+{
+    size_t i = 0;
+#if defined(SIMD_WIDTH)
+    for (; i + SIMD_WIDTH <= count; i += SIMD_WIDTH)
+    {
+        SimdFloat ax, ay, az, bx, by, bz;
+        simd_load3(vecsOne + i, &ax, &ay, &az);
+        simd_load3(vecsTwo + i, &bx, &by, &bz);
+        simd_store3(
+            target + i,
+            simd_sub(simd_mul(ay, bz), simd_mul(az, by)),
+            simd_sub(simd_mul(az, bx), simd_mul(ax, bz)),
+            simd_sub(simd_mul(ax, by), simd_mul(ay, bx))
+        );
+    }
+#endif
+    for (; i < count; i++)
+    {
+        target[i] = vec3_cross(vecsOne[i], vecsTwo[i]);
+    }
+}
+
+Aabb vec3_batch_aabb(const Vec3* points, size_t count)
+{
+    Aabb aabb =
+    {
+        .min = vec3(FLT_MAX, FLT_MAX, FLT_MAX),
+        .max = vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX),
+    };
+
+    size_t i = 0;
+#if defined(SIMD_WIDTH)
+    if (count >= SIMD_WIDTH)
+    {
+        SimdFloat minX = simd_set(FLT_MAX), minY = simd_set(FLT_MAX), minZ = simd_set(FLT_MAX);
+        SimdFloat maxX = simd_set(-FLT_MAX), maxY = simd_set(-FLT_MAX), maxZ = simd_set(-FLT_MAX);
+        for (; i + SIMD_WIDTH <= count; i += SIMD_WIDTH)
+        {
+            SimdFloat x, y, z;
+            simd_load3(points + i, &x, &y, &z);
+            minX = simd_min(minX, x);
+            minY = simd_min(minY, y);
+            minZ = simd_min(minZ, z);
+            maxX = simd_max(maxX, x);
+            maxY = simd_max(maxY, y);
+            maxZ = simd_max(maxZ, z);
+        }
+        aabb.min = vec3(simd_reduceMin(minX), simd_reduceMin(minY), simd_reduceMin(minZ));
+        aabb.max = vec3(simd_reduceMax(maxX), simd_reduceMax(maxY), simd_reduceMax(maxZ));
+    }
+#endif
+    for (; i < count; i++)
+    {
+        aabb.min = vec3(fminf(aabb.min.x, points[i].x), fminf(aabb.min.y, points[i].y), fminf(aabb.min.z, points[i].z));
+        aabb.max = vec3(fmaxf(aabb.max.x, points[i].x), fmaxf(aabb.max.y, points[i].y), fmaxf(aabb.max.z, points[i].z));
+    }
+    return aabb;
+}
+
+size_t mat4_batch_inverse(Mat4* mats, Mat4* target, size_t count)
+{
+    // Singular matrices leave their target untouched and are not counted.
+    bool (*inverse)(Mat4*, Mat4*) = mat4_kernels()->inverse;
+    size_t inverted = 0;
+    for (size_t i = 0; i < count; i++)
+        inverted += inverse(&mats[i], &target[i]) ? 1 : 0;
+    return inverted;
+}
+
+void quat_batch_multiply(const Quat* quatsOne, const Quat* quatsTwo, Quat* target, size_t count)
+{
+    size_t i = 0;
+#if defined(SIMD_WIDTH)
+    for (; i + SIMD_WIDTH <= count; i += SIMD_WIDTH)
+    {
+        SimdFloat ax, ay, az, aw, bx, by, bz, bw;
+        simd_load4((const float*)(quatsOne + i), &ax, &ay, &az, &aw);
+        simd_load4((const float*)(quatsTwo + i), &bx, &by, &bz, &bw);
+        const SimdFloat x = simd_sub(simd_add(simd_add(simd_mul(aw, bx), simd_mul(ax, bw)), simd_mul(ay, bz)), simd_mul(az, by));
+        const SimdFloat y = simd_add(simd_add(simd_sub(simd_mul(aw, by), simd_mul(ax, bz)), simd_mul(ay, bw)), simd_mul(az, bx));
+        const SimdFloat z = simd_add(simd_sub(simd_add(simd_mul(aw, bz), simd_mul(ax, by)), simd_mul(ay, bx)), simd_mul(az, bw));
+        const SimdFloat w = simd_sub(simd_sub(simd_sub(simd_mul(aw, bw), simd_mul(ax, bx)), simd_mul(ay, by)), simd_mul(az, bz));
+        simd_store4((float*)(target + i), x, y, z, w);
+    }
+#endif
+    for (; i < count; i++)
+        target[i] = quat_multiply(quatsOne[i], quatsTwo[i]);
+}
+
+void quat_batch_toAffine(const Quat* quats, const Vec3* translations, Affine* target, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        quat_toAffine(quats[i], translations[i], &target[i]);
+}
@@ -0,0 +1,558 @@
+#include <math.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include "../include/SpaceSimd.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SPACE_SIMD_X86
+#endif
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SPACE_SIMD_NEON
+#endif
+
+// Selected on first use from whichever thread gets there. The tables are
+// static, so relaxed accesses are enough to keep that race defined.
+static _Atomic(const Mat4Kernels*) activeKernels = NULL;
+
+static void scalar_multiply(Mat4* matOne, Mat4* matTwo, Mat4* target)
+{
+    Mat4 temp;
+    for (int i = 0; i < 4; i++)
+    {
+        for (int j = 0; j < 4; j++)
+        {
+            float sum = 0.f;
+            for (int k = 0; k < 4; k++)
+                sum += (*matOne)[i][k] * (*matTwo)[k][j];
+            temp[i][j] = sum;
+        }
+    }
+    mat4_copy(&temp, target);
+}
+
+static void scalar_transpose(Mat4* mat, Mat4* target)
+{
+    Mat4 temp;
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++)
+            temp[i][j] = (*mat)[j][i];
+    mat4_copy(&temp, target);
+}
+
+static Vec3 scalar_transformPoint(Mat4* mat, Vec3 point)
+{
+    return vec3(
+        (*mat)[0][0] * point.x + (*mat)[1][0] * point.y + (*mat)[2][0] * point.z + (*mat)[3][0],
+        (*mat)[0][1] * point.x + (*mat)[1][1] * point.y + (*mat)[2][1] * point.z + (*mat)[3][1],
+        (*mat)[0][2] * point.x + (*mat)[1][2] * point.y + (*mat)[2][2] * point.z + (*mat)[3][2]
+    );
+}
+
+static void scalar_affineMultiply(Affine* matOne, Affine* matTwo, Affine* target)
+{
+    Affine temp;
+    for (int i = 0; i < 4; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            float sum = (*matOne)[i][0] * (*matTwo)[0][j];
+            sum += (*matOne)[i][1] * (*matTwo)[1][j];
+            sum += (*matOne)[i][2] * (*matTwo)[2][j];
+            temp[i][j] = sum;
+        }
+    }
+    for (int j = 0; j < 3; j++)
+        temp[3][j] += (*matTwo)[3][j];
+    affine_copy(&temp, target);
+}
+
+// Singular below this determinant; matches the affine inverse.
+#define MAT4_SINGULAR_DETERMINANT 1e-12f
+
+static bool scalar_inverse(Mat4* mat, Mat4* target)
+{
+    // Laplace expansion over 2x2 sub-determinants of the top and bottom
+    // halves. The inverse of the transpose is the transpose of the inverse,
+    // so the formula is indifferent to row or column-major storage.
+    const float (*m)[4] = (const float (*)[4])(*mat);
+    const float s0 = m[0][0] * m[1][1] - m[1][0] * m[0][1];
+    const float s1 = m[0][0] * m[1][2] - m[1][0] * m[0][2];
+    const float s2 = m[0][0] * m[1][3] - m[1][0] * m[0][3];
+    const float s3 = m[0][1] * m[1][2] - m[1][1] * m[0][2];
+    const float s4 = m[0][1] * m[1][3] - m[1][1] * m[0][3];
+    const float s5 = m[0][2] * m[1][3] - m[1][2] * m[0][3];
+    const float c5 = m[2][2] * m[3][3] - m[3][2] * m[2][3];
+    const float c4 = m[2][1] * m[3][3] - m[3][1] * m[2][3];
+    const float c3 = m[2][1] * m[3][2] - m[3][1] * m[2][2];
+    const float c2 = m[2][0] * m[3][3] - m[3][0] * m[2][3];
+    const float c1 = m[2][0] * m[3][2] - m[3][0] * m[2][2];
+    const float c0 = m[2][0] * m[3][1] - m[3][0] * m[2][1];
+
+    const float determinant = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+    if (fabsf(determinant) < MAT4_SINGULAR_DETERMINANT)
+    {
+        return false;
+    }
+    const float inverseDeterminant = 1.f / determinant;
+
+    Mat4 temp;
+    temp[0][0] = ( m[1][1] * c5 - m[1][2] * c4 + m[1][3] * c3) * inverseDeterminant;
+    temp[0][1] = (-m[0][1] * c5 + m[0][2] * c4 - m[0][3] * c3) * inverseDeterminant;
+    temp[0][2] = ( m[3][1] * s5 - m[3][2] * s4 + m[3][3] * s3) * inverseDeterminant;
+    temp[0][3] = (-m[2][1] * s5 + m[2][2] * s4 - m[2][3] * s3) * inverseDeterminant;
+    temp[1][0] = (-m[1][0] * c5 + m[1][2] * c2 - m[1][3] * c1) * inverseDeterminant;
+    temp[1][1] = ( m[0][0] * c5 - m[0][2] * c2 + m[0][3] * c1) * inverseDeterminant;
+    temp[1][2] = (-m[3][0] * s5 + m[3][2] * s2 - m[3][3] * s1) * inverseDeterminant;
+    temp[1][3] = ( m[2][0] * s5 - m[2][2] * s2 + m[2][3] * s1) * inverseDeterminant;
+    temp[2][0] = ( m[1][0] * c4 - m[1][1] * c2 + m[1][3] * c0) * inverseDeterminant;
+    temp[2][1] = (-m[0][0] * c4 + m[0][1] * c2 - m[0][3] * c0) * inverseDeterminant;
+    temp[2][2] = ( m[3][0] * s4 - m[3][1] * s2 + m[3][3] * s0) * inverseDeterminant;
+    temp[2][3] = (-m[2][0] * s4 + m[2][1] * s2 - m[2][3] * s0) * inverseDeterminant;
+    temp[3][0] = (-m[1][0] * c3 + m[1][1] * c1 - m[1][2] * c0) * inverseDeterminant;
+    temp[3][1] = ( m[0][0] * c3 - m[0][1] * c1 + m[0][2] * c0) * inverseDeterminant;
+    temp[3][2] = (-m[3][0] * s3 + m[3][1] * s1 - m[3][2] * s0) * inverseDeterminant;
+    temp[3][3] = ( m[2][0] * s3 - m[2][1] * s1 + m[2][2] * s0) * inverseDeterminant;
+    mat4_copy(&temp, target);
+    return true;
+}
+
+static const Mat4Kernels scalarKernels =
+{
+    .name = "scalar",
+    .multiply = scalar_multiply,
+    .transpose = scalar_transpose,
+    .transformPoint = scalar_transformPoint,
+    .affineMultiply = scalar_affineMultiply,
+    .inverse = scalar_inverse,
+};
+
+#if defined(SPACE_SIMD_X86)
+
+__attribute__((target("sse2")))
+static void sse_multiply(Mat4* matOne, Mat4* matTwo, Mat4* target)
+{
+    const __m128 rowZero = _mm_load_ps((*matTwo)[0]);
+    const __m128 rowOne = _mm_load_ps((*matTwo)[1]);
+    const __m128 rowTwo = _mm_load_ps((*matTwo)[2]);
+    const __m128 rowThree = _mm_load_ps((*matTwo)[3]);
+
+    // Same summation order as the scalar kernel, so results are bit-exact.
+    __m128 result[4];
+    for (int i = 0; i < 4; i++)
+    {
+        __m128 sum = _mm_mul_ps(_mm_set1_ps((*matOne)[i][0]), rowZero);
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps((*matOne)[i][1]), rowOne));
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps((*matOne)[i][2]), rowTwo));
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps((*matOne)[i][3]), rowThree));
+        result[i] = sum;
+    }
+    for (int i = 0; i < 4; i++)
+        _mm_store_ps((*target)[i], result[i]);
+}
+
+__attribute__((target("sse2")))
+static void sse_transpose(Mat4* mat, Mat4* target)
+{
+    __m128 rowZero = _mm_load_ps((*mat)[0]);
+    __m128 rowOne = _mm_load_ps((*mat)[1]);
+    __m128 rowTwo = _mm_load_ps((*mat)[2]);
+    __m128 rowThree = _mm_load_ps((*mat)[3]);
+    _MM_TRANSPOSE4_PS(rowZero, rowOne, rowTwo, rowThree);
+    _mm_store_ps((*target)[0], rowZero);
+    _mm_store_ps((*target)[1], rowOne);
+    _mm_store_ps((*target)[2], rowTwo);
+    _mm_store_ps((*target)[3], rowThree);
+}
+
+__attribute__((target("sse2")))
+static Vec3 sse_transformPoint(Mat4* mat, Vec3 point)
+{
+    __m128 sum = _mm_mul_ps(_mm_load_ps((*mat)[0]), _mm_set1_ps(point.x));
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_load_ps((*mat)[1]), _mm_set1_ps(point.y)));
+    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_load_ps((*mat)[2]), _mm_set1_ps(point.z)));
+    sum = _mm_add_ps(sum, _mm_load_ps((*mat)[3]));
+
+    float result[4] __attribute__((aligned(16)));
+    _mm_store_ps(result, sum);
+    return vec3(result[0], result[1], result[2]);
+}
+
+// Affine columns are 3 floats wide, so these load and store only the
+// first three lanes; the fourth loads as zero.
+__attribute__((target("sse2")))
+static inline __m128 sse_loadColumn3(const float* source)
+{
+    return _mm_movelh_ps(_mm_castpd_ps(_mm_load_sd((const double*)source)), _mm_load_ss(source + 2));
+}
+
+__attribute__((target("sse2")))
+static inline void sse_storeColumn3(float* target, __m128 value)
+{
+    _mm_storel_pi((__m64*)target, value);
+    _mm_store_ss(target + 2, _mm_movehl_ps(value, value));
+}
+
+__attribute__((target("sse2")))
+static void sse_affineMultiply(Affine* matOne, Affine* matTwo, Affine* target)
+{
+    // Full-width loads of the linear columns pick up the first lane of the
+    // next column, which only ever lands in the unused fourth lane.
+    const __m128 columnZero = _mm_loadu_ps((*matTwo)[0]);
+    const __m128 columnOne = _mm_loadu_ps((*matTwo)[1]);
+    const __m128 columnTwo = _mm_loadu_ps((*matTwo)[2]);
+    const __m128 translation = sse_loadColumn3((*matTwo)[3]);
+
+    __m128 result[4];
+    for (int i = 0; i < 4; i++)
+    {
+        __m128 sum = _mm_mul_ps(_mm_set1_ps((*matOne)[i][0]), columnZero);
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps((*matOne)[i][1]), columnOne));
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps((*matOne)[i][2]), columnTwo));
+        result[i] = sum;
+    }
+    result[3] = _mm_add_ps(result[3], translation);
+
+    // Written in order, each spilled fourth lane is overwritten by the next
+    // column; everything was read first, so aliasing is safe.
+    _mm_storeu_ps((*target)[0], result[0]);
+    _mm_storeu_ps((*target)[1], result[1]);
+    _mm_storeu_ps((*target)[2], result[2]);
+    sse_storeColumn3((*target)[3], result[3]);
+}
+
+#define SSE_SHUFFLE(a, b, x, y, z, w) _mm_shuffle_ps((a), (b), _MM_SHUFFLE((w), (z), (y), (x)))
+#define SSE_SWIZZLE(a, x, y, z, w) SSE_SHUFFLE((a), (a), (x), (y), (z), (w))
+
+// 2x2 blocks packed as (m00, m01, m10, m11): A * B, adj(A) * B, A * adj(B).
+__attribute__((target("sse2")))
+static inline __m128 sse_mat2Multiply(__m128 a, __m128 b)
+{
+    return _mm_add_ps(_mm_mul_ps(a, SSE_SWIZZLE(b, 0, 3, 0, 3)), _mm_mul_ps(SSE_SWIZZLE(a, 1, 0, 3, 2), SSE_SWIZZLE(b, 2, 1, 2, 1)));
+}
+
+__attribute__((target("sse2")))
+static inline __m128 sse_mat2AdjugateMultiply(__m128 a, __m128 b)
+{
+    return _mm_sub_ps(_mm_mul_ps(SSE_SWIZZLE(a, 3, 3, 0, 0), b), _mm_mul_ps(SSE_SWIZZLE(a, 1, 1, 2, 2), SSE_SWIZZLE(b, 2, 3, 0, 1)));
+}
+
+__attribute__((target("sse2")))
+static inline __m128 sse_mat2MultiplyAdjugate(__m128 a, __m128 b)
+{
+    return _mm_sub_ps(_mm_mul_ps(a, SSE_SWIZZLE(b, 3, 0, 3, 0)), _mm_mul_ps(SSE_SWIZZLE(a, 1, 0, 3, 2), SSE_SWIZZLE(b, 2, 1, 2, 1)));
+}
+
+__attribute__((target("sse2")))
+static bool sse_inverse(Mat4* mat, Mat4* target)
+{
+    // Block-wise inverse over the four 2x2 sub-matrices
+    //     | A B |
+    //     | C D |
+    // using adjugates so the only division is by the full determinant.
+    const __m128 rowZero = _mm_load_ps((*mat)[0]);
+    const __m128 rowOne = _mm_load_ps((*mat)[1]);
+    const __m128 rowTwo = _mm_load_ps((*mat)[2]);
+    const __m128 rowThree = _mm_load_ps((*mat)[3]);
+
+    const __m128 a = _mm_movelh_ps(rowZero, rowOne);
+    const __m128 b = _mm_movehl_ps(rowOne, rowZero);
+    const __m128 c = _mm_movelh_ps(rowTwo, rowThree);
+    const __m128 d = _mm_movehl_ps(rowThree, rowTwo);
+
+    // (|A|, |B|, |C|, |D|)
+    const __m128 subDeterminants = _mm_sub_ps(
+        _mm_mul_ps(SSE_SHUFFLE(rowZero, rowTwo, 0, 2, 0, 2), SSE_SHUFFLE(rowOne, rowThree, 1, 3, 1, 3)),
+        _mm_mul_ps(SSE_SHUFFLE(rowZero, rowTwo, 1, 3, 1, 3), SSE_SHUFFLE(rowOne, rowThree, 0, 2, 0, 2))
+    );
+    const __m128 determinantA = SSE_SWIZZLE(subDeterminants, 0, 0, 0, 0);
+    const __m128 determinantB = SSE_SWIZZLE(subDeterminants, 1, 1, 1, 1);
+    const __m128 determinantC = SSE_SWIZZLE(subDeterminants, 2, 2, 2, 2);
+    const __m128 determinantD = SSE_SWIZZLE(subDeterminants, 3, 3, 3, 3);
+
+    const __m128 adjugateDC = sse_mat2AdjugateMultiply(d, c);
+    const __m128 adjugateAB = sse_mat2AdjugateMultiply(a, b);
+    __m128 x = _mm_sub_ps(_mm_mul_ps(determinantD, a), sse_mat2Multiply(b, adjugateDC));
+    __m128 w = _mm_sub_ps(_mm_mul_ps(determinantA, d), sse_mat2Multiply(c, adjugateAB));
+    __m128 y = _mm_sub_ps(_mm_mul_ps(determinantB, c), sse_mat2MultiplyAdjugate(d, adjugateAB));
+    __m128 z = _mm_sub_ps(_mm_mul_ps(determinantC, b), sse_mat2MultiplyAdjugate(a, adjugateDC));
+
+    // |M| = |A||D| + |B||C| - tr(adj(A)B adj(D)C)
+    __m128 trace = _mm_mul_ps(adjugateAB, SSE_SWIZZLE(adjugateDC, 0, 2, 1, 3));
+    trace = _mm_add_ps(trace, _mm_movehl_ps(trace, trace));
+    trace = _mm_add_ss(trace, SSE_SWIZZLE(trace, 1, 1, 1, 1));
+    const __m128 determinant = _mm_sub_ss(
+        _mm_add_ss(_mm_mul_ss(determinantA, determinantD), _mm_mul_ss(determinantB, determinantC)),
+        trace
+    );
+    if (fabsf(_mm_cvtss_f32(determinant)) < MAT4_SINGULAR_DETERMINANT)
+    {
+        return false;
+    }
+
+    const __m128 inverseDeterminant = _mm_div_ps(_mm_setr_ps(1.f, -1.f, -1.f, 1.f), SSE_SWIZZLE(determinant, 0, 0, 0, 0));
+    x = _mm_mul_ps(x, inverseDeterminant);
+    y = _mm_mul_ps(y, inverseDeterminant);
+    z = _mm_mul_ps(z, inverseDeterminant);
+    w = _mm_mul_ps(w, inverseDeterminant);
+
+    // The final shuffles apply the adjugate and reassemble the rows.
+    _mm_store_ps((*target)[0], SSE_SHUFFLE(x, y, 3, 1, 3, 1));
+    _mm_store_ps((*target)[1], SSE_SHUFFLE(x, y, 2, 0, 2, 0));
+    _mm_store_ps((*target)[2], SSE_SHUFFLE(z, w, 3, 1, 3, 1));
+    _mm_store_ps((*target)[3], SSE_SHUFFLE(z, w, 2, 0, 2, 0));
+    return true;
+}
+
+static const Mat4Kernels sseKernels =
+{
+    .name = "sse",
+    .multiply = sse_multiply,
+    .transpose = sse_transpose,
+    .transformPoint = sse_transformPoint,
+    .affineMultiply = sse_affineMultiply,
+    .inverse = sse_inverse,
+};
+
+__attribute__((target("avx2,fma")))
+static void avx2_multiply(Mat4* matOne, Mat4* matTwo, Mat4* target)
+{
+    const __m256 rowZero = _mm256_broadcast_ps((const __m128*)(*matTwo)[0]);
+    const __m256 rowOne = _mm256_broadcast_ps((const __m128*)(*matTwo)[1]);
+    const __m256 rowTwo = _mm256_broadcast_ps((const __m128*)(*matTwo)[2]);
+    const __m256 rowThree = _mm256_broadcast_ps((const __m128*)(*matTwo)[3]);
+
+    // Each 256-bit register holds two rows of matOne, so two rows of the
+    // product are computed per iteration.
+    __m256 result[2];
+    for (int i = 0; i < 2; i++)
+    {
+        const __m256 rows = _mm256_loadu_ps((*matOne)[i * 2]);
+        __m256 sum = _mm256_mul_ps(_mm256_permute_ps(rows, 0x00), rowZero);
+        sum = _mm256_fmadd_ps(_mm256_permute_ps(rows, 0x55), rowOne, sum);
+        sum = _mm256_fmadd_ps(_mm256_permute_ps(rows, 0xAA), rowTwo, sum);
+        sum = _mm256_fmadd_ps(_mm256_permute_ps(rows, 0xFF), rowThree, sum);
+        result[i] = sum;
+    }
+    _mm256_storeu_ps((*target)[0], result[0]);
+    _mm256_storeu_ps((*target)[2], result[1]);
+}
+
+__attribute__((target("avx2,fma")))
+static Vec3 avx2_transformPoint(Mat4* mat, Vec3 point)
+{
+    __m128 sum = _mm_load_ps((*mat)[3]);
+    sum = _mm_fmadd_ps(_mm_load_ps((*mat)[0]), _mm_set1_ps(point.x), sum);
+    sum = _mm_fmadd_ps(_mm_load_ps((*mat)[1]), _mm_set1_ps(point.y), sum);
+    sum = _mm_fmadd_ps(_mm_load_ps((*mat)[2]), _mm_set1_ps(point.z), sum);
+
+    float result[4] __attribute__((aligned(16)));
+    _mm_store_ps(result, sum);
+    return vec3(result[0], result[1], result[2]);
+}
+
+__attribute__((target("avx2,fma")))
+static void avx2_affineMultiply(Affine* matOne, Affine* matTwo, Affine* target)
+{
+    const __m256 columnZero = _mm256_broadcast_ps((const __m128*)(*matTwo)[0]);
+    const __m256 columnOne = _mm256_broadcast_ps((const __m128*)(*matTwo)[1]);
+    const __m256 columnTwo = _mm256_broadcast_ps((const __m128*)(*matTwo)[2]);
+    const __m256 translation = _mm256_insertf128_ps(_mm256_setzero_ps(), sse_loadColumn3((*matTwo)[3]), 1);
+
+    // Each 256-bit register holds two columns of matOne, one per 128-bit
+    // lane, so two columns of the product are computed at once. The last
+    // column is loaded from one float earlier to stay inside matOne, which
+    // shifts its in-lane indices by one.
+    const float* elements = &(*matOne)[0][0];
+    const __m256 firstPair = _mm256_loadu2_m128(elements + 3, elements);
+    const __m256 secondPair = _mm256_loadu2_m128(elements + 8, elements + 6);
+    const __m256i shiftedZero = _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+    const __m256i shiftedOne = _mm256_setr_epi32(1, 1, 1, 1, 2, 2, 2, 2);
+    const __m256i shiftedTwo = _mm256_setr_epi32(2, 2, 2, 2, 3, 3, 3, 3);
+
+    __m256 sum = _mm256_mul_ps(_mm256_permute_ps(firstPair, 0x00), columnZero);
+    sum = _mm256_fmadd_ps(_mm256_permute_ps(firstPair, 0x55), columnOne, sum);
+    const __m256 resultZero = _mm256_fmadd_ps(_mm256_permute_ps(firstPair, 0xAA), columnTwo, sum);
+
+    sum = _mm256_fmadd_ps(_mm256_permutevar_ps(secondPair, shiftedZero), columnZero, translation);
+    sum = _mm256_fmadd_ps(_mm256_permutevar_ps(secondPair, shiftedOne), columnOne, sum);
+    const __m256 resultOne = _mm256_fmadd_ps(_mm256_permutevar_ps(secondPair, shiftedTwo), columnTwo, sum);
+
+    _mm_storeu_ps((*target)[0], _mm256_castps256_ps128(resultZero));
+    _mm_storeu_ps((*target)[1], _mm256_extractf128_ps(resultZero, 1));
+    _mm_storeu_ps((*target)[2], _mm256_castps256_ps128(resultOne));
+    sse_storeColumn3((*target)[3], _mm256_extractf128_ps(resultOne, 1));
+}
+
+static const Mat4Kernels avx2Kernels =
+{
+    .name = "avx2",
+    .multiply = avx2_multiply,
+    .transpose = sse_transpose,
+    .transformPoint = avx2_transformPoint,
+    .affineMultiply = avx2_affineMultiply,
+    .inverse = sse_inverse,
+};
+
+#endif // SPACE_SIMD_X86
+
+#if defined(SPACE_SIMD_NEON)
+
+static void neon_multiply(Mat4* matOne, Mat4* matTwo, Mat4* target)
+{
+    const float32x4_t rowZero = vld1q_f32((*matTwo)[0]);
+    const float32x4_t rowOne = vld1q_f32((*matTwo)[1]);
+    const float32x4_t rowTwo = vld1q_f32((*matTwo)[2]);
+    const float32x4_t rowThree = vld1q_f32((*matTwo)[3]);
+
+    float32x4_t result[4];
+    for (int i = 0; i < 4; i++)
+    {
+        float32x4_t sum = vmulq_n_f32(rowZero, (*matOne)[i][0]);
+        sum = vmlaq_n_f32(sum, rowOne, (*matOne)[i][1]);
+        sum = vmlaq_n_f32(sum, rowTwo, (*matOne)[i][2]);
+        sum = vmlaq_n_f32(sum, rowThree, (*matOne)[i][3]);
+        result[i] = sum;
+    }
+    for (int i = 0; i < 4; i++)
+        vst1q_f32((*target)[i], result[i]);
+}
+
+static void neon_transpose(Mat4* mat, Mat4* target)
+{
+    // De-interleaving load of the whole matrix yields its columns.
+    const float32x4x4_t columns = vld4q_f32(&(*mat)[0][0]);
+    vst1q_f32((*target)[0], columns.val[0]);
+    vst1q_f32((*target)[1], columns.val[1]);
+    vst1q_f32((*target)[2], columns.val[2]);
+    vst1q_f32((*target)[3], columns.val[3]);
+}
+
+static Vec3 neon_transformPoint(Mat4* mat, Vec3 point)
+{
+    float32x4_t sum = vld1q_f32((*mat)[3]);
+    sum = vmlaq_n_f32(sum, vld1q_f32((*mat)[0]), point.x);
+    sum = vmlaq_n_f32(sum, vld1q_f32((*mat)[1]), point.y);
+    sum = vmlaq_n_f32(sum, vld1q_f32((*mat)[2]), point.z);
+    return vec3(vgetq_lane_f32(sum, 0), vgetq_lane_f32(sum, 1), vgetq_lane_f32(sum, 2));
+}
+
+static void neon_affineMultiply(Affine* matOne, Affine* matTwo, Affine* target)
+{
+    // Full-width loads of the linear columns pick up the first lane of the
+    // next column, which only ever lands in the unused fourth lane.
+    const float32x4_t columnZero = vld1q_f32((*matTwo)[0]);
+    const float32x4_t columnOne = vld1q_f32((*matTwo)[1]);
+    const float32x4_t columnTwo = vld1q_f32((*matTwo)[2]);
+    const float32x4_t translation = vcombine_f32(vld1_f32((*matTwo)[3]), vld1_lane_f32(&(*matTwo)[3][2], vdup_n_f32(0.f), 0));
+
+    float32x4_t result[4];
+    for (int i = 0; i < 4; i++)
+    {
+        float32x4_t sum = vmulq_n_f32(columnZero, (*matOne)[i][0]);
+        sum = vmlaq_n_f32(sum, columnOne, (*matOne)[i][1]);
+        sum = vmlaq_n_f32(sum, columnTwo, (*matOne)[i][2]);
+        result[i] = sum;
+    }
+    result[3] = vaddq_f32(result[3], translation);
+
+    vst1q_f32((*target)[0], result[0]);
+    vst1q_f32((*target)[1], result[1]);
+    vst1q_f32((*target)[2], result[2]);
+    vst1_f32((*target)[3], vget_low_f32(result[3]));
+    vst1q_lane_f32(&(*target)[3][2], result[3], 2);
+}
+
+static const Mat4Kernels neonKernels =
+{
+    .name = "neon",
+    .multiply = neon_multiply,
+    .transpose = neon_transpose,
+    .transformPoint = neon_transformPoint,
+    .affineMultiply = neon_affineMultiply,
+    .inverse = scalar_inverse,
+};
+
+#endif // SPACE_SIMD_NEON
+
+bool space_cpuHasAvx2(void)
+{
+#if defined(SPACE_SIMD_X86)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+    return false;
+#endif
+}
+
+static const Mat4Kernels* detectKernels(void)
+{
+#if defined(SPACE_SIMD_X86)
+    if (space_cpuHasAvx2())
+    {
+        return &avx2Kernels;
+    }
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2"))
+    {
+        return &sseKernels;
+    }
+#elif defined(SPACE_SIMD_NEON)
+    return &neonKernels;
+#endif
+    return &scalarKernels;
+}
+
+const Mat4Kernels* mat4_kernels(void)
+{
+    const Mat4Kernels* kernels = atomic_load_explicit(&activeKernels, memory_order_relaxed);
+    if (kernels == NULL)
+    {
+        const Mat4Kernels* expected = NULL;
+        kernels = detectKernels();
+        if (!atomic_compare_exchange_strong_explicit(&activeKernels, &expected, kernels, memory_order_relaxed, memory_order_relaxed))
+        {
+            kernels = expected;
+        }
+    }
+    return kernels;
+}
+
+const Mat4Kernels* mat4_kernels_scalar(void)
+{
+    return &scalarKernels;
+}
+
+const Mat4Kernels* mat4_kernels_find(const char* name)
+{
+    if (strcmp(name, scalarKernels.name) == 0)
+    {
+        return &scalarKernels;
+    }
+#if defined(SPACE_SIMD_X86)
+    __builtin_cpu_init();
+    if (strcmp(name, sseKernels.name) == 0 && __builtin_cpu_supports("sse2"))
+    {
+        return &sseKernels;
+    }
+    if (strcmp(name, avx2Kernels.name) == 0 && space_cpuHasAvx2())
+    {
+        return &avx2Kernels;
+    }
+#endif
+#if defined(SPACE_SIMD_NEON)
+    if (strcmp(name, neonKernels.name) == 0)
+    {
+        return &neonKernels;
+    }
+#endif
+    return NULL;
+}
+
+void mat4_kernels_use(const Mat4Kernels* kernels)
+{
+    atomic_store_explicit(&activeKernels, (kernels != NULL) ? kernels : detectKernels(), memory_order_relaxed);
+}
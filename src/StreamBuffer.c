@@ -0,0 +1,206 @@
+#include "../include/StreamBuffer.h"
+#include "../include/GLState.h"
+#include "../include/Profiler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Buffers are bound to the copy-write target for every mapping operation so
+// the stream never disturbs the array or element-array bindings of a VAO.
+#define STREAM_BUFFER_TARGET GL_COPY_WRITE_BUFFER
+
+#define STREAM_BUFFER_WAIT_TIMEOUT 1000000
+
+static const char* streamBuffer_modeName(StreamBufferMode mode)
+{
+    switch (mode)
+    {
+        case STREAM_BUFFER_PERSISTENT:    return "persistent";
+        case STREAM_BUFFER_UNSYNCHRONIZED: return "unsynchronized";
+        case STREAM_BUFFER_ORPHAN:        return "orphan";
+        default:                          return "auto";
+    }
+}
+
+static void streamBuffer_waitFence(StreamBuffer* buffer, GLsync fence)
+{
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED)
+    {
+        // The GPU has not finished the frame that last used this region.
+        buffer->stallCount++;
+        do
+        {
+            status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, STREAM_BUFFER_WAIT_TIMEOUT);
+        } while (status == GL_TIMEOUT_EXPIRED);
+    }
+    if (status == GL_WAIT_FAILED)
+    {
+        fprintf(stderr, "Failed to wait for a stream buffer fence!\n");
+    }
+}
+
+StreamBuffer streamBuffer_create(GLsizeiptr regionSize, uint32_t regionCount, StreamBufferMode mode)
+{
+    if (mode == STREAM_BUFFER_AUTO)
+    {
+        mode = GLEW_ARB_buffer_storage || GLEW_VERSION_4_4
+            ? STREAM_BUFFER_PERSISTENT
+            : STREAM_BUFFER_UNSYNCHRONIZED;
+    }
+    if (mode == STREAM_BUFFER_ORPHAN || regionCount == 0)
+    {
+        regionCount = 1;
+    }
+    if (regionCount > STREAM_BUFFER_MAX_REGIONS)
+    {
+        regionCount = STREAM_BUFFER_MAX_REGIONS;
+    }
+
+    StreamBuffer buffer =
+    {
+        .mode = mode,
+        .regionSize = regionSize,
+        .regionCount = regionCount,
+        .region = 0,
+        .head = 0,
+        .persistent = NULL,
+        .mapped = false,
+        .fences = { NULL },
+        .frameCount = 0,
+        .stallCount = 0,
+    };
+    const GLsizeiptr size = regionSize * regionCount;
+
+    glGenBuffers(1, &buffer.ID);
+    glState_bindBuffer(STREAM_BUFFER_TARGET, buffer.ID);
+    if (mode == STREAM_BUFFER_PERSISTENT)
+    {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(STREAM_BUFFER_TARGET, size, NULL, flags);
+        buffer.persistent = glMapBufferRange(STREAM_BUFFER_TARGET, 0, size, flags);
+        if (buffer.persistent == NULL)
+        {
+            fprintf(stderr, "Failed to map a persistent stream buffer!\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    else
+    {
+        glBufferData(STREAM_BUFFER_TARGET, size, NULL, GL_STREAM_DRAW);
+    }
+
+    return buffer;
+}
+
+void streamBuffer_beginFrame(StreamBuffer* buffer)
+{
+    buffer->head = 0;
+
+    if (buffer->mode == STREAM_BUFFER_ORPHAN)
+    {
+        glState_bindBuffer(STREAM_BUFFER_TARGET, buffer->ID);
+        glBufferData(STREAM_BUFFER_TARGET, buffer->regionSize, NULL, GL_STREAM_DRAW);
+        return;
+    }
+
+    GLsync fence = buffer->fences[buffer->region];
+    if (fence != NULL)
+    {
+        streamBuffer_waitFence(buffer, fence);
+        glDeleteSync(fence);
+        buffer->fences[buffer->region] = NULL;
+    }
+}
+
+void* streamBuffer_allocate(StreamBuffer* buffer, GLsizeiptr size, GLsizeiptr alignment, GLintptr* offset)
+{
+    if (alignment < 1)
+    {
+        alignment = 1;
+    }
+    const GLsizeiptr start = (buffer->head + alignment - 1) / alignment * alignment;
+    if (start + size > buffer->regionSize)
+    {
+        return NULL;
+    }
+    buffer->head = start + size;
+    PROFILE_COUNT(uploadedBytes, size);
+
+    const GLintptr base = (GLintptr)buffer->region * buffer->regionSize + start;
+    *offset = base;
+
+    if (buffer->mode == STREAM_BUFFER_PERSISTENT)
+    {
+        return buffer->persistent + base;
+    }
+
+    // Only one range can be mapped at a time without persistent storage.
+    streamBuffer_unmap(buffer);
+    glState_bindBuffer(STREAM_BUFFER_TARGET, buffer->ID);
+    void* data = glMapBufferRange(
+        STREAM_BUFFER_TARGET,
+        base,
+        size > 0 ? size : 1,
+        GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT
+    );
+    buffer->mapped = data != NULL;
+    return data;
+}
+
+void streamBuffer_unmap(StreamBuffer* buffer)
+{
+    if (!buffer->mapped)
+    {
+        return;
+    }
+    glState_bindBuffer(STREAM_BUFFER_TARGET, buffer->ID);
+    glUnmapBuffer(STREAM_BUFFER_TARGET);
+    buffer->mapped = false;
+}
+
+void streamBuffer_endFrame(StreamBuffer* buffer)
+{
+    streamBuffer_unmap(buffer);
+    buffer->frameCount++;
+
+    if (buffer->mode == STREAM_BUFFER_ORPHAN)
+    {
+        return;
+    }
+    buffer->fences[buffer->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    buffer->region = (buffer->region + 1) % buffer->regionCount;
+}
+
+void streamBuffer_delete(StreamBuffer* buffer)
+{
+    streamBuffer_unmap(buffer);
+    for (uint32_t i = 0; i < buffer->regionCount; i++)
+    {
+        if (buffer->fences[i] != NULL)
+        {
+            glDeleteSync(buffer->fences[i]);
+            buffer->fences[i] = NULL;
+        }
+    }
+    if (buffer->persistent != NULL)
+    {
+        glState_bindBuffer(STREAM_BUFFER_TARGET, buffer->ID);
+        glUnmapBuffer(STREAM_BUFFER_TARGET);
+        buffer->persistent = NULL;
+    }
+    glState_deleteBuffers(1, &buffer->ID);
+    buffer->ID = 0;
+}
+
+void streamBuffer_log(StreamBuffer* buffer)
+{
+    printf(
+        "Stream buffer (%s, %u x %ld bytes): %llu stalls in %llu frames\n",
+        streamBuffer_modeName(buffer->mode),
+        buffer->regionCount,
+        (long)buffer->regionSize,
+        (unsigned long long)buffer->stallCount,
+        (unsigned long long)buffer->frameCount
+    );
+}
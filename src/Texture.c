@@ -0,0 +1,570 @@
+#include "../include/Texture.h"
+#include "../include/GLState.h"
+#include "../include/Profiler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TEXTURE_UPLOAD_UNIT 0
+
+static double textureCache_now(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec * 1e3 + (double)time.tv_nsec * 1e-6;
+}
+
+static void textureQueue_push(TextureQueue* queue, uint32_t item)
+{
+    if (queue->count == queue->capacity)
+    {
+        const uint32_t capacity = queue->capacity > 0 ? queue->capacity * 2 : 64;
+        uint32_t* items = malloc(capacity * sizeof(uint32_t));
+        if (items == NULL)
+        {
+            fprintf(stderr, "Failed to allocate a texture queue!\n");
+            exit(EXIT_FAILURE);
+        }
+        for (uint32_t i = 0; i < queue->count; i++)
+        {
+            items[i] = queue->items[(queue->head + i) % queue->capacity];
+        }
+        free(queue->items);
+        queue->items = items;
+        queue->head = 0;
+        queue->capacity = capacity;
+    }
+    queue->items[(queue->head + queue->count) % queue->capacity] = item;
+    queue->count++;
+}
+
+static uint32_t textureQueue_pop(TextureQueue* queue)
+{
+    const uint32_t item = queue->items[queue->head];
+    queue->head = (queue->head + 1) % queue->capacity;
+    queue->count--;
+    return item;
+}
+
+static void* textureCache_decode(void* argument)
+{
+    TextureCache* cache = argument;
+    PROFILE_THREAD("Texture decode");
+    pthread_mutex_lock(&cache->mutex);
+    while (!cache->quit)
+    {
+        if (cache->decodeQueue.count == 0)
+        {
+            pthread_cond_wait(&cache->wake, &cache->mutex);
+            continue;
+        }
+        const uint32_t index = textureQueue_pop(&cache->decodeQueue);
+        char path[TEXTURE_MAX_PATH];
+        memcpy(path, cache->textures[index].path, sizeof(path));
+        const bool mipmaps = (cache->textures[index].flags & TEXTURE_FLAG_MIPMAPS) != 0;
+        pthread_mutex_unlock(&cache->mutex);
+
+        PROFILE_BEGIN("Decode texture");
+        const double start = textureCache_now();
+        Image image;
+        const bool decoded = mipmaps ? image_loadMipmapped(&image, path, true) : image_load(&image, path);
+        const double elapsed = textureCache_now() - start;
+        PROFILE_END();
+        if (!decoded)
+        {
+            fprintf(stderr, "Failed to decode the texture %s!\n", path);
+        }
+
+        pthread_mutex_lock(&cache->mutex);
+        Texture* texture = &cache->textures[index];
+        texture->image = image;
+        texture->decodeFailed = !decoded;
+        texture->decodeMilliseconds = (float)elapsed;
+        textureQueue_push(&cache->decodedQueue, index);
+    }
+    pthread_mutex_unlock(&cache->mutex);
+    return NULL;
+}
+
+static void textureCache_queueDecode(TextureCache* cache, TextureHandle handle)
+{
+    cache->textures[handle].state = TEXTURE_QUEUED;
+    pthread_mutex_lock(&cache->mutex);
+    textureQueue_push(&cache->decodeQueue, handle);
+    pthread_cond_signal(&cache->wake);
+    pthread_mutex_unlock(&cache->mutex);
+}
+
+// The list runs from the most recently bound texture at the head to the
+// eviction candidate at the tail, and holds resident textures only.
+static void textureCache_lruRemove(TextureCache* cache, uint32_t index)
+{
+    Texture* texture = &cache->textures[index];
+    if (texture->lruPrev != TEXTURE_INVALID_HANDLE)
+    {
+        cache->textures[texture->lruPrev].lruNext = texture->lruNext;
+    }
+    else
+    {
+        cache->lruHead = texture->lruNext;
+    }
+    if (texture->lruNext != TEXTURE_INVALID_HANDLE)
+    {
+        cache->textures[texture->lruNext].lruPrev = texture->lruPrev;
+    }
+    else
+    {
+        cache->lruTail = texture->lruPrev;
+    }
+    texture->lruPrev = texture->lruNext = TEXTURE_INVALID_HANDLE;
+}
+
+static void textureCache_lruPushFront(TextureCache* cache, uint32_t index)
+{
+    Texture* texture = &cache->textures[index];
+    texture->lruPrev = TEXTURE_INVALID_HANDLE;
+    texture->lruNext = cache->lruHead;
+    if (cache->lruHead != TEXTURE_INVALID_HANDLE)
+    {
+        cache->textures[cache->lruHead].lruPrev = index;
+    }
+    cache->lruHead = index;
+    if (cache->lruTail == TEXTURE_INVALID_HANDLE)
+    {
+        cache->lruTail = index;
+    }
+}
+
+// Evicts the least recently used texture unless it was bound this frame.
+// Memory only comes back once every layer of its array is gone.
+static bool textureCache_evict(TextureCache* cache)
+{
+    const uint32_t index = cache->lruTail;
+    if (index == TEXTURE_INVALID_HANDLE || cache->textures[index].lastUsedFrame >= cache->frame)
+    {
+        return false;
+    }
+
+    Texture* texture = &cache->textures[index];
+    textureCache_lruRemove(cache, index);
+    TextureArray* array = &cache->arrays[texture->array];
+    array->layerMask &= ~(1u << texture->layer);
+    if (array->layerMask == 0)
+    {
+        glState_deleteTextures(1, &array->ID);
+        array->ID = 0;
+        cache->residentSize -= array->size;
+    }
+    texture->array = TEXTURE_INVALID_HANDLE;
+    texture->state = TEXTURE_EVICTED;
+    cache->stats.evictions++;
+    return true;
+}
+
+static bool textureCache_takeLayer(TextureCache* cache, Texture* texture, GLenum internalFormat)
+{
+    const Image* image = &texture->image;
+    for (uint32_t i = 0; i < cache->arrayCount; i++)
+    {
+        TextureArray* array = &cache->arrays[i];
+        if (array->ID != 0 &&
+            array->width == image->width &&
+            array->height == image->height &&
+            array->levelCount == image->levelCount &&
+            array->internalFormat == internalFormat &&
+            array->layerMask != (1u << TEXTURE_ARRAY_LAYERS) - 1)
+        {
+            uint32_t layer = 0;
+            while (array->layerMask & (1u << layer))
+            {
+                layer++;
+            }
+            array->layerMask |= 1u << layer;
+            texture->array = i;
+            texture->layer = layer;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Reuses a free layer of a matching array where there is one, evicting to
+// make room for a new array otherwise. When nothing can be evicted the
+// array is created over budget rather than holding the texture back.
+static void textureCache_allocateLayer(TextureCache* cache, Texture* texture)
+{
+    const GLenum internalFormat = texture->flags & TEXTURE_FLAG_SRGB ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+    const Image* image = &texture->image;
+    const size_t size = image->size * TEXTURE_ARRAY_LAYERS;
+    while (true)
+    {
+        if (textureCache_takeLayer(cache, texture, internalFormat))
+        {
+            return;
+        }
+        if (cache->residentSize + size <= cache->budget || !textureCache_evict(cache))
+        {
+            break;
+        }
+    }
+    if (cache->residentSize + size > cache->budget)
+    {
+        cache->stats.overBudgetArrays++;
+    }
+
+    uint32_t slot = 0;
+    while (slot < cache->arrayCount && cache->arrays[slot].ID != 0)
+    {
+        slot++;
+    }
+    if (slot == cache->arrayCapacity)
+    {
+        const uint32_t capacity = cache->arrayCapacity > 0 ? cache->arrayCapacity * 2 : 8;
+        TextureArray* arrays = realloc(cache->arrays, capacity * sizeof(TextureArray));
+        if (arrays == NULL)
+        {
+            fprintf(stderr, "Failed to allocate texture arrays!\n");
+            exit(EXIT_FAILURE);
+        }
+        cache->arrays = arrays;
+        cache->arrayCapacity = capacity;
+    }
+    if (slot == cache->arrayCount)
+    {
+        cache->arrayCount++;
+    }
+
+    TextureArray* array = &cache->arrays[slot];
+    *array = (TextureArray)
+    {
+        .width = image->width,
+        .height = image->height,
+        .levelCount = image->levelCount,
+        .internalFormat = internalFormat,
+        .layerMask = 1,
+        .size = size,
+    };
+    glGenTextures(1, &array->ID);
+    glState_bindTexture(TEXTURE_UPLOAD_UNIT, GL_TEXTURE_2D_ARRAY, array->ID);
+    if (GLEW_ARB_texture_storage)
+    {
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, image->levelCount, internalFormat, image->width, image->height, TEXTURE_ARRAY_LAYERS);
+    }
+    else
+    {
+        for (uint32_t level = 0; level < image->levelCount; level++)
+        {
+            glTexImage3D(
+                GL_TEXTURE_2D_ARRAY, level, internalFormat,
+                image_levelWidth(image, level), image_levelHeight(image, level), TEXTURE_ARRAY_LAYERS,
+                0, GL_RGBA, GL_UNSIGNED_BYTE, NULL
+            );
+        }
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, (GLint)image->levelCount - 1);
+    }
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, image->levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    cache->residentSize += size;
+
+    texture->array = slot;
+    texture->layer = 0;
+}
+
+// Copies as many rows as still fit in this frame's staging region and
+// issues the matching glTexSubImage3D calls from the bound unpack buffer.
+// Returns false when the texture has to continue next frame.
+static bool textureCache_upload(TextureCache* cache, uint32_t index)
+{
+    Texture* texture = &cache->textures[index];
+    if (texture->array == TEXTURE_INVALID_HANDLE)
+    {
+        textureCache_allocateLayer(cache, texture);
+    }
+    glState_bindTexture(TEXTURE_UPLOAD_UNIT, GL_TEXTURE_2D_ARRAY, cache->arrays[texture->array].ID);
+
+    const Image* image = &texture->image;
+    while (texture->uploadLevel < image->levelCount)
+    {
+        const uint32_t width = image_levelWidth(image, texture->uploadLevel);
+        const uint32_t height = image_levelHeight(image, texture->uploadLevel);
+        const GLsizeiptr rowSize = (GLsizeiptr)width * IMAGE_CHANNELS;
+        const GLsizeiptr available = cache->staging.regionSize - cache->staging.head;
+        uint32_t rows = height - texture->uploadRow;
+        if ((GLsizeiptr)rows * rowSize > available)
+        {
+            rows = (uint32_t)(available / rowSize);
+        }
+        if (rows == 0)
+        {
+            return false;
+        }
+
+        GLintptr offset;
+        uint8_t* staging = streamBuffer_allocate(&cache->staging, rows * rowSize, IMAGE_CHANNELS, &offset);
+        if (staging == NULL)
+        {
+            return false;
+        }
+        memcpy(staging, image_level(image, texture->uploadLevel) + texture->uploadRow * rowSize, rows * rowSize);
+        streamBuffer_unmap(&cache->staging);
+        glState_bindBuffer(GL_PIXEL_UNPACK_BUFFER, cache->staging.ID);
+        glTexSubImage3D(
+            GL_TEXTURE_2D_ARRAY, texture->uploadLevel,
+            0, texture->uploadRow, texture->layer,
+            width, rows, 1,
+            GL_RGBA, GL_UNSIGNED_BYTE, (const void*)offset
+        );
+        cache->stats.uploadedBytes += (uint64_t)(rows * rowSize);
+
+        texture->uploadRow += rows;
+        if (texture->uploadRow == height)
+        {
+            texture->uploadRow = 0;
+            texture->uploadLevel++;
+        }
+    }
+
+    // Not marked as used: only a bind keeps it from being evicted this frame,
+    // or the next upload could not make room and would go over budget.
+    image_free(&texture->image);
+    texture->uploadLevel = 0;
+    texture->state = TEXTURE_RESIDENT;
+    textureCache_lruPushFront(cache, index);
+    return true;
+}
+
+// Needs a current context. threadCount is clamped to
+// TEXTURE_MAX_DECODE_THREADS; uploadBytesPerFrame bounds the pixel data
+// copied into GL each frame.
+TextureCache* textureCache_create(uint32_t threadCount, size_t budget, GLsizeiptr uploadBytesPerFrame, uint32_t framesInFlight)
+{
+    TextureCache* cache = calloc(1, sizeof(TextureCache));
+    if (cache == NULL)
+    {
+        fprintf(stderr, "Failed to allocate the texture cache!\n");
+        exit(EXIT_FAILURE);
+    }
+    cache->budget = budget;
+    cache->lruHead = cache->lruTail = TEXTURE_INVALID_HANDLE;
+    cache->staging = streamBuffer_create(uploadBytesPerFrame, framesInFlight, STREAM_BUFFER_AUTO);
+
+    pthread_mutex_init(&cache->mutex, NULL);
+    pthread_cond_init(&cache->wake, NULL);
+    threadCount = threadCount < 1 ? 1 : threadCount > TEXTURE_MAX_DECODE_THREADS ? TEXTURE_MAX_DECODE_THREADS : threadCount;
+    for (uint32_t i = 0; i < threadCount; i++)
+    {
+        if (pthread_create(&cache->threads[cache->threadCount], NULL, textureCache_decode, cache) == 0)
+        {
+            cache->threadCount++;
+        }
+    }
+    if (cache->threadCount == 0)
+    {
+        fprintf(stderr, "Failed to start the texture decode threads!\n");
+        exit(EXIT_FAILURE);
+    }
+    return cache;
+}
+
+// Returns at once; the texture is decoded in the background and can be
+// bound once textureCache_update has streamed it in. Loading the same path
+// with the same flags again returns the existing handle.
+TextureHandle textureCache_load(TextureCache* cache, const char* path, uint32_t flags)
+{
+    if (strlen(path) >= TEXTURE_MAX_PATH)
+    {
+        fprintf(stderr, "Failed to load the texture %s, the path is too long!\n", path);
+        return TEXTURE_INVALID_HANDLE;
+    }
+    for (uint32_t i = 0; i < cache->textureCount; i++)
+    {
+        if (cache->textures[i].flags == flags && strcmp(cache->textures[i].path, path) == 0)
+        {
+            return i;
+        }
+    }
+
+    pthread_mutex_lock(&cache->mutex);
+    if (cache->textureCount == cache->textureCapacity)
+    {
+        const uint32_t capacity = cache->textureCapacity > 0 ? cache->textureCapacity * 2 : 64;
+        Texture* textures = realloc(cache->textures, capacity * sizeof(Texture));
+        if (textures == NULL)
+        {
+            fprintf(stderr, "Failed to allocate textures!\n");
+            exit(EXIT_FAILURE);
+        }
+        cache->textures = textures;
+        cache->textureCapacity = capacity;
+    }
+
+    const TextureHandle handle = cache->textureCount++;
+    Texture* texture = &cache->textures[handle];
+    *texture = (Texture)
+    {
+        .flags = flags,
+        .state = TEXTURE_QUEUED,
+        .array = TEXTURE_INVALID_HANDLE,
+        .lruPrev = TEXTURE_INVALID_HANDLE,
+        .lruNext = TEXTURE_INVALID_HANDLE,
+    };
+    snprintf(texture->path, sizeof(texture->path), "%s", path);
+    textureQueue_push(&cache->decodeQueue, handle);
+    pthread_cond_signal(&cache->wake);
+    pthread_mutex_unlock(&cache->mutex);
+    return handle;
+}
+
+// Call once a frame: picks up decoded images, streams what fits of the
+// upload queue and evicts down to the budget.
+void textureCache_update(TextureCache* cache)
+{
+    PROFILE_SCOPE("Texture update");
+    pthread_mutex_lock(&cache->mutex);
+    while (cache->decodedQueue.count > 0)
+    {
+        const uint32_t index = textureQueue_pop(&cache->decodedQueue);
+        Texture* texture = &cache->textures[index];
+        cache->stats.decodeMilliseconds += texture->decodeMilliseconds;
+        // A row has to fit in one frame's staging region, or the texture
+        // would hold the front of the upload queue forever.
+        const bool rowFits = texture->decodeFailed || (GLsizeiptr)texture->image.width * IMAGE_CHANNELS <= cache->staging.regionSize;
+        if (!rowFits)
+        {
+            fprintf(stderr, "Failed to stream the texture %s, a row is larger than the per-frame upload limit!\n", texture->path);
+            image_free(&texture->image);
+        }
+        if (texture->decodeFailed || !rowFits)
+        {
+            texture->state = TEXTURE_FAILED;
+            cache->stats.failed++;
+            continue;
+        }
+        texture->state = TEXTURE_UPLOADING;
+        cache->stats.decoded++;
+        textureQueue_push(&cache->uploadQueue, index);
+    }
+    pthread_mutex_unlock(&cache->mutex);
+
+    if (cache->uploadQueue.count > 0)
+    {
+        streamBuffer_beginFrame(&cache->staging);
+        while (cache->uploadQueue.count > 0 && textureCache_upload(cache, cache->uploadQueue.items[cache->uploadQueue.head]))
+        {
+            textureQueue_pop(&cache->uploadQueue);
+        }
+        glState_bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        streamBuffer_endFrame(&cache->staging);
+    }
+
+    while (cache->residentSize > cache->budget && textureCache_evict(cache))
+    {
+    }
+    cache->frame++;
+}
+
+// Binds the texture's array to the unit and returns its layer, or returns
+// false while it is not resident so the caller can draw with a fallback.
+// Binding an evicted texture queues it to be decoded again.
+bool textureCache_bind(TextureCache* cache, TextureHandle handle, GLuint unit, uint32_t* layer)
+{
+    if (handle >= cache->textureCount)
+    {
+        return false;
+    }
+    Texture* texture = &cache->textures[handle];
+    if (texture->state == TEXTURE_EVICTED)
+    {
+        cache->stats.reloads++;
+        textureCache_queueDecode(cache, handle);
+        return false;
+    }
+    if (texture->state != TEXTURE_RESIDENT)
+    {
+        return false;
+    }
+
+    if (cache->lruHead != handle)
+    {
+        textureCache_lruRemove(cache, handle);
+        textureCache_lruPushFront(cache, handle);
+    }
+    texture->lastUsedFrame = cache->frame;
+    glState_bindTexture(unit, GL_TEXTURE_2D_ARRAY, cache->arrays[texture->array].ID);
+    *layer = texture->layer;
+    return true;
+}
+
+TextureState textureCache_state(const TextureCache* cache, TextureHandle handle)
+{
+    return handle < cache->textureCount ? cache->textures[handle].state : TEXTURE_FAILED;
+}
+
+void textureCache_log(const TextureCache* cache)
+{
+    uint32_t resident = 0;
+    for (uint32_t i = 0; i < cache->textureCount; i++)
+    {
+        resident += cache->textures[i].state == TEXTURE_RESIDENT;
+    }
+    uint32_t arrays = 0;
+    for (uint32_t i = 0; i < cache->arrayCount; i++)
+    {
+        arrays += cache->arrays[i].ID != 0;
+    }
+    const uint64_t decodes = cache->stats.decoded + cache->stats.failed;
+    printf(
+        "Textures: %u loaded, %u resident in %u arrays, %.1f of %.1f MB, %llu failed, %llu evictions, %llu reloads, %.1f MB uploaded, %.2f ms mean decode\n",
+        cache->textureCount,
+        resident,
+        arrays,
+        (double)cache->residentSize / (1024.0 * 1024.0),
+        (double)cache->budget / (1024.0 * 1024.0),
+        (unsigned long long)cache->stats.failed,
+        (unsigned long long)cache->stats.evictions,
+        (unsigned long long)cache->stats.reloads,
+        (double)cache->stats.uploadedBytes / (1024.0 * 1024.0),
+        decodes > 0 ? cache->stats.decodeMilliseconds / (double)decodes : 0.0
+    );
+    if (cache->stats.overBudgetArrays > 0)
+    {
+        fprintf(stderr, "Failed to keep textures in budget, %llu arrays were created over it!\n", (unsigned long long)cache->stats.overBudgetArrays);
+    }
+}
+
+void textureCache_delete(TextureCache* cache)
+{
+    pthread_mutex_lock(&cache->mutex);
+    cache->quit = true;
+    pthread_cond_broadcast(&cache->wake);
+    pthread_mutex_unlock(&cache->mutex);
+    for (uint32_t i = 0; i < cache->threadCount; i++)
+    {
+        pthread_join(cache->threads[i], NULL);
+    }
+    pthread_mutex_destroy(&cache->mutex);
+    pthread_cond_destroy(&cache->wake);
+
+    for (uint32_t i = 0; i < cache->textureCount; i++)
+    {
+        image_free(&cache->textures[i].image);
+    }
+    for (uint32_t i = 0; i < cache->arrayCount; i++)
+    {
+        if (cache->arrays[i].ID != 0)
+        {
+            glState_deleteTextures(1, &cache->arrays[i].ID);
+        }
+    }
+    streamBuffer_delete(&cache->staging);
+    free(cache->decodeQueue.items);
+    free(cache->decodedQueue.items);
+    free(cache->uploadQueue.items);
+    free(cache->textures);
+    free(cache->arrays);
+    free(cache);
+}
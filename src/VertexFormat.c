@@ -0,0 +1,331 @@
+#include "../include/VertexFormat.h"
+
+#include <math.h>
+#include <string.h>
+
+static float clampf(float value, float min, float max)
+{
+    return value < min ? min : value > max ? max : value;
+}
+
+static int32_t packSnorm(float value, int32_t maximum)
+{
+    return (int32_t)lrintf(clampf(value, -1.f, 1.f) * (float)maximum);
+}
+
+static uint32_t packUnorm(float value, uint32_t maximum)
+{
+    return (uint32_t)lrintf(clampf(value, 0.f, 1.f) * (float)maximum);
+}
+
+// GL 4.2 signed normalized decoding: both -maximum - 1 and -maximum map to -1.
+static float unpackSnorm(int32_t value, int32_t maximum)
+{
+    const float unpacked = (float)value / (float)maximum;
+    return unpacked < -1.f ? -1.f : unpacked;
+}
+
+static int32_t signExtend(uint32_t value, uint32_t bits)
+{
+    const uint32_t sign = 1u << (bits - 1);
+    return (int32_t)((value ^ sign) - sign);
+}
+
+// Round to nearest even, with overflow to infinity and gradual underflow
+// through the half subnormals.
+uint16_t vertexFormat_packHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    const uint32_t sign = (bits >> 16) & 0x8000u;
+    const uint32_t exponent = (bits >> 23) & 0xFFu;
+    uint32_t mantissa = bits & 0x7FFFFFu;
+
+    if (exponent == 0xFFu)
+    {
+        return (uint16_t)(sign | 0x7C00u | (mantissa != 0 ? 0x200u : 0u));
+    }
+
+    const int32_t halfExponent = (int32_t)exponent - 127 + 15;
+    if (halfExponent >= 31)
+    {
+        return (uint16_t)(sign | 0x7C00u);
+    }
+    if (halfExponent <= 0)
+    {
+        if (halfExponent < -10)
+        {
+            return (uint16_t)sign;
+        }
+        mantissa |= 0x800000u;
+        const uint32_t shift = (uint32_t)(14 - halfExponent);
+        const uint32_t remainder = mantissa & ((1u << shift) - 1);
+        const uint32_t halfway = 1u << (shift - 1);
+        uint32_t half = mantissa >> shift;
+        if (remainder > halfway || (remainder == halfway && (half & 1u)))
+        {
+            half++;
+        }
+        return (uint16_t)(sign | half);
+    }
+
+    // A carry out of the mantissa correctly bumps the exponent, up to infinity.
+    uint32_t half = ((uint32_t)halfExponent << 10) | (mantissa >> 13);
+    const uint32_t remainder = mantissa & 0x1FFFu;
+    if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u)))
+    {
+        half++;
+    }
+    return (uint16_t)(sign | half);
+}
+
+float vertexFormat_unpackHalf(uint16_t value)
+{
+    const uint32_t sign = (uint32_t)(value & 0x8000u) << 16;
+    const uint32_t exponent = (value >> 10) & 0x1Fu;
+    const uint32_t mantissa = value & 0x3FFu;
+
+    if (exponent == 0)
+    {
+        const float subnormal = (float)mantissa * 5.9604644775390625e-8f;
+        return sign != 0 ? -subnormal : subnormal;
+    }
+
+    const uint32_t bits = exponent == 31
+        ? sign | 0x7F800000u | (mantissa << 13)
+        : sign | ((exponent + 112) << 23) | (mantissa << 13);
+    float unpacked;
+    memcpy(&unpacked, &bits, sizeof(unpacked));
+    return unpacked;
+}
+
+uint32_t vertexFormat_packSnorm1010102(float x, float y, float z, float w)
+{
+    return ((uint32_t)packSnorm(x, 511) & 0x3FFu)
+        | ((uint32_t)packSnorm(y, 511) & 0x3FFu) << 10
+        | ((uint32_t)packSnorm(z, 511) & 0x3FFu) << 20
+        | ((uint32_t)packSnorm(w, 1) & 0x3u) << 30;
+}
+
+uint32_t vertexFormat_packUnorm8888(float x, float y, float z, float w)
+{
+    return packUnorm(x, 255)
+        | packUnorm(y, 255) << 8
+        | packUnorm(z, 255) << 16
+        | packUnorm(w, 255) << 24;
+}
+
+uint32_t vertexFormat_attribSize(const MeshAttrib* attrib)
+{
+    switch (attrib->type)
+    {
+        case MESH_TYPE_BYTE:
+        case MESH_TYPE_UNSIGNED_BYTE:
+            return attrib->size;
+        case MESH_TYPE_SHORT:
+        case MESH_TYPE_UNSIGNED_SHORT:
+        case MESH_TYPE_HALF_FLOAT:
+            return 2 * attrib->size;
+        case MESH_TYPE_INT_2_10_10_10_REV:
+            return 4;
+        default:
+            return 4 * attrib->size;
+    }
+}
+
+void vertexFormat_encode(const MeshAttrib* attrib, void* vertex, const float* values)
+{
+    char* target = (char*)vertex + attrib->offset;
+    const bool normalized = attrib->normalized != 0;
+
+    if (attrib->type == MESH_TYPE_INT_2_10_10_10_REV)
+    {
+        const uint32_t packed = normalized
+            ? vertexFormat_packSnorm1010102(values[0], values[1], values[2], values[3])
+            : ((uint32_t)lrintf(values[0]) & 0x3FFu)
+                | ((uint32_t)lrintf(values[1]) & 0x3FFu) << 10
+                | ((uint32_t)lrintf(values[2]) & 0x3FFu) << 20
+                | ((uint32_t)lrintf(values[3]) & 0x3u) << 30;
+        memcpy(target, &packed, sizeof(packed));
+        return;
+    }
+
+    for (uint32_t i = 0; i < attrib->size; i++)
+    {
+        const float value = values[i];
+        switch (attrib->type)
+        {
+            case MESH_TYPE_FLOAT:
+                memcpy(target + 4 * i, &value, 4);
+                break;
+            case MESH_TYPE_HALF_FLOAT:
+            {
+                const uint16_t half = vertexFormat_packHalf(value);
+                memcpy(target + 2 * i, &half, 2);
+                break;
+            }
+            case MESH_TYPE_UNSIGNED_BYTE:
+                ((uint8_t*)target)[i] = (uint8_t)(normalized ? packUnorm(value, 255) : (uint32_t)clampf(value, 0.f, 255.f));
+                break;
+            case MESH_TYPE_BYTE:
+                ((int8_t*)target)[i] = (int8_t)(normalized ? packSnorm(value, 127) : (int32_t)clampf(value, -128.f, 127.f));
+                break;
+            case MESH_TYPE_UNSIGNED_SHORT:
+            {
+                const uint16_t packed = (uint16_t)(normalized ? packUnorm(value, 65535) : (uint32_t)clampf(value, 0.f, 65535.f));
+                memcpy(target + 2 * i, &packed, 2);
+                break;
+            }
+            case MESH_TYPE_SHORT:
+            {
+                const int16_t packed = (int16_t)(normalized ? packSnorm(value, 32767) : (int32_t)clampf(value, -32768.f, 32767.f));
+                memcpy(target + 2 * i, &packed, 2);
+                break;
+            }
+            case MESH_TYPE_UNSIGNED_INT:
+            {
+                const uint32_t packed = (uint32_t)value;
+                memcpy(target + 4 * i, &packed, 4);
+                break;
+            }
+            case MESH_TYPE_INT:
+            {
+                const int32_t packed = (int32_t)value;
+                memcpy(target + 4 * i, &packed, 4);
+                break;
+            }
+        }
+    }
+}
+
+void vertexFormat_decode(const MeshAttrib* attrib, const void* vertex, float* values)
+{
+    const char* source = (const char*)vertex + attrib->offset;
+    const bool normalized = attrib->normalized != 0;
+
+    if (attrib->type == MESH_TYPE_INT_2_10_10_10_REV)
+    {
+        uint32_t packed;
+        memcpy(&packed, source, sizeof(packed));
+        for (uint32_t i = 0; i < 4; i++)
+        {
+            const uint32_t bits = i < 3 ? 10 : 2;
+            const int32_t component = signExtend((packed >> (10 * i)) & ((1u << bits) - 1), bits);
+            values[i] = normalized ? unpackSnorm(component, (1 << (bits - 1)) - 1) : (float)component;
+        }
+        return;
+    }
+
+    for (uint32_t i = 0; i < attrib->size; i++)
+    {
+        switch (attrib->type)
+        {
+            case MESH_TYPE_FLOAT:
+                memcpy(&values[i], source + 4 * i, 4);
+                break;
+            case MESH_TYPE_HALF_FLOAT:
+            {
+                uint16_t half;
+                memcpy(&half, source + 2 * i, 2);
+                values[i] = vertexFormat_unpackHalf(half);
+                break;
+            }
+            case MESH_TYPE_UNSIGNED_BYTE:
+            {
+                const uint8_t packed = ((const uint8_t*)source)[i];
+                values[i] = normalized ? packed / 255.f : (float)packed;
+                break;
+            }
+            case MESH_TYPE_BYTE:
+            {
+                const int8_t packed = ((const int8_t*)source)[i];
+                values[i] = normalized ? unpackSnorm(packed, 127) : (float)packed;
+                break;
+            }
+            case MESH_TYPE_UNSIGNED_SHORT:
+            {
+                uint16_t packed;
+                memcpy(&packed, source + 2 * i, 2);
+                values[i] = normalized ? packed / 65535.f : (float)packed;
+                break;
+            }
+            case MESH_TYPE_SHORT:
+            {
+                int16_t packed;
+                memcpy(&packed, source + 2 * i, 2);
+                values[i] = normalized ? unpackSnorm(packed, 32767) : (float)packed;
+                break;
+            }
+            case MESH_TYPE_UNSIGNED_INT:
+            {
+                uint32_t packed;
+                memcpy(&packed, source + 4 * i, 4);
+                values[i] = (float)packed;
+                break;
+            }
+            case MESH_TYPE_INT:
+            {
+                int32_t packed;
+                memcpy(&packed, source + 4 * i, 4);
+                values[i] = (float)packed;
+                break;
+            }
+            default:
+                values[i] = 0.f;
+                break;
+        }
+    }
+}
+
+// Re-encodes vertices attribute by attribute, matching on location. Missing
+// components default to (0, 0, 0, 1) like GL does.
+void vertexFormat_convert(
+    void* target, const MeshAttrib* targetAttribs, uint32_t targetAttribCount, uint32_t targetStride,
+    const void* source, const MeshAttrib* sourceAttribs, uint32_t sourceAttribCount, uint32_t sourceStride,
+    uint32_t vertexCount)
+{
+    int32_t sourceIndex[MESH_MAX_ATTRIBS];
+    for (uint32_t i = 0; i < targetAttribCount; i++)
+    {
+        sourceIndex[i] = -1;
+        for (uint32_t j = 0; j < sourceAttribCount; j++)
+        {
+            if (sourceAttribs[j].location == targetAttribs[i].location)
+            {
+                sourceIndex[i] = (int32_t)j;
+            }
+        }
+    }
+
+    memset(target, 0, (size_t)vertexCount * targetStride);
+    for (uint32_t vertex = 0; vertex < vertexCount; vertex++)
+    {
+        const char* sourceVertex = (const char*)source + (size_t)vertex * sourceStride;
+        char* targetVertex = (char*)target + (size_t)vertex * targetStride;
+        for (uint32_t i = 0; i < targetAttribCount; i++)
+        {
+            float values[4] = { 0.f, 0.f, 0.f, 1.f };
+            if (sourceIndex[i] >= 0)
+            {
+                vertexFormat_decode(&sourceAttribs[sourceIndex[i]], sourceVertex, values);
+            }
+            vertexFormat_encode(&targetAttribs[i], targetVertex, values);
+        }
+    }
+}
+
+bool vertexFormat_narrowIndices(uint16_t* target, const uint32_t* source, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (source[i] > UINT16_MAX)
+        {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        target[i] = (uint16_t)source[i];
+    }
+    return true;
+}
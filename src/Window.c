@@ -1,4 +1,11 @@
 #include "../include/Window.h"
+#include "../include/GLState.h"
+#include "../include/Image.h"
+
+#include <string.h>
+#include <time.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
 
 static void framebufferSizeCallback(GLFWwindow* window, int width, int height);
 
@@ -41,27 +48,230 @@ Window window_create(int width, int height, const char* title)
         exit(EXIT_FAILURE);
     }
 
-    glEnable(GL_DEPTH_TEST);
+    glState_reset();
+    glState_enable(GL_DEPTH_TEST);
+    glClearColor(0.f, 0.0f, 0.0f, 1.f);
+    glState_viewport(0, 0, width, height);
+
+    return window;
+}
+
+static double window_now(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec + (double)time.tv_nsec * 1e-9;
+}
+
+// Mesa's surfaceless platform needs neither a display server nor a GPU; the
+// default display is the fallback for other drivers.
+static EGLDisplay window_getHeadlessDisplay(void)
+{
+    const char* extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay != NULL && extensions != NULL && strstr(extensions, "EGL_MESA_platform_surfaceless") != NULL)
+    {
+        EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+        if (display != EGL_NO_DISPLAY)
+        {
+            return display;
+        }
+    }
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+// The newest core context the driver gives out, down to 3.3.
+static EGLContext window_createHeadlessContext(EGLDisplay display, EGLConfig config)
+{
+    const EGLint versions[][2] = { { 4, 5 }, { 4, 3 }, { 3, 3 } };
+    for (size_t i = 0; i < sizeof(versions) / sizeof(versions[0]); i++)
+    {
+        const EGLint attribs[] =
+        {
+            EGL_CONTEXT_MAJOR_VERSION, versions[i][0],
+            EGL_CONTEXT_MINOR_VERSION, versions[i][1],
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE,
+        };
+        EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, attribs);
+        if (context != EGL_NO_CONTEXT)
+        {
+            return context;
+        }
+    }
+    return EGL_NO_CONTEXT;
+}
+
+static void window_failHeadless(Window* window, const char* message)
+{
+    fprintf(stderr, "%s\n", message);
+    window_destroy(window);
+    exit(EXIT_FAILURE);
+}
+
+// Renders into a framebuffer object of the given size on an EGL context, so
+// no display server is needed. Nothing is presented; read the frame back
+// with window_saveScreenshot.
+Window window_createHeadless(int width, int height)
+{
+    Window window =
+    {
+        .glfwWindow = NULL,
+        .width = width,
+        .height = height,
+        .deltaTime = 0.f,
+        ._lastTime = 0.f,
+        .headless = true,
+        ._startTime = window_now(),
+    };
+
+    EGLDisplay display = window_getHeadlessDisplay();
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL))
+    {
+        fprintf(stderr, "Failed to initialize an EGL display!\n");
+        exit(EXIT_FAILURE);
+    }
+    window._eglDisplay = display;
+
+    const EGLint configAttribs[] =
+    {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_NONE,
+    };
+    EGLConfig config;
+    EGLint configCount = 0;
+    if (!eglBindAPI(EGL_OPENGL_API) ||
+        !eglChooseConfig(display, configAttribs, &config, 1, &configCount) ||
+        configCount == 0)
+    {
+        window_failHeadless(&window, "Failed to find an EGL config for desktop GL!");
+    }
+
+    EGLContext context = window_createHeadlessContext(display, config);
+    if (context == EGL_NO_CONTEXT)
+    {
+        window_failHeadless(&window, "Failed to create an EGL context!");
+    }
+    window._eglContext = context;
+
+    // Drivers without surfaceless contexts get a 1x1 pbuffer, which is never
+    // drawn to.
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+    {
+        const EGLint surfaceAttribs[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+        EGLSurface surface = eglCreatePbufferSurface(display, config, surfaceAttribs);
+        window._eglSurface = surface != EGL_NO_SURFACE ? surface : NULL;
+        if (surface == EGL_NO_SURFACE || !eglMakeCurrent(display, surface, surface, context))
+        {
+            window_failHeadless(&window, "Failed to make the EGL context current!");
+        }
+    }
+
+    // GLEW built for GLX cannot find a GLX display here, but it has loaded
+    // the GL entry points by the time it reports that.
+    glewExperimental = GL_TRUE;
+    GLenum glewStatus = glewInit();
+    if (glewStatus != GLEW_OK && glewStatus != GLEW_ERROR_NO_GLX_DISPLAY)
+    {
+        fprintf(stderr, "Failed to initialize GLEW!\n");
+        fprintf(stderr, "Error:\n%s\n", glewGetErrorString(glewStatus));
+        window_destroy(&window);
+        exit(EXIT_FAILURE);
+    }
+
+    glGenRenderbuffers(1, &window._colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, window._colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glGenRenderbuffers(1, &window._depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, window._depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &window.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, window.framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, window._colorBuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, window._depthBuffer);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        window_failHeadless(&window, "Failed to create the offscreen framebuffer!");
+    }
+
+    glState_reset();
+    glState_enable(GL_DEPTH_TEST);
     glClearColor(0.f, 0.0f, 0.0f, 1.f);
-    glViewport(0, 0, width, height);
+    glState_viewport(0, 0, width, height);
 
     return window;
 }
 
+// A hidden window whose context shares objects with the window's own, for
+// building GL objects on another thread. NULL when the platform cannot
+// create one, and always for headless windows.
+GLFWwindow* window_createSharedContext(Window* window)
+{
+    if (window->headless)
+    {
+        return NULL;
+    }
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* context = glfwCreateWindow(1, 1, "", NULL, window->glfwWindow);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+    if (context == NULL)
+    {
+        fprintf(stderr, "Failed to create a shared context!\n");
+    }
+    return context;
+}
+
+void window_makeContextCurrent(void* context)
+{
+    glfwMakeContextCurrent((GLFWwindow*)context);
+}
+
+// Headless frames are only flushed, so the driver keeps working on them
+// while the next one is built.
 void window_swapBuffers(Window* window)
 {
+    if (window->headless)
+    {
+        glFlush();
+        return;
+    }
     glfwSwapBuffers(window->glfwWindow);
 }
 
 void window_updateDeltaTime(Window* window)
 {
-    double currentTime = glfwGetTime();
+    double currentTime = window->headless ? window_now() - window->_startTime : glfwGetTime();
     window->deltaTime = currentTime - window->_lastTime;
     window->_lastTime = currentTime;
 }
 
 void window_destroy(Window* window)
 {
+    if (window->headless)
+    {
+        if (window->framebuffer != 0)
+        {
+            glDeleteFramebuffers(1, &window->framebuffer);
+            glDeleteRenderbuffers(1, &window->_colorBuffer);
+            glDeleteRenderbuffers(1, &window->_depthBuffer);
+        }
+        if (window->_eglContext != NULL)
+        {
+            eglMakeCurrent(window->_eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            eglDestroyContext(window->_eglDisplay, window->_eglContext);
+        }
+        if (window->_eglSurface != NULL)
+        {
+            eglDestroySurface(window->_eglDisplay, window->_eglSurface);
+        }
+        eglTerminate(window->_eglDisplay);
+        *window = (Window){ 0 };
+        return;
+    }
     glfwDestroyWindow(window->glfwWindow);
     window->glfwWindow = NULL;
     window->width = 0;
@@ -70,32 +280,87 @@ void window_destroy(Window* window)
 
 bool window_shouldClose(Window* window)
 {
+    if (window->headless)
+    {
+        return window->_closing;
+    }
     return glfwWindowShouldClose(window->glfwWindow);
 }
 
+void window_close(Window* window)
+{
+    if (window->headless)
+    {
+        window->_closing = true;
+        return;
+    }
+    glfwSetWindowShouldClose(window->glfwWindow, GLFW_TRUE);
+}
+
+void window_pollEvents(Window* window)
+{
+    if (!window->headless)
+    {
+        glfwPollEvents();
+    }
+}
+
+// Reads back the frame drawn so far, so call it before the buffers are
+// swapped. The image is written as a binary PPM.
+bool window_saveScreenshot(Window* window, const char* path)
+{
+    Image image;
+    if (!image_create(&image, (uint32_t)window->width, (uint32_t)window->height))
+    {
+        fprintf(stderr, "Failed to allocate a %dx%d screenshot!\n", window->width, window->height);
+        return false;
+    }
+    glState_bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glReadPixels(0, 0, window->width, window->height, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels);
+
+    const bool saved = image_savePpm(&image, path);
+    if (!saved)
+    {
+        fprintf(stderr, "Failed to write the screenshot to %s!\n", path);
+    }
+    image_free(&image);
+    return saved;
+}
+
 bool window_isKeyPressed(Window* window, int key)
 {
+    if (window->headless)
+    {
+        return false;
+    }
     return glfwGetKey(window->glfwWindow, key) == GLFW_PRESS;
 }
 
 void window_showCursor(Window* window)
 {
+    if (window->headless) return;
     glfwSetInputMode(window->glfwWindow, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
 }
 
 void window_hideCursor(Window* window)
 {
+    if (window->headless) return;
     glfwSetInputMode(window->glfwWindow, GLFW_CURSOR, GLFW_CURSOR_HIDDEN);
 }
 
 void window_centerCursor(Window* window)
 {
+    if (window->headless) return;
     glfwSetCursorPos(window->glfwWindow, (double)window->width / 2.f, (double)window->height / 2.f);
 }
 
 Vec3 window_getMovementVec(Window* window)
 {
     Vec3 movementVec = vec3(0.f, 0.f, 0.f);
+    if (window->headless)
+    {
+        return movementVec;
+    }
     if (glfwGetKey(window->glfwWindow, GLFW_KEY_W) == GLFW_PRESS)
     {
         movementVec.z += 1;
@@ -128,5 +393,5 @@ static void framebufferSizeCallback(GLFWwindow* glfwWindow, int width, int heigh
     Window* window = glfwGetWindowUserPointer(glfwWindow);
     window->width = width;
     window->height = height;
-    glViewport(0, 0, width, height);
+    glState_viewport(0, 0, width, height);
 }
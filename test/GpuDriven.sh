@@ -0,0 +1,35 @@
+#!/bin/sh
+# Renders the same scripted headless frames on the GPU-driven path and the
+# CPU-culled path with Mesa's software rasterizer, and fails unless both
+# culled the grid down to the same number of visible instances. The meshes
+# differ between the paths, so the screenshots are kept for inspection but
+# not compared.
+#
+# Usage: test/GpuDriven.sh [build/gl] [frames]
+
+BIN=${1:-build/gl}
+FRAMES=${2:-60}
+OUT=$(dirname "$BIN")
+
+visible()
+{
+    LIBGL_ALWAYS_SOFTWARE=1 "$BIN" --headless --frames "$FRAMES" --size 320x240 "$@" \
+        | sed -n 's/^Visible instances on the last frame: \([0-9]*\) (\(.*\))$/\1 \2/p'
+}
+
+gpu=$(visible --screenshot "$OUT/gpu-driven.ppm")
+cpu=$(visible --cpu-culling --screenshot "$OUT/cpu-culled.ppm")
+
+if [ "${gpu#* }" != "GPU-driven" ]; then
+    echo "Failed to render on the GPU-driven path, got: ${gpu:-nothing}" >&2
+    exit 1
+fi
+if [ "${cpu#* }" != "CPU-culled" ]; then
+    echo "Failed to render on the CPU-culled path, got: ${cpu:-nothing}" >&2
+    exit 1
+fi
+if [ "${gpu%% *}" != "${cpu%% *}" ]; then
+    echo "Failed to match the CPU-culled path: ${gpu%% *} instances visible on the GPU, ${cpu%% *} on the CPU" >&2
+    exit 1
+fi
+echo "GPU-driven and CPU-culled paths both drew ${gpu%% *} instances after $FRAMES frames"
@@ -0,0 +1,1673 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <float.h>
+#include <unistd.h>
+
+#include "../include/Space.h"
+#include "../include/SpaceSimd.h"
+#include "../include/SpaceBatch.h"
+#include "../include/Camera.h"
+#include "../include/Window.h"
+#include "../include/Image.h"
+#include "../include/Texture.h"
+#include "../include/GpuArena.h"
+#include "../include/GLState.h"
+#include "../include/Mesh.h"
+#include "../include/Culling.h"
+#include "../include/Bvh.h"
+#include "../include/RenderQueue.h"
+#include "../include/MeshOptimize.h"
+#include "../include/VertexFormat.h"
+
+typedef bool (*TestFunction)(void);
+
+typedef struct
+{
+    const char* name;
+    TestFunction run;
+} Test;
+
+// The test binary is linked with --wrap for the allocator entry points, like
+// the benchmarks, so heap traffic on the frame path can be asserted on.
+static size_t allocationCount = 0;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* pointer, size_t size);
+
+void* __wrap_malloc(size_t size)
+{
+    allocationCount++;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size)
+{
+    allocationCount++;
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* pointer, size_t size)
+{
+    allocationCount++;
+    return __real_realloc(pointer, size);
+}
+
+static const char* currentTest = NULL;
+
+static bool expect(bool condition, const char* format, ...)
+{
+    if (condition)
+    {
+        return true;
+    }
+    va_list arguments;
+    va_start(arguments, format);
+    fprintf(stderr, "FAIL %s: ", currentTest);
+    vfprintf(stderr, format, arguments);
+    fprintf(stderr, "\n");
+    va_end(arguments);
+    return false;
+}
+
+#define TEST_WINDOW_SIZE 64
+
+// GL tests share one headless context, created by the first that needs it.
+static Window window;
+static bool windowCreated = false;
+
+static void requireContext(void)
+{
+    if (windowCreated)
+        return;
+    window = window_createHeadless(TEST_WINDOW_SIZE, TEST_WINDOW_SIZE);
+    windowCreated = true;
+}
+
+static float randomFloat(float min, float max)
+{
+    return min + (max - min) * ((float)rand() / (float)RAND_MAX);
+}
+
+static Vec3 randomVec3(float min, float max)
+{
+    return vec3(randomFloat(min, max), randomFloat(min, max), randomFloat(min, max));
+}
+
+#define TEST_FRAMES 1000
+
+// Everything camera_recomputeMatrix and the per-frame model matrices go
+// through, in both camera modes. None of it may touch the heap.
+static bool test_allocations_framePath(void)
+{
+    Camera camera = camera_create(60.f, 10.f, 0.25f, 4.f / 3.f);
+    Affine models[16];
+    Mat4 mat;
+    Mat4 other;
+    Mat4 target;
+    Mat3 normal;
+    Vec3 translation = vec3(0.f, 0.f, 0.f);
+    Vec3 scale = vec3(1.f, 1.f, 1.f);
+    volatile float sink = 0.f;
+
+    for (int i = 0; i < 16; i++)
+    {
+        affine_load_identity(&models[i]);
+    }
+
+    srand(1234);
+    const size_t before = allocationCount;
+    for (int frame = 0; frame < TEST_FRAMES; frame++)
+    {
+        camera.position = randomVec3(-50.f, 50.f);
+        camera_updateYaw(&camera, randomFloat(-180.f, 180.f));
+        camera_updatePitch(&camera, randomFloat(-89.f, 89.f));
+        camera_disableQuaternion(&camera);
+        camera_recomputeMatrix(&camera);
+        camera_enableQuaternion(&camera);
+        camera_recomputeMatrix(&camera);
+        sink += camera.matrix[3][3];
+
+        for (int i = 0; i < 16; i++)
+        {
+            const Quat rotation = quat_fromAxisAngle(vec3_normalize(randomVec3(-1.f, 1.f)), randomFloat(-180.f, 180.f));
+            quat_toAffine(rotation, randomVec3(-10.f, 10.f), &models[i]);
+            affine_translate_inplace(&models[i], randomVec3(-1.f, 1.f));
+            affine_multiply_inplace(&models[i], &models[(i + 15) % 16]);
+            affine_to_mat4(&models[i], &mat);
+            affine_from_mat4(&mat, &models[i]);
+            sink += affine_transform_point(&models[i], vec3(1.f, 2.f, 3.f)).x;
+        }
+
+        mat4_load_diagonal(&mat, 2.f);
+        mat4_load_identity(&other);
+        mat4_copy(&camera.matrix, &other);
+        mat4_scale_inplace(&mat, 1.5f);
+        mat4_scale_to(&other, 0.5f, &target);
+        mat4_multiply_inplace(&mat, &other);
+        mat4_multiply_to(&mat, &other, &target);
+        mat4_multiply_many_inplace(&target, 3, &mat, &other, &camera.matrix);
+        mat4_transpose_inplace(&target);
+        mat4_transpose_to(&mat, &target);
+        mat4_translate_inplace(&mat, randomVec3(-10.f, 10.f));
+        mat4_translate_to(&mat, randomVec3(-10.f, 10.f), &target);
+        mat4_rotate_inplace(&mat, randomFloat(-180.f, 180.f), randomVec3(-1.f, 1.f));
+        mat4_rotate_to(&mat, randomFloat(-180.f, 180.f), randomVec3(-1.f, 1.f), &target);
+        mat4_inverse_to(&target, &other);
+        mat4_inverse_inplace(&target);
+        mat4_normal_matrix_to(&target, &normal);
+        mat4_decompose(&target, &translation, &normal, &scale);
+        mat4_ortho_inplace(&mat, -1.f, 1.f, -1.f, 1.f, 0.1f, 100.f);
+        mat4_perspective_inplace(&mat, 60.f, 4.f / 3.f, 0.01f, 100.f);
+        mat4_lookAt_inplace(&mat, camera.position, vec3(0.f, 0.f, 0.f), vec3(0.f, 1.f, 0.f));
+        mat4_view_inplace(&mat, camera.position, camera.orientation);
+        sink += mat4_transform_point(&mat, translation).z + scale.x + normal[1][1] + target[2][2];
+    }
+    const size_t allocations = allocationCount - before;
+    (void)sink;
+    if (!expect(allocations == 0, "%zu allocations over %d frames", allocations, TEST_FRAMES))
+    {
+        return false;
+    }
+
+    // The pointer-returning forms still allocate, which also shows the
+    // counter is wired up.
+    const size_t wrappedBefore = allocationCount;
+    Mat4* product = mat4_multiply(&mat, &other);
+    const size_t wrapped = allocationCount - wrappedBefore;
+    free(product);
+    return expect(wrapped == 1, "mat4_multiply made %zu allocations, expected 1", wrapped);
+}
+
+// SIMD results may differ from the scalar kernels by reordered or fused
+// multiply-adds. Each element is allowed this many ULPs of the sum of the
+// magnitudes of its terms, which is what a reordering can move it by; the
+// inverse also scales by the condition number.
+#define TEST_KERNEL_ULPS         4.f
+#define TEST_KERNEL_INVERSE_ULPS 16.f
+#define TEST_KERNEL_RANDOM_COUNT 10000
+
+static const char* const kernelNames[] = { "sse", "avx2", "neon" };
+
+static bool withinUlps(float value, float reference, float magnitude, float ulps)
+{
+    return fabsf(value - reference) <= ulps * FLT_EPSILON * magnitude;
+}
+
+static void randomMat4(Mat4* mat, float range)
+{
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++)
+            (*mat)[i][j] = randomFloat(-range, range);
+}
+
+// Identity, zero, signed zeros, very large and very small values, and
+// matrices whose products cancel.
+static void edgeCaseMat4(Mat4* mat, int index)
+{
+    switch (index)
+    {
+    case 0:
+        mat4_load_identity(mat);
+        break;
+    case 1:
+        mat4_load_diagonal(mat, 0.f);
+        break;
+    case 2:
+        mat4_load_diagonal(mat, -0.f);
+        (*mat)[3][3] = -1.f;
+        break;
+    case 3:
+        randomMat4(mat, 1e9f);
+        break;
+    case 4:
+        randomMat4(mat, 1e-9f);
+        break;
+    case 5:
+        for (int i = 0; i < 4; i++)
+            for (int j = 0; j < 4; j++)
+                (*mat)[i][j] = ((i + j) % 2 == 0 ? 1.f : -1.f) * (1.f + (float)(i * 4 + j) * FLT_EPSILON);
+        break;
+    default:
+        mat4_perspective_inplace(mat, 60.f, 16.f / 9.f, 0.01f, 1000.f);
+        break;
+    }
+}
+
+#define TEST_KERNEL_EDGE_CASES 7
+
+static bool compareMultiply(const Mat4Kernels* kernels, Mat4* matOne, Mat4* matTwo)
+{
+    Mat4 result;
+    Mat4 reference;
+    kernels->multiply(matOne, matTwo, &result);
+    mat4_kernels_scalar()->multiply(matOne, matTwo, &reference);
+    for (int i = 0; i < 4; i++)
+    {
+        for (int j = 0; j < 4; j++)
+        {
+            float magnitude = 0.f;
+            for (int k = 0; k < 4; k++)
+                magnitude += fabsf((*matOne)[i][k] * (*matTwo)[k][j]);
+            if (!expect(withinUlps(result[i][j], reference[i][j], magnitude, TEST_KERNEL_ULPS),
+                "%s multiply [%d][%d] is %.9g, scalar %.9g", kernels->name, i, j, result[i][j], reference[i][j]))
+                return false;
+        }
+    }
+    return true;
+}
+
+static bool compareTranspose(const Mat4Kernels* kernels, Mat4* mat)
+{
+    Mat4 result;
+    Mat4 reference;
+    kernels->transpose(mat, &result);
+    mat4_kernels_scalar()->transpose(mat, &reference);
+    return expect(memcmp(result, reference, sizeof(Mat4)) == 0, "%s transpose is not bit-exact", kernels->name);
+}
+
+static bool compareTransformPoint(const Mat4Kernels* kernels, Mat4* mat, Vec3 point)
+{
+    const Vec3 result = kernels->transformPoint(mat, point);
+    const Vec3 reference = mat4_kernels_scalar()->transformPoint(mat, point);
+    const float values[3] = { result.x, result.y, result.z };
+    const float references[3] = { reference.x, reference.y, reference.z };
+    for (int j = 0; j < 3; j++)
+    {
+        const float magnitude = fabsf((*mat)[0][j] * point.x) + fabsf((*mat)[1][j] * point.y)
+            + fabsf((*mat)[2][j] * point.z) + fabsf((*mat)[3][j]);
+        if (!expect(withinUlps(values[j], references[j], magnitude, TEST_KERNEL_ULPS),
+            "%s transformPoint [%d] is %.9g, scalar %.9g", kernels->name, j, values[j], references[j]))
+            return false;
+    }
+    return true;
+}
+
+static bool compareAffineMultiply(const Mat4Kernels* kernels, Mat4* matOne, Mat4* matTwo)
+{
+    Affine one;
+    Affine two;
+    Affine result;
+    Affine reference;
+    affine_from_mat4(matOne, &one);
+    affine_from_mat4(matTwo, &two);
+    kernels->affineMultiply(&one, &two, &result);
+    mat4_kernels_scalar()->affineMultiply(&one, &two, &reference);
+    for (int i = 0; i < 4; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            float magnitude = i == 3 ? fabsf(two[3][j]) : 0.f;
+            for (int k = 0; k < 3; k++)
+                magnitude += fabsf(one[i][k] * two[k][j]);
+            if (!expect(withinUlps(result[i][j], reference[i][j], magnitude, TEST_KERNEL_ULPS),
+                "%s affineMultiply [%d][%d] is %.9g, scalar %.9g", kernels->name, i, j, result[i][j], reference[i][j]))
+                return false;
+        }
+    }
+    return true;
+}
+
+static float infinityNorm(Mat4* mat)
+{
+    float norm = 0.f;
+    for (int i = 0; i < 4; i++)
+        norm = fmaxf(norm, fabsf((*mat)[i][0]) + fabsf((*mat)[i][1]) + fabsf((*mat)[i][2]) + fabsf((*mat)[i][3]));
+    return norm;
+}
+
+// Any two correct inverses can differ by the rounding error amplified by the
+// condition number, so the tolerance is scaled by it, on top of the largest
+// element of the scalar inverse. Both kernels must also agree on which
+// matrices are singular.
+static bool compareInverse(const Mat4Kernels* kernels, Mat4* mat)
+{
+    Mat4 result;
+    Mat4 reference;
+    const bool inverted = kernels->inverse(mat, &result);
+    const bool referenceInverted = mat4_kernels_scalar()->inverse(mat, &reference);
+    if (!expect(inverted == referenceInverted, "%s inverse %s a matrix the scalar kernel %s",
+        kernels->name, inverted ? "inverted" : "rejected", referenceInverted ? "inverted" : "rejected"))
+        return false;
+    if (!inverted)
+        return true;
+
+    const float condition = infinityNorm(mat) * infinityNorm(&reference);
+    float magnitude = 0.f;
+    for (int i = 0; i < 4; i++)
+        for (int j = 0; j < 4; j++)
+            magnitude = fmaxf(magnitude, fabsf(reference[i][j]));
+    for (int i = 0; i < 4; i++)
+    {
+        for (int j = 0; j < 4; j++)
+        {
+            if (!expect(withinUlps(result[i][j], reference[i][j], magnitude * condition, TEST_KERNEL_INVERSE_ULPS),
+                "%s inverse [%d][%d] is %.9g, scalar %.9g", kernels->name, i, j, result[i][j], reference[i][j]))
+                return false;
+        }
+    }
+    return true;
+}
+
+// Rotation goes through the dispatched multiply, so it is compared with the
+// backend selected against the same call with the scalar kernels selected.
+// The rotation matrix keeps the input's last row and column, so its terms
+// are bounded by the larger of 1 and the input element.
+static bool compareRotate(const Mat4Kernels* kernels, Mat4* mat, float degrees, Vec3 axis)
+{
+    Mat4 result;
+    Mat4 reference;
+    mat4_kernels_use(kernels);
+    mat4_rotate_to(mat, degrees, axis, &result);
+    mat4_kernels_use(mat4_kernels_scalar());
+    mat4_rotate_to(mat, degrees, axis, &reference);
+    for (int i = 0; i < 4; i++)
+    {
+        for (int j = 0; j < 4; j++)
+        {
+            float magnitude = 0.f;
+            for (int k = 0; k < 4; k++)
+                magnitude += fmaxf(1.f, fabsf((*mat)[i][k])) * fabsf((*mat)[k][j]);
+            if (!expect(withinUlps(result[i][j], reference[i][j], magnitude, TEST_KERNEL_ULPS),
+                "%s rotate [%d][%d] is %.9g, scalar %.9g", kernels->name, i, j, result[i][j], reference[i][j]))
+                return false;
+        }
+    }
+    return true;
+}
+
+static bool compareKernels(const Mat4Kernels* kernels, Mat4* matOne, Mat4* matTwo, Vec3 point)
+{
+    return compareMultiply(kernels, matOne, matTwo)
+        && compareMultiply(kernels, matTwo, matOne)
+        && compareTranspose(kernels, matOne)
+        && compareTransformPoint(kernels, matOne, point)
+        && compareAffineMultiply(kernels, matOne, matTwo)
+        && compareInverse(kernels, matOne)
+        && compareRotate(kernels, matOne, randomFloat(-360.f, 360.f), randomVec3(-1.f, 1.f));
+}
+
+// Every backend the CPU reports is forced in turn, not just the one the
+// dispatch would pick.
+static bool test_kernels_matchScalar(void)
+{
+    bool passed = true;
+    size_t tested = 0;
+    for (size_t n = 0; n < sizeof(kernelNames) / sizeof(kernelNames[0]) && passed; n++)
+    {
+        const Mat4Kernels* kernels = mat4_kernels_find(kernelNames[n]);
+        if (kernels == NULL)
+            continue;
+        tested++;
+
+        mat4_kernels_use(kernels);
+        passed = expect(mat4_kernels() == kernels, "%s could not be selected", kernels->name);
+
+        srand(2468);
+        Mat4 matOne;
+        Mat4 matTwo;
+        for (int i = 0; i < TEST_KERNEL_EDGE_CASES && passed; i++)
+        {
+            for (int j = 0; j < TEST_KERNEL_EDGE_CASES && passed; j++)
+            {
+                edgeCaseMat4(&matOne, i);
+                edgeCaseMat4(&matTwo, j);
+                passed = compareKernels(kernels, &matOne, &matTwo, randomVec3(-100.f, 100.f));
+            }
+        }
+        for (int i = 0; i < TEST_KERNEL_RANDOM_COUNT && passed; i++)
+        {
+            randomMat4(&matOne, 100.f);
+            randomMat4(&matTwo, 100.f);
+            passed = compareKernels(kernels, &matOne, &matTwo, randomVec3(-100.f, 100.f));
+        }
+    }
+    mat4_kernels_use(NULL);
+    printf("Compared %zu SIMD backends against the scalar kernels\n", tested);
+    return passed;
+}
+
+#define TEST_TEXTURE_COUNT      48
+#define TEST_TEXTURE_SIZES      8
+#define TEST_TEXTURE_BUDGET     (256u << 10)
+#define TEST_TEXTURE_UPLOAD     (16 << 10)
+#define TEST_TEXTURE_MAX_FRAMES 20000
+
+// Each texture is a flat colour derived from its index, so a re-streamed
+// layer can be told apart from a stale one.
+static void textureColor(uint32_t index, uint8_t* color)
+{
+    color[0] = (uint8_t)(index * 37);
+    color[1] = (uint8_t)(index * 91 + 17);
+    color[2] = (uint8_t)index;
+    color[3] = 255;
+}
+
+// Consecutive textures share a size, and so an array.
+static uint32_t textureWidth(uint32_t index)
+{
+    return 32 + 16 * (index / (TEST_TEXTURE_COUNT / TEST_TEXTURE_SIZES));
+}
+
+static bool writeTexture(const char* path, uint32_t index)
+{
+    Image image;
+    if (!image_create(&image, textureWidth(index), 32))
+        return false;
+    uint8_t color[IMAGE_CHANNELS];
+    textureColor(index, color);
+    for (size_t i = 0; i < image.size; i += IMAGE_CHANNELS)
+        memcpy(image.pixels + i, color, IMAGE_CHANNELS);
+    const bool saved = image_savePpm(&image, path);
+    image_free(&image);
+    return saved;
+}
+
+// Drives the cache until nothing is queued or uploading, checking the
+// budget and the per-frame upload limit after every frame.
+static bool streamTextures(TextureCache* cache, const TextureHandle* handles, uint32_t count)
+{
+    for (uint32_t frame = 0; frame < TEST_TEXTURE_MAX_FRAMES; frame++)
+    {
+        const uint64_t uploaded = cache->stats.uploadedBytes;
+        textureCache_update(cache);
+        const uint64_t frameBytes = cache->stats.uploadedBytes - uploaded;
+        if (!expect(frameBytes <= TEST_TEXTURE_UPLOAD, "frame %u uploaded %llu bytes, the limit is %d", frame, (unsigned long long)frameBytes, TEST_TEXTURE_UPLOAD))
+            return false;
+        if (!expect(cache->residentSize <= cache->budget, "frame %u has %zu bytes resident, the budget is %zu", frame, cache->residentSize, cache->budget))
+            return false;
+
+        bool pending = false;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const TextureState state = textureCache_state(cache, handles[i]);
+            pending = pending || state == TEXTURE_QUEUED || state == TEXTURE_UPLOADING;
+        }
+        if (!pending)
+            return true;
+        usleep(100);
+    }
+    return expect(false, "textures were still streaming after %d frames", TEST_TEXTURE_MAX_FRAMES);
+}
+
+static bool checkLayer(TextureCache* cache, TextureHandle handle)
+{
+    const Texture* texture = &cache->textures[handle];
+    const TextureArray* array = &cache->arrays[texture->array];
+    const size_t layerSize = (size_t)array->width * array->height * IMAGE_CHANNELS;
+    uint8_t* pixels = malloc(layerSize * TEXTURE_ARRAY_LAYERS);
+    if (pixels == NULL)
+        return expect(false, "could not allocate the read-back buffer");
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGetTexImage(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+
+    uint8_t color[IMAGE_CHANNELS];
+    textureColor(handle, color);
+    bool passed = true;
+    const uint8_t* layer = pixels + layerSize * texture->layer;
+    for (size_t i = 0; i < layerSize && passed; i += IMAGE_CHANNELS)
+        passed = expect(memcmp(layer + i, color, IMAGE_CHANNELS) == 0, "texture %u has the wrong pixels", handle);
+    free(pixels);
+    return passed;
+}
+
+// Loads several budgets' worth of textures in a handful of sizes, so each
+// size has its own array and eviction has to free whole arrays to make room.
+// Binding an evicted texture must bring it back with its own pixels.
+static bool test_textureCache_streamsWithinBudget(void)
+{
+    requireContext();
+    char directory[] = "/tmp/gl-test-XXXXXX";
+    if (!expect(mkdtemp(directory) != NULL, "could not create a temporary directory"))
+        return false;
+
+    char paths[TEST_TEXTURE_COUNT][64];
+    size_t loadedSize = 0;
+    bool passed = true;
+    for (uint32_t i = 0; i < TEST_TEXTURE_COUNT && passed; i++)
+    {
+        snprintf(paths[i], sizeof(paths[i]), "%s/%u.ppm", directory, i);
+        passed = expect(writeTexture(paths[i], i), "could not write %s", paths[i]);
+        loadedSize += (size_t)textureWidth(i) * 32 * IMAGE_CHANNELS;
+    }
+    passed = passed && expect(loadedSize > TEST_TEXTURE_BUDGET, "%zu bytes of textures do not exceed the budget", loadedSize);
+
+    // One decode thread keeps the upload order, and so what stays resident,
+    // the same from run to run.
+    TextureCache* cache = textureCache_create(1, TEST_TEXTURE_BUDGET, TEST_TEXTURE_UPLOAD, 3);
+    TextureHandle handles[TEST_TEXTURE_COUNT];
+    for (uint32_t i = 0; i < TEST_TEXTURE_COUNT && passed; i++)
+    {
+        handles[i] = textureCache_load(cache, paths[i], 0);
+        passed = expect(handles[i] == i, "texture %u got handle %u", i, handles[i]);
+    }
+    passed = passed && streamTextures(cache, handles, TEST_TEXTURE_COUNT);
+    passed = passed && expect(cache->stats.evictions > 0, "nothing was evicted");
+    passed = passed && expect(cache->stats.failed == 0 && cache->stats.overBudgetArrays == 0, "%llu textures failed and %llu arrays went over budget", (unsigned long long)cache->stats.failed, (unsigned long long)cache->stats.overBudgetArrays);
+
+    // Textures of one size share arrays, so this also checks the layers.
+    uint32_t resident = 0;
+    for (uint32_t i = 0; i < TEST_TEXTURE_COUNT && passed; i++)
+    {
+        uint32_t layer;
+        if (textureCache_state(cache, handles[i]) != TEXTURE_RESIDENT)
+            continue;
+        passed = expect(textureCache_bind(cache, handles[i], 0, &layer), "resident texture %u did not bind", i);
+        passed = passed && checkLayer(cache, handles[i]);
+        resident++;
+    }
+    passed = passed && expect(resident > 1, "only %u textures stayed resident", resident);
+    textureCache_update(cache);
+
+    uint32_t reloaded = 0;
+    for (uint32_t i = 0; i < TEST_TEXTURE_COUNT && passed; i++)
+    {
+        if (textureCache_state(cache, handles[i]) != TEXTURE_EVICTED)
+            continue;
+        uint32_t layer;
+        passed = expect(!textureCache_bind(cache, handles[i], 0, &layer), "evicted texture %u bound", i);
+        passed = passed && expect(textureCache_state(cache, handles[i]) == TEXTURE_QUEUED, "evicted texture %u was not queued again", i);
+        passed = passed && streamTextures(cache, &handles[i], 1);
+        passed = passed && expect(textureCache_bind(cache, handles[i], 0, &layer), "texture %u did not stream in again", i);
+        passed = passed && expect(layer == cache->textures[i].layer, "texture %u bound layer %u", i, layer);
+        passed = passed && checkLayer(cache, handles[i]);
+        // Textures bound this frame may not be evicted, so the next one
+        // streams in on a later frame, as it would when drawn.
+        textureCache_update(cache);
+        reloaded++;
+    }
+    passed = passed && expect(reloaded > 0 && cache->stats.reloads == reloaded, "%u evicted textures were bound, %llu reloads counted", reloaded, (unsigned long long)cache->stats.reloads);
+
+    // A row wider than the upload limit can never be staged, so the texture
+    // must fail instead of blocking the textures queued behind it.
+    char widePath[64];
+    snprintf(widePath, sizeof(widePath), "%s/wide.ppm", directory);
+    Image wide;
+    passed = passed && expect(image_create(&wide, TEST_TEXTURE_UPLOAD / IMAGE_CHANNELS + 1, 1), "could not create the wide image");
+    if (passed)
+    {
+        memset(wide.pixels, 255, wide.size);
+        passed = expect(image_savePpm(&wide, widePath), "could not write %s", widePath);
+        image_free(&wide);
+    }
+    if (passed)
+    {
+        TextureHandle queued[2] = { textureCache_load(cache, widePath, 0), TEXTURE_INVALID_HANDLE };
+        for (uint32_t i = 0; i < TEST_TEXTURE_COUNT && queued[1] == TEXTURE_INVALID_HANDLE; i++)
+            queued[1] = textureCache_state(cache, handles[i]) == TEXTURE_EVICTED ? handles[i] : TEXTURE_INVALID_HANDLE;
+        uint32_t layer;
+        passed = expect(queued[1] != TEXTURE_INVALID_HANDLE && !textureCache_bind(cache, queued[1], 0, &layer), "no evicted texture was left to queue");
+        passed = passed && streamTextures(cache, queued, 2);
+        passed = passed && expect(textureCache_state(cache, queued[0]) == TEXTURE_FAILED, "a texture with rows wider than the upload limit did not fail");
+        passed = passed && expect(textureCache_state(cache, queued[1]) == TEXTURE_RESIDENT, "texture %u, queued behind the wide one, did not stream in", queued[1]);
+    }
+    textureCache_delete(cache);
+    unlink(widePath);
+
+    for (uint32_t i = 0; i < TEST_TEXTURE_COUNT; i++)
+        unlink(paths[i]);
+    rmdir(directory);
+    return passed;
+}
+
+#define TEST_ARENA_MESHES     32
+#define TEST_ARENA_MOVES      4
+#define TEST_ARENA_MAX_PASSES 256
+
+static const char* arenaVertexShaderSource =
+    "#version 330 core\n"
+    "layout (location = 0) in vec2 aPos;\n"
+    "layout (location = 1) in float aShade;\n"
+    "flat out float shade;\n"
+    "void main()\n"
+    "{\n"
+    "  shade = aShade;\n"
+    "  gl_Position = vec4(aPos, 0.f, 1.f);\n"
+    "}\0";
+static const char* arenaFragmentShaderSource =
+    "#version 330 core\n"
+    "flat in float shade;\n"
+    "out vec4 FragColor;\n"
+    "void main()\n"
+    "{\n"
+    "  FragColor = vec4(shade, 0.f, 0.f, 1.f);\n"
+    "}\0";
+
+// Every mesh is a full-screen quad shaded by its handle, with its vertices
+// and indices repeated to give the meshes different sizes.
+static GLuint arenaVertexCount(uint32_t mesh)
+{
+    return 4 * (1 + mesh % 4);
+}
+
+static GLuint arenaIndexCount(uint32_t mesh)
+{
+    return 6 * (1 + mesh % 3);
+}
+
+static void arenaMeshData(uint32_t mesh, GLfloat* vertices, GLuint* indices)
+{
+    static const GLfloat corners[] = { -1.f, -1.f, 1.f, -1.f, 1.f, 1.f, -1.f, 1.f };
+    static const GLuint quad[] = { 0, 1, 2, 0, 2, 3 };
+    for (GLuint i = 0; i < arenaVertexCount(mesh); i++)
+    {
+        vertices[i * 3 + 0] = corners[(i % 4) * 2 + 0];
+        vertices[i * 3 + 1] = corners[(i % 4) * 2 + 1];
+        vertices[i * 3 + 2] = (GLfloat)(mesh + 1) / 255.f;
+    }
+    for (GLuint i = 0; i < arenaIndexCount(mesh); i++)
+        indices[i] = quad[i % 6];
+}
+
+static bool checkArenaMesh(GpuArena* arena, Shader* shader, uint32_t mesh)
+{
+    GLfloat vertices[16 * 3];
+    GLuint indices[18];
+    GLfloat storedVertices[16 * 3];
+    GLuint storedIndices[18];
+    arenaMeshData(mesh, vertices, indices);
+    const GpuArenaMesh* range = &arena->meshes[mesh];
+    glState_bindBuffer(GL_COPY_READ_BUFFER, arena->vertexBuffer);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, (GLintptr)arena->vertexStride * range->vertexOffset, (GLsizeiptr)arena->vertexStride * range->vertexCount, storedVertices);
+    glState_bindBuffer(GL_COPY_READ_BUFFER, arena->indexBuffer);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, (GLintptr)sizeof(GLuint) * range->indexOffset, (GLsizeiptr)sizeof(GLuint) * range->indexCount, storedIndices);
+    if (!expect(memcmp(vertices, storedVertices, sizeof(GLfloat) * 3 * range->vertexCount) == 0, "mesh %u has the wrong vertices at %u", mesh, range->vertexOffset))
+        return false;
+    if (!expect(memcmp(indices, storedIndices, sizeof(GLuint) * range->indexCount) == 0, "mesh %u has the wrong indices at %u", mesh, range->indexOffset))
+        return false;
+
+    RenderCommand command = { 0 };
+    gpuArena_fillCommand(arena, mesh, &command);
+    if (!expect(command.baseVertex == (int32_t)range->vertexOffset && command.indexOffset == sizeof(GLuint) * range->indexOffset && command.count == range->indexCount, "mesh %u has a stale draw command", mesh))
+        return false;
+
+    uint8_t pixel[4];
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    shader_use(shader);
+    gpuArena_draw(arena, mesh);
+    glReadPixels(TEST_WINDOW_SIZE / 2, TEST_WINDOW_SIZE / 2, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+    return expect(pixel[0] == mesh + 1, "drawing mesh %u gave shade %u", mesh, pixel[0]);
+}
+
+static bool checkArenaRanges(GpuArena* arena)
+{
+    for (uint32_t i = 0; i < arena->meshCount; i++)
+    {
+        const GpuArenaMesh* one = &arena->meshes[i];
+        if (!one->live)
+            continue;
+        if (!expect(one->vertexOffset + one->vertexCount <= arena->vertices.capacity && one->indexOffset + one->indexCount <= arena->indices.capacity, "mesh %u lies outside the arena", i))
+            return false;
+        for (uint32_t j = i + 1; j < arena->meshCount; j++)
+        {
+            const GpuArenaMesh* two = &arena->meshes[j];
+            if (!two->live)
+                continue;
+            const bool verticesApart = one->vertexOffset + one->vertexCount <= two->vertexOffset || two->vertexOffset + two->vertexCount <= one->vertexOffset;
+            const bool indicesApart = one->indexOffset + one->indexCount <= two->indexOffset || two->indexOffset + two->indexCount <= one->indexOffset;
+            if (!expect(verticesApart && indicesApart, "meshes %u and %u overlap", i, j))
+                return false;
+        }
+    }
+    return true;
+}
+
+// Frees every other mesh of a full arena, then defragments a few moves at a
+// time until nothing moves. Fragmentation has to drop, and every surviving
+// mesh must still read back and draw from wherever it ended up.
+static bool test_gpuArena_defragment(void)
+{
+    requireContext();
+    Shader shader = shader_create(arenaVertexShaderSource, arenaFragmentShaderSource);
+    if (!expect(shader.ID != 0, "could not build the arena shader"))
+        return false;
+    GpuArena arena = gpuArena_create(3 * sizeof(GLfloat), 64, 64);
+    gpuArena_linkAttrib(&arena, 0, 2, GL_FLOAT, GL_FALSE, (void*)0);
+    gpuArena_linkAttrib(&arena, 1, 1, GL_FLOAT, GL_FALSE, (void*)(2 * sizeof(GLfloat)));
+
+    // An empty index range is not a failed allocation and must not grow.
+    const uint32_t grows = arena.grows;
+    const GpuMeshHandle empty = gpuArena_allocate(&arena, 4, 0);
+    bool passed = expect(empty != GPU_ARENA_INVALID_HANDLE && arena.grows == grows, "an allocation without indices failed or grew the arena");
+    gpuArena_free(&arena, empty);
+
+    for (uint32_t i = 0; i < TEST_ARENA_MESHES && passed; i++)
+    {
+        GLfloat vertices[16 * 3];
+        GLuint indices[18];
+        arenaMeshData(i, vertices, indices);
+        passed = expect(gpuArena_allocate(&arena, arenaVertexCount(i), arenaIndexCount(i)) == i, "mesh %u got another handle", i);
+        gpuArena_upload(&arena, i, vertices, indices);
+    }
+    for (uint32_t i = 0; i < TEST_ARENA_MESHES; i += 2)
+        gpuArena_free(&arena, i);
+
+    const GpuArenaStats before = gpuArena_getStats(&arena);
+    passed = passed && expect(before.vertexFragmentation > 0.f && before.indexFragmentation > 0.f, "freeing every other mesh left no fragmentation");
+    uint32_t passes = 0;
+    for (uint32_t moves = 1; moves > 0 && passed && passes < TEST_ARENA_MAX_PASSES; passes++)
+    {
+        moves = gpuArena_defragment(&arena, TEST_ARENA_MOVES);
+        passed = expect(moves <= TEST_ARENA_MOVES, "one pass made %u moves", moves);
+        passed = passed && checkArenaRanges(&arena);
+    }
+    const GpuArenaStats after = gpuArena_getStats(&arena);
+    passed = passed && expect(after.moves > 0, "nothing was moved");
+    passed = passed && expect(after.vertexFragmentation < before.vertexFragmentation && after.indexFragmentation < before.indexFragmentation,
+        "fragmentation went from %.2f/%.2f to %.2f/%.2f", before.vertexFragmentation, before.indexFragmentation, after.vertexFragmentation, after.indexFragmentation);
+    for (uint32_t i = 1; i < TEST_ARENA_MESHES && passed; i += 2)
+        passed = checkArenaMesh(&arena, &shader, i);
+    printf("Defragmented %llu moves in %u passes, fragmentation %.2f/%.2f to %.2f/%.2f\n",
+        (unsigned long long)after.moves, passes, before.vertexFragmentation, before.indexFragmentation, after.vertexFragmentation, after.indexFragmentation);
+
+    gpuArena_delete(&arena);
+    shader_delete(&shader);
+    return passed;
+}
+
+// One float triangle, saved and loaded back with a broken attribute layout or
+// index. Loading must fail unless the file is intact, and a bad index only
+// fails when the load is asked to check them.
+static bool saveAndLoad(MeshData* data, const char* path, uint32_t flags)
+{
+    Mesh mesh;
+    if (!meshData_save(data, path) || !mesh_load(&mesh, path, flags))
+        return false;
+    mesh_unload(&mesh);
+    return true;
+}
+
+static bool test_mesh_rejectsMalformed(void)
+{
+    char path[] = "/tmp/gl-test-XXXXXX";
+    const int file = mkstemp(path);
+    if (!expect(file >= 0, "could not create a temporary file"))
+        return false;
+    close(file);
+
+    float vertices[3][6] = { { 0.f, 0.f, 0.f, 1.f, 0.f, 0.f }, { 1.f, 0.f, 0.f, 0.f, 1.f, 0.f }, { 0.f, 1.f, 0.f, 0.f, 0.f, 1.f } };
+    uint32_t indices[3] = { 0, 1, 2 };
+    MeshData data =
+    {
+        .vertices = vertices,
+        .vertexCount = 3,
+        .vertexStride = sizeof(vertices[0]),
+        .indices = indices,
+        .indexCount = 3,
+        .indexSize = sizeof(uint32_t),
+        .attribs = { { 0, 3, MESH_TYPE_FLOAT, 0, 0 }, { 1, 3, MESH_TYPE_FLOAT, 0, 3 * sizeof(float) } },
+        .attribCount = 2,
+        .lods = { { 0, 3, 0.f, 0 } },
+        .lodCount = 1,
+    };
+
+    bool passed = expect(saveAndLoad(&data, path, MESH_LOAD_CHECK_INDICES), "an intact mesh did not load");
+    passed = passed && expect(mesh_checkIndices(indices, 3, sizeof(uint32_t), 3), "valid indices were rejected");
+
+    data.attribs[1].offset = 4 * sizeof(float);
+    passed = passed && expect(!saveAndLoad(&data, path, 0), "an attribute past the end of the vertex loaded");
+    data.attribs[1] = (MeshAttrib){ 1, 4, MESH_TYPE_FLOAT, 0, 3 * sizeof(float) };
+    passed = passed && expect(!saveAndLoad(&data, path, 0), "an attribute overlapping the next vertex loaded");
+    data.attribs[1] = (MeshAttrib){ 1, 3, MESH_TYPE_FLOAT, 0, 3 * sizeof(float) };
+
+    indices[2] = 3;
+    passed = passed && expect(saveAndLoad(&data, path, 0), "an out-of-range index was checked without the flag");
+    passed = passed && expect(!saveAndLoad(&data, path, MESH_LOAD_CHECK_INDICES), "an out-of-range index loaded");
+    passed = passed && expect(!mesh_checkIndices(indices, 3, sizeof(uint32_t), 3), "an out-of-range index passed the check");
+    const uint16_t narrowIndices[3] = { 0, 1, 3 };
+    passed = passed && expect(!mesh_checkIndices(narrowIndices, 3, sizeof(uint16_t), 3), "an out-of-range 16-bit index passed the check");
+
+    unlink(path);
+    return passed;
+}
+
+#define TEST_BVH_BOXES   2000
+#define TEST_BVH_QUERIES 64
+
+static Aabb randomAabb(float range, float maxHalfSize)
+{
+    const Vec3 center = randomVec3(-range, range);
+    const Vec3 halfSize = randomVec3(0.05f, maxHalfSize);
+    Aabb aabb =
+    {
+        .min = vec3_sub(center, halfSize),
+        .max = vec3_add(center, halfSize),
+    };
+    return aabb;
+}
+
+static void randomFrustum(Frustum* frustum)
+{
+    Mat4 view;
+    Mat4 projection;
+    Mat4 cameraMatrix;
+    mat4_lookAt_inplace(&view, randomVec3(-150.f, 150.f), randomVec3(-50.f, 50.f), vec3(0.f, 1.f, 0.f));
+    mat4_perspective_inplace(&projection, randomFloat(30.f, 90.f), 4.f / 3.f, 0.1f, randomFloat(50.f, 300.f));
+    mat4_multiply_to(&view, &projection, &cameraMatrix);
+    frustum_extract(frustum, &cameraMatrix);
+}
+
+// The BVH and the SIMD groups classify boxes by centre and extent, which can
+// round differently from the positive vertex of frustum_testAabb for a box
+// touching a plane, so such boxes are left out of comparisons.
+static bool nearFrustumPlane(Frustum* frustum, Aabb aabb)
+{
+    const Vec3 center = vec3_scale(vec3_add(aabb.min, aabb.max), 0.5f);
+    const Vec3 extent = vec3_scale(vec3_sub(aabb.max, aabb.min), 0.5f);
+    for (int plane = 0; plane < FRUSTUM_PLANE_COUNT; plane++)
+    {
+        const float distance = vec3_dot(frustum->planes[plane].normal, center) + frustum->planes[plane].distance;
+        if (fabsf(distance + vec3_dot(frustum->absNormals[plane], extent)) < 1e-3f)
+            return true;
+    }
+    return false;
+}
+
+// Checks a list of visible indices against frustum_testAabb on every box,
+// and that no index is reported twice.
+static bool checkVisible(Frustum* frustum, const Aabb* bounds, uint32_t count, const uint32_t* visibleIndices, size_t visibleCount, const char* culler)
+{
+    uint8_t* visible = calloc(count, 1);
+    bool passed = expect(visible != NULL, "could not allocate the visibility flags");
+    for (size_t i = 0; i < visibleCount && passed; i++)
+    {
+        passed = expect(visibleIndices[i] < count && !visible[visibleIndices[i]], "%s reported box %u twice or out of range", culler, visibleIndices[i]);
+        if (passed)
+            visible[visibleIndices[i]] = 1;
+    }
+    for (uint32_t i = 0; i < count && passed; i++)
+    {
+        const bool expected = frustum_testAabb(frustum, bounds[i]);
+        passed = expect(expected == (bool)visible[i] || nearFrustumPlane(frustum, bounds[i]),
+            "%s has box %u %s, frustum_testAabb %s", culler, i, visible[i] ? "visible" : "culled", expected ? "visible" : "culled");
+    }
+    free(visible);
+    return passed;
+}
+
+// The same slab test as the BVH, so leaf hits agree exactly.
+static bool rayHitsAabb(Ray ray, Aabb aabb, float maxDistance, float* distance)
+{
+    const Vec3 inverseDirection = vec3(1.f / ray.direction.x, 1.f / ray.direction.y, 1.f / ray.direction.z);
+    const float x1 = (aabb.min.x - ray.origin.x) * inverseDirection.x;
+    const float x2 = (aabb.max.x - ray.origin.x) * inverseDirection.x;
+    const float y1 = (aabb.min.y - ray.origin.y) * inverseDirection.y;
+    const float y2 = (aabb.max.y - ray.origin.y) * inverseDirection.y;
+    const float z1 = (aabb.min.z - ray.origin.z) * inverseDirection.z;
+    const float z2 = (aabb.max.z - ray.origin.z) * inverseDirection.z;
+    const float near = fmaxf(fmaxf(fminf(x1, x2), fminf(y1, y2)), fmaxf(fminf(z1, z2), 0.f));
+    const float far = fminf(fminf(fmaxf(x1, x2), fmaxf(y1, y2)), fminf(fmaxf(z1, z2), maxDistance));
+    *distance = near;
+    return near <= far;
+}
+
+static bool evenPrimitive(void* userData, uint32_t primitive, Ray ray, float* distance)
+{
+    (void)userData;
+    (void)ray;
+    (void)distance;
+    return primitive % 2 == 0;
+}
+
+static bool checkRaycast(Bvh* bvh, const Aabb* bounds, uint32_t count, Ray ray, float maxDistance, BvhRayTest test)
+{
+    bool expectedFound = false;
+    float closest = maxDistance;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        float distance;
+        if (rayHitsAabb(ray, bounds[i], closest, &distance) && (test == NULL || test(NULL, i, ray, &distance)) && distance <= closest)
+        {
+            closest = distance;
+            expectedFound = true;
+        }
+    }
+
+    BvhHit hit = { 0 };
+    const bool found = bvh_raycast(bvh, bounds, ray, maxDistance, test, NULL, &hit);
+    if (!expect(found == expectedFound, "bvh_raycast %s, the linear scan %s", found ? "hit" : "missed", expectedFound ? "hit" : "missed"))
+        return false;
+    if (!found)
+        return true;
+    // Overlapping boxes can tie, so the hit only has to be one of the closest.
+    float distance;
+    const bool hitsPrimitive = rayHitsAabb(ray, bounds[hit.primitive], maxDistance, &distance);
+    return expect(hit.distance == closest && hitsPrimitive && distance == closest && (test == NULL || test(NULL, hit.primitive, ray, &distance)),
+        "bvh_raycast hit box %u at %.9g, the closest is at %.9g", hit.primitive, hit.distance, closest);
+}
+
+static bool overlaps(Aabb a, Aabb b)
+{
+    return a.min.x <= b.max.x && a.max.x >= b.min.x
+        && a.min.y <= b.max.y && a.max.y >= b.min.y
+        && a.min.z <= b.max.z && a.max.z >= b.min.z;
+}
+
+static bool checkOverlap(Bvh* bvh, const Aabb* bounds, uint32_t count, Aabb query, uint32_t* results)
+{
+    size_t expectedCount = 0;
+    for (uint32_t i = 0; i < count; i++)
+        expectedCount += overlaps(bounds[i], query) ? 1 : 0;
+
+    const size_t resultCount = bvh_queryOverlap(bvh, bounds, query, results, count);
+    uint8_t* reported = calloc(count, 1);
+    bool passed = expect(reported != NULL, "could not allocate the overlap flags");
+    passed = passed && expect(resultCount == expectedCount, "bvh_queryOverlap found %zu boxes, the pairwise test %zu", resultCount, expectedCount);
+    for (size_t i = 0; i < resultCount && passed; i++)
+    {
+        passed = expect(results[i] < count && !reported[results[i]] && overlaps(bounds[results[i]], query), "bvh_queryOverlap reported box %u twice or without an overlap", results[i]);
+        if (passed)
+            reported[results[i]] = 1;
+    }
+    free(reported);
+
+    // A smaller result buffer stops the query early but never overruns.
+    const size_t limit = 3;
+    const size_t limitedCount = passed ? bvh_queryOverlap(bvh, bounds, query, results, limit) : 0;
+    passed = passed && expect(limitedCount == (expectedCount < limit ? expectedCount : limit), "a query limited to %zu results returned %zu", limit, limitedCount);
+    for (size_t i = 0; i < limitedCount && passed; i++)
+        passed = expect(overlaps(bounds[results[i]], query), "a limited query reported box %u without an overlap", results[i]);
+    return passed;
+}
+
+static bool checkBvh(Bvh* bvh, const Aabb* bounds, uint32_t count, uint32_t* scratch)
+{
+    bool passed = expect(bvh->primitiveCount == count && bvh->nodeCount > 0, "the BVH holds %u of %u boxes in %u nodes", bvh->primitiveCount, count, bvh->nodeCount);
+    for (int i = 0; i < TEST_BVH_QUERIES && passed; i++)
+    {
+        Frustum frustum;
+        randomFrustum(&frustum);
+        const size_t visibleCount = bvh_cullFrustum(bvh, bounds, &frustum, scratch);
+        passed = checkVisible(&frustum, bounds, count, scratch, visibleCount, "bvh_cullFrustum");
+
+        Ray ray =
+        {
+            .origin = randomVec3(-150.f, 150.f),
+            .direction = vec3_normalize(randomVec3(-1.f, 1.f)),
+        };
+        passed = passed && checkRaycast(bvh, bounds, count, ray, 400.f, NULL);
+        passed = passed && checkRaycast(bvh, bounds, count, ray, 400.f, evenPrimitive);
+        // Straight at a box, so hits are not left to chance.
+        const Aabb target = bounds[rand() % count];
+        ray.direction = vec3_normalize(vec3_sub(vec3_scale(vec3_add(target.min, target.max), 0.5f), ray.origin));
+        passed = passed && checkRaycast(bvh, bounds, count, ray, 400.f, NULL);
+
+        passed = passed && checkOverlap(bvh, bounds, count, randomAabb(100.f, 20.f), scratch);
+    }
+    return passed;
+}
+
+// Random boxes, some overlapping, checked against brute force for frustum
+// culling, closest-hit raycasts and overlap queries, built on one thread and
+// on several, and again after every box moved and the BVH was refit.
+static bool test_bvh_matchesBruteForce(void)
+{
+    Aabb* bounds = malloc(TEST_BVH_BOXES * sizeof(Aabb));
+    uint32_t* scratch = malloc(TEST_BVH_BOXES * sizeof(uint32_t));
+    bool passed = expect(bounds != NULL && scratch != NULL, "could not allocate the boxes");
+
+    srand(1357);
+    for (uint32_t i = 0; i < TEST_BVH_BOXES && passed; i++)
+        bounds[i] = randomAabb(100.f, i % 10 == 0 ? 10.f : 2.f);
+
+    const int threadCounts[] = { 1, 4 };
+    for (size_t t = 0; t < sizeof(threadCounts) / sizeof(threadCounts[0]) && passed; t++)
+    {
+        Bvh bvh = bvh_build(bounds, TEST_BVH_BOXES, threadCounts[t]);
+        passed = checkBvh(&bvh, bounds, TEST_BVH_BOXES, scratch);
+        bvh_delete(&bvh);
+    }
+
+    Bvh bvh = bvh_build(bounds, TEST_BVH_BOXES, 1);
+    for (uint32_t i = 0; i < TEST_BVH_BOXES && passed; i++)
+    {
+        const Vec3 offset = i % 3 == 0 ? randomVec3(-60.f, 60.f) : randomVec3(-1.f, 1.f);
+        bounds[i].min = vec3_add(bounds[i].min, offset);
+        bounds[i].max = vec3_add(bounds[i].max, offset);
+    }
+    bvh_refit(&bvh, bounds);
+    passed = passed && checkBvh(&bvh, bounds, TEST_BVH_BOXES, scratch);
+    bvh_delete(&bvh);
+
+    free(bounds);
+    free(scratch);
+    return passed;
+}
+
+#define TEST_QUEUE_THREADS 3
+
+typedef enum
+{
+    KEYS_RANDOM,
+    KEYS_TOP_BYTE,
+    KEYS_DUPLICATE,
+    KEYS_MIXED,
+} KeyPattern;
+
+static uint64_t randomKey(KeyPattern pattern)
+{
+    const uint64_t random = ((uint64_t)rand() << 42) ^ ((uint64_t)rand() << 21) ^ (uint64_t)rand();
+    switch (pattern)
+    {
+    case KEYS_RANDOM:
+        return random;
+    case KEYS_TOP_BYTE:
+        // Only the most significant digit differs, so every lower pass is skipped.
+        return ((uint64_t)(rand() % 256) << 56) | 0x0012345678abcdefull;
+    case KEYS_DUPLICATE:
+        return (uint64_t)(rand() % 5) << 40;
+    default:
+        return rand() % 4 == 0 ? random : renderKey((RenderPass)(rand() % 3), rand() % 4, rand() % 4, 0, rand() % 8);
+    }
+}
+
+static int compareSortEntries(const void* one, const void* two)
+{
+    const RenderSortEntry* a = one;
+    const RenderSortEntry* b = two;
+    if (a->key != b->key)
+        return a->key < b->key ? -1 : 1;
+    return a->index < b->index ? -1 : a->index > b->index;
+}
+
+// Pushes keys into every thread's buffer, and compares the sorted entries
+// with qsort by key and then by merged index, which is the stable order.
+static bool checkQueueSort(RenderQueue* queue, KeyPattern pattern, uint32_t count)
+{
+    RenderSortEntry* expected = malloc((count + 1) * sizeof(RenderSortEntry));
+    if (!expect(expected != NULL, "could not allocate the reference entries"))
+        return false;
+    renderQueue_clear(queue);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        RenderCommand command = { 0 };
+        command.key = randomKey(pattern);
+        command.count = i;
+        renderCommandBuffer_push(renderQueue_getBuffer(queue, rand() % TEST_QUEUE_THREADS), &command);
+    }
+    renderQueue_sort(queue);
+
+    bool passed = expect(queue->count == count, "sorted %u of %u commands", queue->count, count);
+    for (uint32_t i = 0; i < count && passed; i++)
+    {
+        expected[i].key = queue->commands[i].key;
+        expected[i].index = i;
+    }
+    qsort(expected, count, sizeof(RenderSortEntry), compareSortEntries);
+    for (uint32_t i = 0; i < count && passed; i++)
+    {
+        const RenderSortEntry entry = queue->entries[i];
+        passed = expect(i == 0 || queue->entries[i - 1].key <= entry.key, "pattern %d: key %u is smaller than the one before it", pattern, i);
+        passed = passed && expect(entry.key == expected[i].key && entry.index == expected[i].index,
+            "pattern %d: entry %u is key %016llx of command %u, qsort gave %016llx of %u", pattern, i,
+            (unsigned long long)entry.key, entry.index, (unsigned long long)expected[i].key, expected[i].index);
+        passed = passed && expect(queue->commands[entry.index].key == entry.key, "pattern %d: entry %u points at a command with another key", pattern, i);
+    }
+    free(expected);
+    return passed;
+}
+
+static bool test_renderQueue_sortMatchesQsort(void)
+{
+    static const uint32_t counts[] = { 0, 1, 2, 255, 4097 };
+    RenderQueue queue = renderQueue_create(TEST_QUEUE_THREADS);
+    bool passed = true;
+    srand(8642);
+    for (int pattern = KEYS_RANDOM; pattern <= KEYS_MIXED && passed; pattern++)
+        for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]) && passed; i++)
+            passed = checkQueueSort(&queue, (KeyPattern)pattern, counts[i]);
+    renderQueue_delete(&queue);
+    return passed;
+}
+
+// Counts on both sides of the SIMD width, so every kernel runs its vector
+// loop, its scalar tail, or both.
+static const size_t batchCounts[] = { 0, 1, 3, 4, 5, 7, 8, 13, 67 };
+
+#define TEST_BATCH_MAX 67
+
+typedef struct
+{
+    Vec3 one[TEST_BATCH_MAX];
+    Vec3 two[TEST_BATCH_MAX];
+    Quat quatsOne[TEST_BATCH_MAX];
+    Quat quatsTwo[TEST_BATCH_MAX];
+    float x[3][TEST_BATCH_MAX];
+    float y[3][TEST_BATCH_MAX];
+    float z[3][TEST_BATCH_MAX];
+    Vec3 vecResult[TEST_BATCH_MAX];
+    Quat quatResult[TEST_BATCH_MAX];
+    float floatResult[TEST_BATCH_MAX];
+    Affine affineResult[TEST_BATCH_MAX];
+    Mat4 mats[TEST_BATCH_MAX];
+    Mat4 matResult[TEST_BATCH_MAX];
+} BatchData;
+
+static Vec3Soa batchSoa(BatchData* data, int slot)
+{
+    Vec3Soa soa = { data->x[slot], data->y[slot], data->z[slot] };
+    return soa;
+}
+
+static Vec2Soa batchSoa2(BatchData* data, int slot)
+{
+    Vec2Soa soa = { data->x[slot], data->y[slot] };
+    return soa;
+}
+
+static bool expectVec3(const char* kernel, size_t i, Vec3 value, Vec3 reference, float magnitude)
+{
+    return expect(withinUlps(value.x, reference.x, magnitude, TEST_KERNEL_ULPS)
+        && withinUlps(value.y, reference.y, magnitude, TEST_KERNEL_ULPS)
+        && withinUlps(value.z, reference.z, magnitude, TEST_KERNEL_ULPS),
+        "%s [%zu] is (%.9g, %.9g, %.9g), scalar (%.9g, %.9g, %.9g)", kernel, i,
+        value.x, value.y, value.z, reference.x, reference.y, reference.z);
+}
+
+static float vec3_magnitude(Vec3 vec)
+{
+    return fabsf(vec.x) + fabsf(vec.y) + fabsf(vec.z);
+}
+
+static bool compareBatchVec3(BatchData* data, size_t count)
+{
+    Mat4 mat;
+    randomMat4(&mat, 10.f);
+    const Vec3Soa one = batchSoa(data, 0);
+    const Vec3Soa two = batchSoa(data, 1);
+    const Vec3Soa result = batchSoa(data, 2);
+    bool passed = true;
+
+    vec3soa_transform_points(&mat, one, result, count);
+    vec3_batch_transform_points(&mat, data->one, data->vecResult, count);
+    for (size_t i = 0; i < count && passed; i++)
+    {
+        const Vec3 reference = mat4_kernels_scalar()->transformPoint(&mat, data->one[i]);
+        const Vec3 point = data->one[i];
+        float magnitude = 0.f;
+        for (int j = 0; j < 3; j++)
+            magnitude = fmaxf(magnitude, fabsf(mat[0][j] * point.x) + fabsf(mat[1][j] * point.y) + fabsf(mat[2][j] * point.z) + fabsf(mat[3][j]));
+        passed = expectVec3("vec3soa_transform_points", i, vec3(result.x[i], result.y[i], result.z[i]), reference, magnitude)
+            && expectVec3("vec3_batch_transform_points", i, data->vecResult[i], reference, magnitude);
+    }
+
+    vec3soa_normalize(one, result, count);
+    vec3_batch_normalize(data->one, data->vecResult, count);
+    for (size_t i = 0; i < count && passed; i++)
+    {
+        const Vec3 reference = vec3_normalize(data->one[i]);
+        passed = expectVec3("vec3soa_normalize", i, vec3(result.x[i], result.y[i], result.z[i]), reference, 1.f)
+            && expectVec3("vec3_batch_normalize", i, data->vecResult[i], reference, 1.f);
+    }
+
+    vec3soa_cross(one, two, result, count);
+    vec3_batch_cross(data->one, data->two, data->vecResult, count);
+    for (size_t i = 0; i < count && passed; i++)
+    {
+        const Vec3 reference = vec3_cross(data->one[i], data->two[i]);
+        const float magnitude = vec3_magnitude(data->one[i]) * vec3_magnitude(data->two[i]);
+        passed = expectVec3("vec3soa_cross", i, vec3(result.x[i], result.y[i], result.z[i]), reference, magnitude)
+            && expectVec3("vec3_batch_cross", i, data->vecResult[i], reference, magnitude);
+    }
+
+    vec3soa_dot(one, two, data->floatResult, count);
+    for (size_t i = 0; i < count && passed; i++)
+    {
+        const float reference = vec3_dot(data->one[i], data->two[i]);
+        const float magnitude = vec3_magnitude(data->one[i]) * vec3_magnitude(data->two[i]);
+        passed = expect(withinUlps(data->floatResult[i], reference, magnitude, TEST_KERNEL_ULPS), "vec3soa_dot [%zu] is %.9g, scalar %.9g", i, data->floatResult[i], reference);
+    }
+    vec3_batch_dot(data->one, data->two, data->floatResult, count);
+    for (size_t i = 0; i < count && passed; i++)
+    {
+        const float reference = vec3_dot(data->one[i], data->two[i]);
+        const float magnitude = vec3_magnitude(data->one[i]) * vec3_magnitude(data->two[i]);
+        passed = expect(withinUlps(data->floatResult[i], reference, magnitude, TEST_KERNEL_ULPS), "vec3_batch_dot [%zu] is %.9g, scalar %.9g", i, data->floatResult[i], reference);
+    }
+
+    // Min and max do not round, so the bounds must be exact.
+    Aabb reference = { vec3(FLT_MAX, FLT_MAX, FLT_MAX), vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX) };
+    for (size_t i = 0; i < count; i++)
+    {
+        reference.min = vec3(fminf(reference.min.x, data->one[i].x), fminf(reference.min.y, data->one[i].y), fminf(reference.min.z, data->one[i].z));
+        reference.max = vec3(fmaxf(reference.max.x, data->one[i].x), fmaxf(reference.max.y, data->one[i].y), fmaxf(reference.max.z, data->one[i].z));
+    }
+    const Aabb soaBounds = vec3soa_aabb(one, count);
+    const Aabb bounds = vec3_batch_aabb(data->one, count);
+    passed = passed && expect(memcmp(&soaBounds, &reference, sizeof(Aabb)) == 0 && memcmp(&bounds, &reference, sizeof(Aabb)) == 0, "the bounds of %zu points differ from the scalar loop", count);
+    return passed;
+}
+
+static bool compareBatchVec2(BatchData* data, size_t count)
+{
+    const Vec2Soa one = batchSoa2(data, 0);
+    const Vec2Soa two = batchSoa2(data, 1);
+    const Vec2Soa result = batchSoa2(data, 2);
+    bool passed = true;
+
+    vec2soa_normalize(one, result, count);
+    for (size_t i = 0; i < count && passed; i++)
+    {
+        const Vec2 reference = vec2_normalize(vec2(one.x[i], one.y[i]));
+        passed = expect(withinUlps(result.x[i], reference.x, 1.f, TEST_KERNEL_ULPS) && withinUlps(result.y[i], reference.y, 1.f, TEST_KERNEL_ULPS),
+            "vec2soa_normalize [%zu] is (%.9g, %.9g), scalar (%.9g, %.9g)", i, result.x[i], result.y[i], reference.x, reference.y);
+    }
+
+    vec2soa_dot(one, two, data->floatResult, count);
+    for (size_t i = 0; i < count && passed; i++)
+    {
+        const float reference = vec2_dot(vec2(one.x[i], one.y[i]), vec2(two.x[i], two.y[i]));
+        const float magnitude = fabsf(one.x[i] * two.x[i]) + fabsf(one.y[i] * two.y[i]);
+        passed = expect(withinUlps(data->floatResult[i], reference, magnitude, TEST_KERNEL_ULPS), "vec2soa_dot [%zu] is %.9g, scalar %.9g", i, data->floatResult[i], reference);
+    }
+    return passed;
+}
+
+static bool compareBatchQuat(BatchData* data, size_t count)
+{
+    bool passed = true;
+    quat_batch_multiply(data->quatsOne, data->quatsTwo, data->quatResult, count);
+    for (size_t i = 0; i < count && passed; i++)
+    {
+        const Quat value = data->quatResult[i];
+        const Quat reference = quat_multiply(data->quatsOne[i], data->quatsTwo[i]);
+        // Both are unit quaternions, so every term is at most 1.
+        passed = expect(withinUlps(value.x, reference.x, 4.f, TEST_KERNEL_ULPS) && withinUlps(value.y, reference.y, 4.f, TEST_KERNEL_ULPS)
+            && withinUlps(value.z, reference.z, 4.f, TEST_KERNEL_ULPS) && withinUlps(value.w, reference.w, 4.f, TEST_KERNEL_ULPS),
+            "quat_batch_multiply [%zu] is (%.9g, %.9g, %.9g, %.9g), scalar (%.9g, %.9g, %.9g, %.9g)", i,
+            value.x, value.y, value.z, value.w, reference.x, reference.y, reference.z, reference.w);
+    }
+
+    quat_batch_toAffine(data->quatsOne, data->two, data->affineResult, count);
+    for (size_t i = 0; i < count && passed; i++)
+    {
+        Affine reference;
+        quat_toAffine(data->quatsOne[i], data->two[i], &reference);
+        passed = expect(memcmp(data->affineResult[i], reference, sizeof(Affine)) == 0, "quat_batch_toAffine [%zu] differs from quat_toAffine", i);
+    }
+
+    // The batch inverse runs the dispatched kernel, so it must match it
+    // bit for bit, and skip the same singular matrices.
+    size_t expectedInverted = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        randomMat4(&data->mats[i], 10.f);
+        if (i % 5 == 4)
+            mat4_load_diagonal(&data->mats[i], 0.f);
+        mat4_load_identity(&data->matResult[i]);
+    }
+    const size_t inverted = mat4_batch_inverse(data->mats, data->matResult, count);
+    for (size_t i = 0; i < count && passed; i++)
+    {
+        Mat4 reference;
+        mat4_load_identity(&reference);
+        expectedInverted += mat4_kernels()->inverse(&data->mats[i], &reference) ? 1 : 0;
+        passed = expect(memcmp(data->matResult[i], reference, sizeof(Mat4)) == 0, "mat4_batch_inverse [%zu] differs from the %s kernel", i, mat4_kernels()->name);
+    }
+    return passed && expect(inverted == expectedInverted, "mat4_batch_inverse inverted %zu of %zu matrices, expected %zu", inverted, count, expectedInverted);
+}
+
+// Every batch kernel against the scalar Vec3, Vec2, Quat and Mat4 functions,
+// within the same ULP tolerance as the Mat4 backends. Each input set has a
+// zero vector, which normalizes to zero on both paths.
+static bool test_batch_matchesScalar(void)
+{
+    BatchData* data = malloc(sizeof(BatchData));
+    if (!expect(data != NULL, "could not allocate the batch data"))
+        return false;
+    bool passed = true;
+    srand(97531);
+    for (size_t c = 0; c < sizeof(batchCounts) / sizeof(batchCounts[0]) && passed; c++)
+    {
+        const size_t count = batchCounts[c];
+        for (size_t i = 0; i < count; i++)
+        {
+            data->one[i] = i == count / 2 ? vec3(0.f, 0.f, 0.f) : randomVec3(-100.f, 100.f);
+            data->two[i] = randomVec3(-100.f, 100.f);
+            data->quatsOne[i] = quat_fromAxisAngle(randomVec3(-1.f, 1.f), randomFloat(-180.f, 180.f));
+            data->quatsTwo[i] = quat_fromAxisAngle(randomVec3(-1.f, 1.f), randomFloat(-180.f, 180.f));
+            data->x[0][i] = data->one[i].x;
+            data->y[0][i] = data->one[i].y;
+            data->z[0][i] = data->one[i].z;
+            data->x[1][i] = data->two[i].x;
+            data->y[1][i] = data->two[i].y;
+            data->z[1][i] = data->two[i].z;
+        }
+        passed = compareBatchVec3(data, count) && compareBatchVec2(data, count) && compareBatchQuat(data, count);
+    }
+    free(data);
+    return passed;
+}
+
+#define TEST_CULL_FRAMES 32
+
+static bool nearSpherePlane(Frustum* frustum, Sphere sphere)
+{
+    for (int plane = 0; plane < FRUSTUM_PLANE_COUNT; plane++)
+    {
+        const float distance = vec3_dot(frustum->planes[plane].normal, sphere.center) + frustum->planes[plane].distance;
+        if (fabsf(distance + sphere.radius) < 1e-3f)
+            return true;
+    }
+    return false;
+}
+
+static bool checkCullSpheres(Frustum* frustum, const Sphere* spheres, size_t count, uint8_t* planeCache, uint32_t* visibleIndices)
+{
+    const size_t visibleCount = frustum_cullSpheres(frustum, spheres, count, planeCache, visibleIndices);
+    bool passed = true;
+    size_t next = 0;
+    for (size_t i = 0; i < count && passed; i++)
+    {
+        const bool visible = next < visibleCount && visibleIndices[next] == i;
+        next += visible ? 1 : 0;
+        const bool expected = frustum_testSphere(frustum, spheres[i]);
+        passed = expect(visible == expected || nearSpherePlane(frustum, spheres[i]),
+            "frustum_cullSpheres has sphere %zu of %zu %s, frustum_testSphere %s", i, count, visible ? "visible" : "culled", expected ? "visible" : "culled");
+    }
+    return passed && expect(next == visibleCount, "frustum_cullSpheres reported %zu spheres out of order or twice", visibleCount - next);
+}
+
+// The batch cullers against the per-object tests, at counts on both sides of
+// the SIMD width, without a plane cache and with one carried from frame to
+// frame as the camera moves, so cached planes are often stale.
+static bool test_culling_matchesPerObject(void)
+{
+    Aabb* aabbs = malloc(TEST_BVH_BOXES * sizeof(Aabb));
+    Sphere* spheres = malloc(TEST_BVH_BOXES * sizeof(Sphere));
+    uint32_t* visibleIndices = malloc(TEST_BVH_BOXES * sizeof(uint32_t));
+    uint8_t* planeCache = calloc(FRUSTUM_CACHE_SIZE(TEST_BVH_BOXES), 1);
+    bool passed = expect(aabbs != NULL && spheres != NULL && visibleIndices != NULL && planeCache != NULL, "could not allocate the objects");
+
+    srand(2222);
+    for (uint32_t i = 0; i < TEST_BVH_BOXES && passed; i++)
+    {
+        aabbs[i] = randomAabb(100.f, 5.f);
+        spheres[i].center = vec3_scale(vec3_add(aabbs[i].min, aabbs[i].max), 0.5f);
+        spheres[i].radius = randomFloat(0.1f, 5.f);
+    }
+
+    const size_t counts[] = { 1, 3, 4, 5, 7, 13, TEST_BVH_BOXES - 1 };
+    for (int frame = 0; frame < TEST_CULL_FRAMES && passed; frame++)
+    {
+        Frustum frustum;
+        randomFrustum(&frustum);
+        for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]) && passed; c++)
+        {
+            const size_t count = counts[c];
+            size_t visibleCount = frustum_cullAabbs(&frustum, aabbs, count, NULL, visibleIndices);
+            passed = checkVisible(&frustum, aabbs, (uint32_t)count, visibleIndices, visibleCount, "frustum_cullAabbs");
+            visibleCount = passed ? frustum_cullAabbs(&frustum, aabbs, count, planeCache, visibleIndices) : 0;
+            passed = passed && checkVisible(&frustum, aabbs, (uint32_t)count, visibleIndices, visibleCount, "frustum_cullAabbs with a plane cache");
+            passed = passed && checkCullSpheres(&frustum, spheres, count, NULL, visibleIndices);
+            passed = passed && checkCullSpheres(&frustum, spheres, count, planeCache, visibleIndices);
+        }
+    }
+
+    free(aabbs);
+    free(spheres);
+    free(visibleIndices);
+    free(planeCache);
+    return passed;
+}
+
+#define TEST_GRID_SIZE 32
+
+// A bumpy grid of TEST_GRID_SIZE squared vertices, with its triangles
+// shuffled so the index order has no cache locality to start with.
+static size_t gridMesh(float* positions, uint32_t* indices)
+{
+    for (uint32_t y = 0; y < TEST_GRID_SIZE; y++)
+    {
+        for (uint32_t x = 0; x < TEST_GRID_SIZE; x++)
+        {
+            float* position = &positions[3 * (y * TEST_GRID_SIZE + x)];
+            position[0] = (float)x;
+            position[1] = sinf((float)x * 0.4f) * cosf((float)y * 0.3f);
+            position[2] = (float)y;
+        }
+    }
+    size_t count = 0;
+    for (uint32_t y = 0; y + 1 < TEST_GRID_SIZE; y++)
+    {
+        for (uint32_t x = 0; x + 1 < TEST_GRID_SIZE; x++)
+        {
+            const uint32_t corner = y * TEST_GRID_SIZE + x;
+            const uint32_t quad[6] = { corner, corner + TEST_GRID_SIZE, corner + 1, corner + 1, corner + TEST_GRID_SIZE, corner + TEST_GRID_SIZE + 1 };
+            memcpy(&indices[count], quad, sizeof(quad));
+            count += 6;
+        }
+    }
+    for (size_t i = count / 3; i > 1; i--)
+    {
+        const size_t j = (size_t)rand() % i;
+        uint32_t swap[3];
+        memcpy(swap, &indices[3 * (i - 1)], sizeof(swap));
+        memcpy(&indices[3 * (i - 1)], &indices[3 * j], sizeof(swap));
+        memcpy(&indices[3 * j], swap, sizeof(swap));
+    }
+    return count;
+}
+
+// Rotates a triangle so its smallest index comes first, keeping the winding,
+// so triangles can be compared regardless of which vertex they start on.
+static void canonicalTriangle(const uint32_t* triangle, uint32_t* target)
+{
+    const int first = triangle[0] <= triangle[1] && triangle[0] <= triangle[2] ? 0 : triangle[1] <= triangle[2] ? 1 : 2;
+    for (int k = 0; k < 3; k++)
+        target[k] = triangle[(first + k) % 3];
+}
+
+static int compareTriangles(const void* one, const void* two)
+{
+    const uint32_t* a = one;
+    const uint32_t* b = two;
+    for (int k = 0; k < 3; k++)
+        if (a[k] != b[k])
+            return a[k] < b[k] ? -1 : 1;
+    return 0;
+}
+
+static bool sameTriangles(const uint32_t* indices, const uint32_t* other, size_t count)
+{
+    uint32_t* sorted = malloc(2 * count * sizeof(uint32_t));
+    if (sorted == NULL)
+        return false;
+    for (size_t i = 0; i < count; i += 3)
+    {
+        canonicalTriangle(&indices[i], &sorted[i]);
+        canonicalTriangle(&other[i], &sorted[count + i]);
+    }
+    qsort(sorted, count / 3, 3 * sizeof(uint32_t), compareTriangles);
+    qsort(sorted + count, count / 3, 3 * sizeof(uint32_t), compareTriangles);
+    const bool same = memcmp(sorted, sorted + count, count * sizeof(uint32_t)) == 0;
+    free(sorted);
+    return same;
+}
+
+// The Forsyth reordering must emit every input triangle once, with its
+// winding, and must not make the cache behave worse; on the shuffled grid it
+// has to do much better.
+static bool test_meshOptimize_vertexCache(void)
+{
+    static float positions[3 * TEST_GRID_SIZE * TEST_GRID_SIZE];
+    static uint32_t indices[6 * (TEST_GRID_SIZE - 1) * (TEST_GRID_SIZE - 1)];
+    static uint32_t optimized[6 * (TEST_GRID_SIZE - 1) * (TEST_GRID_SIZE - 1)];
+    const uint32_t vertexCount = TEST_GRID_SIZE * TEST_GRID_SIZE;
+    srand(4444);
+    const size_t count = gridMesh(positions, indices);
+
+    meshOptimize_vertexCache(optimized, indices, count, vertexCount);
+    bool passed = expect(sameTriangles(indices, optimized, count), "the optimized indices are not a permutation of the input triangles");
+    const float before = meshOptimize_acmr(indices, count, vertexCount, MESH_OPTIMIZE_CACHE_SIZE);
+    const float after = meshOptimize_acmr(optimized, count, vertexCount, MESH_OPTIMIZE_CACHE_SIZE);
+    passed = passed && expect(after <= before && after < 1.f, "ACMR went from %.3f to %.3f", before, after);
+
+    // Already optimized input must not get worse either.
+    meshOptimize_vertexCache(indices, optimized, count, vertexCount);
+    const float again = meshOptimize_acmr(indices, count, vertexCount, MESH_OPTIMIZE_CACHE_SIZE);
+    passed = passed && expect(sameTriangles(indices, optimized, count) && again <= after, "optimizing twice changed the triangles or took ACMR from %.3f to %.3f", after, again);
+    printf("ACMR %.3f before and %.3f after optimizing the vertex cache\n", before, after);
+    return passed;
+}
+
+// Half floats round to nearest even, so a normal value comes back within
+// half a unit in the last of its 11 significant bits, and a subnormal within
+// half of 2^-24. Every finite half must also survive unpacking and packing.
+static bool test_vertexFormat_roundTrip(void)
+{
+    bool passed = true;
+    for (uint32_t bits = 0; bits <= 0xFFFFu && passed; bits++)
+    {
+        const uint16_t half = (uint16_t)bits;
+        if ((half & 0x7C00u) == 0x7C00u && (half & 0x3FFu) != 0)
+            continue;
+        passed = expect(vertexFormat_packHalf(vertexFormat_unpackHalf(half)) == half, "half %04x did not round-trip", half);
+    }
+
+    srand(5555);
+    for (int i = 0; i < 100000 && passed; i++)
+    {
+        const float value = (rand() % 2 ? -1.f : 1.f) * powf(2.f, randomFloat(-26.f, 15.9f));
+        const float unpacked = vertexFormat_unpackHalf(vertexFormat_packHalf(value));
+        const float bound = fabsf(value) >= 6.103515625e-5f ? fabsf(value) * 0x1p-11f : 0x1p-25f;
+        passed = expect(fabsf(unpacked - value) <= bound, "%.9g came back from a half as %.9g", value, unpacked);
+    }
+    passed = passed && expect(isinf(vertexFormat_unpackHalf(vertexFormat_packHalf(65520.f))) && vertexFormat_unpackHalf(vertexFormat_packHalf(65519.f)) == 65504.f, "the half overflow threshold is wrong");
+    passed = passed && expect(isnan(vertexFormat_unpackHalf(vertexFormat_packHalf(NAN))) && signbit(vertexFormat_unpackHalf(vertexFormat_packHalf(-0.f))), "NaN or a negative zero did not survive a half");
+
+    // Normalized formats come back within half a step: 1/511 for the 10-bit
+    // components of 2_10_10_10, 1/127 and 1/32767 for signed bytes and
+    // shorts, 1/255 for unsigned bytes. The 2-bit w holds -1, 0 and 1 exactly.
+    const MeshAttrib attribs[] =
+    {
+        { 0, 4, MESH_TYPE_INT_2_10_10_10_REV, 1, 0 },
+        { 0, 4, MESH_TYPE_BYTE, 1, 0 },
+        { 0, 4, MESH_TYPE_SHORT, 1, 0 },
+        { 0, 4, MESH_TYPE_UNSIGNED_BYTE, 1, 0 },
+    };
+    const float steps[] = { 1.f / 511.f, 1.f / 127.f, 1.f / 32767.f, 1.f / 255.f };
+    for (size_t a = 0; a < sizeof(attribs) / sizeof(attribs[0]) && passed; a++)
+    {
+        const bool unsignedType = attribs[a].type == MESH_TYPE_UNSIGNED_BYTE;
+        for (int i = 0; i < 10000 && passed; i++)
+        {
+            float values[4];
+            float unpacked[4];
+            uint8_t vertex[8] = { 0 };
+            for (int k = 0; k < 4; k++)
+                values[k] = randomFloat(unsignedType ? 0.f : -1.f, 1.f);
+            if (i < 3)
+                values[0] = values[1] = values[2] = unsignedType ? (float)i * 0.5f : (float)i - 1.f;
+            if (attribs[a].type == MESH_TYPE_INT_2_10_10_10_REV)
+                values[3] = (float)(rand() % 3 - 1);
+            vertexFormat_encode(&attribs[a], vertex, values);
+            vertexFormat_decode(&attribs[a], vertex, unpacked);
+            for (int k = 0; k < 4 && passed; k++)
+                passed = expect(fabsf(unpacked[k] - values[k]) <= 0.5f * steps[a] * (1.f + 4.f * FLT_EPSILON) + FLT_EPSILON,
+                    "type %04x component %d: %.9g came back as %.9g", attribs[a].type, k, values[k], unpacked[k]);
+        }
+    }
+    return passed;
+}
+
+#define TEST_SIMPLIFY_GUARD 16
+
+// Simplifies the grid to shrinking budgets. The result must be whole
+// triangles with in-range, distinct corners, must shrink, and must not write
+// past the indexCount indices the header asks target to hold.
+static bool test_meshOptimize_simplify(void)
+{
+    static float positions[3 * TEST_GRID_SIZE * TEST_GRID_SIZE];
+    static uint32_t indices[6 * (TEST_GRID_SIZE - 1) * (TEST_GRID_SIZE - 1)];
+    static uint32_t simplified[6 * (TEST_GRID_SIZE - 1) * (TEST_GRID_SIZE - 1) + TEST_SIMPLIFY_GUARD];
+    const uint32_t vertexCount = TEST_GRID_SIZE * TEST_GRID_SIZE;
+    srand(6666);
+    const size_t indexCount = gridMesh(positions, indices);
+
+    const float ratios[] = { 0.75f, 0.5f, 0.25f, 0.f };
+    size_t previousCount = indexCount;
+    bool passed = true;
+    for (size_t r = 0; r < sizeof(ratios) / sizeof(ratios[0]) && passed; r++)
+    {
+        for (size_t i = 0; i < TEST_SIMPLIFY_GUARD; i++)
+            simplified[indexCount + i] = 0xDEADBEEFu;
+        const size_t targetCount = (size_t)((float)indexCount * ratios[r]) / 3 * 3;
+        float error = -1.f;
+        const size_t count = meshOptimize_simplify(simplified, indices, indexCount, positions, vertexCount, 3 * sizeof(float), targetCount, &error);
+
+        passed = expect(count % 3 == 0 && count > 0 && count <= previousCount, "simplifying to %zu indices gave %zu after %zu", targetCount, count, previousCount);
+        passed = passed && expect(targetCount == 0 || count <= targetCount, "simplifying to %zu indices stopped at %zu", targetCount, count);
+        passed = passed && expect(error >= 0.f && isfinite(error), "simplifying to %zu indices reported an error of %g", targetCount, error);
+        for (size_t i = 0; i < count && passed; i += 3)
+        {
+            const uint32_t* triangle = &simplified[i];
+            passed = expect(triangle[0] < vertexCount && triangle[1] < vertexCount && triangle[2] < vertexCount, "triangle %zu has an index out of range", i / 3);
+            passed = passed && expect(triangle[0] != triangle[1] && triangle[1] != triangle[2] && triangle[0] != triangle[2], "triangle %zu is degenerate", i / 3);
+        }
+        for (size_t i = 0; i < TEST_SIMPLIFY_GUARD && passed; i++)
+            passed = expect(simplified[indexCount + i] == 0xDEADBEEFu, "simplify wrote past indexCount");
+        previousCount = count;
+    }
+    return passed;
+}
+
+#define TEST(name) { #name, test_##name }
+
+static const Test tests[] =
+{
+    TEST(allocations_framePath),
+    TEST(kernels_matchScalar),
+    TEST(batch_matchesScalar),
+    TEST(textureCache_streamsWithinBudget),
+    TEST(gpuArena_defragment),
+    TEST(mesh_rejectsMalformed),
+    TEST(meshOptimize_vertexCache),
+    TEST(meshOptimize_simplify),
+    TEST(vertexFormat_roundTrip),
+    TEST(culling_matchesPerObject),
+    TEST(bvh_matchesBruteForce),
+    TEST(renderQueue_sortMatchesQsort),
+};
+
+static void printUsage(const char* program)
+{
+    fprintf(stderr, "Usage: %s [--filter TEXT]\n", program);
+}
+
+int main(int argc, char** argv)
+{
+    const char* filter = NULL;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+            filter = argv[++i];
+        else
+        {
+            printUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    size_t run = 0;
+    size_t failed = 0;
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++)
+    {
+        const Test* test = &tests[i];
+        if (filter != NULL && strstr(test->name, filter) == NULL)
+            continue;
+        currentTest = test->name;
+        const bool passed = test->run();
+        printf("%s %s\n", passed ? "PASS" : "FAIL", test->name);
+        failed += passed ? 0 : 1;
+        run++;
+    }
+    if (windowCreated)
+        window_destroy(&window);
+    printf("%zu of %zu tests passed\n", run - failed, run);
+    return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,269 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "../include/Mesh.h"
+#include "../include/MeshOptimize.h"
+
+#define LOAD_BENCH_RUNS 5
+
+// Half-float position, 2_10_10_10 normal and half-float texcoord: 12 or 16
+// bytes a vertex instead of 24 or 32. Half floats keep about three decimal
+// digits, so very large models should be authored in local units.
+static const MeshAttrib packedAttribs[] =
+{
+    { 0, 3, MESH_TYPE_HALF_FLOAT, 0, 0 },
+    { 1, 4, MESH_TYPE_INT_2_10_10_10_REV, 1, 8 },
+    { 2, 2, MESH_TYPE_HALF_FLOAT, 0, 12 },
+};
+
+typedef struct
+{
+    bool texcoords;
+    bool packed;
+    bool optimize;
+    uint32_t lodCount;
+    float lodRatio;
+} ConvertOptions;
+
+static double nowMilliseconds(void)
+{
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (double)time.tv_sec * 1e3 + (double)time.tv_nsec * 1e-6;
+}
+
+static void printUsage(const char* program)
+{
+    fprintf(stderr,
+        "Usage: %s [--uv] [--packed] [--no-optimize] [--lods N] [--lod-ratio R]\n"
+        "          <input.obj> <output.mesh>\n"
+        "       %s --bench [--uv] <input.obj> [output.mesh]\n"
+        "Converts a Wavefront OBJ into the binary mesh format. Vertices hold a\n"
+        "float3 position and float3 normal, plus a float2 texcoord with --uv.\n"
+        "--packed stores half-float positions and texcoords, 2_10_10_10 normals\n"
+        "and 16-bit indices where they fit. Triangles and vertices are reordered\n"
+        "for the vertex cache unless --no-optimize is given.\n"
+        "--lods stores up to N levels of detail (at most %d), each with about R\n"
+        "times the triangles of the previous one (default 0.5).\n"
+        "--bench compares parsing the OBJ with mapping the converted file.\n",
+        program,
+        program,
+        MESH_MAX_LODS
+    );
+}
+
+static int convert(const char* input, const char* output, ConvertOptions options)
+{
+    MeshData data;
+    const double start = nowMilliseconds();
+    if (!meshData_parseObj(&data, input, options.texcoords))
+    {
+        return EXIT_FAILURE;
+    }
+    const double parsed = nowMilliseconds();
+
+    if (options.lodCount > 1)
+    {
+        meshData_generateLods(&data, options.lodCount, options.lodRatio);
+        for (uint32_t i = 0; i < data.lodCount; i++)
+        {
+            printf("lod %u: %u triangles, error %g\n", i, data.lods[i].indexCount / 3, data.lods[i].error);
+        }
+    }
+
+    const uint32_t vertexCount = data.vertexCount;
+    const uint32_t vertexStride = data.vertexStride;
+    const float acmr16 = meshOptimize_acmr(data.indices, data.indexCount, data.vertexCount, 16);
+    const float acmr32 = meshOptimize_acmr(data.indices, data.indexCount, data.vertexCount, 32);
+    if (options.optimize)
+    {
+        meshData_optimize(&data);
+        printf(
+            "vertex cache: ACMR %.3f -> %.3f (16 entries), %.3f -> %.3f (32 entries)\n",
+            acmr16,
+            meshOptimize_acmr(data.indices, data.indexCount, data.vertexCount, 16),
+            acmr32,
+            meshOptimize_acmr(data.indices, data.indexCount, data.vertexCount, 32)
+        );
+    }
+    if (options.packed)
+    {
+        meshData_convert(&data, packedAttribs, options.texcoords ? 3 : 2, options.texcoords ? 16 : 12);
+        meshData_narrowIndices(&data);
+    }
+    printf(
+        "vertex data: %u bytes -> %u bytes (%u -> %u bytes a vertex, %u-bit indices)\n",
+        vertexCount * vertexStride + data.indexCount * (uint32_t)sizeof(uint32_t),
+        data.vertexCount * data.vertexStride + data.indexCount * data.indexSize,
+        vertexStride,
+        data.vertexStride,
+        8 * data.indexSize
+    );
+
+    // Optimization, LODs and narrowing all rewrite the indices, so check them
+    // once more before anything can load them.
+    if (!mesh_checkIndices(data.indices, data.indexCount, data.indexSize, data.vertexCount))
+    {
+        fprintf(stderr, "Failed to convert %s, an index is out of range of its %u vertices!\n", input, data.vertexCount);
+        meshData_free(&data);
+        return EXIT_FAILURE;
+    }
+    if (!meshData_save(&data, output))
+    {
+        meshData_free(&data);
+        return EXIT_FAILURE;
+    }
+
+    printf(
+        "%s: %u vertices, %u triangles, %u LODs, bounds (%g %g %g)-(%g %g %g), parsed in %.2f ms\n",
+        output,
+        data.vertexCount,
+        data.lods[0].indexCount / 3,
+        data.lodCount,
+        data.bounds.min.x, data.bounds.min.y, data.bounds.min.z,
+        data.bounds.max.x, data.bounds.max.y, data.bounds.max.z,
+        parsed - start
+    );
+    meshData_free(&data);
+    return EXIT_SUCCESS;
+}
+
+// Best of a few runs each. The mapped path copies both blobs once, which is
+// the work glBufferData would do with the same pointers.
+static int benchmark(const char* input, const char* output, bool texcoords)
+{
+    double parseBest = 1e30;
+    MeshData data = { 0 };
+    for (int run = 0; run < LOAD_BENCH_RUNS; run++)
+    {
+        meshData_free(&data);
+        const double start = nowMilliseconds();
+        if (!meshData_parseObj(&data, input, texcoords))
+        {
+            return EXIT_FAILURE;
+        }
+        const double elapsed = nowMilliseconds() - start;
+        parseBest = elapsed < parseBest ? elapsed : parseBest;
+    }
+    if (!meshData_save(&data, output))
+    {
+        meshData_free(&data);
+        return EXIT_FAILURE;
+    }
+
+    const size_t vertexBytes = (size_t)data.vertexCount * data.vertexStride;
+    const size_t indexBytes = (size_t)data.indexCount * data.indexSize;
+    void* scratch = malloc(vertexBytes + indexBytes);
+    if (scratch == NULL)
+    {
+        fprintf(stderr, "Failed to allocate the benchmark buffer!\n");
+        meshData_free(&data);
+        return EXIT_FAILURE;
+    }
+
+    double loadBest = 1e30;
+    for (int run = 0; run < LOAD_BENCH_RUNS; run++)
+    {
+        Mesh mesh;
+        const double start = nowMilliseconds();
+        if (!mesh_load(&mesh, output, 0))
+        {
+            free(scratch);
+            meshData_free(&data);
+            return EXIT_FAILURE;
+        }
+        memcpy(scratch, mesh.vertices, vertexBytes);
+        memcpy((char*)scratch + vertexBytes, mesh.indices, indexBytes);
+        mesh_unload(&mesh);
+        const double elapsed = nowMilliseconds() - start;
+        loadBest = elapsed < loadBest ? elapsed : loadBest;
+    }
+
+    const double megabytes = (double)(vertexBytes + indexBytes) / (1024.0 * 1024.0);
+    printf("mesh,vertices,triangles,megabytes,parse_ms,load_ms,speedup,load_mb_per_s\n");
+    printf(
+        "%s,%u,%u,%.2f,%.3f,%.3f,%.1f,%.0f\n",
+        input,
+        data.vertexCount,
+        data.indexCount / 3,
+        megabytes,
+        parseBest,
+        loadBest,
+        parseBest / loadBest,
+        megabytes / (loadBest * 1e-3)
+    );
+    free(scratch);
+    meshData_free(&data);
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv)
+{
+    bool bench = false;
+    ConvertOptions options = { .texcoords = false, .packed = false, .optimize = true, .lodCount = 1, .lodRatio = 0.5f };
+    const char* paths[2] = { NULL, NULL };
+    int pathCount = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--bench") == 0)
+        {
+            bench = true;
+        }
+        else if (strcmp(argv[i], "--uv") == 0)
+        {
+            options.texcoords = true;
+        }
+        else if (strcmp(argv[i], "--packed") == 0)
+        {
+            options.packed = true;
+        }
+        else if (strcmp(argv[i], "--no-optimize") == 0)
+        {
+            options.optimize = false;
+        }
+        else if (strcmp(argv[i], "--lods") == 0 && i + 1 < argc)
+        {
+            const int lodCount = atoi(argv[++i]);
+            if (lodCount < 1 || lodCount > MESH_MAX_LODS)
+            {
+                printUsage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            options.lodCount = (uint32_t)lodCount;
+        }
+        else if (strcmp(argv[i], "--lod-ratio") == 0 && i + 1 < argc)
+        {
+            options.lodRatio = strtof(argv[++i], NULL);
+            if (!(options.lodRatio > 0.f && options.lodRatio < 1.f))
+            {
+                printUsage(argv[0]);
+                return EXIT_FAILURE;
+            }
+        }
+        else if (argv[i][0] != '-' && pathCount < 2)
+        {
+            paths[pathCount++] = argv[i];
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (bench && pathCount >= 1)
+    {
+        return benchmark(paths[0], pathCount == 2 ? paths[1] : "/tmp/meshconvert_bench.mesh", options.texcoords);
+    }
+    if (!bench && pathCount == 2)
+    {
+        return convert(paths[0], paths[1], options);
+    }
+    printUsage(argv[0]);
+    return EXIT_FAILURE;
+}